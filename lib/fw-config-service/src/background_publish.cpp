@@ -22,10 +22,23 @@
 BackgroundPublish::~BackgroundPublish()
 {
     stop();
+    if(wake_queue)
+    {
+        os_queue_destroy(wake_queue, nullptr);
+        wake_queue = NULL;
+    }
 }
 
 void BackgroundPublish::start()
 {
+    // room for a wakeup from each queued publish and from stop(), a wakeup
+    // that doesn't fit isn't needed as the thread has one waiting already
+    if(!wake_queue && os_queue_create(&wake_queue, sizeof(uint8_t), BACKGROUND_PUBLISH_QUEUE_SIZE + 1, nullptr))
+    {
+        wake_queue = NULL;
+        return;
+    }
+
     if(!thread)
     {
         // use OS_THREAD_PRIORITY_DEFAULT so that application, system, and
@@ -42,80 +55,125 @@ void BackgroundPublish::stop()
     if(thread)
     {
         state = BACKGROUND_PUBLISH_STOP;
+        wake();
         thread->dispose();
         delete thread;
         thread = NULL;
     }
 }
 
+// highest priority pending publish, the earliest requested among equals
+background_publish_entry_t *BackgroundPublish::next()
+{
+    background_publish_entry_t *entry = NULL;
+
+    for(auto &it : queue)
+    {
+        if(!it.pending)
+        {
+            continue;
+        }
+        if(!entry ||
+            it.priority > entry->priority ||
+            (it.priority == entry->priority && (int32_t) (it.sequence - entry->sequence) < 0))
+        {
+            entry = &it;
+        }
+    }
+    return entry;
+}
+
+void BackgroundPublish::wake()
+{
+    uint8_t event = 0;
+    os_queue_put(wake_queue, &event, 0, nullptr);
+}
+
+void BackgroundPublish::wait(system_tick_t timeout)
+{
+    uint8_t event;
+    os_queue_take(wake_queue, &event, timeout, nullptr);
+    wakeup_count++;
+}
+
 void BackgroundPublish::thread_f()
 {
     while(true)
     {
+        // block until there is something to publish, a wakeup left over
+        // from a publish already handled just goes round again
+        system_tick_t idle_start = millis();
         while(state == BACKGROUND_PUBLISH_IDLE)
         {
-            // yield to rest of system while we wait
-            // a condition variable would be ideal but doesn't look like
-            // std::condition_variable is supported
-            delay(1);
+            wait(CONCURRENT_WAIT_FOREVER);
         }
+        idle_time_ms += millis() - idle_start;
 
         if(state == BACKGROUND_PUBLISH_STOP)
         {
             break;
         }
 
-        // temporarily acquire the lock
-        // this allows a calling thread to block the publish thread if it needs
-        // additional synchronization around a publish request and acts as a
-        // memory barrier around publish arguments to ensure all updates
-        // are complete
-        lock();
-        unlock();
+        // acquiring the lock allows a calling thread to block the publish
+        // thread if it needs additional synchronization around a publish
+        // request and acts as a memory barrier around publish arguments to
+        // ensure all updates are complete
+        // the entry isn't touched by publish() again until it is released
+        background_publish_entry_t *entry;
+        WITH_LOCK(*this)
+        {
+            entry = next();
+        }
 
         // kick off the publish
         // WITH_ACK does not work as expected from a background thread
         // use the Future<bool> object directly as its default wait
         // (used by WITH_ACK) short-circuits when not called from the
         // main application thread
-        auto ok = Particle.publish(event_name, event_data, event_flags);
+        auto ok = Particle.publish(entry->event_name, entry->event_data, entry->event_flags);
 
-        // then wait for publish to complete
+        // then wait for publish to complete, the future wakes the thread
+        // when it does
+        ok.onSuccess([this](bool) { wake(); });
+        ok.onError([this](const particle::Error &) { wake(); });
         while(!ok.isDone() && state != BACKGROUND_PUBLISH_STOP)
         {
-            // yield to rest of system while we wait
-            delay(1);
+            wait(BACKGROUND_PUBLISH_WAIT_MS);
         }
         publish_status_t status = ok.isSucceeded() ? BACKGROUND_PUBLISH_STATUS_SUCCESS : BACKGROUND_PUBLISH_STATUS_FAILURE;
 
-        if(completed_cb)
+        if(entry->completed_cb)
         {
-            completed_cb(status,
-                event_name,
-                event_data,
-                event_context);
+            entry->completed_cb(status,
+                entry->event_name,
+                entry->event_data,
+                entry->event_context);
         }
-        
+
         WITH_LOCK(*this)
         {
             if(state == BACKGROUND_PUBLISH_STOP)
             {
                 break;
             }
-            event_context = NULL;
-            completed_cb = NULL;
-            state = BACKGROUND_PUBLISH_IDLE;
+            entry->event_context = NULL;
+            entry->completed_cb = NULL;
+            entry->pending = false;
+            if(!next())
+            {
+                state = BACKGROUND_PUBLISH_IDLE;
+            }
         }
     }
 }
 
-bool BackgroundPublish::publish(const char *name, const char *data, PublishFlags flags, publish_completed_cb_t cb, const void *context)
+bool BackgroundPublish::publish(const char *name, const char *data, PublishFlags flags, publish_completed_cb_t cb, const void *context, publish_priority_t priority)
 {
     // protect against separate threads trying to publish at the same time
     std::lock_guard<RecursiveMutex> lg(mutex);
 
-    // check currently in idle state and ready to accept publish request
-    if(!thread || state != BACKGROUND_PUBLISH_IDLE)
+    // check running and ready to accept publish request
+    if(!thread || state == BACKGROUND_PUBLISH_STOP)
     {
         return false;
     }
@@ -127,25 +185,44 @@ bool BackgroundPublish::publish(const char *name, const char *data, PublishFlags
         return false;
     }
 
-    // have the lock and thread is currently idle
+    background_publish_entry_t *entry = NULL;
+    for(auto &it : queue)
+    {
+        if(!it.pending)
+        {
+            entry = &it;
+            break;
+        }
+    }
+
+    if(!entry)
+    {
+        return false;
+    }
+
+    // have the lock and the entry is free
     // safe to prepare publish request
-    strncpy(event_name, name, sizeof(event_name));
-    event_name[sizeof(event_name)-1] = '\0'; // ensure null termination
+    strncpy(entry->event_name, name, sizeof(entry->event_name));
+    entry->event_name[sizeof(entry->event_name)-1] = '\0'; // ensure null termination
 
     if(data)
     {
-        strncpy(event_data, data, sizeof(event_data));
-        event_data[sizeof(event_data)-1] = '\0'; // ensure null termination
+        strncpy(entry->event_data, data, sizeof(entry->event_data));
+        entry->event_data[sizeof(entry->event_data)-1] = '\0'; // ensure null termination
     }
     else
     {
-        event_data[0] = '\0'; // null terminate at start for no event data
+        entry->event_data[0] = '\0'; // null terminate at start for no event data
     }
 
-    completed_cb = cb;
-    event_context = context;
-    event_flags = flags;
+    entry->completed_cb = cb;
+    entry->event_context = context;
+    entry->event_flags = flags;
+    entry->priority = priority;
+    entry->sequence = sequence++;
+    entry->pending = true;
     state = BACKGROUND_PUBLISH_REQUESTED;
+    wake();
 
     return true;
 }
@@ -23,6 +23,18 @@ using namespace std::placeholders;
 #include <spark_wiring_thread.h>
 #include <protocol_defs.h>
 
+// publishes that can be waiting at the same time, including the one in
+// progress
+#ifndef BACKGROUND_PUBLISH_QUEUE_SIZE
+    #define BACKGROUND_PUBLISH_QUEUE_SIZE (4)
+#endif
+
+// longest the thread blocks waiting on a publish to complete before checking
+// it again, completion normally wakes it straight away
+#ifndef BACKGROUND_PUBLISH_WAIT_MS
+    #define BACKGROUND_PUBLISH_WAIT_MS (1000)
+#endif
+
 typedef enum {
     BACKGROUND_PUBLISH_IDLE = 0,
     BACKGROUND_PUBLISH_REQUESTED,
@@ -34,11 +46,33 @@ typedef enum {
     BACKGROUND_PUBLISH_STATUS_FAILURE,
 } publish_status_t;
 
+// waiting publishes go out highest priority first and in the order they were
+// requested within the same priority
+typedef enum {
+    BACKGROUND_PUBLISH_PRIORITY_LOW = 0,
+    BACKGROUND_PUBLISH_PRIORITY_NORMAL,
+    BACKGROUND_PUBLISH_PRIORITY_HIGH,
+} publish_priority_t;
+
 typedef std::function<void(publish_status_t status,
     const char *event_name,
     const char *event_data,
     const void *event_context)> publish_completed_cb_t;
 
+typedef struct {
+    // arguments for Particle.publish
+    char event_name[particle::protocol::MAX_EVENT_NAME_LENGTH+1];
+    char event_data[particle::protocol::MAX_EVENT_DATA_LENGTH+1];
+    PublishFlags event_flags;
+    // callback when publish completes
+    publish_completed_cb_t completed_cb;
+    const void *event_context;
+    publish_priority_t priority;
+    // order the publish was requested in
+    uint32_t sequence;
+    bool pending;
+} background_publish_entry_t;
+
 class BackgroundPublish
 {
     public:
@@ -48,11 +82,13 @@ class BackgroundPublish
 
         void stop();
 
+        // queues the publish, returns false if the queue is full
         bool publish(const char *name,
             const char *data = NULL,
             PublishFlags flags = PRIVATE,
             publish_completed_cb_t cb = NULL,
-            const void *context = NULL);
+            const void *context = NULL,
+            publish_priority_t priority = BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         template <typename T>
         bool publish(const char *name,
@@ -60,7 +96,8 @@ class BackgroundPublish
             PublishFlags flags = PRIVATE,
             void (T::*cb)(publish_status_t status, const char *, const char *, const void *) = NULL,
             T *instance = NULL,
-            const void *context = NULL);
+            const void *context = NULL,
+            publish_priority_t priority = BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         bool try_lock() {return mutex.try_lock();};
 
@@ -70,19 +107,29 @@ class BackgroundPublish
 
         bool idle() { return state == BACKGROUND_PUBLISH_IDLE; }
 
+        // times the thread has woken up and the time it has spent waiting
+        // with nothing to publish
+        uint32_t wakeups() const { return wakeup_count; }
+        uint32_t idle_ms() const { return idle_time_ms; }
+
     private:
         Thread *thread = NULL;
         void thread_f();
+        background_publish_entry_t *next();
+        void wake();
+        void wait(system_tick_t timeout);
         RecursiveMutex mutex;
+        // idle once every queued publish has completed
         volatile publish_thread_state_t state = BACKGROUND_PUBLISH_IDLE;
 
-        // arguments for Particle.publish
-        char event_name[particle::protocol::MAX_EVENT_NAME_LENGTH+1];
-        char event_data[particle::protocol::MAX_EVENT_DATA_LENGTH+1];
-        PublishFlags event_flags;
-        // callback when publish completes
-        publish_completed_cb_t completed_cb = NULL;
-        const void *event_context = NULL;
+        background_publish_entry_t queue[BACKGROUND_PUBLISH_QUEUE_SIZE] = {};
+        uint32_t sequence = 0;
+
+        // the thread blocks on the queue until a publish is requested or
+        // completes or the thread is stopped
+        os_queue_t wake_queue = NULL;
+        volatile uint32_t wakeup_count = 0;
+        volatile uint32_t idle_time_ms = 0;
 };
 
 template <typename T>
@@ -91,7 +138,8 @@ bool BackgroundPublish::publish(const char *name,
             PublishFlags flags,
             void (T::*cb)(publish_status_t status, const char *, const char *, const void *),
             T *instance,
-            const void *context)
+            const void *context,
+            publish_priority_t priority)
 {
-    return publish(name, data, flags, std::bind(cb, instance, _1, _2, _3, _4), context);
+    return publish(name, data, flags, std::bind(cb, instance, _1, _2, _3, _4), context, priority);
 }
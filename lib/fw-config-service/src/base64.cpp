@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include "base64.h"
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int base64_encode(const void *data, size_t len, char *out, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    size_t text_len = base64_size(len);
+    if(size <= text_len)
+    {
+        return -ENOSPC;
+    }
+
+    char *pos = out;
+    for(size_t i = 0; i < len; i += 3)
+    {
+        uint32_t group = (uint32_t) bytes[i] << 16;
+        if(i + 1 < len)
+        {
+            group |= (uint32_t) bytes[i + 1] << 8;
+        }
+        if(i + 2 < len)
+        {
+            group |= bytes[i + 2];
+        }
+        *pos++ = BASE64[(group >> 18) & 0x3f];
+        *pos++ = BASE64[(group >> 12) & 0x3f];
+        *pos++ = (i + 1 < len) ? BASE64[(group >> 6) & 0x3f] : '=';
+        *pos++ = (i + 2 < len) ? BASE64[group & 0x3f] : '=';
+    }
+    *pos = '\0';
+    return text_len;
+}
+
+int base64_decode(const char *text, size_t len, uint8_t *out, size_t size)
+{
+    size_t count = 0;
+    uint32_t group = 0;
+    unsigned bits = 0;
+
+    for(size_t i = 0; i < len && text[i] != '='; i++)
+    {
+        const char *digit = (const char *) memchr(BASE64, text[i], sizeof(BASE64) - 1);
+        if(!digit)
+        {
+            return -EINVAL;
+        }
+        group = (group << 6) | (uint32_t) (digit - BASE64);
+        bits += 6;
+        if(bits >= 8)
+        {
+            bits -= 8;
+            if(count >= size)
+            {
+                return -ENOSPC;
+            }
+            out[count++] = (group >> bits) & 0xff;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// length of the base64 text for len bytes, without the terminator
+static inline size_t base64_size(size_t len)
+{
+    return ((len + 2) / 3) * 4;
+}
+
+// writes the data as terminated base64 text, returns the text length
+int base64_encode(const void *data, size_t len, char *out, size_t size);
+// decodes base64 text, returns the bytes decoded
+int base64_decode(const char *text, size_t len, uint8_t *out, size_t size);
@@ -25,7 +25,7 @@
 CloudService *CloudService::_instance = nullptr;
 
 CloudService::CloudService() :
-    _writer(json_buf, sizeof(json_buf)), _req_id(1)
+    _writer(json_buf, sizeof(json_buf)), _writer_req_id(0), _req_id(1)
 {
 }
 
@@ -250,11 +250,12 @@ int CloudService::beginCommand(const char *cmd)
     // I2C device in order to format into the output command)
     mutex.lock();
 
-    _writer = JSONBufferWriter(json_buf, sizeof(json_buf)); // reset the output
+    _writer = CloudServiceWriter(json_buf, sizeof(json_buf)); // reset the output
 
     writer().beginObject();
     writer().name(CLOUD_KEY_CMD).value(cmd);
     snprintf(_writer_event_name, sizeof(_writer_event_name), CLOUD_PUB_PREFIX "%s", cmd);
+    _writer_req_id = 0;
     writer().name(CLOUD_KEY_TIME).value((unsigned int) Time.now());
 
     return 0;
@@ -338,17 +339,31 @@ int CloudService::send(const char *event,
     unsigned int timeout_ms,
     const void *context,
     const char *event_name,
-    uint32_t req_id)
+    uint32_t req_id,
+    publish_priority_t priority)
 {
     int rval = 0;
     size_t event_len = strlen(event);
     std::lock_guard<RecursiveMutex> lg(mutex);
 
-    if(!event_name ||
+    if(event == json_buf)
+    {
+        // the command in the writer, its cmd and req_id were kept as it
+        // was written
+        if(!event_name)
+        {
+            event_name = _writer_event_name;
+        }
+        if(!req_id)
+        {
+            req_id = _writer_req_id;
+        }
+    }
+    else if(!event_name ||
         (!req_id && cb && (cloud_flags & CloudServicePublishFlags::FULL_ACK)))
     {
-        // should have request id or event name but it wasn't passed in
-        // extract from event
+        // an event kept elsewhere should have request id or event name but
+        // it wasn't passed in, extract from event
         JSONValue root = JSONValue::parseCopy(event, event_len);
         _get_common_fields(root, &event_name, nullptr, &req_id, nullptr);
 
@@ -356,14 +371,21 @@ int CloudService::send(const char *event,
         {
             return -EINVAL;
         }
-    }    
 
-    strlcpy(_writer_event_name, event_name, sizeof(_writer_event_name));
+        // the name points into the parsed copy, keep it before that is freed
+        strlcpy(_writer_event_name, event_name, sizeof(_writer_event_name));
+        event_name = _writer_event_name;
+    }
+
+    if(event_name != _writer_event_name)
+    {
+        strlcpy(_writer_event_name, event_name, sizeof(_writer_event_name));
+    }
 
     // much simpler if there is no callback and can just publish into the void
     if(!cb)
     {
-        if(!background_publish.publish(_writer_event_name, event))
+        if(!background_publish.publish(_writer_event_name, event, PRIVATE, NULL, NULL, priority))
         {
             rval = -EBUSY;
         }
@@ -408,7 +430,7 @@ int CloudService::send(const char *event,
         send_handler->cb = cb;
         send_handler->context = context;
         send_handler->req_data = event;
-        if(!background_publish.publish(_writer_event_name, event, publish_flags | PRIVATE, &CloudService::publish_cb, this, send_handler))
+        if(!background_publish.publish(_writer_event_name, event, publish_flags | PRIVATE, &CloudService::publish_cb, this, send_handler, priority))
         {
             delete send_handler;
             rval = -EBUSY;
@@ -423,32 +445,45 @@ int CloudService::send(const char *event,
     return rval;
 }
 
-int CloudService::send(PublishFlags publish_flags, CloudServicePublishFlags cloud_flags, cloud_service_send_cb_t cb, unsigned int timeout_ms, const void *context)
+int CloudService::end_command(uint32_t req_id)
 {
-    int rval = 0;
     // NOTE: if this JSON object close code changes then estimatedEndCommandSize() must be updated.
     // The general pattern is:
     //       ,\"req_id\":0000000000}
-    uint32_t req_id = (cb && (cloud_flags & CloudServicePublishFlags::FULL_ACK)) ? get_next_req_id() : 0;
-
     if(req_id)
     {
         writer().name(CLOUD_KEY_REQ_ID).value((unsigned int) req_id);
     }
     writer().endObject();
+    _writer_req_id = req_id;
 
     // output json overflowed the buffer
     // dataSize does not include the null terminator
     if(writer().dataSize() >= writer().bufferSize())
     {
-        unlock();
         return -ENOSPC;
     }
 
     // ensure null termination of the output json
     writer().buffer()[writer().dataSize()] = '\0';
 
-    rval = send(writer().buffer(), publish_flags, cloud_flags, cb, timeout_ms, context, _writer_event_name, req_id);
+    return 0;
+}
+
+int CloudService::endCommand(CloudServicePublishFlags cloud_flags)
+{
+    return end_command((cloud_flags & CloudServicePublishFlags::FULL_ACK) ? get_next_req_id() : 0);
+}
+
+int CloudService::send(PublishFlags publish_flags, CloudServicePublishFlags cloud_flags, cloud_service_send_cb_t cb, unsigned int timeout_ms, const void *context, publish_priority_t priority)
+{
+    uint32_t req_id = (cb && (cloud_flags & CloudServicePublishFlags::FULL_ACK)) ? get_next_req_id() : 0;
+
+    int rval = end_command(req_id);
+    if(!rval)
+    {
+        rval = send(writer().buffer(), publish_flags, cloud_flags, cb, timeout_ms, context, _writer_event_name, req_id, priority);
+    }
 
     unlock();
     return rval;
@@ -460,7 +495,8 @@ int CloudService::sendAck(JSONValue &root, int status)
     if(!rval)
     {
         writer().name("status").value(status);
-        rval = send();
+        // the cloud is waiting on the ack, send it ahead of other publishes
+        rval = send(PRIVATE, CloudServicePublishFlags::NONE, nullptr, 0, nullptr, BACKGROUND_PUBLISH_PRIORITY_HIGH);
     }
 
     return rval;
@@ -79,6 +79,22 @@ public:
     String req_data;
 };
 
+// JSON buffer writer that can also take values serialized already, such as
+// a batch of them written into an array
+class CloudServiceWriter : public JSONBufferWriter
+{
+    public:
+        CloudServiceWriter(char *buf, size_t size) : JSONBufferWriter(buf, size) {}
+
+        // writes the json as is inside the array or object begun last, the
+        // caller adds the separators between values
+        CloudServiceWriter &raw(const char *json, size_t size)
+        {
+            write(json, size);
+            return *this;
+        }
+};
+
 class CloudService
 {
     public:
@@ -105,12 +121,17 @@ class CloudService
         int beginCommand(const char *cmd);
         int beginResponse(const char *cmd, JSONValue &root);
         size_t estimatedEndCommandSize() const;
+        // finishes the command in the writer without sending it, for the
+        // caller to keep and send later with send(event, ...), the lock taken
+        // by beginCommand() is kept
+        int endCommand(CloudServicePublishFlags cloud_flags = CloudServicePublishFlags::NONE);
 
         int send(PublishFlags publish_flags = PRIVATE,
             CloudServicePublishFlags cloud_flags = CloudServicePublishFlags::NONE,
             cloud_service_send_cb_t cb=nullptr,
             unsigned int timeout_ms=0,
-            const void *context=nullptr);
+            const void *context=nullptr,
+            publish_priority_t priority=BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         template <typename T>
         int send(PublishFlags publish_flags = PRIVATE,
@@ -118,7 +139,8 @@ class CloudService
             int (T::*cb)(CloudServiceStatus status, JSONValue *, const char *, const void *context)=nullptr,
             T *instance=nullptr,
             uint32_t timeout_ms=0,
-            const void *context=nullptr);
+            const void *context=nullptr,
+            publish_priority_t priority=BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         int send(const char *event,
             PublishFlags publish_flags = PRIVATE,
@@ -127,7 +149,8 @@ class CloudService
             unsigned int timeout_ms=0,
             const void *context=nullptr,
             const char *event_name=nullptr,
-            uint32_t req_id=0);
+            uint32_t req_id=0,
+            publish_priority_t priority=BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         template <typename T>
         int send(const char *event,
@@ -138,11 +161,17 @@ class CloudService
             uint32_t timeout_ms=0,
             const void *context=nullptr,
             const char *event_name=nullptr,
-            uint32_t req_id=0);
+            uint32_t req_id=0,
+            publish_priority_t priority=BACKGROUND_PUBLISH_PRIORITY_NORMAL);
 
         int sendAck(JSONValue &root, int status);
 
-        JSONBufferWriter &writer() { return _writer; };
+        CloudServiceWriter &writer() { return _writer; };
+
+        // cmd of the command begun in writer() and the req_id it was ended
+        // with, for a caller keeping the command to send later
+        const char *commandName() const { return _writer_event_name; }
+        uint32_t commandReqId() const { return _writer_req_id; }
 
         void lock() {mutex.lock();}
         void unlock() {mutex.unlock();}
@@ -184,10 +213,13 @@ class CloudService
         void tick_sec();
 
         uint32_t get_next_req_id();
+        int end_command(uint32_t req_id);
 
         char json_buf[particle::protocol::MAX_EVENT_DATA_LENGTH + 1];
-        JSONBufferWriter _writer;
+        CloudServiceWriter _writer;
         char _writer_event_name[sizeof(CLOUD_PUB_PREFIX) + CLOUD_MAX_CMD_LEN];
+        // kept as the command is written so it is never parsed back out
+        uint32_t _writer_req_id;
 
         // iterate req_id on each send
         uint32_t _req_id;
@@ -223,9 +255,10 @@ int CloudService::send(PublishFlags publish_flags,
     int (T::*cb)(CloudServiceStatus status, JSONValue *, const char *, const void *context),
     T *instance,
     uint32_t timeout_ms,
-    const void *context)
+    const void *context,
+    publish_priority_t priority)
 {
-    return send(publish_flags, cloud_flags, std::bind(cb, instance, _1, _2, _3, _4), timeout_ms, context);
+    return send(publish_flags, cloud_flags, std::bind(cb, instance, _1, _2, _3, _4), timeout_ms, context, priority);
 }
 
 
@@ -238,9 +271,10 @@ int CloudService::send(const char *event,
     uint32_t timeout_ms,
     const void *context,
     const char *event_name,
-    uint32_t req_id)
+    uint32_t req_id,
+    publish_priority_t priority)
 {
-    return send(event, publish_flags, cloud_flags, std::bind(cb, instance, _1, _2, _3, _4), timeout_ms, context, event_name, req_id);
+    return send(event, publish_flags, cloud_flags, std::bind(cb, instance, _1, _2, _3, _4), timeout_ms, context, event_name, req_id, priority);
 }
 
 void log_json(const char *json, size_t size);
@@ -28,8 +28,9 @@ Logger config_service_log("Config Service");
 
 int _config_process_json(JSONValue &json_root, const char *json_root_name, ConfigNode *config_root);
 int config_process_json(const char *json, size_t size, ConfigNode *config_root);
-int config_write_json(ConfigNode *root, JSONWriter &writer);
-void config_hash(ConfigNode *root, murmur3_hash_t &hash);
+
+// room kept in a get_cfg part for the flag written after the config
+static const size_t GET_CFG_LAST_SIZE = sizeof(",\"last\":false") - 1;
 
 static String _format_hash_str(murmur3_hash_t &hash)
 {
@@ -60,106 +61,17 @@ static int _json_parse_hash_str(JSONValue value, murmur3_hash_t &hash)
     return 0;
 }
 
-ConfigNode *ConfigObject::child(const char *name)
-{
-    if(!name)
-    {
-        return nullptr;
-    }
-
-    for(int i=0; i < child_count(); i++)
-    {
-        auto _child = child(i);
-        if(!_child->name() || !strcmp(name, _child->name()))
-        {
-            return _child;
-        }
-    }
-    return nullptr;
-}
-
-int ConfigObject::enter(bool write)
-{
-    if(enter_cb)
-    {
-        return enter_cb(write, (!write || !wcontext) ? context : wcontext);
-    }
-    return 0;
-}
-
-int ConfigObject::exit(bool write, int status)
-{
-    if(exit_cb)
-    {
-        return exit_cb(write, status, (!write || !wcontext) ? context : wcontext);
-    }
-    return status;
-}
-
-bool ConfigFloat::check(double value)
-{
-    return (
-        (isnan(range_min) || value >= range_min) &&
-        (isnan(range_max) || value <= range_max)
-    );
-};
-
-bool ConfigString::check(const char *value)
-{
-    if(!_size || _size == SIZE_MAX)
-    {
-        return true;
-    }
-
-    // need to ensure room for null terminator as well
-    return (strnlen(value, _size) < _size);
-}
-
-int ConfigStringEnum::set(const char *value)
-{
-    if(!this->set_cb)
-    {
-        return -EPERM;
-    }
-
-    for(auto pair : enums)
-    {
-        if(!strcmp(pair.first, value))
-        {
-            return set_cb(pair.second, this->wcontext ? this->wcontext : this->context);
-        }
-    }
-
-    return -EINVAL;
-}
-
-int ConfigStringEnum::get(const char * &value)
-{
-    if(!this->get_cb)
-    {
-        return -EPERM;
-    }
-
-    int32_t enum_val;
-    CHECK(get_cb(enum_val, this->context));
-
-    for(auto pair : enums)
-    {
-        if(pair.second == enum_val)
-        {
-            value = pair.first;
-            return 0;
-        }
-    }
-    return -EINVAL;
-}
-
 ConfigService *ConfigService::_instance = nullptr;
 ConfigService::ConfigService() :
+    last_rehash_sec(0),
+    store(CONFIG_SERVICE_FS_STORE_PATH),
     fs_ok(false),
     sync_pending(false),
     sync_ok(false),
-    config_sync_pending_object(nullptr)
+    config_sync_pending_modules(),
+    get_cfg_request(0),
+    get_cfg_part(0),
+    get_cfg_pending(false)
 {
 }
 
@@ -185,6 +97,11 @@ void ConfigService::init()
             fs_ok = true;
         }
     }
+
+    if(fs_ok && store.open())
+    {
+        fs_ok = false;
+    }
 }
 
 void ConfigService::tick()
@@ -204,7 +121,7 @@ void ConfigService::flush()
     {
         for(auto &it : configs)
         {
-            config_hash(it.root, it.hash);
+            config_hash_changed(it.root, it.hash, it.tree_hash);
         }
         save_all();
     }
@@ -216,10 +133,21 @@ void ConfigService::tick_sec()
     // on crc mismatch
     // make sure we are likely to succeed in publishing first...
 
-    // update hash across all configs once a second for change detection
+    if(last_tick_sec - last_rehash_sec >= CONFIG_SERVICE_REHASH_INTERVAL_SEC)
+    {
+        last_rehash_sec = last_tick_sec;
+        for(auto &it : configs)
+        {
+            it.root->mark_dirty();
+        }
+    }
+
+    // update hash across all configs once a second for change detection,
+    // a module is only read back in full when the parts marked dirty since
+    // the last tick changed its tree hash
     for(auto &it : configs)
     {
-        config_hash(it.root, it.hash);
+        config_hash_changed(it.root, it.hash, it.tree_hash);
     }
 
     if(Particle.connected())
@@ -239,8 +167,8 @@ void ConfigService::tick_sec()
                 cloud_service.beginCommand(CLOUD_CMD_SYNC);
                 cloud_service.writer().name("hash").value(_format_hash_str(hash_accum).c_str());
                 // TODO: Cloud is not sending app ack yet
-                // if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, &ConfigService::sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr))
-                if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE, &ConfigService::sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr))
+                // if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, &ConfigService::sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr, BACKGROUND_PUBLISH_PRIORITY_LOW))
+                if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE, &ConfigService::sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr, BACKGROUND_PUBLISH_PRIORITY_LOW))
                 {
                     sync_pending = true;
                 }
@@ -248,44 +176,201 @@ void ConfigService::tick_sec()
         }
         else
         {
-            if(!config_sync_pending_object)
+            if(config_sync_pending_modules.isEmpty())
             {
-                for(auto &it : configs)
-                {
-                    if(it.hash != it.sync_hash)
-                    {
-                        cloud_service.beginCommand(CLOUD_CMD_CFG);
-                        cloud_service.writer().name("cfg").beginObject();
-                        config_write_json(it.root, cloud_service.writer());
-                        cloud_service.writer().endObject();
-                        // TODO: Cloud is not sending app ack yet
-                        // if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, &ConfigService::config_sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr))
-                        if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE, &ConfigService::config_sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr))
-                        {
-                            config_sync_pending_object = &it;
-                            // possible config could be updated again before ack
-                            // received so save off the hash we sent rather than
-                            // simply using the current hash in the callback
-                            config_sync_pending_hash = it.hash;
-                            break;
-                        }
-                    }
-                }
+                sync_changes();
             }
         }
+
+        if(!get_cfg_modules.isEmpty() && !get_cfg_pending)
+        {
+            get_cfg_send();
+        }
     }
 
     // once a second check all configs and save to filesystem as necessary
     if(fs_ok)
     {
         save_all();
+        if(store.compact_pending())
+        {
+            store.compact();
+        }
     }
 }
 
+// publishes the leaves changed since last acknowledged for as many modules as
+// fit in one event, modules or changes that don't fit follow in later events
+// once this one is acknowledged
+void ConfigService::sync_changes()
+{
+    CloudService &cloud_service = CloudService::instance();
+
+    // changes are collected before taking the cloud lock, possible config
+    // could be updated again before ack received so save off the hash we
+    // sent rather than simply using the current hash in the callback
+    Vector<config_sync_module_t> modules;
+    config_sync_pending_changes.clear();
+    for(auto &it : configs)
+    {
+        if(it.hash != it.sync_hash)
+        {
+            int start = config_sync_pending_changes.size();
+            config_sync_changes(it.root, config_sync_pending_changes);
+            if(config_sync_pending_changes.size() == start)
+            {
+                // changed back to the values the cloud has
+                it.sync_hash = it.hash;
+                continue;
+            }
+            modules.append({&it, it.hash, config_sync_pending_changes.size() - start, false});
+        }
+    }
+
+    if(modules.isEmpty())
+    {
+        return;
+    }
+
+    cloud_service.beginCommand(CLOUD_CMD_CFG);
+    auto &writer = cloud_service.writer();
+    writer.name("cfg").beginObject();
+
+    Vector<config_sync_leaf_t> sent;
+    int start = 0;
+    for(auto &it : modules)
+    {
+        Vector<config_sync_leaf_t> changes(config_sync_pending_changes.data() + start, it.count);
+        start += it.count;
+
+        int error = config_write_json_changes(it.desc->root, writer,
+            writer.bufferSize() - writer.dataSize() - cloud_service.estimatedEndCommandSize() - 1,
+            changes);
+        if(error == -ENOSPC)
+        {
+            if(!config_sync_pending_modules.isEmpty())
+            {
+                break;
+            }
+            // a single value too large to ever publish
+            Log.error("config %s: %s too large to sync", it.desc->root->name(), changes[0].node->name());
+            changes.removeAt(1, changes.size() - 1);
+            config_sync_commit(changes);
+            continue;
+        }
+        sent.append(changes);
+        // the module is back in sync once all of its changes are acknowledged
+        config_sync_pending_modules.append({it.desc, it.hash, changes.size(), changes.size() == it.count});
+        if(changes.size() < it.count)
+        {
+            break;
+        }
+    }
+    config_sync_pending_changes = sent;
+    writer.endObject();
+
+    if(config_sync_pending_modules.isEmpty())
+    {
+        cloud_service.unlock();
+        return;
+    }
+
+    // TODO: Cloud is not sending app ack yet
+    // if(cloud_service.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, &ConfigService::config_sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr, BACKGROUND_PUBLISH_PRIORITY_LOW))
+    if(cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE, &ConfigService::config_sync_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, nullptr, BACKGROUND_PUBLISH_PRIORITY_LOW))
+    {
+        config_sync_pending_modules.clear();
+    }
+}
+
+// publishes the next part of the modules requested by get_cfg, parts are
+// numbered from zero and the last one is flagged so the cloud can merge them
+// back into the whole config
+void ConfigService::get_cfg_send()
+{
+    CloudService &cloud_service = CloudService::instance();
+
+    get_cfg_retry_modules = get_cfg_modules;
+    get_cfg_retry_stream = get_cfg_stream;
+
+    cloud_service.beginCommand(CLOUD_CMD_CFG);
+    auto &writer = cloud_service.writer();
+    writer.name("part").value(get_cfg_part);
+    writer.name("cfg").beginObject();
+    size_t start = writer.dataSize();
+
+    while(!get_cfg_modules.isEmpty())
+    {
+        auto desc = get_cfg_modules.first();
+        if(get_cfg_stream.done())
+        {
+            get_cfg_stream.begin(desc->root);
+        }
+
+        int error = get_cfg_stream.write(writer,
+            writer.bufferSize() - writer.dataSize() - cloud_service.estimatedEndCommandSize() - GET_CFG_LAST_SIZE - 1);
+        if(error == -ENOSPC && writer.dataSize() == start)
+        {
+            // a single value too large to ever publish
+            Log.error("config %s: value too large to publish", desc->root->name());
+            get_cfg_stream.skip();
+            continue;
+        }
+        if(error == -ENOSPC || error == -EAGAIN)
+        {
+            break;
+        }
+        if(error)
+        {
+            Log.error("config %s: failed to publish (%d)", desc->root->name(), error);
+        }
+        get_cfg_modules.removeAt(0);
+    }
+
+    writer.endObject();
+    writer.name("last").value(get_cfg_modules.isEmpty());
+
+    // TODO: Cloud is not sending app ack yet
+    // if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, &ConfigService::get_cfg_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, (const void *) (uintptr_t) get_cfg_request, BACKGROUND_PUBLISH_PRIORITY_LOW))
+    if(!cloud_service.send(WITH_ACK, CloudServicePublishFlags::NONE, &ConfigService::get_cfg_ack_cb, this, CLOUD_DEFAULT_TIMEOUT_MS, (const void *) (uintptr_t) get_cfg_request, BACKGROUND_PUBLISH_PRIORITY_LOW))
+    {
+        get_cfg_pending = true;
+    }
+    else
+    {
+        get_cfg_modules = get_cfg_retry_modules;
+        get_cfg_stream = get_cfg_retry_stream;
+    }
+}
+
+int ConfigService::get_cfg_ack_cb(CloudServiceStatus status, JSONValue *root, const char *req_event, const void *context)
+{
+    get_cfg_pending = false;
+
+    // a newer get_cfg has started over
+    if((uint32_t) (uintptr_t) context != get_cfg_request)
+    {
+        return 0;
+    }
+
+    if(status == CloudServiceStatus::SUCCESS)
+    {
+        get_cfg_part++;
+    }
+    else
+    {
+        get_cfg_modules = get_cfg_retry_modules;
+        get_cfg_stream = get_cfg_retry_stream;
+    }
+
+    return 0;
+}
+
 void ConfigService::resetToFactory()
 {
     // reset to factory by clearing out all config files and performing a
     // device reset
+    store.close();
     auto dir = opendir(CONFIG_SERVICE_FS_PATH);
 
     struct dirent* ent = nullptr;
@@ -310,10 +395,22 @@ String ConfigService::_get_filename(const char *name)
 
 void ConfigService::save_all(bool force)
 {
+    // modules changed together reach flash together
+    store.begin();
     for(auto &it : configs)
     {
         _save(it, force);
     }
+    if(store.commit())
+    {
+        // saved hashes were updated ahead of the commit, clear them so every
+        // module is written again
+        for(auto &it : configs)
+        {
+            it.file_hash = murmur3_hash_t();
+            it.file_sync_hash = murmur3_hash_t();
+        }
+    }
 }
 
 int ConfigService::save(const char *name, bool force)
@@ -329,11 +426,6 @@ int ConfigService::save(const char *name, bool force)
     return 0;
 }
 
-// A bug in Device-OS 1.5.3 caused newlib to call into the unsupported _link()
-// function rather than the supported _rename() function. As workaround extern
-// the _rename() function (also exported via dynalb) and call directly.
-extern "C" int _rename(const char* oldpath, const char* newpath);
-
 int ConfigService::_save(config_service_desc_t &config_desc, bool force)
 {
     if(!force && config_desc.hash == config_desc.file_hash && config_desc.sync_hash == config_desc.file_sync_hash)
@@ -360,45 +452,13 @@ int ConfigService::_save(config_service_desc_t &config_desc, bool force)
 
     Log.info("saving config %s: %.*s", config_desc.root->name(), (int) writer.dataSize(), writer.buffer());
 
-    // to ensure we always have a valid config write new config to a temp file
-    // and use rename() to move over the original file.
-    // rename() is an atomic operation on the filesystem so will either succeed
-    // or leave the existing config alone to recover in case of interrupution
-    String filename = _get_filename(config_desc.root->name());
-    String temp_filename = filename + ".tmp";
-
-    // new config to the temp file
-    int fd = open(temp_filename, O_CREAT | O_WRONLY | O_TRUNC, 0664);
-    if(fd <= 0)
-    {
-        return -errno;
-    }
-
-    int error = 0;
-    int written = write(fd, writer.buffer(), writer.dataSize());
-    if(written < 0)
-    {
-        error = -errno;
-    }
-    else if(written != (int) writer.dataSize())
-    {
-        error = -EIO;
-    }
-
-    close(fd);
-
-    // then rename over the existing config
+    // appended to the log so the previous record stays valid until the new
+    // one is completely on flash
+    int error = store.write(config_desc.root->name(), writer.buffer(), writer.dataSize());
     if(!error)
     {
-        if(_rename(temp_filename, filename))
-        {
-           error = -errno;
-        }
-        else
-        {
-            config_desc.file_hash = config_desc.hash;
-            config_desc.file_sync_hash = config_desc.sync_hash;
-        }
+        config_desc.file_hash = config_desc.hash;
+        config_desc.file_sync_hash = config_desc.sync_hash;
     }
 
     return error;
@@ -468,6 +528,39 @@ int _process_load(config_service_desc_t &config_desc, char *json, size_t size)
 }
 
 int ConfigService::_load(config_service_desc_t &config_desc)
+{
+    int size = store.find(config_desc.root->name());
+
+    if(size < 0)
+    {
+        // migrate the config file written by older firmware into the log
+        int error = _load_file(config_desc);
+        if(!error && !_save(config_desc, true))
+        {
+            remove(_get_filename(config_desc.root->name()));
+        }
+        return error;
+    }
+
+    char *json = (char *) malloc(size);
+    if(!json)
+    {
+        return -ENOMEM;
+    }
+
+    int error = store.read(config_desc.root->name(), json, size);
+    if(error >= 0)
+    {
+        Log.info("loading config %s: %.*s", config_desc.root->name(), size, json);
+        error = _process_load(config_desc, json, size);
+    }
+
+    free(json);
+
+    return error;
+}
+
+int ConfigService::_load_file(config_service_desc_t &config_desc)
 {
     int error = 0;
     struct stat st;
@@ -542,9 +635,11 @@ int ConfigService::registerModule(ConfigNode &root)
 
     config_service_desc_t desc = {&root};
 
-    if(fs_ok)
+    // leaves are only known to match the cloud when the module was saved
+    // after a complete sync, otherwise the first sync publishes all of them
+    if(fs_ok && !_load(desc))
     {
-        _load(desc);
+        config_sync_reset(desc.root, desc.hash == desc.sync_hash);
     }
 
     configs.push_front(desc);
@@ -570,12 +665,15 @@ int ConfigService::get_cfg_cb(CloudServiceStatus status, JSONValue *root, const
         }
     }
 
+    // the requested modules are published from tick_sec() a part at a time,
+    // a request while one is in progress starts over
+    Vector<config_service_desc_t *> modules;
     if(!config)
     {
         rval = 0;
         for(auto it = configs.begin(); it != configs.end(); it++)
         {
-            it->sync_hash.h[0]--;
+            modules.append(&*it);
         }
     }
     else if(config->isObject())
@@ -585,16 +683,22 @@ int ConfigService::get_cfg_cb(CloudServiceStatus status, JSONValue *root, const
 
         while(obj_it.next())
         {
-            for(auto it = configs.begin(); it != configs.end(); it++)
+            auto it = get_module((const char *) obj_it.name());
+            if(it != configs.end() && !modules.contains(&*it))
             {
-                if(!strcmp(it->root->name(), (const char *) obj_it.name()))
-                {
-                    it->sync_hash.h[0]--;
-                }
+                modules.append(&*it);
             }
         }
     }
 
+    if(!rval)
+    {
+        get_cfg_modules = modules;
+        get_cfg_stream = ConfigJsonStream();
+        get_cfg_request++;
+        get_cfg_part = 0;
+    }
+
     CloudService::instance().sendAck(*root, rval);
 
     return rval;
@@ -625,35 +729,49 @@ int ConfigService::set_cfg_cb(CloudServiceStatus status, JSONValue *root, const
 
     if(config)
     {
-        obj_it = JSONObjectIterator(*config);
+        // the modules in the command are applied all together or not at all,
+        // the current values of each are saved before any is changed
+        std::list<ConfigSnapshot> snapshots;
 
-        while(obj_it.next())
+        obj_it = JSONObjectIterator(*config);
+        while(!rval && obj_it.next())
         {
-            auto it = configs.begin();
-            for(; it != configs.end(); it++)
-            {
-                if(!strcmp(it->root->name(), obj_it.name().data()))
-                {
-                    auto _config = obj_it.value();
-                    auto _rval = _config_process_json(_config, it->root->name(), it->root);
-
-                    // want to continue processing all modules and not abort if
-                    // one module fails but still report overall failure if
-                    // an earlier module fails so only update the overall rval
-                    // on an actual failure code
-                    if(_rval)
-                    {
-                        rval = _rval;
-                    }
-                    break;
-                }
-            }
-
+            auto it = get_module(obj_it.name().data());
             if(it == configs.end())
             {
                 Log.error("%s: unexpected module: %s", __func__, obj_it.name().data());
                 rval = -ENODEV;
+                break;
             }
+            snapshots.emplace_back();
+            rval = snapshots.back().save(it->root);
+        }
+
+        int applied = 0;
+        obj_it = JSONObjectIterator(*config);
+        while(!rval && obj_it.next())
+        {
+            auto it = get_module(obj_it.name().data());
+            auto _config = obj_it.value();
+            applied++;
+            rval = _config_process_json(_config, it->root->name(), it->root);
+        }
+
+        if(rval)
+        {
+            // undo in reverse so a module listed twice ends up as it was
+            // before the first
+            auto snapshot = snapshots.begin();
+            std::advance(snapshot, applied);
+            while(snapshot != snapshots.begin())
+            {
+                (--snapshot)->restore();
+            }
+        }
+        else
+        {
+            // saved at once in a single write rather than on the next tick
+            flush();
         }
     }
     else
@@ -692,12 +810,18 @@ int ConfigService::config_sync_ack_cb(CloudServiceStatus status, JSONValue *root
 {
     if(status == CloudServiceStatus::SUCCESS)
     {
-        if(config_sync_pending_object)
+        config_sync_commit(config_sync_pending_changes);
+        // a module stays out of sync until the last of its changes has been
+        // acknowledged
+        for(auto &it : config_sync_pending_modules)
         {
-            config_sync_pending_object->sync_hash = config_sync_pending_hash;
+            if(it.complete)
+            {
+                it.desc->sync_hash = it.hash;
+            }
         }
     }
-    config_sync_pending_object = nullptr;
+    config_sync_pending_modules.clear();
 
     return 0;
 }
@@ -779,253 +903,3 @@ int config_process_json(const char *json, size_t size, ConfigNode *config_root)
 
     return _config_process_json(json_root, "", config_root);
 }
-
-// writes config as a json object to the output writer
-int config_write_json(ConfigNode *root, JSONWriter &writer)
-{
-    int error = -EINVAL;
-    switch(root->type())
-    {
-        case CONFIG_NODE_TYPE_INT:
-        {
-            int32_t value;
-            error = reinterpret_cast<ConfigInt *>(root)->get(value);
-            if(!error)
-            {
-                writer.name(root->name()).value((int) value);
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_BOOL:
-        {
-            bool value;
-            error = reinterpret_cast<ConfigBool *>(root)->get(value);
-            if(!error)
-            {
-                writer.name(root->name()).value(value);
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_FLOAT:
-        {
-            double value;
-            error = reinterpret_cast<ConfigFloat *>(root)->get(value);
-            if(!error)
-            {
-                writer.name(root->name()).value(value, 10); // !!! TODO !!! temporary fix
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_STRING:
-        {
-            const char *value;
-            error = reinterpret_cast<ConfigString *>(root)->get(value);
-            if(!error)
-            {
-                writer.name(root->name()).value(value);
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_STRING_ENUM:
-        {
-            const char *value;
-            error = reinterpret_cast<ConfigStringEnum *>(root)->get(value);
-            if(!error)
-            {
-                writer.name(root->name()).value(value);
-            }
-        }
-        case CONFIG_NODE_TYPE_ARRAY:
-            break;
-        case CONFIG_NODE_TYPE_UNKNOWN:
-            break;
-        case CONFIG_NODE_TYPE_OBJECT:
-        {
-            auto object_node = reinterpret_cast<ConfigObject *>(root);
-
-            error = object_node->enter(false);
-            if(!error)
-            {
-                if(root->name())
-                {
-                    writer.name(root->name()).beginObject();
-                }
-                else
-                {
-                    writer.beginObject();
-                }
-
-                for(int i=0; i < object_node->child_count(); i++)
-                {
-                    auto child = object_node->child(i);
-                    if(child->name())
-                    {
-                        error = config_write_json(child, writer);
-                    }
-                }
-                writer.endObject();
-                error = object_node->exit(false, error);
-            }
-            break;
-        }
-    }
-
-    return error;
-}
-
-// hash the config structure into the output hash object
-void _config_hash(ConfigNode *root, murmur3_hash_t &hash)
-{
-    int error;
-
-    switch(root->type())
-    {
-        case CONFIG_NODE_TYPE_INT:
-        {
-            int32_t value;
-            error = reinterpret_cast<ConfigInt *>(root)->get(value);
-            if(!error)
-            {
-                murmur3_hash_update(hash, &value, sizeof(value));
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_BOOL:
-        {
-            bool value;
-            error = reinterpret_cast<ConfigBool *>(root)->get(value);
-            if(!error)
-            {
-                murmur3_hash_update(hash, &value, sizeof(value));
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_FLOAT:
-        {
-            double value;
-            error = reinterpret_cast<ConfigFloat *>(root)->get(value);
-            if(!error)
-            {
-                murmur3_hash_update(hash, &value, sizeof(value));
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_STRING:
-        {
-            const char *value;
-            error = reinterpret_cast<ConfigString *>(root)->get(value);
-            if(!error)
-            {
-                murmur3_hash_update(hash, value, strlen(value));
-            }
-            break;
-        }
-        case CONFIG_NODE_TYPE_STRING_ENUM:
-        {
-            const char *value;
-            error = reinterpret_cast<ConfigStringEnum *>(root)->get(value);
-            if(!error)
-            {
-                murmur3_hash_update(hash, value, strlen(value));
-            }
-        }
-        case CONFIG_NODE_TYPE_ARRAY:
-            break;
-        case CONFIG_NODE_TYPE_UNKNOWN:
-            break;
-        case CONFIG_NODE_TYPE_OBJECT:
-        {
-            auto object_node = reinterpret_cast<ConfigObject *>(root);
-
-            error = object_node->enter(false);
-            if(!error)
-            {
-                if(root->name())
-                {
-                    murmur3_hash_update(hash, root->name(), strlen(root->name()));
-                }
-
-                for(int i=0; i < object_node->child_count(); i++)
-                {
-                    auto child = object_node->child(i);
-                    if(child->name())
-                    {
-                        _config_hash(child, hash);
-                    }
-                }
-                object_node->exit(false, error);
-            }
-            break;
-        }
-    }
-}
-
-void config_hash(ConfigNode *root, murmur3_hash_t &hash)
-{
-    murmur3_hash_start(hash, 0);
-    _config_hash(root, hash);
-    murmur3_hash_finalize(hash);
-}
-
-int config_get_int32_cb(int32_t &value, const void *context)
-{
-    value = *(int32_t *)context;
-
-    return 0;
-}
-
-int config_set_int32_cb(int32_t value, const void *context)
-{
-    *(int32_t *)context = value;
-
-    return 0;
-}
-
-int config_get_float_cb(double &value, const void *context)
-{
-    value = *(double *)context;
-
-    return 0;
-
-}
-
-int config_set_float_cb(double value, const void *context)
-{
-    *(double *)context = value;
-
-    return 0;
-}
-
-int config_get_bool_cb(bool &value, const void *context)
-{
-    value = *(bool *)context;
-
-    return 0;
-}
-
-int config_set_bool_cb(bool value, const void *context)
-{
-    *(bool *)context = value;
-
-    return 0;
-}
-
-int config_set_string_cb(const char *value, const void *context)
-{
-    char *s = (char *) context;
-
-    // TODO: This makes me so very nervous but range-checking for the value
-    // string to fit into s already checked before callback execution.
-    // I suppose if the string was mutated in some fashion in between the check
-    // and the copy could still allow for a buffer overflow...
-    strcpy(s, value);
-
-    return 0;
-}
-
-int config_get_string_cb(const char * &value, const void *context)
-{
-    value = (const char *) context;
-
-    return 0;
-}
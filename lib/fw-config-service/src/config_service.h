@@ -22,6 +22,8 @@
 
 #include "cloud_service.h"
 
+#include "config_store.h"
+
 #include "murmur3.h"
 
 #include <list>
@@ -32,6 +34,15 @@
 #define CONFIG_SERVICE_FS_VERSION_KEY "version"
 #define CONFIG_SERVICE_FS_SYNC_HASH_KEY "hash"
 #define CONFIG_SERVICE_FS_VERSION (1)
+// all modules are kept in a single log, per module files from older
+// firmware are migrated into it as the modules register
+#define CONFIG_SERVICE_FS_STORE_PATH CONFIG_SERVICE_FS_PATH "/config.log"
+
+// values changed without being marked dirty, for example a getter reporting
+// live state, are only picked up by a periodic full rehash
+#ifndef CONFIG_SERVICE_REHASH_INTERVAL_SEC
+    #define CONFIG_SERVICE_REHASH_INTERVAL_SEC (60)
+#endif
 
 extern Logger config_service_log;
 
@@ -50,6 +61,8 @@ typedef struct config_service_desc_t {
     // are up to date
     // on mismatch will trigger save to file
     murmur3_hash_t file_sync_hash;
+    // hashes cached by the config objects when hash was last computed
+    murmur3_hash_t tree_hash;
 } config_service_desc_t;
 
 class ConfigService
@@ -93,24 +106,55 @@ class ConfigService
 
         int sync_ack_cb(CloudServiceStatus status, JSONValue *root, const char *req_event, const void *context);
         int config_sync_ack_cb(CloudServiceStatus status, JSONValue *root, const char *req_event, const void *context);
+        int get_cfg_ack_cb(CloudServiceStatus status, JSONValue *root, const char *req_event, const void *context);
 
         // process infrequent actions
         void tick_sec();
+        void sync_changes();
+        void get_cfg_send();
 
         void save_all(bool force=false);
         int save(const char *name, bool force=false);
 
         int _save(config_service_desc_t &config_desc, bool force=false);
         int _load(config_service_desc_t &config_desc);
+        int _load_file(config_service_desc_t &config_desc);
         String _get_filename(const char *name);
 
+        ConfigStore store;
+
         uint32_t last_tick_sec;
+        uint32_t last_rehash_sec;
 
         bool fs_ok;
 
         bool sync_pending;
         bool sync_ok;
 
-        config_service_desc_t *config_sync_pending_object;
-        murmur3_hash_t config_sync_pending_hash;
+        // modules published in the pending sync with the hash at the time,
+        // the number of their changes sent and whether that was all of them
+        typedef struct {
+            config_service_desc_t *desc;
+            murmur3_hash_t hash;
+            int count;
+            bool complete;
+        } config_sync_module_t;
+
+        Vector<config_sync_module_t> config_sync_pending_modules;
+        // leaves published in the pending sync
+        Vector<config_sync_leaf_t> config_sync_pending_changes;
+
+        // modules requested by get_cfg still to publish, streamed one
+        // numbered part at a time with the next part sent once the previous
+        // is acknowledged
+        Vector<config_service_desc_t *> get_cfg_modules;
+        ConfigJsonStream get_cfg_stream;
+        // where the part waiting for its ack started, to send it again if it
+        // fails
+        Vector<config_service_desc_t *> get_cfg_retry_modules;
+        ConfigJsonStream get_cfg_retry_stream;
+        // tells acks of a part apart from those of an earlier request
+        uint32_t get_cfg_request;
+        int get_cfg_part;
+        bool get_cfg_pending;
 };
@@ -0,0 +1,1046 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include "config_service_nodes.h"
+
+#include "murmur3.h"
+
+ConfigNode *ConfigObject::child(const char *name)
+{
+    if(!name)
+    {
+        return nullptr;
+    }
+
+    int low = 0;
+    int high = _index.size() - 1;
+    while(low <= high)
+    {
+        int mid = (low + high) / 2;
+        int position = _index[mid];
+        int cmp = strcmp(name, _children[position]->name());
+        if(!cmp)
+        {
+            // an unnamed child declared earlier takes precedence as it would
+            // when searching in order
+            return child((_wildcard >= 0 && _wildcard < position) ? _wildcard : position);
+        }
+        if(cmp < 0)
+        {
+            high = mid - 1;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    // children past those indexed are searched in order
+    for(int i = UINT16_MAX + 1; i < child_count(); i++)
+    {
+        auto position_name = _children[i]->name();
+        if(position_name && !strcmp(name, position_name))
+        {
+            return child((_wildcard >= 0 && _wildcard < i) ? _wildcard : i);
+        }
+    }
+    return child(_wildcard);
+}
+
+void ConfigObject::build_index()
+{
+    _index.clear();
+    _wildcard = -1;
+
+    // children don't change after construction so a one-off insertion sort
+    _index.reserve(child_count());
+    for(int i = 0; i < child_count(); i++)
+    {
+        auto name = _children[i]->name();
+        if(!name)
+        {
+            if(_wildcard < 0)
+            {
+                _wildcard = i;
+            }
+            continue;
+        }
+        if(i > UINT16_MAX)
+        {
+            continue;
+        }
+
+        int j = _index.size();
+        while(j > 0 && strcmp(_children[_index[j - 1]]->name(), name) > 0)
+        {
+            j--;
+        }
+        _index.insert(j, (uint16_t) i);
+    }
+}
+
+int ConfigObject::enter(bool write)
+{
+    if(enter_cb)
+    {
+        return enter_cb(write, (!write || !wcontext) ? context : wcontext);
+    }
+    return 0;
+}
+
+int ConfigObject::exit(bool write, int status)
+{
+    // a write may be committed from shadow values here rather than through
+    // the leaf setters so any value below may have changed
+    if(write)
+    {
+        mark_dirty();
+    }
+
+    if(exit_cb)
+    {
+        return exit_cb(write, status, (!write || !wcontext) ? context : wcontext);
+    }
+    return status;
+}
+
+void ConfigObject::adopt()
+{
+    for(auto &child : _children)
+    {
+        child->_parent = this;
+    }
+}
+
+void ConfigObject::mark_ancestors_dirty()
+{
+    // an object is only ever clean with all of its children clean so the
+    // walk up can stop at the first object already dirty
+    for(auto node = this; node && !node->_dirty; node = node->parent())
+    {
+        node->_dirty = true;
+    }
+}
+
+void ConfigObject::mark_dirty()
+{
+    for(auto &child : _children)
+    {
+        if(child->type() == CONFIG_NODE_TYPE_OBJECT)
+        {
+            reinterpret_cast<ConfigObject *>(child.get())->mark_dirty();
+        }
+    }
+    _dirty = true;
+    if(parent())
+    {
+        parent()->mark_ancestors_dirty();
+    }
+}
+
+void ConfigNode::mark_dirty()
+{
+    if(_parent)
+    {
+        _parent->mark_ancestors_dirty();
+    }
+}
+
+bool ConfigFloat::check(double value)
+{
+    return (
+        (isnan(range_min) || value >= range_min) &&
+        (isnan(range_max) || value <= range_max)
+    );
+};
+
+bool ConfigString::check(const char *value)
+{
+    if(!_size || _size == SIZE_MAX)
+    {
+        return true;
+    }
+
+    // need to ensure room for null terminator as well
+    return (strnlen(value, _size) < _size);
+}
+
+int ConfigStringEnum::set(const char *value)
+{
+    if(!this->set_cb)
+    {
+        return -EPERM;
+    }
+
+    for(auto pair : enums)
+    {
+        if(!strcmp(pair.first, value))
+        {
+            int error = set_cb(pair.second, this->wcontext ? this->wcontext : this->context);
+            if(!error)
+            {
+                mark_dirty();
+            }
+            return error;
+        }
+    }
+
+    return -EINVAL;
+}
+
+int ConfigStringEnum::get(const char * &value)
+{
+    if(!this->get_cb)
+    {
+        return -EPERM;
+    }
+
+    int32_t enum_val;
+    CHECK(get_cb(enum_val, this->context));
+
+    for(auto pair : enums)
+    {
+        if(pair.second == enum_val)
+        {
+            value = pair.first;
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+// hash the value of a leaf into the output hash object
+static void _config_leaf_hash(ConfigNode *root, murmur3_hash_t &hash)
+{
+    int error;
+
+    switch(root->type())
+    {
+        case CONFIG_NODE_TYPE_INT:
+        {
+            int32_t value;
+            error = reinterpret_cast<ConfigInt *>(root)->get(value);
+            if(!error)
+            {
+                murmur3_hash_update(hash, &value, sizeof(value));
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_BOOL:
+        {
+            bool value;
+            error = reinterpret_cast<ConfigBool *>(root)->get(value);
+            if(!error)
+            {
+                murmur3_hash_update(hash, &value, sizeof(value));
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_FLOAT:
+        {
+            double value;
+            error = reinterpret_cast<ConfigFloat *>(root)->get(value);
+            if(!error)
+            {
+                murmur3_hash_update(hash, &value, sizeof(value));
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_STRING:
+        {
+            const char *value;
+            error = reinterpret_cast<ConfigString *>(root)->get(value);
+            if(!error)
+            {
+                murmur3_hash_update(hash, value, strlen(value));
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_STRING_ENUM:
+        {
+            const char *value;
+            error = reinterpret_cast<ConfigStringEnum *>(root)->get(value);
+            if(!error)
+            {
+                murmur3_hash_update(hash, value, strlen(value));
+            }
+        }
+        case CONFIG_NODE_TYPE_ARRAY:
+            break;
+        case CONFIG_NODE_TYPE_UNKNOWN:
+            break;
+        case CONFIG_NODE_TYPE_OBJECT:
+            break;
+    }
+}
+
+const uint32_t *ConfigObject::hash()
+{
+    if(!_dirty)
+    {
+        return _hash;
+    }
+
+    int error = enter(false);
+    if(error)
+    {
+        // try again next time
+        return _hash;
+    }
+
+    murmur3_hash_t hash;
+    murmur3_hash_start(hash, 0);
+    if(name())
+    {
+        murmur3_hash_update(hash, name(), strlen(name()));
+    }
+
+    // child objects contribute their own cached hash rather than their
+    // values so a change is only read back along its path from the root
+    bool clean = true;
+    for(int i=0; i < child_count(); i++)
+    {
+        auto node = child(i);
+        if(!node->name())
+        {
+            continue;
+        }
+        if(node->type() == CONFIG_NODE_TYPE_OBJECT)
+        {
+            auto object_node = reinterpret_cast<ConfigObject *>(node);
+            murmur3_hash_update(hash, object_node->hash(), sizeof(_hash));
+            clean = clean && !object_node->dirty();
+        }
+        else
+        {
+            _config_leaf_hash(node, hash);
+        }
+    }
+    exit(false, error);
+
+    murmur3_hash_finalize(hash);
+    memcpy(_hash, hash.h, sizeof(_hash));
+    _dirty = !clean;
+
+    return _hash;
+}
+
+// streams every value of the tree through the output hash object
+static void _config_hash(ConfigNode *root, murmur3_hash_t &hash)
+{
+    if(root->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        _config_leaf_hash(root, hash);
+        return;
+    }
+
+    auto object_node = reinterpret_cast<ConfigObject *>(root);
+
+    int error = object_node->enter(false);
+    if(!error)
+    {
+        if(root->name())
+        {
+            murmur3_hash_update(hash, root->name(), strlen(root->name()));
+        }
+
+        for(int i=0; i < object_node->child_count(); i++)
+        {
+            auto child = object_node->child(i);
+            if(child->name())
+            {
+                _config_hash(child, hash);
+            }
+        }
+        object_node->exit(false, error);
+    }
+}
+
+void config_hash(ConfigNode *root, murmur3_hash_t &hash)
+{
+    murmur3_hash_start(hash, 0);
+    _config_hash(root, hash);
+    murmur3_hash_finalize(hash);
+}
+
+void config_hash_changed(ConfigNode *root, murmur3_hash_t &hash, murmur3_hash_t &tree_hash)
+{
+    if(root->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        config_hash(root, hash);
+        return;
+    }
+
+    auto object_node = reinterpret_cast<ConfigObject *>(root);
+    if(!memcmp(tree_hash.h, object_node->hash(), sizeof(tree_hash.h)))
+    {
+        return;
+    }
+
+    memcpy(tree_hash.h, object_node->hash(), sizeof(tree_hash.h));
+    config_hash(root, hash);
+}
+
+// writes config as a json object to the output writer
+int config_write_json(ConfigNode *root, JSONWriter &writer)
+{
+    int error = -EINVAL;
+    switch(root->type())
+    {
+        case CONFIG_NODE_TYPE_INT:
+        {
+            int32_t value;
+            error = reinterpret_cast<ConfigInt *>(root)->get(value);
+            if(!error)
+            {
+                writer.name(root->name()).value((int) value);
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_BOOL:
+        {
+            bool value;
+            error = reinterpret_cast<ConfigBool *>(root)->get(value);
+            if(!error)
+            {
+                writer.name(root->name()).value(value);
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_FLOAT:
+        {
+            double value;
+            error = reinterpret_cast<ConfigFloat *>(root)->get(value);
+            if(!error)
+            {
+                writer.name(root->name()).value(value, 10); // !!! TODO !!! temporary fix
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_STRING:
+        {
+            const char *value;
+            error = reinterpret_cast<ConfigString *>(root)->get(value);
+            if(!error)
+            {
+                writer.name(root->name()).value(value);
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_STRING_ENUM:
+        {
+            const char *value;
+            error = reinterpret_cast<ConfigStringEnum *>(root)->get(value);
+            if(!error)
+            {
+                writer.name(root->name()).value(value);
+            }
+        }
+        case CONFIG_NODE_TYPE_ARRAY:
+            break;
+        case CONFIG_NODE_TYPE_UNKNOWN:
+            break;
+        case CONFIG_NODE_TYPE_OBJECT:
+        {
+            auto object_node = reinterpret_cast<ConfigObject *>(root);
+
+            error = object_node->enter(false);
+            if(!error)
+            {
+                if(root->name())
+                {
+                    writer.name(root->name()).beginObject();
+                }
+                else
+                {
+                    writer.beginObject();
+                }
+
+                for(int i=0; i < object_node->child_count(); i++)
+                {
+                    auto child = object_node->child(i);
+                    if(child->name())
+                    {
+                        error = config_write_json(child, writer);
+                    }
+                }
+                writer.endObject();
+                error = object_node->exit(false, error);
+            }
+            break;
+        }
+    }
+
+    return error;
+}
+
+// digest of a leaf value to tell whether it has changed since it was synced,
+// zero is kept to mean not known
+static uint32_t _config_leaf_digest(ConfigNode *leaf)
+{
+    murmur3_hash_t hash;
+
+    murmur3_hash_start(hash, 0);
+    _config_leaf_hash(leaf, hash);
+    murmur3_hash_finalize(hash);
+
+    return hash.h[0] ? hash.h[0] : 1;
+}
+
+int config_sync_changes(ConfigNode *root, Vector<config_sync_leaf_t> &changes)
+{
+    if(root->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        auto digest = _config_leaf_digest(root);
+        if(digest != root->synced())
+        {
+            changes.append({root, digest});
+        }
+        return 0;
+    }
+
+    auto object = reinterpret_cast<ConfigObject *>(root);
+    int error = object->enter(false);
+    for(int i = 0; !error && i < object->child_count(); i++)
+    {
+        auto child = object->child(i);
+        if(child->name())
+        {
+            error = config_sync_changes(child, changes);
+        }
+    }
+    return object->exit(false, error);
+}
+
+static bool _config_sync_contains(const Vector<config_sync_leaf_t> &changes, ConfigNode *node)
+{
+    for(auto &it : changes)
+    {
+        for(ConfigNode *parent = it.node; parent; parent = parent->parent())
+        {
+            if(parent == node)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// bytes a leaf adds to the output, name and value plus the separator
+static size_t _config_sync_leaf_size(ConfigNode *leaf)
+{
+    char buf[64];
+    JSONBufferWriter writer(buf, sizeof(buf));
+
+    writer.beginObject();
+    config_write_json(leaf, writer);
+    writer.endObject();
+
+    return writer.dataSize() - 2 + 1;
+}
+
+// bytes an object adds around its children, "name":{} plus the separator
+static size_t _config_sync_object_size(ConfigNode *object)
+{
+    return strlen(object->name()) + 5 + 1;
+}
+
+static int _config_write_json_changes(ConfigNode *root, JSONWriter &writer, const Vector<config_sync_leaf_t> &changes)
+{
+    if(root->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        return config_write_json(root, writer);
+    }
+
+    auto object = reinterpret_cast<ConfigObject *>(root);
+    int error = object->enter(false);
+    if(!error)
+    {
+        writer.name(root->name()).beginObject();
+        for(int i = 0; !error && i < object->child_count(); i++)
+        {
+            auto child = object->child(i);
+            if(child->name() && _config_sync_contains(changes, child))
+            {
+                error = _config_write_json_changes(child, writer, changes);
+            }
+        }
+        writer.endObject();
+    }
+    return object->exit(false, error);
+}
+
+int config_write_json_changes(ConfigNode *root, JSONWriter &writer, size_t size, Vector<config_sync_leaf_t> &changes)
+{
+    // objects opened so far, the changes are in tree order so the objects of
+    // a leaf already open are always found on the path to the root
+    Vector<ConfigNode *> objects;
+    size_t used = _config_sync_object_size(root);
+    int count = 0;
+
+    for(; count < changes.size(); count++)
+    {
+        auto leaf = changes[count].node;
+        size_t cost = _config_sync_leaf_size(leaf);
+        int opened = 0;
+
+        for(ConfigNode *parent = leaf->parent(); parent && parent != root && !objects.contains(parent); parent = parent->parent())
+        {
+            cost += _config_sync_object_size(parent);
+            objects.append(parent);
+            opened++;
+        }
+
+        if(used + cost > size)
+        {
+            objects.removeAt(objects.size() - opened, opened);
+            break;
+        }
+        used += cost;
+    }
+
+    if(!count && changes.size())
+    {
+        return -ENOSPC;
+    }
+
+    changes.removeAt(count, changes.size() - count);
+    return _config_write_json_changes(root, writer, changes);
+}
+
+void config_sync_commit(const Vector<config_sync_leaf_t> &changes)
+{
+    for(auto &it : changes)
+    {
+        it.node->set_synced(it.digest);
+    }
+}
+
+void config_sync_reset(ConfigNode *root, bool synced)
+{
+    if(root->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        root->set_synced(synced ? _config_leaf_digest(root) : 0);
+        return;
+    }
+
+    // values are only read back when marking them in sync
+    auto object = reinterpret_cast<ConfigObject *>(root);
+    int error = synced ? object->enter(false) : 0;
+    for(int i = 0; !error && i < object->child_count(); i++)
+    {
+        config_sync_reset(object->child(i), synced);
+    }
+    if(synced && !error)
+    {
+        object->exit(false, 0);
+    }
+}
+
+void ConfigJsonStream::begin(ConfigNode *root)
+{
+    _root = root;
+    _position.clear();
+    _skip = false;
+}
+
+void ConfigJsonStream::_open_objects()
+{
+    for(; _opened < _objects.size(); _opened++)
+    {
+        _writer->name(_objects[_opened]->name()).beginObject();
+    }
+}
+
+int ConfigJsonStream::_write_leaf(ConfigNode *leaf)
+{
+    if(_skip)
+    {
+        _skip = false;
+        return 0;
+    }
+
+    size_t cost = _config_sync_leaf_size(leaf);
+    for(int i = _opened; i < _objects.size(); i++)
+    {
+        cost += _config_sync_object_size(_objects[i]);
+    }
+    if(_used + cost > _size)
+    {
+        _full = true;
+        return 0;
+    }
+
+    _open_objects();
+    // a leaf that can't be read is left out as config_write_json() does
+    config_write_json(leaf, *_writer);
+    _used += cost;
+    _count++;
+    return 0;
+}
+
+int ConfigJsonStream::_write_object(ConfigObject *object, int depth)
+{
+    int error = object->enter(false);
+    if(error)
+    {
+        return error;
+    }
+    _objects.append(object);
+
+    // resumes at the position of the node the previous part stopped at
+    int start = (depth < _position.size()) ? _position[depth] : 0;
+    bool empty = true;
+
+    for(int i = start; !error && !_full && i < object->child_count(); i++)
+    {
+        auto child = object->child(i);
+        if(!child->name())
+        {
+            continue;
+        }
+        empty = false;
+
+        // past the node resumed at the rest is written from the start
+        if(i != start || depth >= _position.size())
+        {
+            _position.resize(depth + 1);
+            _position[depth] = i;
+        }
+
+        if(child->type() == CONFIG_NODE_TYPE_OBJECT)
+        {
+            error = _write_object(reinterpret_cast<ConfigObject *>(child), depth + 1);
+        }
+        else
+        {
+            error = _write_leaf(child);
+        }
+    }
+
+    // an object without children is written as it is, the objects it is
+    // nested in are opened for it like for a leaf
+    if(!error && empty && !start)
+    {
+        size_t cost = 0;
+        for(int i = _opened; i < _objects.size(); i++)
+        {
+            cost += _config_sync_object_size(_objects[i]);
+        }
+        if(_used + cost > _size)
+        {
+            _full = true;
+        }
+        else
+        {
+            _open_objects();
+            _used += cost;
+        }
+    }
+
+    if(_opened == _objects.size())
+    {
+        _writer->endObject();
+        _opened--;
+    }
+    _objects.removeAt(_objects.size() - 1);
+
+    if(!_full)
+    {
+        _position.resize(depth);
+    }
+    return object->exit(false, error);
+}
+
+int ConfigJsonStream::write(JSONWriter &writer, size_t size)
+{
+    if(!_root)
+    {
+        return 0;
+    }
+
+    _writer = &writer;
+    _size = size;
+    _used = 0;
+    _count = 0;
+    _full = false;
+    _objects.clear();
+    _opened = 0;
+
+    int error;
+    if(_root->type() == CONFIG_NODE_TYPE_OBJECT)
+    {
+        error = _write_object(reinterpret_cast<ConfigObject *>(_root), 0);
+    }
+    else
+    {
+        error = _write_leaf(_root);
+    }
+
+    if(!error && _full)
+    {
+        return _count ? -EAGAIN : -ENOSPC;
+    }
+    _root = nullptr;
+    return error;
+}
+
+static int _config_leaf_count(ConfigNode *node)
+{
+    if(node->type() != CONFIG_NODE_TYPE_OBJECT)
+    {
+        return 1;
+    }
+
+    auto object = reinterpret_cast<ConfigObject *>(node);
+    int count = 0;
+    for(int i = 0; i < object->child_count(); i++)
+    {
+        count += _config_leaf_count(object->child(i));
+    }
+    return count;
+}
+
+ConfigSnapshot::~ConfigSnapshot()
+{
+    _clear();
+}
+
+void ConfigSnapshot::_clear()
+{
+    for(auto &it : _values)
+    {
+        if(it.valid && it.type == CONFIG_NODE_TYPE_STRING)
+        {
+            free(it.s);
+        }
+    }
+    _values.clear();
+    _root = nullptr;
+}
+
+int ConfigSnapshot::save(ConfigNode *root)
+{
+    _clear();
+    _root = root;
+
+    int error = _save(root);
+    if(error)
+    {
+        _clear();
+    }
+    return error;
+}
+
+int ConfigSnapshot::_save(ConfigNode *node)
+{
+    if(node->type() == CONFIG_NODE_TYPE_OBJECT)
+    {
+        auto object = reinterpret_cast<ConfigObject *>(node);
+        int error = object->enter(false);
+        for(int i = 0; !error && i < object->child_count(); i++)
+        {
+            error = _save(object->child(i));
+        }
+        return object->exit(false, error);
+    }
+
+    config_snapshot_value_t value = {};
+    value.type = node->type();
+
+    switch(node->type())
+    {
+        case CONFIG_NODE_TYPE_INT:
+            value.valid = !reinterpret_cast<ConfigInt *>(node)->get(value.i);
+            break;
+        case CONFIG_NODE_TYPE_BOOL:
+            value.valid = !reinterpret_cast<ConfigBool *>(node)->get(value.b);
+            break;
+        case CONFIG_NODE_TYPE_FLOAT:
+            value.valid = !reinterpret_cast<ConfigFloat *>(node)->get(value.f);
+            break;
+        case CONFIG_NODE_TYPE_STRING:
+        {
+            const char *s;
+            if(!reinterpret_cast<ConfigString *>(node)->get(s))
+            {
+                value.s = strdup(s);
+                if(!value.s)
+                {
+                    return -ENOMEM;
+                }
+                value.valid = true;
+            }
+            break;
+        }
+        case CONFIG_NODE_TYPE_STRING_ENUM:
+            value.valid = !static_cast<ConfigLeaf<int32_t, CONFIG_NODE_TYPE_STRING_ENUM> *>(
+                reinterpret_cast<ConfigStringEnum *>(node))->get(value.i);
+            break;
+        default:
+            break;
+    }
+
+    if(!_values.append(value))
+    {
+        if(value.valid && value.type == CONFIG_NODE_TYPE_STRING)
+        {
+            free(value.s);
+        }
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+int ConfigSnapshot::restore()
+{
+    if(!_root)
+    {
+        return -EINVAL;
+    }
+
+    int index = 0;
+    return _restore(_root, index);
+}
+
+// every leaf is written back even after an error so as much as possible of
+// the tree is restored, the first error is reported
+int ConfigSnapshot::_restore(ConfigNode *node, int &index)
+{
+    if(node->type() == CONFIG_NODE_TYPE_OBJECT)
+    {
+        auto object = reinterpret_cast<ConfigObject *>(node);
+        int error = object->enter(true);
+        if(error)
+        {
+            // skip the values of the leaves that can't be restored
+            index += _config_leaf_count(node);
+            return error;
+        }
+        for(int i = 0; i < object->child_count(); i++)
+        {
+            int child_error = _restore(object->child(i), index);
+            if(!error)
+            {
+                error = child_error;
+            }
+        }
+        return object->exit(true, error);
+    }
+
+    if(index >= _values.size())
+    {
+        return -EINVAL;
+    }
+
+    auto &value = _values[index++];
+    if(!value.valid)
+    {
+        return 0;
+    }
+
+    int error = 0;
+    switch(value.type)
+    {
+        case CONFIG_NODE_TYPE_INT:
+            error = reinterpret_cast<ConfigInt *>(node)->set(value.i);
+            break;
+        case CONFIG_NODE_TYPE_BOOL:
+            error = reinterpret_cast<ConfigBool *>(node)->set(value.b);
+            break;
+        case CONFIG_NODE_TYPE_FLOAT:
+            error = reinterpret_cast<ConfigFloat *>(node)->set(value.f);
+            break;
+        case CONFIG_NODE_TYPE_STRING:
+            error = reinterpret_cast<ConfigString *>(node)->set(value.s);
+            break;
+        case CONFIG_NODE_TYPE_STRING_ENUM:
+            error = static_cast<ConfigLeaf<int32_t, CONFIG_NODE_TYPE_STRING_ENUM> *>(
+                reinterpret_cast<ConfigStringEnum *>(node))->set(value.i);
+            break;
+        default:
+            break;
+    }
+
+    // read only leaves can't have been changed
+    return (error == -EPERM) ? 0 : error;
+}
+
+int config_get_int32_cb(int32_t &value, const void *context)
+{
+    value = *(int32_t *)context;
+
+    return 0;
+}
+
+int config_set_int32_cb(int32_t value, const void *context)
+{
+    *(int32_t *)context = value;
+
+    return 0;
+}
+
+int config_get_float_cb(double &value, const void *context)
+{
+    value = *(double *)context;
+
+    return 0;
+
+}
+
+int config_set_float_cb(double value, const void *context)
+{
+    *(double *)context = value;
+
+    return 0;
+}
+
+int config_get_bool_cb(bool &value, const void *context)
+{
+    value = *(bool *)context;
+
+    return 0;
+}
+
+int config_set_bool_cb(bool value, const void *context)
+{
+    *(bool *)context = value;
+
+    return 0;
+}
+
+int config_set_string_cb(const char *value, const void *context)
+{
+    char *s = (char *) context;
+
+    // TODO: This makes me so very nervous but range-checking for the value
+    // string to fit into s already checked before callback execution.
+    // I suppose if the string was mutated in some fashion in between the check
+    // and the copy could still allow for a buffer overflow...
+    strcpy(s, value);
+
+    return 0;
+}
+
+int config_get_string_cb(const char * &value, const void *context)
+{
+    value = (const char *) context;
+
+    return 0;
+}
@@ -20,6 +20,8 @@
 
 #include <memory>
 
+#include "murmur3.h"
+
 typedef enum config_node_type_t {
     CONFIG_NODE_TYPE_UNKNOWN,
     CONFIG_NODE_TYPE_NULL,
@@ -45,26 +47,48 @@ int config_set_float_cb(double value, const void *context);
 int config_get_string_cb(const char * &value, const void *context);
 int config_set_string_cb(const char *value, const void *context);
 
+class ConfigObject;
+
 class ConfigNode
 {
     public:
-        ConfigNode(const char *name=nullptr, config_node_type_t node_type=CONFIG_NODE_TYPE_UNKNOWN) : _name(name), _type(node_type) {}
+        ConfigNode(const char *name=nullptr, config_node_type_t node_type=CONFIG_NODE_TYPE_UNKNOWN) : _name(name), _type(node_type), _parent(nullptr), _synced(0) {}
         virtual ~ConfigNode() {}
         config_node_type_t type() {return _type;}
         const char * name() {return _name;}
+        ConfigObject *parent() {return _parent;}
+
+        // flags the value as changed so the next hash of the module reads it
+        // back, setters and object commits do this already but a value
+        // changed directly through its context needs to be marked by hand
+        virtual void mark_dirty();
+
+        // digest of the leaf value as last acknowledged by the cloud, zero
+        // when not known
+        uint32_t synced() {return _synced;}
+        void set_synced(uint32_t digest) {_synced = digest;}
     private:
+        friend class ConfigObject;
+
         const char *_name;
         config_node_type_t _type;
+        ConfigObject *_parent;
+        uint32_t _synced;
 };
 
 // allocates a copy of of ConfigNode derived class via std::shared_ptr
 // intended for use with std::initializer_list or similar to allocate a new
 // copy during initialization
+// a pointer to a node with static storage is referenced as is, without a copy
+// or a shared_ptr control block on the heap
 class ConfigNodeAllocator
 {
     public:
         template <class T>
         ConfigNodeAllocator(T node) : node(std::make_shared<T>(node)) {}
+
+        template <class T>
+        ConfigNodeAllocator(T *node) : node(std::shared_ptr<ConfigNode>(), node) {}
         
         std::shared_ptr<ConfigNode> get() const {return node;};
     private:
@@ -257,26 +281,68 @@ class ConfigObject : public ConfigNode
         enter_cb(enter_cb),
         exit_cb(exit_cb),
         context(context),
-        wcontext(wcontext)
+        wcontext(wcontext),
+        _dirty(true),
+        _hash{0}
         {
             _children.reserve(children.size()); // minimize memory allocation
             for(auto child : children)
             {
                 _children.append(child.get());
             }
+            adopt();
+            build_index();
+        }
+
+        // children are shared between copies, the latest copy is the one
+        // kept by ConfigNodeAllocator so becomes their parent
+        ConfigObject(const ConfigObject &other) :
+        ConfigNode(other),
+        _children(other._children),
+        _index(other._index),
+        _wildcard(other._wildcard),
+        enter_cb(other.enter_cb),
+        exit_cb(other.exit_cb),
+        context(other.context),
+        wcontext(other.wcontext),
+        _dirty(true),
+        _hash{0}
+        {
+            adopt();
         }
 
         int child_count() { return _children.size(); }
         ConfigNode *child(const char *name);
-        ConfigNode *child(int position) { return (position < child_count()) ? _children[position].get() : nullptr; }
+        ConfigNode *child(int position) { return (position >= 0 && position < child_count()) ? _children[position].get() : nullptr; }
         int enter(bool write);
         int exit(bool write, int status);
+
+        void mark_dirty() override;
+        bool dirty() { return _dirty; }
+
+        // hash of the object and all of its children, only the parts of the
+        // tree marked dirty since the last call are read back and rehashed
+        const uint32_t *hash();
     private:
+        friend class ConfigNode;
+
+        void adopt();
+        void mark_ancestors_dirty();
+        void build_index();
+
         Vector<std::shared_ptr<ConfigNode>> _children;
+        // positions of the first 65536 children sorted by name for lookup by
+        // binary search, the children themselves stay in declaration order
+        // for output
+        Vector<uint16_t> _index;
+        // first child without a name, it matches any name
+        int _wildcard;
         std::function<int(bool write, const void *context)> enter_cb;
         std::function<int(bool write, int status, const void *context)> exit_cb;
         const void *context;
         const void *wcontext;
+        bool _dirty;
+        uint32_t _hash[4];
 };
 
 template <class T, config_node_type_t NODE_T>
@@ -298,7 +364,12 @@ int ConfigLeaf<T, NODE_T>::set(T value)
         return -EDOM;
     }
 
-    return set_cb(value, wcontext ? wcontext : context);
+    int error = set_cb(value, wcontext ? wcontext : context);
+    if(!error)
+    {
+        this->mark_dirty();
+    }
+    return error;
 }
 
 template <class T, config_node_type_t NODE_T>
@@ -311,3 +382,112 @@ int ConfigLeaf<T, NODE_T>::get(T &value)
 
     return get_cb(value, context);
 }
+
+// hash of the config tree as stored and synced with the cloud, every value in
+// the tree is read back and streamed through a single hash
+void config_hash(ConfigNode *root, murmur3_hash_t &hash);
+
+// as config_hash() but the tree is only read back when the hashes cached by
+// its objects differ from tree_hash, so a module that hasn't been marked dirty
+// costs nothing to hash again and keeps its previous hash
+void config_hash_changed(ConfigNode *root, murmur3_hash_t &hash, murmur3_hash_t &tree_hash);
+
+// writes config as a json object to the output writer
+int config_write_json(ConfigNode *root, JSONWriter &writer);
+
+// leaf with a value that differs from the one last acknowledged by the cloud
+typedef struct {
+    ConfigNode *node;
+    uint32_t digest;
+} config_sync_leaf_t;
+
+// collects the leaves of the tree changed since last acknowledged, in tree order
+int config_sync_changes(ConfigNode *root, Vector<config_sync_leaf_t> &changes);
+
+// writes as many of the changes as fit in size bytes as a json object nested
+// as in the tree, changes is trimmed to the leaves written
+// returns -ENOSPC if not even the first change fits
+int config_write_json_changes(ConfigNode *root, JSONWriter &writer, size_t size, Vector<config_sync_leaf_t> &changes);
+
+// records the written changes as acknowledged by the cloud
+void config_sync_commit(const Vector<config_sync_leaf_t> &changes);
+
+// sets every leaf as in sync with its current value or as unknown so all are
+// sent with the next changes
+void config_sync_reset(ConfigNode *root, bool synced);
+
+// Writes a config tree as json a part at a time, for trees too large for a
+// single event. Each part is a json object nested as in the tree holding the
+// leaves that follow the previous part, up to the size given, so merging the
+// parts in order gives back the whole tree. Parts end on node boundaries and
+// only the position of the next node is kept in between, the tree is read
+// again as each part is written.
+class ConfigJsonStream
+{
+    public:
+        ConfigJsonStream() : _root(nullptr), _skip(false) {}
+
+        void begin(ConfigNode *root);
+        bool done() { return !_root; }
+
+        // writes the next part into at most size bytes of the writer
+        // returns 0 once the tree is complete, -EAGAIN if more parts follow,
+        // -ENOSPC if not even the next leaf fits or the error reading the tree
+        int write(JSONWriter &writer, size_t size);
+
+        // passes over the next leaf, for one too large to ever fit a part
+        void skip() { _skip = true; }
+    private:
+        int _write_object(ConfigObject *object, int depth);
+        int _write_leaf(ConfigNode *leaf);
+        void _open_objects();
+
+        ConfigNode *_root;
+        // child positions from the root down to the next node to write
+        Vector<int> _position;
+        bool _skip;
+
+        // part being written, objects are entered on the way down but only
+        // written once a leaf inside them fits
+        JSONWriter *_writer;
+        size_t _size;
+        size_t _used;
+        int _count;
+        bool _full;
+        Vector<ConfigObject *> _objects;
+        int _opened;
+};
+
+// Copy of the leaf values of a tree. Restoring writes them back through the
+// object enter and exit callbacks the same way a config update does, which
+// rolls back a change applied to several modules when one of them fails.
+class ConfigSnapshot
+{
+    public:
+        ConfigSnapshot() : _root(nullptr) {}
+        ~ConfigSnapshot();
+        ConfigSnapshot(const ConfigSnapshot &) = delete;
+        ConfigSnapshot &operator=(const ConfigSnapshot &) = delete;
+
+        int save(ConfigNode *root);
+        int restore();
+    private:
+        typedef struct {
+            config_node_type_t type;
+            // value could be read and is restored
+            bool valid;
+            union {
+                bool b;
+                int32_t i;
+                double f;
+                char *s;
+            };
+        } config_snapshot_value_t;
+
+        int _save(ConfigNode *node);
+        int _restore(ConfigNode *node, int &index);
+        void _clear();
+
+        ConfigNode *_root;
+        Vector<config_snapshot_value_t> _values;
+};
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config_store.h"
+#include "crc32.h"
+
+// A bug in Device-OS 1.5.3 caused newlib to call into the unsupported _link()
+// function rather than the supported _rename() function. As workaround extern
+// the _rename() function (also exported via dynalb) and call directly.
+extern "C" int _rename(const char* oldpath, const char* newpath);
+
+static uint32_t _record_crc(const config_store_record_t &record)
+{
+    return crc32_update(0, &record, offsetof(config_store_record_t, crc));
+}
+
+static size_t _record_size(size_t name_len, size_t size)
+{
+    return sizeof(config_store_record_t) + name_len + size;
+}
+
+// reads exactly len bytes, a short read is reported as -EIO
+static int _read_all(int fd, void *data, size_t len)
+{
+    int rval = ::read(fd, data, len);
+    if(rval < 0)
+    {
+        return -errno;
+    }
+    return (rval == (int) len) ? 0 : -EIO;
+}
+
+static int _write_all(int fd, const void *data, size_t len)
+{
+    int rval = ::write(fd, data, len);
+    if(rval < 0)
+    {
+        return -errno;
+    }
+    return (rval == (int) len) ? 0 : -EIO;
+}
+
+ConfigStore::ConfigStore(const char *path) :
+    _path(path),
+    _fd(-1),
+    _end(0),
+    _live(0),
+    _batch(false),
+    _batch_error(0),
+    _batch_end(0)
+{
+    snprintf(_temp_path, sizeof(_temp_path), "%s.tmp", path);
+}
+
+ConfigStore::~ConfigStore()
+{
+    close();
+}
+
+config_store_entry_t *ConfigStore::_find(const char *name)
+{
+    for(auto &it : _entries)
+    {
+        if(!strcmp(it.name, name))
+        {
+            return &it;
+        }
+    }
+    return nullptr;
+}
+
+// makes the record the latest for its name, its superseded record is garbage
+void ConfigStore::_index(const config_store_entry_t &entry)
+{
+    size_t name_len = strlen(entry.name);
+    auto existing = _find(entry.name);
+    if(existing)
+    {
+        _live -= _record_size(name_len, existing->size);
+        *existing = entry;
+    }
+    else
+    {
+        _entries.append(entry);
+    }
+    _live += _record_size(name_len, entry.size);
+}
+
+// walks the log from the start indexing the latest record of each name,
+// stops at the first record that doesn't frame and check correctly which
+// marks the end of the log
+int ConfigStore::_scan(bool &torn)
+{
+    config_store_file_header_t file_header;
+    struct stat st;
+
+    _entries.clear();
+    _end = sizeof(file_header);
+    _live = sizeof(file_header);
+    torn = false;
+
+    if(fstat(_fd, &st))
+    {
+        return -errno;
+    }
+
+    if((size_t) st.st_size < sizeof(file_header) ||
+        _read_all(_fd, &file_header, sizeof(file_header)) ||
+        file_header.magic != CONFIG_STORE_FILE_MAGIC ||
+        file_header.version != CONFIG_STORE_VERSION)
+    {
+        torn = true;
+        return 0;
+    }
+
+    // records of a batch are held back until its commit record
+    Vector<config_store_entry_t> batch;
+    uint32_t pos = _end;
+
+    while(pos < (uint32_t) st.st_size)
+    {
+        config_store_record_t record;
+        config_store_entry_t entry = {};
+
+        if(_read_all(_fd, &record, sizeof(record)) ||
+            record.magic != CONFIG_STORE_RECORD_MAGIC ||
+            (!record.name_len && !(record.flags & CONFIG_STORE_FLAG_COMMIT)) ||
+            record.name_len >= sizeof(entry.name) ||
+            record.size > CONFIG_STORE_RECORD_MAX ||
+            pos + _record_size(record.name_len, record.size) > (uint32_t) st.st_size ||
+            _read_all(_fd, entry.name, record.name_len))
+        {
+            torn = true;
+            break;
+        }
+
+        uint32_t crc = crc32_update(_record_crc(record), entry.name, record.name_len);
+        uint8_t buf[256];
+        size_t remaining = record.size;
+        while(remaining)
+        {
+            size_t len = std::min(remaining, sizeof(buf));
+            if(_read_all(_fd, buf, len))
+            {
+                break;
+            }
+            crc = crc32_update(crc, buf, len);
+            remaining -= len;
+        }
+
+        if(remaining || crc != record.crc)
+        {
+            torn = true;
+            break;
+        }
+
+        entry.offset = pos + sizeof(record) + record.name_len;
+        entry.size = record.size;
+        pos += _record_size(record.name_len, record.size);
+
+        if(record.flags & CONFIG_STORE_FLAG_BATCH)
+        {
+            batch.append(entry);
+            continue;
+        }
+
+        if(record.flags & CONFIG_STORE_FLAG_COMMIT)
+        {
+            for(auto &it : batch)
+            {
+                _index(it);
+            }
+        }
+        else
+        {
+            // a batch never committed was written over
+            _index(entry);
+        }
+        batch.clear();
+        _end = pos;
+    }
+
+    // the log ends after the last committed record, anything after it is
+    // dropped
+    if(!batch.isEmpty())
+    {
+        torn = true;
+    }
+
+    return 0;
+}
+
+int ConfigStore::open()
+{
+    close();
+
+    // an interrupted compaction leaves the log as it was
+    unlink(_temp_path);
+
+    _fd = ::open(_path, O_RDWR | O_CREAT, 0664);
+    if(_fd < 0)
+    {
+        _fd = -1;
+        return -errno;
+    }
+
+    bool torn;
+    int error = _scan(torn);
+
+    // rewrite rather than append behind a torn tail, a partial record can
+    // make the record after it look torn as well
+    if(!error && torn)
+    {
+        error = compact();
+    }
+
+    if(error)
+    {
+        close();
+    }
+    return error;
+}
+
+void ConfigStore::close()
+{
+    if(_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+int ConfigStore::find(const char *name)
+{
+    auto entry = _find(name);
+    return entry ? (int) entry->size : -ENOENT;
+}
+
+int ConfigStore::read(const char *name, char *data, size_t size)
+{
+    auto entry = _find(name);
+    if(!entry)
+    {
+        return -ENOENT;
+    }
+    if(size < entry->size)
+    {
+        return -ENOSPC;
+    }
+    if(lseek(_fd, entry->offset, SEEK_SET) < 0)
+    {
+        return -errno;
+    }
+    int error = _read_all(_fd, data, entry->size);
+    return error ? error : (int) entry->size;
+}
+
+int ConfigStore::_append(int fd, uint32_t offset, const char *name, const char *data, size_t size, uint8_t flags)
+{
+    config_store_record_t record = {};
+    record.magic = CONFIG_STORE_RECORD_MAGIC;
+    record.name_len = strlen(name);
+    record.flags = flags;
+    record.size = size;
+    record.crc = crc32_update(crc32_update(_record_crc(record), name, record.name_len), data, size);
+
+    if(lseek(fd, offset, SEEK_SET) < 0)
+    {
+        return -errno;
+    }
+    CHECK(_write_all(fd, &record, sizeof(record)));
+    CHECK(_write_all(fd, name, record.name_len));
+    CHECK(_write_all(fd, data, size));
+    return 0;
+}
+
+int ConfigStore::write(const char *name, const char *data, size_t size)
+{
+    if(_fd < 0)
+    {
+        return -EBADF;
+    }
+
+    size_t name_len = strlen(name);
+    if(!name_len || name_len >= CONFIG_STORE_NAME_MAX || size > CONFIG_STORE_RECORD_MAX)
+    {
+        return -EINVAL;
+    }
+
+    config_store_entry_t entry = {};
+    strcpy(entry.name, name);
+    entry.size = size;
+
+    if(_batch)
+    {
+        if(!_batch_error)
+        {
+            _batch_error = _append(_fd, _batch_end, name, data, size, CONFIG_STORE_FLAG_BATCH);
+        }
+        if(_batch_error)
+        {
+            return _batch_error;
+        }
+        entry.offset = _batch_end + sizeof(config_store_record_t) + name_len;
+        _batch_entries.append(entry);
+        _batch_end += _record_size(name_len, size);
+        return 0;
+    }
+
+    // only index the record once it is on flash, a failed append is found
+    // torn and dropped on the next open
+    CHECK(_append(_fd, _end, name, data, size));
+    if(fsync(_fd))
+    {
+        return -errno;
+    }
+
+    entry.offset = _end + sizeof(config_store_record_t) + name_len;
+    _index(entry);
+    _end += _record_size(name_len, size);
+
+    return 0;
+}
+
+void ConfigStore::begin()
+{
+    _batch = true;
+    _batch_error = 0;
+    _batch_end = _end;
+    _batch_entries.clear();
+}
+
+int ConfigStore::commit()
+{
+    if(!_batch)
+    {
+        return 0;
+    }
+    _batch = false;
+
+    int error = _batch_error;
+    if(!error && !_batch_entries.isEmpty())
+    {
+        // the records are appended already and go to flash together with
+        // the commit record
+        error = _append(_fd, _batch_end, "", nullptr, 0, CONFIG_STORE_FLAG_COMMIT);
+        if(!error && fsync(_fd))
+        {
+            error = -errno;
+        }
+        if(!error)
+        {
+            for(auto &it : _batch_entries)
+            {
+                _index(it);
+            }
+            _end = _batch_end + _record_size(0, 0);
+        }
+    }
+
+    _batch_entries.clear();
+    return error;
+}
+
+int ConfigStore::compact()
+{
+    if(_fd < 0)
+    {
+        return -EBADF;
+    }
+
+    int fd = ::open(_temp_path, O_CREAT | O_WRONLY | O_TRUNC, 0664);
+    if(fd < 0)
+    {
+        return -errno;
+    }
+
+    config_store_file_header_t file_header = {CONFIG_STORE_FILE_MAGIC, CONFIG_STORE_VERSION};
+    int error = _write_all(fd, &file_header, sizeof(file_header));
+
+    // records are copied in index order, their offsets in the new log are
+    // only applied once the rename has succeeded
+    Vector<config_store_entry_t> entries = _entries;
+    uint32_t offset = sizeof(file_header);
+    char *data = nullptr;
+
+    if(!error && _entries.size())
+    {
+        data = (char *) malloc(CONFIG_STORE_RECORD_MAX);
+        if(!data)
+        {
+            error = -ENOMEM;
+        }
+    }
+
+    for(auto &it : entries)
+    {
+        if(error)
+        {
+            break;
+        }
+        error = read(it.name, data, CONFIG_STORE_RECORD_MAX);
+        if(error >= 0)
+        {
+            error = _append(fd, offset, it.name, data, it.size);
+        }
+        it.offset = offset + sizeof(config_store_record_t) + strlen(it.name);
+        offset += _record_size(strlen(it.name), it.size);
+    }
+    free(data);
+
+    if(!error && fsync(fd))
+    {
+        error = -errno;
+    }
+    ::close(fd);
+
+    if(!error && _rename(_temp_path, _path))
+    {
+        error = -errno;
+    }
+
+    if(error)
+    {
+        unlink(_temp_path);
+        return error;
+    }
+
+    ::close(_fd);
+    _fd = ::open(_path, O_RDWR);
+    if(_fd < 0)
+    {
+        _fd = -1;
+        return -errno;
+    }
+
+    _entries = entries;
+    _end = offset;
+    _live = offset;
+    return 0;
+}
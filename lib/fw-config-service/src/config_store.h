@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// longest module name that can be stored, including the terminator
+#ifndef CONFIG_STORE_NAME_MAX
+    #define CONFIG_STORE_NAME_MAX (32)
+#endif
+
+// largest single record accepted on write and during recovery
+#ifndef CONFIG_STORE_RECORD_MAX
+    #define CONFIG_STORE_RECORD_MAX (4096)
+#endif
+
+// bytes of superseded records allowed to build up in the log before
+// compact_pending() asks for a rewrite
+#ifndef CONFIG_STORE_COMPACT_GARBAGE
+    #define CONFIG_STORE_COMPACT_GARBAGE (8192)
+#endif
+
+#define CONFIG_STORE_FILE_MAGIC (0x4C474643) // "CFGL"
+#define CONFIG_STORE_RECORD_MAGIC (0x52474643) // "CFGR"
+#define CONFIG_STORE_VERSION (1)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+} config_store_file_header_t;
+
+// record written as part of a batch, only live once the batch is committed
+#define CONFIG_STORE_FLAG_BATCH (0x01)
+// marks the preceding batch records committed, has no name or data
+#define CONFIG_STORE_FLAG_COMMIT (0x02)
+
+// each record is followed by the module name (without terminator) and then
+// the data, the crc covers the header up to the crc, the name and the data
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t name_len;
+    uint8_t flags;
+    uint8_t reserved[2];
+    uint32_t size;
+    uint32_t crc;
+} config_store_record_t;
+
+typedef struct {
+    char name[CONFIG_STORE_NAME_MAX];
+    // file offset of the data of the latest record for this name
+    uint32_t offset;
+    uint32_t size;
+} config_store_entry_t;
+
+// Append-only store keeping the configuration of all modules in a single file.
+// Every write appends a CRC framed record and only the latest record for each
+// module is live. Opening the store reads the log sequentially once to index
+// the latest records, stopping at the first torn or corrupt record left by a
+// power cut. Compaction writes the live records to a temporary file that is
+// renamed over the log so an interrupted compaction leaves the log untouched.
+// Writes between begin() and commit() are recovered all together or not at
+// all and are flushed to flash once.
+class ConfigStore
+{
+    public:
+        ConfigStore(const char *path);
+        ~ConfigStore();
+
+        // scan the log and recover from an interrupted write or compaction
+        int open();
+        void close();
+        bool is_open() { return _fd >= 0; }
+
+        // size of the latest record for the name or -ENOENT
+        int find(const char *name);
+        // read the latest record for the name, returns the bytes read
+        int read(const char *name, char *data, size_t size);
+        int write(const char *name, const char *data, size_t size);
+
+        // group the following writes into a batch up to commit(), a batch
+        // with a failed write is dropped as a whole
+        void begin();
+        int commit();
+
+        // rewrite the log with only the live records
+        int compact();
+        bool compact_pending() { return (_end - _live) >= CONFIG_STORE_COMPACT_GARBAGE; }
+
+        // bytes in the log and bytes held by live records
+        size_t size() { return _end; }
+        size_t live_size() { return _live; }
+    private:
+        config_store_entry_t *_find(const char *name);
+        void _index(const config_store_entry_t &entry);
+        int _scan(bool &torn);
+        int _append(int fd, uint32_t offset, const char *name, const char *data, size_t size, uint8_t flags=0);
+
+        const char *_path;
+        char _temp_path[64];
+        int _fd;
+        uint32_t _end;
+        uint32_t _live;
+        Vector<config_store_entry_t> _entries;
+
+        bool _batch;
+        int _batch_error;
+        uint32_t _batch_end;
+        Vector<config_store_entry_t> _batch_entries;
+};
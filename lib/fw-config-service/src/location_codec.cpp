@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include <math.h>
+
+#include "base64.h"
+#include "location_codec.h"
+
+static int32_t _quantize(double value, double scale)
+{
+    return (int32_t) lround(value * scale);
+}
+
+static uint32_t _quantize_unsigned(float value)
+{
+    return (value > 0.0f) ? (uint32_t) lroundf(value * (float) LOCATION_CODEC_TENTHS_SCALE) : 0;
+}
+
+LocationEncoder::LocationEncoder(uint8_t *buf, size_t size) :
+    _buf(buf),
+    _capacity(size),
+    _size(0),
+    _count(0)
+{
+}
+
+int LocationEncoder::put(uint64_t value)
+{
+    do
+    {
+        if(_size >= _capacity)
+        {
+            return -ENOSPC;
+        }
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        _buf[_size++] = byte | (value ? 0x80 : 0);
+    } while(value);
+    return 0;
+}
+
+int LocationEncoder::begin(const location_fix_t *reference)
+{
+    _size = 0;
+    _count = 0;
+    _time = 0;
+    _latitude = 0;
+    _longitude = 0;
+    _altitude = 0;
+
+    CHECK(put(LOCATION_CODEC_VERSION));
+    CHECK(put(reference ? LOCATION_CODEC_FLAG_REFERENCE : 0));
+    if(reference)
+    {
+        CHECK(put(reference->time));
+        if(reference->locked)
+        {
+            _latitude = _quantize(reference->latitude, LOCATION_CODEC_DEGREES_SCALE);
+            _longitude = _quantize(reference->longitude, LOCATION_CODEC_DEGREES_SCALE);
+            if(reference->full)
+            {
+                _altitude = _quantize(reference->altitude, LOCATION_CODEC_TENTHS_SCALE);
+            }
+        }
+    }
+    return 0;
+}
+
+int LocationEncoder::add(const location_fix_t &fix)
+{
+    // a point that doesn't fit is taken back out
+    size_t start = _size;
+    bool full = fix.locked && fix.full;
+    int32_t latitude = _quantize(fix.latitude, LOCATION_CODEC_DEGREES_SCALE);
+    int32_t longitude = _quantize(fix.longitude, LOCATION_CODEC_DEGREES_SCALE);
+    int32_t altitude = _quantize(fix.altitude, LOCATION_CODEC_TENTHS_SCALE);
+
+    int error = put((fix.locked ? LOCATION_CODEC_POINT_LOCKED : 0) | (full ? LOCATION_CODEC_POINT_FULL : 0));
+    if(!error)
+    {
+        error = _count ? put_signed((int64_t) fix.time - _time) : put(fix.time);
+    }
+    if(!error && fix.locked)
+    {
+        error = put_signed((int64_t) latitude - _latitude);
+        if(!error)
+        {
+            error = put_signed((int64_t) longitude - _longitude);
+        }
+    }
+    if(!error && full)
+    {
+        float fields[] = {fix.heading, fix.speed, fix.horizontalAccuracy,
+            fix.horizontalDop, fix.verticalAccuracy, fix.verticalDop};
+
+        error = put_signed((int64_t) altitude - _altitude);
+        for(auto field : fields)
+        {
+            if(error)
+            {
+                break;
+            }
+            error = put(_quantize_unsigned(field));
+        }
+    }
+
+    if(error)
+    {
+        _size = start;
+        return error;
+    }
+
+    _count++;
+    _time = fix.time;
+    if(fix.locked)
+    {
+        _latitude = latitude;
+        _longitude = longitude;
+    }
+    if(full)
+    {
+        _altitude = altitude;
+    }
+    return 0;
+}
+
+int LocationEncoder::text(char *out, size_t size)
+{
+    return base64_encode(_buf, _size, out, size);
+}
+
+LocationDecoder::LocationDecoder(const uint8_t *data, size_t size) :
+    _data(data),
+    _size(size),
+    _pos(0),
+    _count(0)
+{
+}
+
+int LocationDecoder::get(uint64_t &value)
+{
+    value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if(_pos >= _size)
+        {
+            return -EINVAL;
+        }
+        uint8_t byte = _data[_pos++];
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+        {
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+int LocationDecoder::get_signed(int64_t &value)
+{
+    uint64_t zigzag;
+    CHECK(get(zigzag));
+    value = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+    return 0;
+}
+
+int LocationDecoder::begin(const location_fix_t *reference)
+{
+    uint64_t version, flags;
+
+    _pos = 0;
+    _count = 0;
+    _time = 0;
+    _latitude = 0;
+    _longitude = 0;
+    _altitude = 0;
+
+    CHECK(get(version));
+    CHECK(get(flags));
+    if(version != LOCATION_CODEC_VERSION)
+    {
+        return -EINVAL;
+    }
+
+    if(flags & LOCATION_CODEC_FLAG_REFERENCE)
+    {
+        uint64_t time;
+        CHECK(get(time));
+        if(!reference || reference->time != time)
+        {
+            return -EINVAL;
+        }
+        if(reference->locked)
+        {
+            _latitude = _quantize(reference->latitude, LOCATION_CODEC_DEGREES_SCALE);
+            _longitude = _quantize(reference->longitude, LOCATION_CODEC_DEGREES_SCALE);
+            if(reference->full)
+            {
+                _altitude = _quantize(reference->altitude, LOCATION_CODEC_TENTHS_SCALE);
+            }
+        }
+    }
+    return 0;
+}
+
+int LocationDecoder::next(location_fix_t &fix)
+{
+    uint64_t flags, value;
+    int64_t delta;
+
+    if(_pos >= _size)
+    {
+        return -ENOENT;
+    }
+
+    fix = {};
+    CHECK(get(flags));
+    fix.locked = flags & LOCATION_CODEC_POINT_LOCKED;
+    fix.full = fix.locked && (flags & LOCATION_CODEC_POINT_FULL);
+
+    if(_count)
+    {
+        CHECK(get_signed(delta));
+        fix.time = _time + delta;
+    }
+    else
+    {
+        CHECK(get(value));
+        fix.time = value;
+    }
+
+    if(fix.locked)
+    {
+        CHECK(get_signed(delta));
+        _latitude += delta;
+        CHECK(get_signed(delta));
+        _longitude += delta;
+        fix.latitude = _latitude / LOCATION_CODEC_DEGREES_SCALE;
+        fix.longitude = _longitude / LOCATION_CODEC_DEGREES_SCALE;
+    }
+
+    if(fix.full)
+    {
+        float *fields[] = {&fix.heading, &fix.speed, &fix.horizontalAccuracy,
+            &fix.horizontalDop, &fix.verticalAccuracy, &fix.verticalDop};
+
+        CHECK(get_signed(delta));
+        _altitude += delta;
+        fix.altitude = _altitude / LOCATION_CODEC_TENTHS_SCALE;
+        for(auto field : fields)
+        {
+            CHECK(get(value));
+            *field = value / LOCATION_CODEC_TENTHS_SCALE;
+        }
+    }
+
+    _time = fix.time;
+    _count++;
+    return 0;
+}
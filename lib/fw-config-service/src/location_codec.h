@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base64.h"
+
+// Compact location payload, version 1. A header byte for the version and a
+// flags byte, followed by the time of the reference point when the payload
+// is relative to one. Every point then starts with a flags byte and its time,
+// absolute for the first point and a delta afterwards. Latitude and longitude
+// are in 1e-7 degrees and delta encoded against the previous locked point of
+// the payload, the reference or zero. Altitude is in decimeters and delta
+// encoded the same way against the previous point carrying it. The remaining
+// fields are quantized to a tenth of their unit. Unsigned values are LEB128
+// varints, signed values zigzag encoded first. The payload is base64 encoded
+// to travel in an event and decoded again with base64_decode().
+#define LOCATION_CODEC_VERSION (1)
+
+// payload flags
+#define LOCATION_CODEC_FLAG_REFERENCE (0x01)
+
+// point flags
+#define LOCATION_CODEC_POINT_LOCKED (0x01)
+#define LOCATION_CODEC_POINT_FULL (0x02)
+
+#define LOCATION_CODEC_DEGREES_SCALE (1e7)
+#define LOCATION_CODEC_TENTHS_SCALE (10.0)
+
+// largest encoded point, flags, time and nine fields
+#define LOCATION_CODEC_POINT_MAX (1 + 5 + 9 * 5)
+
+typedef struct {
+    uint32_t time;
+    bool locked;
+    // altitude, heading, speed, accuracy and dilution of precision present,
+    // only for a locked point
+    bool full;
+    double latitude;
+    double longitude;
+    float altitude;
+    float heading;
+    float speed;
+    float horizontalAccuracy;
+    float horizontalDop;
+    float verticalAccuracy;
+    float verticalDop;
+} location_fix_t;
+
+class LocationEncoder
+{
+    public:
+        LocationEncoder(uint8_t *buf, size_t size);
+
+        // starts a payload, relative to the reference when one is given
+        int begin(const location_fix_t *reference=nullptr);
+        // adds a point, -ENOSPC leaves the payload as it was
+        int add(const location_fix_t &fix);
+
+        const uint8_t *data() { return _buf; }
+        size_t size() { return _size; }
+        size_t count() { return _count; }
+
+        // length of the payload as base64 and the payload as base64, the
+        // text is terminated and the length returned
+        size_t text_size() { return base64_size(_size); }
+        int text(char *out, size_t size);
+    private:
+        int put(uint64_t value);
+        int put_signed(int64_t value) { return put(((uint64_t) value << 1) ^ (uint64_t) (value >> 63)); }
+
+        uint8_t *_buf;
+        size_t _capacity;
+        size_t _size;
+        size_t _count;
+
+        uint32_t _time;
+        int32_t _latitude;
+        int32_t _longitude;
+        int32_t _altitude;
+};
+
+class LocationDecoder
+{
+    public:
+        LocationDecoder(const uint8_t *data, size_t size);
+
+        // reads the header, -EINVAL for another version or when the payload
+        // is relative to a reference other than the one given
+        int begin(const location_fix_t *reference=nullptr);
+        // reads the next point, -ENOENT past the last
+        int next(location_fix_t &fix);
+    private:
+        int get(uint64_t &value);
+        int get_signed(int64_t &value);
+
+        const uint8_t *_data;
+        size_t _size;
+        size_t _pos;
+        size_t _count;
+
+        uint32_t _time;
+        int32_t _latitude;
+        int32_t _longitude;
+        int32_t _altitude;
+};
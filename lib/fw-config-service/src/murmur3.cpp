@@ -46,51 +46,54 @@ static uint32_t fmix32(uint32_t h)
     return h;
 }
 
-static void murmur3_hash_step(murmur3_hash_t &hash, const uint8_t *block)
+// block words are loaded with memcpy, which compiles to a single load where
+// the target allows unaligned access and is safe at any address otherwise,
+// casting the block to uint32_t * let the compiler merge the loads into
+// instructions that fault on unaligned addresses
+static inline uint32_t load32(const uint8_t *p)
 {
-    // k1 through k4 should not need to be declared volatile
-    // however, the compiler appears to generate an illegal instruction
-    // sequence under optimization that causes the operation to hardfault
-    // and declaring as volatile functions to prevent that
-    volatile uint32_t k1 = ((uint32_t *) block)[0];
-    volatile uint32_t k2 = ((uint32_t *) block)[1];
-    volatile uint32_t k3 = ((uint32_t *) block)[2];
-    volatile uint32_t k4 = ((uint32_t *) block)[3];
-
-    k1 *= c1;
-    k1  = rotl32(k1,15);
-    k1 *= c2;
-    hash.h[0] ^= k1;
-
-    hash.h[0] = rotl32(hash.h[0],19);
-    hash.h[0] += hash.h[1];
-    hash.h[0] = hash.h[0]*5+0x561ccd1b;
-
-    k2 *= c2;
-    k2  = rotl32(k2,16);
-    k2 *= c3; hash.h[1] ^= k2;
-
-    hash.h[1] = rotl32(hash.h[1],17);
-    hash.h[1] += hash.h[2];
-    hash.h[1] = hash.h[1]*5+0x0bcaa747;
-
-    k3 *= c3;
-    k3  = rotl32(k3,17);
-    k3 *= c4;
-    hash.h[2] ^= k3;
-
-    hash.h[2] = rotl32(hash.h[2],15);
-    hash.h[2] += hash.h[3];
-    hash.h[2] = hash.h[2]*5+0x96cd1c35;
-
-    k4 *= c4;
-    k4  = rotl32(k4,18);
-    k4 *= c1;
-    hash.h[3] ^= k4;
-
-    hash.h[3] = rotl32(hash.h[3],13);
-    hash.h[3] += hash.h[0];
-    hash.h[3] = hash.h[3]*5+0x32ac3b17;
+    uint32_t k;
+    memcpy(&k, p, sizeof(k));
+    return k;
+}
+
+// mixes whole 16 byte blocks with the state held in locals so the loop stays
+// in registers rather than going through the hash struct on every round
+static void murmur3_hash_blocks(murmur3_hash_t &hash, const uint8_t *blocks, size_t count)
+{
+    uint32_t h1 = hash.h[0];
+    uint32_t h2 = hash.h[1];
+    uint32_t h3 = hash.h[2];
+    uint32_t h4 = hash.h[3];
+
+    for(; count > 0; count--, blocks += 16)
+    {
+        uint32_t k1 = load32(blocks + 0);
+        uint32_t k2 = load32(blocks + 4);
+        uint32_t k3 = load32(blocks + 8);
+        uint32_t k4 = load32(blocks + 12);
+
+        k1 *= c1; k1  = rotl32(k1,15); k1 *= c2; h1 ^= k1;
+
+        h1 = rotl32(h1,19); h1 += h2; h1 = h1*5+0x561ccd1b;
+
+        k2 *= c2; k2  = rotl32(k2,16); k2 *= c3; h2 ^= k2;
+
+        h2 = rotl32(h2,17); h2 += h3; h2 = h2*5+0x0bcaa747;
+
+        k3 *= c3; k3  = rotl32(k3,17); k3 *= c4; h3 ^= k3;
+
+        h3 = rotl32(h3,15); h3 += h4; h3 = h3*5+0x96cd1c35;
+
+        k4 *= c4; k4  = rotl32(k4,18); k4 *= c1; h4 ^= k4;
+
+        h4 = rotl32(h4,13); h4 += h1; h4 = h4*5+0x32ac3b17;
+    }
+
+    hash.h[0] = h1;
+    hash.h[1] = h2;
+    hash.h[2] = h3;
+    hash.h[3] = h4;
 }
 
 void murmur3_hash_start(murmur3_hash_t &hash, uint32_t seed)
@@ -107,34 +110,35 @@ void murmur3_hash_update(murmur3_hash_t &hash, const void * data, unsigned int l
 {
     const uint8_t * bytes = (const uint8_t *) data;
 
-    while(len > 0)
+    // complete a partial block left by the previous update
+    if(hash.accum_len)
     {
-        // handle partial block updates
-        if(hash.accum_len || len < sizeof(hash.accum))
-        {
-            int to_copy = std::min(sizeof(hash.accum) - hash.accum_len, len);
-            memcpy(hash.accum + hash.accum_len, bytes, to_copy);
-            hash.accum_len += to_copy;
-            bytes += to_copy;
-            len -= to_copy;
-
-            if(hash.accum_len == sizeof(hash.accum))
-            {
-                murmur3_hash_step(hash, hash.accum);
-                hash.accum_len = 0;
-            }
-        }
-        // handle full block updates
-        else
+        size_t to_copy = std::min<size_t>(sizeof(hash.accum) - hash.accum_len, len);
+        memcpy(hash.accum + hash.accum_len, bytes, to_copy);
+        hash.accum_len += to_copy;
+        bytes += to_copy;
+        len -= to_copy;
+
+        if(hash.accum_len < (int) sizeof(hash.accum))
         {
-            while(len >= sizeof(hash.accum))
-            {
-                murmur3_hash_step(hash, bytes);
-                bytes += sizeof(hash.accum);
-                len -= sizeof(hash.accum);
-            }
+            return;
         }
+        murmur3_hash_blocks(hash, hash.accum, 1);
+        hash.accum_len = 0;
     }
+
+    // hash full blocks straight from the input at any alignment
+    size_t blocks = len / sizeof(hash.accum);
+    if(blocks)
+    {
+        murmur3_hash_blocks(hash, bytes, blocks);
+        bytes += blocks * sizeof(hash.accum);
+        len -= blocks * sizeof(hash.accum);
+    }
+
+    // keep the tail for the next update or finalize
+    memcpy(hash.accum, bytes, len);
+    hash.accum_len = len;
 }
 
 void murmur3_hash_finalize(murmur3_hash_t &hash)
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include "publish_batch.h"
+
+PublishBatch::PublishBatch(size_t capacity) :
+    _capacity(capacity),
+    _size(0),
+    _last(0)
+{
+}
+
+int PublishBatch::add(const char *json, size_t size, uint32_t time)
+{
+    if(!size || size > _capacity || size > UINT16_MAX)
+    {
+        return -EINVAL;
+    }
+
+    size_t separator = _size ? 1 : 0;
+    if(_size + separator + size > sizeof(_data))
+    {
+        return -ENOSPC;
+    }
+
+    if(separator)
+    {
+        _data[_size] = ',';
+    }
+    memcpy(_data + _size + separator, json, size);
+    _entries.append({(uint16_t) size, time});
+    _size += separator + size;
+    _last = size;
+    return 0;
+}
+
+size_t PublishBatch::front(size_t space, size_t &count)
+{
+    size_t bytes = 0;
+    count = 0;
+    for(auto &it : _entries)
+    {
+        size_t next = bytes + (count ? 1 : 0) + it.size;
+        if(next > space)
+        {
+            break;
+        }
+        bytes = next;
+        count++;
+    }
+    return bytes;
+}
+
+size_t PublishBatch::front_size(size_t count)
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < count && i < (size_t) _entries.size(); i++)
+    {
+        bytes += (i ? 1 : 0) + _entries[i].size;
+    }
+    return bytes;
+}
+
+void PublishBatch::pop(size_t count)
+{
+    if(count >= (size_t) _entries.size())
+    {
+        clear();
+        return;
+    }
+
+    // each value dropped takes its separator with it
+    size_t bytes = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        bytes += _entries[i].size + 1;
+    }
+    memmove(_data, _data + bytes, _size - bytes);
+    _size -= bytes;
+    _entries.removeAt(0, count);
+}
+
+void PublishBatch::clear()
+{
+    _entries.clear();
+    _size = 0;
+}
+
+bool PublishBatch::full()
+{
+    return _size && (_size + 1 + _last > _capacity);
+}
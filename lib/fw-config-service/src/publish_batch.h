@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <protocol_defs.h>
+
+// bytes of serialized values a batch holds, enough for more than an event
+// so values left over from one event start the next
+#ifndef PUBLISH_BATCH_BUFFER_SIZE
+    #define PUBLISH_BATCH_BUFFER_SIZE (2 * particle::protocol::MAX_EVENT_DATA_LENGTH)
+#endif
+
+typedef struct {
+    uint16_t size;
+    uint32_t time;
+} publish_batch_entry_t;
+
+// Values serialized as JSON held back to be sent together as an array in a
+// single event. The capacity is the room an event has for the array, a value
+// larger than that can never be sent and is refused. Values are only ever
+// taken whole, from the oldest, as many as fit the space given.
+class PublishBatch
+{
+    public:
+        PublishBatch(size_t capacity=particle::protocol::MAX_EVENT_DATA_LENGTH);
+
+        void set_capacity(size_t capacity) { _capacity = capacity; }
+        size_t capacity() { return _capacity; }
+
+        // adds a value serialized already, -EINVAL when it never fits an
+        // event and -ENOSPC when the batch needs to be sent first
+        int add(const char *json, size_t size, uint32_t time);
+
+        // bytes of the oldest values that fit whole in space, comma
+        // separated starting at data(), and how many values these are
+        size_t front(size_t space, size_t &count);
+        const char *data() { return _data; }
+        // bytes of the oldest values with separators
+        size_t front_size(size_t count);
+        // drops the oldest values, once written out
+        void pop(size_t count);
+        void clear();
+
+        // no room left for another value the size of the last one added
+        bool full();
+        // room left in the buffer for a value of the size
+        bool fits(size_t size) { return _size + (_size ? 1 : 0) + size <= sizeof(_data); }
+
+        size_t count() { return _entries.size(); }
+        // bytes of all values held, with separators
+        size_t size() { return _size; }
+        // time of the oldest value held
+        uint32_t oldest() { return _entries.isEmpty() ? 0 : _entries.first().time; }
+    private:
+        size_t _capacity;
+        size_t _size;
+        size_t _last;
+        char _data[PUBLISH_BATCH_BUFFER_SIZE];
+        Vector<publish_batch_entry_t> _entries;
+};
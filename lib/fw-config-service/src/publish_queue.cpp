@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Particle.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32.h"
+#include "publish_queue.h"
+
+static const size_t SLOT_SIZE = sizeof(publish_queue_record_t) + PUBLISH_QUEUE_DATA_MAX;
+
+static uint32_t _record_crc(const publish_queue_record_t &record, const void *data)
+{
+    return crc32_update(crc32_update(0, &record, offsetof(publish_queue_record_t, state)), data, record.size);
+}
+
+// reads or writes exactly len bytes at the offset, a short transfer is
+// reported as -EIO
+static int _pread_all(int fd, uint32_t offset, void *data, size_t len)
+{
+    if(lseek(fd, offset, SEEK_SET) < 0)
+    {
+        return -errno;
+    }
+    int rval = ::read(fd, data, len);
+    if(rval < 0)
+    {
+        return -errno;
+    }
+    return (rval == (int) len) ? 0 : -EIO;
+}
+
+static int _pwrite_all(int fd, uint32_t offset, const void *data, size_t len)
+{
+    if(lseek(fd, offset, SEEK_SET) < 0)
+    {
+        return -errno;
+    }
+    int rval = ::write(fd, data, len);
+    if(rval < 0)
+    {
+        return -errno;
+    }
+    return (rval == (int) len) ? 0 : -EIO;
+}
+
+PublishQueue::PublishQueue(const char *path, size_t slots, publish_queue_order_t order) :
+    _path(path),
+    _slots(slots),
+    _order(order),
+    _fd(-1),
+    _next_seq(1),
+    _budget(0),
+    _session_bytes(0),
+    _dropped(0)
+{
+}
+
+PublishQueue::~PublishQueue()
+{
+    close();
+}
+
+uint32_t PublishQueue::_slot_offset(size_t slot)
+{
+    return sizeof(publish_queue_file_header_t) + slot * SLOT_SIZE;
+}
+
+// a slot that doesn't frame and check correctly is empty
+int PublishQueue::_read_slot(size_t slot, publish_queue_slot_t &entry)
+{
+    publish_queue_record_t record;
+    char data[PUBLISH_QUEUE_DATA_MAX];
+
+    entry = {};
+    if(_pread_all(_fd, _slot_offset(slot), &record, sizeof(record)) ||
+        record.magic != PUBLISH_QUEUE_RECORD_MAGIC ||
+        record.size > PUBLISH_QUEUE_DATA_MAX ||
+        record.seq % _slots != slot ||
+        (record.state != PUBLISH_QUEUE_STATE_PENDING && record.state != PUBLISH_QUEUE_STATE_SENT))
+    {
+        return 0;
+    }
+
+    // sent payloads are checked as well, the next sequence number is taken
+    // from them after a reset
+    if(_pread_all(_fd, _slot_offset(slot) + sizeof(record), data, record.size) ||
+        _record_crc(record, data) != record.crc)
+    {
+        return 0;
+    }
+
+    entry.seq = record.seq;
+    entry.id = record.id;
+    entry.size = record.size;
+    entry.pending = record.state == PUBLISH_QUEUE_STATE_PENDING;
+    return 0;
+}
+
+int PublishQueue::open()
+{
+    close();
+
+    _fd = ::open(_path, O_RDWR | O_CREAT, 0664);
+    if(_fd < 0)
+    {
+        _fd = -1;
+        return -errno;
+    }
+
+    // a queue written with another layout is started over
+    publish_queue_file_header_t header;
+    if(_pread_all(_fd, 0, &header, sizeof(header)) ||
+        header.magic != PUBLISH_QUEUE_FILE_MAGIC ||
+        header.version != PUBLISH_QUEUE_VERSION ||
+        header.slots != _slots ||
+        header.slot_size != SLOT_SIZE)
+    {
+        header = {PUBLISH_QUEUE_FILE_MAGIC, PUBLISH_QUEUE_VERSION, (uint32_t) _slots, (uint32_t) SLOT_SIZE};
+        int error = ftruncate(_fd, 0) ? -errno : _pwrite_all(_fd, 0, &header, sizeof(header));
+        if(!error && fsync(_fd))
+        {
+            error = -errno;
+        }
+        if(error)
+        {
+            close();
+            return error;
+        }
+    }
+
+    _entries.clear();
+    _next_seq = 1;
+    for(size_t slot = 0; slot < _slots; slot++)
+    {
+        publish_queue_slot_t entry;
+        _read_slot(slot, entry);
+        _entries.append(entry);
+        if(entry.seq && (int32_t) (entry.seq + 1 - _next_seq) > 0)
+        {
+            _next_seq = entry.seq + 1;
+        }
+    }
+
+    return 0;
+}
+
+void PublishQueue::close()
+{
+    if(_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+int PublishQueue::push(const char *data, size_t size, uint32_t *seq, uint32_t id)
+{
+    if(_fd < 0)
+    {
+        return -EBADF;
+    }
+    if(size > PUBLISH_QUEUE_DATA_MAX)
+    {
+        return -EINVAL;
+    }
+
+    // zero is kept to mean no payload
+    if(!_next_seq)
+    {
+        _next_seq++;
+    }
+
+    size_t slot = _next_seq % _slots;
+    publish_queue_record_t record = {};
+    record.magic = PUBLISH_QUEUE_RECORD_MAGIC;
+    record.seq = _next_seq;
+    record.id = id;
+    record.size = size;
+    record.state = PUBLISH_QUEUE_STATE_PENDING;
+    record.crc = _record_crc(record, data);
+
+    auto &entry = _entries[slot];
+    if(entry.pending)
+    {
+        _dropped++;
+    }
+    // the slot is empty until the new payload is on flash
+    entry = {};
+
+    uint32_t offset = _slot_offset(slot);
+    CHECK(_pwrite_all(_fd, offset, &record, sizeof(record)));
+    CHECK(_pwrite_all(_fd, offset + sizeof(record), data, size));
+    if(fsync(_fd))
+    {
+        return -errno;
+    }
+
+    entry = {record.seq, record.id, record.size, true};
+    if(seq)
+    {
+        *seq = record.seq;
+    }
+    _next_seq++;
+    return 0;
+}
+
+int PublishQueue::next(char *data, size_t size, uint32_t &seq, uint32_t *id)
+{
+    if(_fd < 0)
+    {
+        return -EBADF;
+    }
+
+    publish_queue_slot_t *next = nullptr;
+    for(auto &it : _entries)
+    {
+        if(!it.pending)
+        {
+            continue;
+        }
+        int32_t age = it.seq - (next ? next->seq : 0);
+        if(!next || (_order == PUBLISH_QUEUE_OLDEST_FIRST ? age < 0 : age > 0))
+        {
+            next = &it;
+        }
+    }
+
+    if(!next)
+    {
+        return -ENOENT;
+    }
+    if(size < next->size)
+    {
+        return -ENOSPC;
+    }
+    if(_budget && _session_bytes && _session_bytes + next->size > _budget)
+    {
+        return -EDQUOT;
+    }
+
+    CHECK(_pread_all(_fd, _slot_offset(next->seq % _slots) + sizeof(publish_queue_record_t), data, next->size));
+    seq = next->seq;
+    if(id)
+    {
+        *id = next->id;
+    }
+    return next->size;
+}
+
+int PublishQueue::ack(uint32_t seq)
+{
+    if(_fd < 0)
+    {
+        return -EBADF;
+    }
+
+    size_t slot = seq % _slots;
+    auto &entry = _entries[slot];
+    if(!seq || entry.seq != seq || !entry.pending)
+    {
+        return -ENOENT;
+    }
+
+    // not synced, a sent payload found pending after a reset is only sent
+    // again and the next push syncs it along with the new payload
+    uint8_t state = PUBLISH_QUEUE_STATE_SENT;
+    CHECK(_pwrite_all(_fd, _slot_offset(slot) + offsetof(publish_queue_record_t, state), &state, sizeof(state)));
+    entry.pending = false;
+    _session_bytes += entry.size;
+    return 0;
+}
+
+size_t PublishQueue::pending()
+{
+    size_t count = 0;
+    for(auto &it : _entries)
+    {
+        if(it.pending)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+PublishSender::PublishSender(PublishQueue &queue, send_t send, done_t done) :
+    _queue(queue),
+    _send(send),
+    _done(done),
+    _connected(false),
+    _sending(false),
+    _sending_context(0),
+    _live_id(0),
+    _latest_pending(false),
+    _latest_context(0)
+{
+}
+
+int PublishSender::publish(const char *data, size_t size, uint32_t id, bool connected)
+{
+    _latest_pending = true;
+
+    if(connected && !_sending && !_send(data, id, LIVE))
+    {
+        _sending = true;
+        _sending_context = LIVE;
+        _live_id = id;
+        _latest_context = LIVE;
+        return 0;
+    }
+
+    uint32_t seq;
+    int rval = _queue.push(data, size, &seq, id);
+    if(rval)
+    {
+        _latest_pending = false;
+        return rval;
+    }
+    _latest_context = seq;
+    return 0;
+}
+
+void PublishSender::complete(uint32_t context, int status, bool retry, const char *data, void *response)
+{
+    if(_sending && context == _sending_context)
+    {
+        _sending = false;
+    }
+    bool latest = _latest_pending && context == _latest_context;
+
+    if(retry)
+    {
+        if(context != LIVE)
+        {
+            // still queued
+            return;
+        }
+        uint32_t seq;
+        if(!_queue.push(data, strlen(data), &seq, _live_id))
+        {
+            if(latest)
+            {
+                _latest_context = seq;
+            }
+            return;
+        }
+        // can't be kept for a retry so finishes as it is
+    }
+    else if(context != LIVE)
+    {
+        _queue.ack(context);
+    }
+
+    if(latest)
+    {
+        _latest_pending = false;
+        _done(status, response, data);
+    }
+}
+
+void PublishSender::loop(bool connected)
+{
+    if(connected && !_connected)
+    {
+        _queue.new_session();
+    }
+    _connected = connected;
+
+    if(!connected || _sending || !_queue.is_open())
+    {
+        return;
+    }
+
+    uint32_t seq, id;
+    int size = _queue.next(_buffer, sizeof(_buffer) - 1, seq, &id);
+    if(size < 0)
+    {
+        // nothing queued or the budget for this connection is used up
+        return;
+    }
+    _buffer[size] = '\0';
+
+    // the buffer is kept untouched until the send completes
+    int rval = _send(_buffer, id, seq);
+    if(!rval)
+    {
+        _sending = true;
+        _sending_context = seq;
+    }
+    else if(rval != -EBUSY && rval != -ENOMEM)
+    {
+        // -EBUSY and -ENOMEM should recover very quickly and are retried on
+        // the next loop, anything else won't go through on a retry either
+        _queue.ack(seq);
+        if(_latest_pending && seq == _latest_context)
+        {
+            _latest_pending = false;
+            _done(rval, nullptr, _buffer);
+        }
+    }
+}
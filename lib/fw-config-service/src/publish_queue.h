@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+#include <protocol_defs.h>
+
+// payloads the queue holds before the oldest is overwritten
+#ifndef PUBLISH_QUEUE_SLOTS
+    #define PUBLISH_QUEUE_SLOTS (32)
+#endif
+
+// largest payload a slot holds
+#ifndef PUBLISH_QUEUE_DATA_MAX
+    #define PUBLISH_QUEUE_DATA_MAX (particle::protocol::MAX_EVENT_DATA_LENGTH)
+#endif
+
+#define PUBLISH_QUEUE_FILE_MAGIC (0x51425550) // "PUBQ"
+#define PUBLISH_QUEUE_RECORD_MAGIC (0x52425550) // "PUBR"
+#define PUBLISH_QUEUE_VERSION (2)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+} publish_queue_file_header_t;
+
+#define PUBLISH_QUEUE_STATE_SENT (0x00)
+#define PUBLISH_QUEUE_STATE_PENDING (0x01)
+
+// each slot starts with a record followed by the payload, the crc covers the
+// record up to the state and the payload so the state can be updated alone
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t id;
+    uint16_t size;
+    uint8_t reserved;
+    uint8_t state;
+    uint32_t crc;
+} publish_queue_record_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t id;
+    uint16_t size;
+    bool pending;
+} publish_queue_slot_t;
+
+typedef enum {
+    PUBLISH_QUEUE_OLDEST_FIRST,
+    PUBLISH_QUEUE_NEWEST_FIRST,
+} publish_queue_order_t;
+
+// Queue of finished publish payloads kept in flash for sending once the
+// cloud can be reached, surviving resets and sleep. Payloads are numbered in
+// the order they are pushed and the payload with number n goes in slot n
+// modulo the slot count, so the file is a ring where a push into a full
+// queue overwrites the oldest payload. Every slot is CRC framed, opening the
+// queue reads each slot header once and a slot torn by a power cut is found
+// empty. A sent payload is marked in place with a single byte write, synced
+// with the next push as losing it only means the payload is sent again.
+class PublishQueue
+{
+    public:
+        PublishQueue(const char *path,
+            size_t slots=PUBLISH_QUEUE_SLOTS,
+            publish_queue_order_t order=PUBLISH_QUEUE_OLDEST_FIRST);
+        ~PublishQueue();
+
+        int open();
+        void close();
+        bool is_open() { return _fd >= 0; }
+
+        // persists the payload with an id of the caller's kept beside it,
+        // such as the request id of the event, returns 0 and its sequence
+        // number
+        int push(const char *data, size_t size, uint32_t *seq=nullptr, uint32_t id=0);
+
+        // reads the next payload to send into data, returns its size or
+        // -ENOENT when there is nothing to send and -EDQUOT when the
+        // session budget is used up, a payload is sent again until acked
+        int next(char *data, size_t size, uint32_t &seq, uint32_t *id=nullptr);
+        // marks the payload sent
+        int ack(uint32_t seq);
+
+        // bytes of payloads acked per session before next() holds back the
+        // rest, zero for no limit, a payload handed out again after a failed
+        // send isn't charged twice and a session always gets at least one
+        // payload so a large one can't block it
+        void set_budget(size_t bytes) { _budget = bytes; }
+        void new_session() { _session_bytes = 0; }
+        size_t session_bytes() { return _session_bytes; }
+
+        void set_order(publish_queue_order_t order) { _order = order; }
+
+        // payloads waiting to be sent
+        size_t pending();
+        // payloads overwritten before they were sent since the queue opened
+        size_t dropped() { return _dropped; }
+    private:
+        int _read_slot(size_t slot, publish_queue_slot_t &entry);
+        uint32_t _slot_offset(size_t slot);
+
+        const char *_path;
+        size_t _slots;
+        publish_queue_order_t _order;
+        int _fd;
+        uint32_t _next_seq;
+        Vector<publish_queue_slot_t> _entries;
+
+        size_t _budget;
+        size_t _session_bytes;
+        size_t _dropped;
+};
+
+// Sends publishes straight away while connected and keeps them in the queue
+// only while they can't be sent, offline or after a failed send, so a publish
+// that goes through first time is never written to flash. One send is in
+// flight at a time and queued publishes go out once it completes.
+class PublishSender
+{
+    public:
+        // starts sending data, the send finishes with a call to complete()
+        // passing the context back, returns -EBUSY or -ENOMEM to try again
+        // later and any other error to give up on the publish
+        typedef std::function<int(const char *data, uint32_t id, uint32_t context)> send_t;
+        // the latest publish finished with the status and response passed
+        // to complete(), or the error of a send that can't be tried again
+        // and no response
+        typedef std::function<void(int status, void *response, const char *data)> done_t;
+
+        PublishSender(PublishQueue &queue, send_t send, done_t done);
+
+        // sends the publish or queues it, an error leaves it with neither
+        int publish(const char *data, size_t size, uint32_t id, bool connected);
+        // the send with the context finished, a publish that should be
+        // retried is queued if it wasn't already
+        void complete(uint32_t context, int status, bool retry, const char *data, void *response=nullptr);
+        // sends the next queued publish, each connection gets a new budget
+        void loop(bool connected);
+
+        bool sending() { return _sending; }
+    private:
+        // context of a publish sent without being queued, queued publishes
+        // pass their sequence number which is never zero
+        static const uint32_t LIVE = 0;
+
+        PublishQueue &_queue;
+        send_t _send;
+        done_t _done;
+        bool _connected;
+        bool _sending;
+        uint32_t _sending_context;
+        uint32_t _live_id;
+        bool _latest_pending;
+        uint32_t _latest_context;
+        char _buffer[PUBLISH_QUEUE_DATA_MAX + 1];
+};
@@ -0,0 +1,215 @@
+#include "Particle.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+
+// exported by Device OS as a workaround for newlib calling _link()
+extern "C" int _rename(const char* oldpath, const char* newpath)
+{
+    return rename(oldpath, newpath);
+}
+
+// flushes to flash are counted to check how often the config store syncs
+int test_fsync_count = 0;
+
+extern "C" int fsync(int fd)
+{
+    test_fsync_count++;
+    return 0;
+}
+
+ParticleClass Particle;
+Logger Log;
+SystemClass System;
+TimeClass Time;
+
+size_t test_json_parse_count = 0;
+size_t test_json_parse_allocations = 0;
+
+namespace {
+
+// the copy of the text and the document parsed in place in it
+struct TestJSONData {
+    std::unique_ptr<char[]> text;
+    DynamicJsonDocument doc;
+
+    explicit TestJSONData(size_t size) : text(new char[size + 1]), doc(JSON_ARRAY_SIZE(size / 2 + 1)) {}
+};
+
+} // namespace
+
+JSONValue JSONValue::parseCopy(const char *json, size_t size)
+{
+    test_json_parse_count++;
+    // the shared data with its control block, the text and the document pool
+    test_json_parse_allocations += 3;
+
+    auto data = std::make_shared<TestJSONData>(size);
+    memcpy(data->text.get(), json, size);
+    data->text[size] = '\0';
+    if (deserializeJson(data->doc, data->text.get(), size)) {
+        return JSONValue();
+    }
+    return JSONValue(data, data->doc.as<ArduinoJson::JsonVariantConst>());
+}
+
+JSONType JSONValue::type() const
+{
+    if (!data_) {
+        return JSON_TYPE_INVALID;
+    }
+    if (variant_.isNull()) {
+        return JSON_TYPE_NULL;
+    }
+    if (variant_.is<bool>()) {
+        return JSON_TYPE_BOOL;
+    }
+    if (variant_.is<double>()) {
+        return JSON_TYPE_NUMBER;
+    }
+    if (variant_.is<const char *>()) {
+        return JSON_TYPE_STRING;
+    }
+    if (variant_.is<ArduinoJson::JsonArrayConst>()) {
+        return JSON_TYPE_ARRAY;
+    }
+    return JSON_TYPE_OBJECT;
+}
+
+JSONString JSONValue::toString() const
+{
+    if (isBool()) {
+        return JSONString(toBool() ? "true" : "false");
+    }
+    return JSONString(variant_.as<const char *>());
+}
+
+bool JSONObjectIterator::next()
+{
+    if (started_ && it_ != object_.end()) {
+        ++it_;
+    }
+    started_ = true;
+    return it_ != object_.end();
+}
+
+bool JSONArrayIterator::next()
+{
+    if (started_ && it_ != array_.end()) {
+        ++it_;
+    }
+    started_ = true;
+    return it_ != array_.end();
+}
+
+void TestFutureState::complete(bool success)
+{
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = success ? 1 : -1;
+        pending.swap(callbacks);
+    }
+    for (auto &it : pending) {
+        it();
+    }
+}
+
+void TestFutureState::then(std::function<void()> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!result) {
+            callbacks.push_back(callback);
+            return;
+        }
+    }
+    callback();
+}
+
+Future<bool> ParticleClass::publish(const char *name, const char *data, PublishFlags flags)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto state = std::make_shared<TestFutureState>();
+    publishes_.push_back({name, data ? data : "", flags, state});
+    return Future<bool>(state);
+}
+
+std::vector<TestPublish> ParticleClass::publishes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publishes_;
+}
+
+bool ParticleClass::complete(size_t index, bool success)
+{
+    std::shared_ptr<TestFutureState> state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index >= publishes_.size()) {
+            return false;
+        }
+        state = publishes_[index].state;
+    }
+    state->complete(success);
+    return true;
+}
+
+void ParticleClass::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    publishes_.clear();
+}
+
+struct os_queue_stub {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t item_size;
+    size_t item_count;
+};
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void* reserved)
+{
+    *queue = new os_queue_stub();
+    (*queue)->item_size = item_size;
+    (*queue)->item_count = item_count;
+    return 0;
+}
+
+int os_queue_destroy(os_queue_t queue, void* reserved)
+{
+    delete queue;
+    return 0;
+}
+
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void* reserved)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto ready = [queue]() { return queue->items.size() < queue->item_count; };
+    if (delay == CONCURRENT_WAIT_FOREVER) {
+        queue->changed.wait(lock, ready);
+    } else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(delay), ready)) {
+        return -1;
+    }
+    auto bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->changed.notify_all();
+    return 0;
+}
+
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void* reserved)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto ready = [queue]() { return !queue->items.empty(); };
+    if (delay == CONCURRENT_WAIT_FOREVER) {
+        queue->changed.wait(lock, ready);
+    } else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(delay), ready)) {
+        return -1;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return 0;
+}
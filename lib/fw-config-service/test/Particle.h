@@ -0,0 +1,459 @@
+#pragma once
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+// List of all defined system errors
+#define SYSTEM_ERROR_NONE                   (0)
+#define SYSTEM_ERROR_UNKNOWN                (-100)
+#define SYSTEM_ERROR_BUSY                   (-110)
+#define SYSTEM_ERROR_NOT_SUPPORTED          (-120)
+#define SYSTEM_ERROR_NOT_ALLOWED            (-130)
+#define SYSTEM_ERROR_CANCELLED              (-140)
+#define SYSTEM_ERROR_ABORTED                (-150)
+#define SYSTEM_ERROR_TIMEOUT                (-160)
+#define SYSTEM_ERROR_NOT_FOUND              (-170)
+#define SYSTEM_ERROR_ALREADY_EXISTS         (-180)
+#define SYSTEM_ERROR_TOO_LARGE              (-190)
+#define SYSTEM_ERROR_NOT_ENOUGH_DATA        (-191)
+#define SYSTEM_ERROR_LIMIT_EXCEEDED         (-200)
+#define SYSTEM_ERROR_END_OF_STREAM          (-201)
+#define SYSTEM_ERROR_INVALID_STATE          (-210)
+#define SYSTEM_ERROR_IO                     (-220)
+#define SYSTEM_ERROR_WOULD_BLOCK            (-221)
+#define SYSTEM_ERROR_FILE                   (-225)
+#define SYSTEM_ERROR_NETWORK                (-230)
+#define SYSTEM_ERROR_PROTOCOL               (-240)
+#define SYSTEM_ERROR_INTERNAL               (-250)
+#define SYSTEM_ERROR_NO_MEMORY              (-260)
+#define SYSTEM_ERROR_INVALID_ARGUMENT       (-270)
+#define SYSTEM_ERROR_BAD_DATA               (-280)
+#define SYSTEM_ERROR_OUT_OF_RANGE           (-290)
+#define SYSTEM_ERROR_DEPRECATED             (-300)
+
+// Catch defines its own CHECK assertion for test sources
+#ifndef CHECK
+#define CHECK(_expr) \
+    do { \
+        auto _ret = _expr; \
+        if (_ret < 0) { \
+            return _ret; \
+        } \
+    } while (false)
+#endif
+
+#include "spark_wiring_vector.h"
+
+using namespace spark;
+
+// Output side of the Device OS JSON API, enough to capture the config output
+class JSONWriter {
+public:
+    virtual ~JSONWriter() = default;
+
+    JSONWriter& beginObject() {
+        separator();
+        write('{');
+        state_ = BEGIN;
+        return *this;
+    }
+
+    JSONWriter& endObject() {
+        write('}');
+        state_ = NEXT;
+        return *this;
+    }
+
+    JSONWriter& beginArray() {
+        separator();
+        write('[');
+        state_ = BEGIN;
+        return *this;
+    }
+
+    JSONWriter& endArray() {
+        write(']');
+        state_ = NEXT;
+        return *this;
+    }
+
+    JSONWriter& name(const char *name) {
+        separator();
+        string(name);
+        state_ = VALUE;
+        return *this;
+    }
+
+    JSONWriter& value(bool val) {
+        return raw(val ? "true" : "false");
+    }
+
+    JSONWriter& value(int val) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", val);
+        return raw(buf);
+    }
+
+    JSONWriter& value(unsigned val) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u", val);
+        return raw(buf);
+    }
+
+    JSONWriter& value(double val, int precision) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*g", precision, val);
+        return raw(buf);
+    }
+
+    JSONWriter& value(double val) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", val);
+        return raw(buf);
+    }
+
+    JSONWriter& value(const char *val) {
+        separator();
+        string(val);
+        state_ = NEXT;
+        return *this;
+    }
+
+protected:
+    virtual void write(const char *data, size_t size) = 0;
+
+private:
+    enum State { BEGIN, NEXT, VALUE };
+    State state_ = BEGIN;
+
+    void write(char c) {
+        write(&c, 1);
+    }
+
+    void separator() {
+        if (state_ == NEXT) {
+            write(',');
+        } else if (state_ == VALUE) {
+            write(':');
+        }
+    }
+
+    void string(const char *str) {
+        write('"');
+        for (; *str; str++) {
+            if (*str == '"' || *str == '\\') {
+                write('\\');
+            }
+            write(*str);
+        }
+        write('"');
+    }
+
+    JSONWriter& raw(const char *str) {
+        separator();
+        write(str, strlen(str));
+        state_ = NEXT;
+        return *this;
+    }
+};
+
+class JSONBufferWriter: public JSONWriter {
+public:
+    JSONBufferWriter(char *buf, size_t size) : buf_(buf), bufSize_(size), n_(0) {}
+
+    char* buffer() const { return buf_; }
+    size_t bufferSize() const { return bufSize_; }
+    size_t dataSize() const { return n_; }
+
+protected:
+    void write(const char *data, size_t size) override {
+        if (n_ < bufSize_) {
+            memcpy(buf_ + n_, data, std::min(size, bufSize_ - n_));
+        }
+        n_ += size;
+    }
+
+private:
+    char *buf_;
+    size_t bufSize_;
+    size_t n_;
+};
+
+// Input side of the Device OS JSON API, parsed by ArduinoJson in place in a
+// copy of the text like Device OS does. parseCopy() counts its calls and the
+// heap blocks they take, for tests checking which paths parse.
+#include <ArduinoJson.h>
+
+extern size_t test_json_parse_count;
+extern size_t test_json_parse_allocations;
+
+enum JSONType {
+    JSON_TYPE_INVALID,
+    JSON_TYPE_NULL,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_STRING,
+    JSON_TYPE_ARRAY,
+    JSON_TYPE_OBJECT
+};
+
+class JSONString {
+public:
+    explicit JSONString(const char *str = nullptr) : str_(str ? str : "") {}
+
+    const char *data() const { return str_; }
+    operator const char *() const { return str_; }
+
+private:
+    const char *str_;
+};
+
+class JSONValue {
+public:
+    JSONValue() = default;
+
+    static JSONValue parseCopy(const char *json, size_t size);
+    static JSONValue parseCopy(const char *json) {
+        return parseCopy(json, strlen(json));
+    }
+
+    JSONType type() const;
+    bool isValid() const { return type() != JSON_TYPE_INVALID; }
+    bool isNull() const { return type() == JSON_TYPE_NULL; }
+    bool isBool() const { return type() == JSON_TYPE_BOOL; }
+    bool isNumber() const { return type() == JSON_TYPE_NUMBER; }
+    bool isString() const { return type() == JSON_TYPE_STRING; }
+    bool isArray() const { return type() == JSON_TYPE_ARRAY; }
+    bool isObject() const { return type() == JSON_TYPE_OBJECT; }
+
+    bool toBool() const { return variant_.as<bool>(); }
+    int toInt() const { return (int) variant_.as<int64_t>(); }
+    double toDouble() const { return variant_.as<double>(); }
+    JSONString toString() const;
+
+private:
+    friend class JSONObjectIterator;
+    friend class JSONArrayIterator;
+
+    JSONValue(std::shared_ptr<const void> data, ArduinoJson::JsonVariantConst variant) :
+        data_(data), variant_(variant) {}
+
+    // text and document the variant points into, none if invalid
+    std::shared_ptr<const void> data_;
+    ArduinoJson::JsonVariantConst variant_;
+};
+
+class JSONObjectIterator {
+public:
+    explicit JSONObjectIterator(const JSONValue &value) :
+        data_(value.data_), object_(value.variant_.as<ArduinoJson::JsonObjectConst>()), it_(object_.begin()), started_(false) {}
+
+    bool next();
+    JSONString name() const { return JSONString(it_->key().c_str()); }
+    JSONValue value() const { return JSONValue(data_, it_->value()); }
+    size_t count() const { return object_.size(); }
+
+private:
+    std::shared_ptr<const void> data_;
+    ArduinoJson::JsonObjectConst object_;
+    mutable ArduinoJson::JsonObjectConst::iterator it_;
+    bool started_;
+};
+
+class JSONArrayIterator {
+public:
+    explicit JSONArrayIterator(const JSONValue &value) :
+        data_(value.data_), array_(value.variant_.as<ArduinoJson::JsonArrayConst>()), it_(array_.begin()), started_(false) {}
+
+    bool next();
+    JSONValue value() const { return JSONValue(data_, *it_); }
+    size_t count() const { return array_.size(); }
+
+private:
+    std::shared_ptr<const void> data_;
+    ArduinoJson::JsonArrayConst array_;
+    mutable ArduinoJson::JsonArrayConst::iterator it_;
+    bool started_;
+};
+
+// Publish side of the Device OS cloud API. Particle.publish() returns at once
+// and the publish completes when the test completes it, the way the cloud
+// acknowledges some time later.
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spark_wiring_thread.h"
+
+typedef uint8_t PublishFlags;
+
+const PublishFlags PUBLIC = 0x00;
+const PublishFlags PRIVATE = 0x01;
+const PublishFlags NO_ACK = 0x02;
+const PublishFlags WITH_ACK = 0x08;
+
+typedef uint32_t system_tick_t;
+
+inline system_tick_t millis() {
+    static auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void delay(unsigned ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+// provided by newlib on the device
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = std::min(len, size - 1);
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+class String {
+public:
+    String(const char *str = nullptr) : str_(str ? str : "") {}
+
+    const char *c_str() const { return str_.c_str(); }
+    unsigned length() const { return str_.size(); }
+    operator const char *() const { return c_str(); }
+
+private:
+    std::string str_;
+};
+
+// Logging is compiled out as LOG_DISABLE does on the device
+class Logger {
+public:
+    void trace(const char *fmt, ...) const {}
+    void info(const char *fmt, ...) const {}
+    void warn(const char *fmt, ...) const {}
+    void error(const char *fmt, ...) const {}
+    void printf(const char *fmt, ...) const {}
+};
+
+extern Logger Log;
+
+class SystemClass {
+public:
+    unsigned uptime() const { return millis() / 1000; }
+};
+
+extern SystemClass System;
+
+class TimeClass {
+public:
+    time_t now() const { return time(nullptr); }
+};
+
+extern TimeClass Time;
+
+// Blocking queue standing in for the RTOS queue
+#define CONCURRENT_WAIT_FOREVER ((system_tick_t) -1)
+
+typedef struct os_queue_stub* os_queue_t;
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void* reserved);
+int os_queue_destroy(os_queue_t queue, void* reserved);
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void* reserved);
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void* reserved);
+
+namespace particle {
+
+struct Error {
+    int code;
+};
+
+} // namespace particle
+
+// Result of an asynchronous operation, completed by the test through
+// ParticleClass::complete()
+struct TestFutureState {
+    std::mutex mutex;
+    // zero while in progress, then one on success or minus one on failure
+    std::atomic<int> result{0};
+    std::vector<std::function<void()>> callbacks;
+
+    void complete(bool success);
+    void then(std::function<void()> callback);
+};
+
+template <typename T>
+class Future {
+public:
+    explicit Future(std::shared_ptr<TestFutureState> state) : state_(state) {}
+
+    bool isDone() const { return state_->result != 0; }
+    bool isSucceeded() const { return state_->result > 0; }
+
+    Future &onSuccess(std::function<void(T)> callback) {
+        auto state = state_;
+        state_->then([state, callback]() {
+            if (state->result > 0) {
+                callback(true);
+            }
+        });
+        return *this;
+    }
+
+    Future &onError(std::function<void(const particle::Error &)> callback) {
+        auto state = state_;
+        state_->then([state, callback]() {
+            if (state->result < 0) {
+                callback(particle::Error{SYSTEM_ERROR_UNKNOWN});
+            }
+        });
+        return *this;
+    }
+
+private:
+    std::shared_ptr<TestFutureState> state_;
+};
+
+struct TestPublish {
+    std::string name;
+    std::string data;
+    PublishFlags flags;
+    std::shared_ptr<TestFutureState> state;
+};
+
+class ParticleClass {
+public:
+    Future<bool> publish(const char *name, const char *data, PublishFlags flags);
+
+    // cloud functions are never called by the cloud, tests call them directly
+    template <typename T>
+    bool function(const char *name, int (T::*handler)(String), T *instance) {
+        return true;
+    }
+
+    // publishes made so far, in the order they were made
+    std::vector<TestPublish> publishes();
+    // completes the publish, returns false if it hasn't been made
+    bool complete(size_t index, bool success);
+    void reset();
+
+private:
+    std::mutex mutex_;
+    std::vector<TestPublish> publishes_;
+};
+
+extern ParticleClass Particle;
@@ -0,0 +1,515 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Particle.h"
+#include "background_publish.h"
+#include "config_service_nodes.h"
+#include "config_store.h"
+#include "location_codec.h"
+#include "murmur3.h"
+
+// Reports the config hashing cost of one ConfigService::tick_sec() for a
+// range of module and node counts.  Every module root is made of objects of
+// eight leaves each, as is typical for the tracker configuration. A changed
+// module is still read back in full for the stored hash, only the check for
+// a change is limited to the dirty path.
+//
+// Child lookup by name is timed against the linear search it replaced, both
+// alone and while applying set_cfg documents to a tree shaped like the
+// tracker geofence config. The host build has no JSON parser so documents are
+// pre-parsed and applied the way _config_process_json() walks them.
+//
+// Also reports the time to load every module config on boot from one file
+// per module against the single config store log, with and without
+// superseded records waiting for compaction.
+//
+// Reports murmur3 throughput over buffers at aligned and unaligned
+// addresses and when fed in the small updates config hashing makes.
+//
+// Reports how often the background publish thread wakes up while idle and
+// per publish against polling every millisecond with delay(1).
+//
+// Finally reports the bytes per location point and points per event of the
+// JSON location object against the compact encoding, for a buoy drifting
+// with a fix every minute and for a vehicle moving with a fix every second.
+
+static const unsigned LEAVES_PER_OBJECT = 8;
+static const unsigned TICKS = 200;
+
+// module of 4^depth objects of eight leaves each, a deeper module has more
+// nodes along the path to a changed leaf
+struct Module {
+    std::vector<int32_t> values;
+    unsigned next = 0;
+    ConfigObject *root;
+    murmur3_hash_t hash, tree;
+
+    Module(unsigned depth) : values(LEAVES_PER_OBJECT << (2 * depth)) {
+        root = new ConfigObject(node(depth));
+    }
+
+    int32_t *value() {
+        return &values[next++];
+    }
+
+    ConfigObject node(unsigned depth) {
+        if (!depth) {
+            return ConfigObject("object", {
+                ConfigInt("a", value()), ConfigInt("b", value()), ConfigInt("c", value()), ConfigInt("d", value()),
+                ConfigInt("e", value()), ConfigInt("f", value()), ConfigInt("g", value()), ConfigInt("h", value()),
+            });
+        }
+        return ConfigObject("object", {node(depth - 1), node(depth - 1), node(depth - 1), node(depth - 1)});
+    }
+
+    ConfigInt *leaf(unsigned n) {
+        auto object = root;
+        while (object->child(0)->type() == CONFIG_NODE_TYPE_OBJECT) {
+            object = reinterpret_cast<ConfigObject *>(object->child(n % 4));
+            n /= 4;
+        }
+        return reinterpret_cast<ConfigInt *>(object->child(n % LEAVES_PER_OBJECT));
+    }
+};
+
+enum class Tick {
+    FULL,       // every module rehashed as before dirty tracking
+    IDLE,       // nothing changed
+    ONE_LEAF,   // one leaf of one module set
+};
+
+static double perTickUs(std::vector<Module *> &modules, Tick tick) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < TICKS; t++) {
+        if (tick == Tick::ONE_LEAF) {
+            modules[t % modules.size()]->leaf(t)->set(t);
+        }
+        for (auto module : modules) {
+            if (tick == Tick::FULL) {
+                config_hash(module->root, module->hash);
+            } else {
+                config_hash_changed(module->root, module->hash, module->tree);
+            }
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / TICKS;
+}
+
+static const unsigned LOOKUPS = 200000;
+static const unsigned DOCUMENTS = 20000;
+
+// lookup as done before the child index
+static ConfigNode *linearChild(ConfigObject *object, const char *name) {
+    for (int i = 0; i < object->child_count(); i++) {
+        auto child = object->child(i);
+        if (!child->name() || !strcmp(name, child->name())) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+struct Document {
+    const char *name;
+    double value;
+    std::vector<Document> children;
+};
+
+template <typename Lookup>
+static int apply(const Document &document, ConfigNode *node, Lookup &lookup) {
+    if (node->type() != CONFIG_NODE_TYPE_OBJECT) {
+        return reinterpret_cast<ConfigFloat *>(node)->set(document.value);
+    }
+    auto object = reinterpret_cast<ConfigObject *>(node);
+    int error = object->enter(true);
+    for (auto &child : document.children) {
+        if (error) {
+            break;
+        }
+        auto config_child = lookup(object, child.name);
+        if (config_child) {
+            error = apply(child, config_child, lookup);
+        }
+    }
+    return object->exit(true, error);
+}
+
+static const char *ZONE_NAMES[] = {"enable", "lat", "lon", "radius", "outside", "inside", "enter", "exit", "verif", "shape_type"};
+
+struct GeofenceModule {
+    double values[4][10] = {};
+    double interval = 0;
+    double receiver = 0;
+    ConfigObject *root;
+
+    ConfigObject zone(const char *name, double *v) {
+        return ConfigObject(name, {
+            ConfigFloat(ZONE_NAMES[0], &v[0]), ConfigFloat(ZONE_NAMES[1], &v[1]),
+            ConfigFloat(ZONE_NAMES[2], &v[2]), ConfigFloat(ZONE_NAMES[3], &v[3]),
+            ConfigFloat(ZONE_NAMES[4], &v[4]), ConfigFloat(ZONE_NAMES[5], &v[5]),
+            ConfigFloat(ZONE_NAMES[6], &v[6]), ConfigFloat(ZONE_NAMES[7], &v[7]),
+            ConfigFloat(ZONE_NAMES[8], &v[8]), ConfigFloat(ZONE_NAMES[9], &v[9]),
+        });
+    }
+
+    GeofenceModule() {
+        root = new ConfigObject("geofence", {
+            ConfigFloat("interval", &interval),
+            ConfigFloat("receiver", &receiver),
+            zone("zone1", values[0]), zone("zone2", values[1]),
+            zone("zone3", values[2]), zone("zone4", values[3]),
+        });
+    }
+
+    // full geofence config as sent by the cloud, zones last
+    Document document() {
+        Document document = {"geofence", 0, {{"interval", 60, {}}, {"receiver", 1, {}}}};
+        for (auto zone : {"zone1", "zone2", "zone3", "zone4"}) {
+            Document z = {zone, 0, {}};
+            for (auto name : ZONE_NAMES) {
+                z.children.push_back({name, 1, {}});
+            }
+            document.children.push_back(z);
+        }
+        return document;
+    }
+};
+
+template <typename Lookup>
+static double lookupNs(ConfigObject *object, Lookup lookup) {
+    volatile uintptr_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < LOOKUPS; i++) {
+        found = found + (uintptr_t) lookup(object, ZONE_NAMES[i % 10]);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+}
+
+template <typename Lookup>
+static double documentUs(GeofenceModule &module, const Document &document, Lookup lookup) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < DOCUMENTS; i++) {
+        apply(document, module.root, lookup);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / DOCUMENTS;
+}
+
+static void lookupBench() {
+    GeofenceModule module;
+    auto document = module.document();
+    auto zone = reinterpret_cast<ConfigObject *>(module.root->child("zone4"));
+    auto linear = [](ConfigObject *object, const char *name) { return linearChild(object, name); };
+    auto indexed = [](ConfigObject *object, const char *name) { return object->child(name); };
+
+    printf("\n%20s %12s %12s\n", "", "linear", "indexed");
+    printf("%20s %12.1f %12.1f\n", "lookup ns", lookupNs(zone, linear), lookupNs(zone, indexed));
+    printf("%20s %12.2f %12.2f\n", "set_cfg document us", documentUs(module, document, linear), documentUs(module, document, indexed));
+}
+
+static const unsigned BOOTS = 200;
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// load as done before the config store, stat, open and read one file per module
+static double fileBootUs(const std::string &dir, unsigned modules, const std::string &json) {
+    for (unsigned i = 0; i < modules; i++) {
+        auto name = dir + "/module" + std::to_string(i) + ".cfg";
+        int fd = open(name.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0664);
+        write(fd, json.data(), json.size());
+        close(fd);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned boot = 0; boot < BOOTS; boot++) {
+        for (unsigned i = 0; i < modules; i++) {
+            auto name = dir + "/module" + std::to_string(i) + ".cfg";
+            struct stat st;
+            stat(name.c_str(), &st);
+            int fd = open(name.c_str(), O_RDONLY);
+            char *data = (char *) malloc(st.st_size);
+            read(fd, data, st.st_size);
+            free(data);
+            close(fd);
+        }
+    }
+    auto us = elapsedUs(start) / BOOTS;
+
+    for (unsigned i = 0; i < modules; i++) {
+        unlink((dir + "/module" + std::to_string(i) + ".cfg").c_str());
+    }
+    return us;
+}
+
+static double storeBootUs(const std::string &dir, unsigned modules, const std::string &json, unsigned updates) {
+    auto path = dir + "/config.log";
+    {
+        ConfigStore store(path.c_str());
+        store.open();
+        for (unsigned u = 0; u <= updates; u++) {
+            for (unsigned i = 0; i < modules; i++) {
+                store.write(("module" + std::to_string(i)).c_str(), json.data(), json.size());
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned boot = 0; boot < BOOTS; boot++) {
+        ConfigStore store(path.c_str());
+        store.open();
+        for (unsigned i = 0; i < modules; i++) {
+            auto name = "module" + std::to_string(i);
+            int size = store.find(name.c_str());
+            char *data = (char *) malloc(size);
+            store.read(name.c_str(), data, size);
+            free(data);
+        }
+    }
+    auto us = elapsedUs(start) / BOOTS;
+
+    unlink(path.c_str());
+    return us;
+}
+
+static void bootBench() {
+    char name[] = "/tmp/fw-config-service-bench-XXXXXX";
+    std::string dir = mkdtemp(name);
+    std::string json(400, ' ');
+
+    printf("\n%8s %12s %12s %16s\n", "modules", "files us", "store us", "store +1 gen us");
+    for (unsigned modules : {4, 8, 16}) {
+        auto files = fileBootUs(dir, modules, json);
+        auto store = storeBootUs(dir, modules, json, 0);
+        auto stale = storeBootUs(dir, modules, json, 1);
+        printf("%8u %12.2f %12.2f %16.2f\n", modules, files, store, stale);
+    }
+    rmdir(dir.c_str());
+}
+
+static const size_t HASH_BYTES = 1 << 24;
+
+static double hashMBs(const uint8_t *data, size_t len, size_t update) {
+    murmur3_hash_t hash;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t total = 0; total < HASH_BYTES; total += len) {
+        murmur3_hash_start(hash, 0);
+        for (size_t i = 0; i < len; i += update) {
+            murmur3_hash_update(hash, data + i, std::min(update, len - i));
+        }
+        murmur3_hash_finalize(hash);
+    }
+    // keep the result alive
+    volatile uint32_t sink = hash.h[0];
+    (void) sink;
+    return HASH_BYTES / elapsedUs(start);
+}
+
+static void hashBench() {
+    std::vector<uint8_t> buffer(4096 + 16);
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = (uint8_t) (i * 7 + 1);
+    }
+    auto aligned = buffer.data();
+    auto unaligned = buffer.data() + 1;
+
+    printf("\n%20s %12s %12s\n", "murmur3 MB/s", "aligned", "unaligned");
+    for (size_t len : {64, 4096}) {
+        auto label = std::to_string(len) + " bytes";
+        printf("%20s %12.1f %12.1f\n", label.c_str(), hashMBs(aligned, len, len), hashMBs(unaligned, len, len));
+    }
+    for (size_t update : {4, 24}) {
+        auto label = std::to_string(update) + " byte updates";
+        printf("%20s %12.1f %12.1f\n", label.c_str(), hashMBs(aligned, 4096, update), hashMBs(unaligned, 4096, update));
+    }
+}
+
+static const unsigned IDLE_MS = 1000;
+static const unsigned PUBLISHES = 200;
+
+// wakeups of a thread polling with delay(1) as the publish thread used to
+static double pollingWakeupsPerSec() {
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned> wakeups{0};
+    std::thread thread([&]() {
+        while (!stop) {
+            delay(1);
+            wakeups++;
+        }
+    });
+    delay(IDLE_MS);
+    stop = true;
+    thread.join();
+    return wakeups * 1000.0 / IDLE_MS;
+}
+
+static void publishBench() {
+    Particle.reset();
+    BackgroundPublish publisher;
+    publisher.start();
+
+    delay(IDLE_MS);
+    double idle = publisher.wakeups() * 1000.0 / IDLE_MS;
+
+    // the cloud acknowledges each publish a millisecond after it is made
+    auto start = publisher.wakeups();
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < PUBLISHES; i++) {
+        publisher.publish("event", "data");
+        while (Particle.publishes().size() <= i) {
+            std::this_thread::yield();
+        }
+        delay(1);
+        Particle.complete(i, true);
+    }
+    while (!publisher.idle()) {
+        std::this_thread::yield();
+    }
+    double per_publish = (double) (publisher.wakeups() - start) / PUBLISHES;
+    double publish_ms = elapsedUs(t0) / 1000.0 / PUBLISHES;
+    publisher.stop();
+
+    // a polling thread wakes once for every millisecond a publish takes
+    printf("\n%20s %12s %12s\n", "publish thread", "delay(1)", "blocking");
+    printf("%20s %12.1f %12.1f\n", "idle wakeups/s", pollingWakeupsPerSec(), idle);
+    printf("%20s %12.1f %12.1f\n", "wakeups/publish", publish_ms, per_publish);
+}
+
+static const size_t TRACK_POINTS = 1000;
+
+static std::vector<location_fix_t> track(double step, uint32_t interval, bool full) {
+    std::mt19937 rng(0x5EED);
+    std::normal_distribution<double> drift(0.0, step);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<location_fix_t> points;
+    double lat = 37.7749295, lon = -122.4194155;
+
+    for (size_t i = 0; i < TRACK_POINTS; i++) {
+        location_fix_t fix = {};
+        fix.time = 1600000000 + interval * i;
+        fix.locked = true;
+        fix.full = full;
+        lat += drift(rng);
+        lon += drift(rng);
+        fix.latitude = lat;
+        fix.longitude = lon;
+        fix.altitude = 3.5f + uniform(rng);
+        fix.heading = 360.0f * uniform(rng);
+        fix.speed = 20.0f * uniform(rng);
+        fix.horizontalAccuracy = 2.0f + 10.0f * uniform(rng);
+        fix.horizontalDop = 0.5f + 2.0f * uniform(rng);
+        fix.verticalAccuracy = 3.0f + 10.0f * uniform(rng);
+        fix.verticalDop = 0.5f + 3.0f * uniform(rng);
+        points.push_back(fix);
+    }
+    return points;
+}
+
+// bytes of the point as written into the loc object by TrackerLocation
+static size_t jsonBytes(const location_fix_t &fix) {
+    char buf[256];
+    JSONBufferWriter writer(buf, sizeof(buf));
+    writer.beginObject();
+    writer.name("lck").value(1);
+    writer.name("time").value((unsigned) fix.time);
+    writer.name("lat").value(fix.latitude, 8);
+    writer.name("lon").value(fix.longitude, 8);
+    if (fix.full) {
+        writer.name("alt").value(fix.altitude, 3);
+        writer.name("hd").value(fix.heading, 2);
+        writer.name("spd").value(fix.speed, 2);
+        writer.name("h_acc").value(fix.horizontalAccuracy, 3);
+        writer.name("hdop").value(fix.horizontalDop, 1);
+        writer.name("v_acc").value(fix.verticalAccuracy, 3);
+        writer.name("vdop").value(fix.verticalDop, 1);
+    }
+    writer.endObject();
+    return writer.dataSize();
+}
+
+static void codecBench() {
+    struct {
+        const char *name;
+        double step;
+        uint32_t interval;
+    } tracks[] = {
+        {"buoy 60s", 2e-5, 60},
+        {"vehicle 1s", 2e-4, 1},
+    };
+    // bytes an event has for points once the rest of the loc publish is in
+    const size_t space = particle::protocol::MAX_EVENT_DATA_LENGTH - 96;
+
+    printf("\n%20s %12s %12s %12s %12s %12s\n", "location bytes/point", "json", "compact", "base64", "json/event", "comp/event");
+    for (auto &it : tracks) {
+        for (auto full : {true, false}) {
+            auto points = track(it.step, it.interval, full);
+            size_t json = 0;
+            for (auto &fix : points) {
+                json += jsonBytes(fix) + 1;
+            }
+
+            std::vector<uint8_t> buf(TRACK_POINTS * LOCATION_CODEC_POINT_MAX);
+            LocationEncoder encoder(buf.data(), buf.size());
+            encoder.begin();
+            for (auto &fix : points) {
+                encoder.add(fix);
+            }
+
+            // points per event with a new payload started for each event
+            std::vector<uint8_t> event(space);
+            LocationEncoder packer(event.data(), event.size());
+            size_t events = 1;
+            packer.begin();
+            for (auto &fix : points) {
+                if (packer.add(fix) || packer.text_size() > space) {
+                    events++;
+                    packer.begin();
+                    packer.add(fix);
+                }
+            }
+
+            auto label = std::string(it.name) + (full ? " full" : " min");
+            printf("%20s %12.1f %12.1f %12.1f %12.1f %12.1f\n", label.c_str(),
+                (double) json / TRACK_POINTS,
+                (double) encoder.size() / TRACK_POINTS,
+                (double) encoder.text_size() / TRACK_POINTS,
+                (double) space * TRACK_POINTS / json,
+                (double) TRACK_POINTS / events);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    printf("%8s %8s %12s %12s %12s\n", "modules", "nodes", "full us", "idle us", "one leaf us");
+    for (unsigned module_count : {4, 8, 16}) {
+        for (unsigned depth : {0, 1, 2}) {
+            std::vector<Module *> modules;
+            for (unsigned i = 0; i < module_count; i++) {
+                modules.push_back(new Module(depth));
+            }
+            auto objects = 1u << (2 * depth);
+            auto nodes = module_count * (objects * LEAVES_PER_OBJECT + (4 * objects - 1) / 3);
+            auto full = perTickUs(modules, Tick::FULL);
+            auto idle = perTickUs(modules, Tick::IDLE);
+            auto one = perTickUs(modules, Tick::ONE_LEAF);
+            printf("%8u %8u %12.2f %12.2f %12.2f\n", module_count, nodes, full, idle, one);
+        }
+    }
+    lookupBench();
+    bootBench();
+    hashBench();
+    publishBench();
+    codecBench();
+    return 0;
+}
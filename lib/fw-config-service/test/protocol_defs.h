@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace particle {
+namespace protocol {
+
+const size_t MAX_EVENT_NAME_LENGTH = 64;
+const size_t MAX_EVENT_DATA_LENGTH = 622;
+
+} // namespace protocol
+} // namespace particle
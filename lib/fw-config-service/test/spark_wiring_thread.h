@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#define OS_THREAD_PRIORITY_DEFAULT (2)
+
+#define WITH_LOCK(lock) for (std::unique_lock<typename std::remove_reference<decltype(lock)>::type> __with_lock((lock)); __with_lock; __with_lock.unlock())
+
+// Runs the thread function on a host thread, dispose() waits for it to
+// return rather than killing it
+class Thread {
+public:
+    Thread(const char* name, std::function<void()> function, int priority = OS_THREAD_PRIORITY_DEFAULT) :
+        _thread(function) {}
+
+    ~Thread() {
+        dispose();
+    }
+
+    void dispose() {
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+private:
+    std::thread _thread;
+};
+
+class RecursiveMutex {
+public:
+    void lock() { _mutex.lock(); }
+    bool try_lock() { return _mutex.try_lock(); }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::recursive_mutex _mutex;
+};
@@ -0,0 +1,2095 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Particle.h"
+#include "background_publish.h"
+#include "base64.h"
+#include "cloud_service.h"
+#include "config_service_nodes.h"
+#include "config_store.h"
+#include "location_codec.h"
+#include "murmur3.h"
+#include "publish_batch.h"
+#include "publish_queue.h"
+
+// Module with leaves of each type directly below the root and in two nested
+// objects, getters are counted to tell which parts of the tree are read back
+struct Module {
+    int32_t interval = 60;
+    bool enable = true;
+    double radius = 150.5;
+    char name[16] = "tracker";
+    int32_t mode = 1;
+    int32_t zone_interval[2] = {10, 20};
+    double zone_lat[2] = {37.7749, -33.8688};
+    int reads = 0;
+    int zone_reads[2] = {0, 0};
+
+    std::function<int(int32_t &, const void *)> countInt(int *counter) {
+        return [this, counter](int32_t &value, const void *context) {
+            (*counter)++;
+            return config_get_int32_cb(value, context);
+        };
+    }
+
+    std::function<int(double &, const void *)> countFloat(int *counter) {
+        return [this, counter](double &value, const void *context) {
+            (*counter)++;
+            return config_get_float_cb(value, context);
+        };
+    }
+
+    ConfigObject zone(const char *name, int i) {
+        return ConfigObject(name, {
+            ConfigInt("interval", countInt(&zone_reads[i]), config_set_int32_cb, &zone_interval[i]),
+            ConfigFloat("lat", countFloat(&zone_reads[i]), config_set_float_cb, &zone_lat[i]),
+        });
+    }
+
+    ConfigObject root {"module", {
+        ConfigInt("interval", countInt(&reads), config_set_int32_cb, &interval),
+        ConfigBool("enable", &enable),
+        ConfigFloat("radius", &radius),
+        ConfigString("name", &name, sizeof(name)),
+        ConfigStringEnum("mode", {{"off", 0}, {"on", 1}}, &mode),
+        zone("zone1", 0),
+        zone("zone2", 1),
+    }};
+
+    ConfigObject &child(const char *name) {
+        return *reinterpret_cast<ConfigObject *>(root.child(name));
+    }
+
+    template <class T>
+    T &leaf(ConfigObject &object, const char *name) {
+        return *reinterpret_cast<T *>(object.child(name));
+    }
+
+    // hash with every object read back again
+    murmur3_hash_t full() {
+        root.mark_dirty();
+        return hash();
+    }
+
+    // hash cached by the objects, which tells a module has changed
+    murmur3_hash_t hash() {
+        murmur3_hash_t hash;
+        memcpy(hash.h, root.hash(), sizeof(hash.h));
+        return hash;
+    }
+
+    void resetReads() {
+        reads = zone_reads[0] = zone_reads[1] = 0;
+    }
+};
+
+TEST_CASE("Dirty tracked config hashing") {
+    Module module;
+    auto initial = module.hash();
+    REQUIRE_FALSE(module.root.dirty());
+    REQUIRE(module.reads == 1);
+    REQUIRE(module.zone_reads[0] == 2);
+    REQUIRE(module.zone_reads[1] == 2);
+
+    SECTION("Children are parented to the copy kept in the tree") {
+        auto &zone1 = module.child("zone1");
+        REQUIRE(zone1.parent() == &module.root);
+        REQUIRE(zone1.child("lat")->parent() == &zone1);
+        REQUIRE(module.root.child("interval")->parent() == &module.root);
+        REQUIRE(module.root.parent() == nullptr);
+    }
+
+    SECTION("A clean tree is not read back") {
+        module.resetReads();
+        REQUIRE(module.hash() == initial);
+        REQUIRE(module.reads == 0);
+        REQUIRE(module.zone_reads[0] == 0);
+        REQUIRE(module.zone_reads[1] == 0);
+        REQUIRE(module.full() == initial);
+    }
+
+    SECTION("Setters only dirty the path to the root") {
+        auto &zone2 = module.child("zone2");
+        module.resetReads();
+        REQUIRE(module.leaf<ConfigFloat>(zone2, "lat").set(51.5074) == 0);
+        REQUIRE(zone2.dirty());
+        REQUIRE(module.root.dirty());
+        REQUIRE_FALSE(module.child("zone1").dirty());
+
+        auto changed = module.hash();
+        REQUIRE(changed != initial);
+        REQUIRE(module.reads == 1);
+        REQUIRE(module.zone_reads[0] == 0);
+        REQUIRE(module.zone_reads[1] == 2);
+        REQUIRE(module.full() == changed);
+
+        // same values give the same hash again
+        REQUIRE(module.leaf<ConfigFloat>(zone2, "lat").set(-33.8688) == 0);
+        REQUIRE(module.hash() == initial);
+
+        REQUIRE(module.leaf<ConfigStringEnum>(module.root, "mode").set("off") == 0);
+        REQUIRE(module.hash() != initial);
+        REQUIRE(module.leaf<ConfigString>(module.root, "name").set("monitor") == 0);
+        auto both = module.hash();
+        REQUIRE(module.full() == both);
+    }
+
+    SECTION("Rejected values leave the tree clean") {
+        REQUIRE(module.leaf<ConfigString>(module.root, "name").set("a name that is too long") == -EDOM);
+        REQUIRE(module.leaf<ConfigStringEnum>(module.root, "mode").set("auto") == -EINVAL);
+        REQUIRE_FALSE(module.root.dirty());
+    }
+
+    SECTION("Values changed behind the tree need marking") {
+        module.zone_interval[0] = 15;
+        REQUIRE(module.hash() == initial);
+        module.child("zone1").child("interval")->mark_dirty();
+        module.resetReads();
+        auto changed = module.hash();
+        REQUIRE(changed != initial);
+        REQUIRE(module.zone_reads[0] == 2);
+        REQUIRE(module.zone_reads[1] == 0);
+        REQUIRE(module.full() == changed);
+    }
+}
+
+TEST_CASE("Shadowed config commit") {
+    // values are written to a shadow copy and committed on exit, as with the
+    // tracker location config
+    struct {
+        int32_t interval = 60;
+        int32_t shadow = 60;
+        int enter_status = 0;
+    } state;
+
+    ConfigObject root("shadowed", {
+        ConfigInt("interval", config_get_int32_cb, config_set_int32_cb, &state.interval, &state.shadow),
+    },
+    [&](bool write, const void *context) {
+        if(write)
+        {
+            state.shadow = state.interval;
+        }
+        return state.enter_status;
+    },
+    [&](bool write, int status, const void *context) {
+        if(write && !status)
+        {
+            state.interval = state.shadow;
+        }
+        return status;
+    });
+
+    murmur3_hash_t initial, tree;
+    config_hash_changed(&root, initial, tree);
+
+    // the setter only touches the shadow so the hash can't change until commit
+    REQUIRE(root.enter(true) == 0);
+    REQUIRE(reinterpret_cast<ConfigInt *>(root.child("interval"))->set(300) == 0);
+    REQUIRE(root.exit(true, 0) == 0);
+    REQUIRE(state.interval == 300);
+    REQUIRE(root.dirty());
+    murmur3_hash_t hash = initial;
+    config_hash_changed(&root, hash, tree);
+    REQUIRE(hash != initial);
+
+    // an object that can't be entered stays dirty and is retried, keeping
+    // its previous hash meanwhile
+    state.interval = 60;
+    root.mark_dirty();
+    state.enter_status = -EBUSY;
+    murmur3_hash_t busy = hash;
+    config_hash_changed(&root, busy, tree);
+    REQUIRE(busy == hash);
+    REQUIRE(root.dirty());
+    state.enter_status = 0;
+    config_hash_changed(&root, busy, tree);
+    REQUIRE(busy == initial);
+    REQUIRE_FALSE(root.dirty());
+}
+
+// the hash stored with a module and synced with the cloud streams every
+// value of the tree, stored hashes must still match after an upgrade
+TEST_CASE("Module hash composition") {
+    Module module;
+
+    auto stream = [](Module &m) {
+        murmur3_hash_t hash;
+        murmur3_hash_start(hash, 0);
+        murmur3_hash_update(hash, "module", strlen("module"));
+        murmur3_hash_update(hash, &m.interval, sizeof(m.interval));
+        murmur3_hash_update(hash, &m.enable, sizeof(m.enable));
+        murmur3_hash_update(hash, &m.radius, sizeof(m.radius));
+        murmur3_hash_update(hash, m.name, strlen(m.name));
+        const char *mode = m.mode ? "on" : "off";
+        murmur3_hash_update(hash, mode, strlen(mode));
+        for(int i = 0; i < 2; i++) {
+            const char *zone = i ? "zone2" : "zone1";
+            murmur3_hash_update(hash, zone, strlen(zone));
+            murmur3_hash_update(hash, &m.zone_interval[i], sizeof(m.zone_interval[i]));
+            murmur3_hash_update(hash, &m.zone_lat[i], sizeof(m.zone_lat[i]));
+        }
+        murmur3_hash_finalize(hash);
+        return hash;
+    };
+
+    murmur3_hash_t hash, tree;
+    config_hash(&module.root, hash);
+    REQUIRE(hash == stream(module));
+
+    // a clean tree keeps its hash without being read back
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(hash == stream(module));
+    module.resetReads();
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(module.reads == 0);
+    REQUIRE(module.zone_reads[0] == 0);
+    REQUIRE(module.zone_reads[1] == 0);
+
+    // a change is read back in full once
+    auto &zone2 = module.child("zone2");
+    REQUIRE(module.leaf<ConfigFloat>(zone2, "lat").set(51.5074) == 0);
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(hash == stream(module));
+    module.resetReads();
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(module.reads == 0);
+    REQUIRE(module.zone_reads[1] == 0);
+
+    // values changed behind the tree are picked up once marked
+    module.zone_interval[0] = 15;
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(hash != stream(module));
+    module.root.mark_dirty();
+    config_hash_changed(&module.root, hash, tree);
+    REQUIRE(hash == stream(module));
+}
+
+TEST_CASE("Child lookup") {
+    int32_t values[6] = {};
+    static ConfigObject zone("zone", {
+        ConfigInt("verif", &values[0]),
+    });
+    ConfigObject object("object", {
+        ConfigInt("radius", &values[1]),
+        ConfigInt("enable", &values[2]),
+        ConfigInt("lat", &values[3]),
+        &zone,
+        ConfigInt("exit", &values[4]),
+        ConfigInt("lon", &values[5]),
+    });
+
+    SECTION("Every child is found by name") {
+        for (int i = 0; i < object.child_count(); i++) {
+            REQUIRE(object.child(object.child(i)->name()) == object.child(i));
+        }
+        REQUIRE(object.child("zone") == &zone);
+        REQUIRE(object.child("") == nullptr);
+        REQUIRE(object.child("a") == nullptr);
+        REQUIRE(object.child("lats") == nullptr);
+        REQUIRE(object.child("zzz") == nullptr);
+        REQUIRE(object.child(nullptr) == nullptr);
+        REQUIRE(object.child(-1) == nullptr);
+        REQUIRE(object.child(object.child_count()) == nullptr);
+    }
+
+    SECTION("Static nodes are referenced and adopted") {
+        REQUIRE(zone.parent() == &object);
+        REQUIRE(reinterpret_cast<ConfigInt *>(zone.child("verif"))->set(30) == 0);
+        REQUIRE(object.dirty());
+        REQUIRE(values[0] == 30);
+    }
+
+    SECTION("Unnamed children match names not found earlier") {
+        ConfigObject wildcard("wildcard", {
+            ConfigInt("b", &values[0]),
+            ConfigInt(nullptr, &values[1]),
+            ConfigInt("a", &values[2]),
+        });
+        REQUIRE(wildcard.child("b") == wildcard.child(0));
+        REQUIRE(wildcard.child("a") == wildcard.child(1));
+        REQUIRE(wildcard.child("c") == wildcard.child(1));
+    }
+
+    SECTION("Children past the first 256 are found by name") {
+        // names sort in the reverse of declaration order
+        std::vector<std::string> names;
+        int32_t leaves[300] = {};
+        for (int i = 0; i < 300; i++) {
+            names.push_back(std::to_string(1000 - i));
+        }
+#define LEAF(i) ConfigInt(names[i].c_str(), &leaves[i])
+#define LEAVES10(i) LEAF(i), LEAF(i + 1), LEAF(i + 2), LEAF(i + 3), LEAF(i + 4), \
+    LEAF(i + 5), LEAF(i + 6), LEAF(i + 7), LEAF(i + 8), LEAF(i + 9)
+#define LEAVES100(i) LEAVES10(i), LEAVES10(i + 10), LEAVES10(i + 20), LEAVES10(i + 30), LEAVES10(i + 40), \
+    LEAVES10(i + 50), LEAVES10(i + 60), LEAVES10(i + 70), LEAVES10(i + 80), LEAVES10(i + 90)
+        ConfigObject wide("wide", {LEAVES100(0), LEAVES100(100), LEAVES100(200)});
+#undef LEAVES100
+#undef LEAVES10
+#undef LEAF
+        REQUIRE(wide.child_count() == 300);
+        for (int i = 0; i < wide.child_count(); i++) {
+            REQUIRE(wide.child(names[i].c_str()) == wide.child(i));
+        }
+        REQUIRE(wide.child("1001") == nullptr);
+        REQUIRE(wide.child("700") == nullptr);
+    }
+}
+
+// Stand-in for the cloud side of config sync, publishes the changed leaves of
+// a module in events of at most EVENT_SIZE bytes and acknowledges them the way
+// ConfigService::tick_sec() and config_sync_ack_cb() do
+static const size_t EVENT_SIZE = 622;
+
+struct CloudSink {
+    std::vector<std::string> events;
+
+    // publish until everything is in sync, returns the events sent
+    size_t sync(ConfigNode *root, bool ack = true) {
+        size_t sent = 0;
+        for (;;) {
+            Vector<config_sync_leaf_t> changes;
+            REQUIRE(config_sync_changes(root, changes) == 0);
+            if (changes.isEmpty()) {
+                break;
+            }
+            int total = changes.size();
+            std::string event(EVENT_SIZE + 1, '\0');
+            JSONBufferWriter writer(&event[0], EVENT_SIZE);
+            writer.beginObject();
+            writer.name("cmd").value("cfg");
+            writer.name("time").value(1600000000u);
+            writer.name("cfg").beginObject();
+            REQUIRE(config_write_json_changes(root, writer, writer.bufferSize() - writer.dataSize() - 21 - 1, changes) == 0);
+            REQUIRE(changes.size() <= total);
+            writer.endObject();
+            writer.endObject();
+            REQUIRE(writer.dataSize() + 21 <= EVENT_SIZE);
+            event.resize(writer.dataSize());
+            events.push_back(event);
+            sent++;
+            if (!ack) {
+                break;
+            }
+            config_sync_commit(changes);
+        }
+        return sent;
+    }
+
+    size_t bytes() {
+        size_t total = 0;
+        for (auto &it : events) {
+            total += it.size();
+        }
+        return total;
+    }
+};
+
+struct GeofenceConfig {
+    int32_t interval = 0;
+    bool receiver = false;
+    struct {
+        bool enable = false;
+        double lat = 0.0;
+        double lon = 0.0;
+        double radius = 0.0;
+        bool outside = false, inside = false, enter = false, exit = false;
+        int32_t verif = 0;
+        int32_t shape = 0;
+    } zones[4];
+
+    ConfigObject zone(const char *name, int i) {
+        return ConfigObject(name, {
+            ConfigBool("enable", &zones[i].enable),
+            ConfigFloat("lat", &zones[i].lat),
+            ConfigFloat("lon", &zones[i].lon),
+            ConfigFloat("radius", &zones[i].radius),
+            ConfigBool("outside", &zones[i].outside),
+            ConfigBool("inside", &zones[i].inside),
+            ConfigBool("enter", &zones[i].enter),
+            ConfigBool("exit", &zones[i].exit),
+            ConfigInt("verif", &zones[i].verif),
+            ConfigStringEnum("shape_type", {{"circular", 0}, {"polygonal", 1}}, &zones[i].shape),
+        });
+    }
+
+    ConfigObject root {"geofence", {
+        ConfigInt("interval", &interval),
+        ConfigBool("receiver", &receiver),
+        zone("zone1", 0),
+        zone("zone2", 1),
+        zone("zone3", 2),
+        zone("zone4", 3),
+    }};
+
+    ConfigObject &object(const char *name) {
+        return *reinterpret_cast<ConfigObject *>(root.child(name));
+    }
+};
+
+TEST_CASE("Field level config sync") {
+    GeofenceConfig config;
+    CloudSink cloud;
+
+    for (int i = 0; i < 4; i++) {
+        config.zones[i] = {true, 37.7749 + i, -122.4194 - i, 1000.0 * (i + 1), true, true, true, true, 30, 0};
+    }
+
+    SECTION("Unknown leaves are all published") {
+        // the whole module no longer fits in a single event
+        config_sync_reset(&config.root, false);
+        REQUIRE(cloud.sync(&config.root) == 2);
+        REQUIRE(cloud.events[0].find("\"zone1\":{\"enable\":true") != std::string::npos);
+        REQUIRE(cloud.events[1].find("\"zone4\":{") != std::string::npos);
+        REQUIRE(cloud.events[1].find("\"shape_type\":\"circular\"}}}}") != std::string::npos);
+        REQUIRE(cloud.sync(&config.root) == 0);
+    }
+
+    SECTION("Only changed leaves are published") {
+        config_sync_reset(&config.root, true);
+        REQUIRE(cloud.sync(&config.root) == 0);
+
+        REQUIRE(reinterpret_cast<ConfigFloat *>(config.object("zone2").child("lat"))->set(51.5) == 0);
+        REQUIRE(reinterpret_cast<ConfigInt *>(config.root.child("interval"))->set(60) == 0);
+        REQUIRE(cloud.sync(&config.root) == 1);
+        REQUIRE(cloud.events[0] == "{\"cmd\":\"cfg\",\"time\":1600000000,\"cfg\":{\"geofence\":{\"interval\":60,\"zone2\":{\"lat\":51.5}}}}");
+
+        // a value changed and back again has nothing to publish
+        REQUIRE(reinterpret_cast<ConfigBool *>(config.object("zone3").child("exit"))->set(false) == 0);
+        REQUIRE(reinterpret_cast<ConfigBool *>(config.object("zone3").child("exit"))->set(true) == 0);
+        REQUIRE(cloud.sync(&config.root) == 0);
+    }
+
+    SECTION("Unacknowledged leaves are published again") {
+        config_sync_reset(&config.root, true);
+        config.zones[0].radius = 250.0;
+        REQUIRE(cloud.sync(&config.root, false) == 1);
+        REQUIRE(cloud.sync(&config.root) == 1);
+        REQUIRE(cloud.events[0] == cloud.events[1]);
+    }
+
+    SECTION("Changes too large for one event are split") {
+        char names[4][64];
+        ConfigObject large("large", {
+            ConfigString("a", &names[0], sizeof(names[0])),
+            ConfigString("b", &names[1], sizeof(names[1])),
+            ConfigObject("nested", {
+                ConfigString("c", &names[2], sizeof(names[2])),
+                ConfigString("d", &names[3], sizeof(names[3])),
+            }),
+        });
+        for (auto &name : names) {
+            memset(name, 'x', sizeof(name) - 1);
+            name[sizeof(name) - 1] = '\0';
+        }
+        ConfigObject module("module", {&config.root, &large});
+
+        config_sync_reset(&module, false);
+        REQUIRE(cloud.sync(&module) == 2);
+        REQUIRE(cloud.events[1].find("\"large\":{") != std::string::npos);
+        for (auto &event : cloud.events) {
+            REQUIRE(event.size() <= EVENT_SIZE);
+        }
+    }
+
+    SECTION("Changes of several modules share an event") {
+        int32_t interval = 60;
+        ConfigObject sleep("sleep", {ConfigInt("exe_min", &interval)});
+        config_sync_reset(&config.root, true);
+        config_sync_reset(&sleep, true);
+        config.zones[3].verif = 45;
+        interval = 15;
+
+        // as ConfigService::sync_changes() writes them
+        char buf[EVENT_SIZE];
+        JSONBufferWriter writer(buf, sizeof(buf));
+        writer.beginObject();
+        for (auto module : {&config.root, &sleep}) {
+            Vector<config_sync_leaf_t> changes;
+            REQUIRE(config_sync_changes(module, changes) == 0);
+            REQUIRE(config_write_json_changes(module, writer, writer.bufferSize() - writer.dataSize() - 1, changes) == 0);
+            config_sync_commit(changes);
+        }
+        writer.endObject();
+        REQUIRE(std::string(buf, writer.dataSize()) == "{\"geofence\":{\"zone4\":{\"verif\":45}},\"sleep\":{\"exe_min\":15}}");
+        REQUIRE(cloud.sync(&config.root) == 0);
+        REQUIRE(cloud.sync(&sleep) == 0);
+    }
+
+    SECTION("A leaf that can never fit is reported") {
+        char name[700];
+        memset(name, 'x', sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        ConfigObject module("module", {ConfigString("name", &name, sizeof(name))});
+        Vector<config_sync_leaf_t> changes;
+        char buf[EVENT_SIZE];
+        JSONBufferWriter writer(buf, sizeof(buf));
+
+        REQUIRE(config_sync_changes(&module, changes) == 0);
+        REQUIRE(config_write_json_changes(&module, writer, sizeof(buf), changes) == -ENOSPC);
+        REQUIRE(writer.dataSize() == 0);
+    }
+
+    SECTION("Payload against publishing whole modules") {
+        char buf[2048];
+        JSONBufferWriter writer(buf, sizeof(buf));
+        writer.beginObject();
+        config_write_json(&config.root, writer);
+        writer.endObject();
+        auto full = writer.dataSize();
+
+        config_sync_reset(&config.root, true);
+        config.zones[1].radius = 2500.0;
+        cloud.sync(&config.root);
+        REQUIRE(cloud.events.size() == 1);
+        // the delta includes the command envelope the full size doesn't
+        REQUIRE(cloud.bytes() * 4 < full);
+        WARN("whole module " << full << " bytes, one changed leaf " << cloud.bytes() << " bytes");
+    }
+}
+
+// Flattens json as written by JSONWriter into the path and text of each
+// value, enough to merge the parts of a streamed config back together
+static void flattenJson(const std::string &json, size_t &pos, const std::string &path, std::map<std::string, std::string> &values) {
+    if (json[pos] != '{') {
+        size_t end = pos;
+        if (json[pos] == '"') {
+            end = json.find('"', pos + 1) + 1;
+        } else {
+            while (end < json.size() && json[end] != ',' && json[end] != '}') {
+                end++;
+            }
+        }
+        values[path] = json.substr(pos, end - pos);
+        pos = end;
+        return;
+    }
+    pos++;
+    if (json[pos] == '}') {
+        values[path] = "{}";
+    }
+    while (json[pos] != '}') {
+        if (json[pos] == ',') {
+            pos++;
+        }
+        size_t end = json.find('"', pos + 1);
+        auto name = json.substr(pos + 1, end - pos - 1);
+        pos = end + 2;
+        flattenJson(json, pos, path + "/" + name, values);
+    }
+    pos++;
+}
+
+static std::map<std::string, std::string> flattenJson(const std::string &json) {
+    std::map<std::string, std::string> values;
+    size_t pos = 0;
+    flattenJson(json, pos, "", values);
+    REQUIRE(pos == json.size());
+    return values;
+}
+
+// Stand-in for the cloud side of get_cfg, publishes the modules a numbered
+// part at a time the way ConfigService::get_cfg_send() does
+struct GetCfgSink {
+    std::vector<std::string> events;
+
+    void publish(std::vector<ConfigNode *> modules) {
+        ConfigJsonStream stream;
+        int part = 0;
+        while (!modules.empty()) {
+            std::string event(EVENT_SIZE + 1, '\0');
+            JSONBufferWriter writer(&event[0], EVENT_SIZE);
+            writer.beginObject();
+            writer.name("cmd").value("cfg");
+            writer.name("time").value(1600000000u);
+            writer.name("part").value(part++);
+            writer.name("cfg").beginObject();
+            size_t start = writer.dataSize();
+            while (!modules.empty()) {
+                if (stream.done()) {
+                    stream.begin(modules.front());
+                }
+                int error = stream.write(writer, writer.bufferSize() - writer.dataSize() - 21 - 13 - 1);
+                if (error == -ENOSPC && writer.dataSize() == start) {
+                    stream.skip();
+                    continue;
+                }
+                if (error == -ENOSPC || error == -EAGAIN) {
+                    break;
+                }
+                REQUIRE(error == 0);
+                modules.erase(modules.begin());
+            }
+            writer.endObject();
+            writer.name("last").value(modules.empty());
+            writer.endObject();
+            REQUIRE(writer.dataSize() + 21 <= EVENT_SIZE);
+            event.resize(writer.dataSize());
+            events.push_back(event);
+            REQUIRE(part < 1000);
+        }
+    }
+
+    // merges the config of every part, checking they are numbered in order
+    // and only the last is flagged
+    std::map<std::string, std::string> merge() {
+        std::map<std::string, std::string> merged;
+        for (size_t i = 0; i < events.size(); i++) {
+            auto values = flattenJson(events[i]);
+            REQUIRE(values["/part"] == std::to_string(i));
+            REQUIRE(values["/last"] == (i + 1 == events.size() ? "true" : "false"));
+            for (auto &it : values) {
+                if (!it.first.compare(0, 5, "/cfg/")) {
+                    REQUIRE(merged.count(it.first) == 0);
+                    merged[it.first.substr(4)] = it.second;
+                }
+            }
+        }
+        return merged;
+    }
+};
+
+static std::map<std::string, std::string> wholeConfig(std::vector<ConfigNode *> modules) {
+    std::string buf(1 << 16, '\0');
+    JSONBufferWriter writer(&buf[0], buf.size());
+    writer.beginObject();
+    for (auto module : modules) {
+        config_write_json(module, writer);
+    }
+    writer.endObject();
+    REQUIRE(writer.dataSize() < buf.size());
+    buf.resize(writer.dataSize());
+    return flattenJson(buf);
+}
+
+// module of 4^depth objects of eight leaves of every type
+struct LargeConfig {
+    std::vector<int32_t> ints;
+    std::vector<double> floats;
+    std::vector<bool> bools;
+    std::vector<std::array<char, 24>> strings;
+    unsigned next = 0;
+    ConfigObject root;
+
+    LargeConfig(const char *name, unsigned depth) :
+        ints(2 << (2 * depth)), floats(2 << (2 * depth)), bools(2 << (2 * depth)), strings(2 << (2 * depth)),
+        root(name, {node(depth, 0), node(depth, 1), node(depth, 2), node(depth, 3)}) {
+    }
+
+    ConfigObject node(unsigned depth, unsigned n) {
+        static const char *NAMES[] = {"alpha", "beta", "gamma", "delta"};
+        if (depth == 1) {
+            unsigned i = next++;
+            ints[2 * i] = i;
+            ints[2 * i + 1] = -(int32_t) i;
+            floats[2 * i] = i + 0.5;
+            floats[2 * i + 1] = -1.25 * i;
+            snprintf(strings[2 * i].data(), strings[2 * i].size(), "value %u", i);
+            snprintf(strings[2 * i + 1].data(), strings[2 * i + 1].size(), "other value %u", i);
+            return ConfigObject(NAMES[n], {
+                ConfigInt("count", &ints[2 * i]), ConfigInt("offset", &ints[2 * i + 1]),
+                ConfigFloat("lat", &floats[2 * i]), ConfigFloat("lon", &floats[2 * i + 1]),
+                ConfigBool("enable", [this, i](bool &value, const void *) { value = bools[2 * i]; return 0; }, nullptr),
+                ConfigBool("notify", [this, i](bool &value, const void *) { value = bools[2 * i + 1]; return 0; }, nullptr),
+                ConfigString("label", strings[2 * i].data(), strings[2 * i].size()),
+                ConfigString("note", strings[2 * i + 1].data(), strings[2 * i + 1].size()),
+            });
+        }
+        return ConfigObject(NAMES[n], {node(depth - 1, 0), node(depth - 1, 1), node(depth - 1, 2), node(depth - 1, 3)});
+    }
+};
+
+TEST_CASE("Streamed config") {
+    GetCfgSink cloud;
+
+    SECTION("A tree of hundreds of nodes is published in parts") {
+        LargeConfig config("large", 3);
+        cloud.publish({&config.root});
+        auto merged = cloud.merge();
+        REQUIRE(merged.size() == 64 * 8);
+        REQUIRE(merged == wholeConfig({&config.root}));
+        REQUIRE(cloud.events.size() > 10);
+        for (auto &event : cloud.events) {
+            REQUIRE(event.size() <= EVENT_SIZE);
+        }
+        // parts are filled up to a leaf that no longer fits
+        REQUIRE(cloud.events[0].size() > EVENT_SIZE - 100);
+    }
+
+    SECTION("Modules share parts") {
+        GeofenceConfig geofence;
+        int32_t interval = 60;
+        ConfigObject sleep("sleep", {ConfigInt("exe_min", &interval)});
+        LargeConfig config("large", 2);
+        cloud.publish({&sleep, &geofence.root, &config.root});
+        REQUIRE(cloud.merge() == wholeConfig({&sleep, &geofence.root, &config.root}));
+        REQUIRE(cloud.events[0].find("\"sleep\":{\"exe_min\":60},\"geofence\":{") != std::string::npos);
+    }
+
+    SECTION("Values changed between parts are read as each part is written") {
+        LargeConfig config("large", 2);
+        ConfigJsonStream stream;
+        char buf[256];
+        JSONBufferWriter writer(buf, sizeof(buf));
+        stream.begin(&config.root);
+        REQUIRE(stream.write(writer, sizeof(buf)) == -EAGAIN);
+        config.ints.back() = 1234;
+        std::string rest;
+        int error;
+        do {
+            JSONBufferWriter part(buf, sizeof(buf));
+            error = stream.write(part, sizeof(buf));
+            rest.append(buf, part.dataSize());
+        } while (error == -EAGAIN);
+        REQUIRE(error == 0);
+        REQUIRE(stream.done());
+        REQUIRE(rest.find("\"offset\":1234") != std::string::npos);
+    }
+
+    SECTION("Empty objects and unnamed children") {
+        int32_t value = 5;
+        ConfigObject module("module", {
+            ConfigObject("empty", {}),
+            ConfigInt(nullptr, &value),
+            ConfigObject("nested", {ConfigObject("empty", {}), ConfigInt("value", &value)}),
+        });
+        cloud.publish({&module});
+        REQUIRE(cloud.events.size() == 1);
+        REQUIRE(cloud.merge() == wholeConfig({&module}));
+        REQUIRE(cloud.events[0].find("\"cfg\":{\"module\":{\"empty\":{},\"nested\":{\"empty\":{},\"value\":5}}}") != std::string::npos);
+    }
+
+    SECTION("A leaf that can never fit is passed over") {
+        char name[700];
+        memset(name, 'x', sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        int32_t value = 5;
+        ConfigObject module("module", {
+            ConfigInt("before", &value),
+            ConfigString("name", &name, sizeof(name)),
+            ConfigInt("after", &value),
+        });
+        cloud.publish({&module});
+        auto merged = cloud.merge();
+        auto whole = wholeConfig({&module});
+        REQUIRE(whole.erase("/module/name") == 1);
+        REQUIRE(merged == whole);
+    }
+}
+
+// config store log in a temporary directory removed again with the test
+struct TempStore {
+    std::string dir;
+    std::string path;
+    std::string temp_path;
+
+    TempStore() {
+        char name[] = "/tmp/fw-config-service-XXXXXX";
+        dir = mkdtemp(name);
+        path = dir + "/config.log";
+        temp_path = path + ".tmp";
+    }
+
+    ~TempStore() {
+        unlink(path.c_str());
+        unlink(temp_path.c_str());
+        rmdir(dir.c_str());
+    }
+
+    static std::string read(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static void write(const std::string &path, const std::string &data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+    }
+
+    static bool exists(const std::string &path) {
+        struct stat st;
+        return !stat(path.c_str(), &st);
+    }
+};
+
+static const char *STORE_NAMES[] = {"location", "sleep", "tracker", "temp", "rgb", "imu_trig"};
+
+static void requireContents(ConfigStore &store, const std::map<std::string, std::string> &expected) {
+    for (auto name : STORE_NAMES) {
+        auto it = expected.find(name);
+        if (it == expected.end()) {
+            REQUIRE(store.find(name) == -ENOENT);
+            continue;
+        }
+        std::string data(CONFIG_STORE_RECORD_MAX, '\0');
+        REQUIRE(store.find(name) == (int) it->second.size());
+        REQUIRE(store.read(name, &data[0], data.size()) == (int) it->second.size());
+        data.resize(it->second.size());
+        REQUIRE(data == it->second);
+    }
+}
+
+TEST_CASE("Config store") {
+    TempStore temp;
+    ConfigStore store(temp.path.c_str());
+    std::map<std::string, std::string> expected;
+
+    REQUIRE(store.write("location", "{}", 2) == -EBADF);
+    REQUIRE(store.open() == 0);
+    REQUIRE(store.size() == sizeof(config_store_file_header_t));
+    requireContents(store, expected);
+
+    expected["location"] = "{\"interval\":60}";
+    expected["sleep"] = "{\"mode\":\"enable\"}";
+    for (auto &it : expected) {
+        REQUIRE(store.write(it.first.c_str(), it.second.data(), it.second.size()) == 0);
+    }
+    requireContents(store, expected);
+
+    SECTION("Latest record wins across reopen") {
+        expected["location"] = "{\"interval\":300}";
+        REQUIRE(store.write("location", expected["location"].data(), expected["location"].size()) == 0);
+        REQUIRE(store.size() > store.live_size());
+        requireContents(store, expected);
+
+        auto size = store.size();
+        store.close();
+        REQUIRE(store.open() == 0);
+        REQUIRE(store.size() == size);
+        requireContents(store, expected);
+    }
+
+    SECTION("Compaction keeps only live records") {
+        for (int i = 0; i < 1000 && !store.compact_pending(); i++) {
+            auto data = std::string("{\"interval\":") + std::to_string(i) + "}";
+            REQUIRE(store.write("location", data.data(), data.size()) == 0);
+            expected["location"] = data;
+        }
+        REQUIRE(store.compact_pending());
+        REQUIRE(store.compact() == 0);
+        REQUIRE_FALSE(store.compact_pending());
+        REQUIRE(store.size() == store.live_size());
+        REQUIRE(TempStore::read(temp.path).size() == store.size());
+        REQUIRE_FALSE(TempStore::exists(temp.temp_path));
+        requireContents(store, expected);
+
+        // and appends continue after the compacted records
+        expected["rgb"] = "{\"type\":\"tracker\"}";
+        REQUIRE(store.write("rgb", expected["rgb"].data(), expected["rgb"].size()) == 0);
+        store.close();
+        REQUIRE(store.open() == 0);
+        requireContents(store, expected);
+    }
+
+    SECTION("Invalid requests") {
+        std::string large(CONFIG_STORE_RECORD_MAX + 1, 'x');
+        char small[4];
+        REQUIRE(store.write("location", large.data(), large.size()) == -EINVAL);
+        REQUIRE(store.write("", "{}", 2) == -EINVAL);
+        REQUIRE(store.write("a_module_name_that_is_far_too_long", "{}", 2) == -EINVAL);
+        REQUIRE(store.read("location", small, sizeof(small)) == -ENOSPC);
+        REQUIRE(store.read("temp", small, sizeof(small)) == -ENOENT);
+        requireContents(store, expected);
+    }
+
+    SECTION("Corruption drops the log from the damaged record") {
+        auto log = TempStore::read(temp.path);
+        store.close();
+
+        // flip a byte in the data of the second record
+        log[log.size() - 2] ^= 0x01;
+        TempStore::write(temp.path, log);
+        REQUIRE(store.open() == 0);
+        expected.erase("sleep");
+        requireContents(store, expected);
+
+        // an unrecognised file is started over
+        store.close();
+        TempStore::write(temp.path, "not a config log");
+        REQUIRE(store.open() == 0);
+        expected.clear();
+        requireContents(store, expected);
+        REQUIRE(store.size() == sizeof(config_store_file_header_t));
+    }
+}
+
+extern int test_fsync_count;
+
+TEST_CASE("Config store batches") {
+    TempStore temp;
+    ConfigStore store(temp.path.c_str());
+    std::map<std::string, std::string> expected;
+
+    REQUIRE(store.open() == 0);
+
+    SECTION("A batch is flushed once") {
+        test_fsync_count = 0;
+        for (auto name : STORE_NAMES) {
+            expected[name] = std::string("{\"") + name + "\":{}}";
+            REQUIRE(store.write(name, expected[name].data(), expected[name].size()) == 0);
+        }
+        REQUIRE(test_fsync_count == 6);
+
+        test_fsync_count = 0;
+        store.begin();
+        for (auto name : STORE_NAMES) {
+            expected[name] = std::string("{\"") + name + "\":{\"enable\":true}}";
+            REQUIRE(store.write(name, expected[name].data(), expected[name].size()) == 0);
+        }
+        // not visible until committed
+        REQUIRE(store.find("location") == (int) strlen("{\"location\":{}}"));
+        REQUIRE(store.commit() == 0);
+        REQUIRE(test_fsync_count == 1);
+        requireContents(store, expected);
+
+        store.close();
+        REQUIRE(store.open() == 0);
+        requireContents(store, expected);
+    }
+
+    SECTION("An uncommitted batch is dropped") {
+        expected["location"] = "{}";
+        REQUIRE(store.write("location", "{}", 2) == 0);
+        store.begin();
+        REQUIRE(store.write("location", "{\"a\":1}", 7) == 0);
+        REQUIRE(store.write("sleep", "{\"b\":2}", 7) == 0);
+        store.close();
+
+        REQUIRE(store.open() == 0);
+        requireContents(store, expected);
+        REQUIRE(store.size() == store.live_size());
+    }
+}
+
+// Two modules changed together, the second rejects its change part way
+TEST_CASE("Config transaction rollback") {
+    struct {
+        int32_t interval = 60;
+        int32_t shadow = 60;
+        bool enable = true;
+        bool enable_shadow = true;
+    } location;
+    struct {
+        char name[16] = "tracker";
+        int32_t mode = 1;
+        double radius = 100.0;
+    } direct;
+
+    ConfigObject shadowed("location", {
+        ConfigInt("interval", config_get_int32_cb, config_set_int32_cb, &location.interval, &location.shadow),
+        ConfigBool("enable", config_get_bool_cb, config_set_bool_cb, &location.enable, &location.enable_shadow),
+    },
+    [&](bool write, const void *context) {
+        if(write)
+        {
+            location.shadow = location.interval;
+            location.enable_shadow = location.enable;
+        }
+        return 0;
+    },
+    [&](bool write, int status, const void *context) {
+        if(write && !status)
+        {
+            location.interval = location.shadow;
+            location.enable = location.enable_shadow;
+        }
+        return status;
+    });
+
+    ConfigObject unshadowed("direct", {
+        ConfigString("name", &direct.name, sizeof(direct.name)),
+        ConfigStringEnum("mode", {{"off", 0}, {"on", 1}}, &direct.mode),
+        ConfigObject("limits", {
+            ConfigFloat("radius", &direct.radius),
+        }),
+    });
+
+    murmur3_hash_t shadowed_hash, unshadowed_hash, hash;
+    config_hash(&shadowed, shadowed_hash);
+    config_hash(&unshadowed, unshadowed_hash);
+
+    ConfigSnapshot snapshots[2];
+    REQUIRE(snapshots[0].save(&shadowed) == 0);
+    REQUIRE(snapshots[1].save(&unshadowed) == 0);
+
+    // the first module is committed through its exit callback
+    REQUIRE(shadowed.enter(true) == 0);
+    REQUIRE(reinterpret_cast<ConfigInt *>(shadowed.child("interval"))->set(900) == 0);
+    REQUIRE(reinterpret_cast<ConfigBool *>(shadowed.child("enable"))->set(false) == 0);
+    REQUIRE(shadowed.exit(true, 0) == 0);
+    REQUIRE(location.interval == 900);
+
+    // the second is changed directly until a value is rejected
+    REQUIRE(unshadowed.enter(true) == 0);
+    REQUIRE(reinterpret_cast<ConfigString *>(unshadowed.child("name"))->set("monitor") == 0);
+    REQUIRE(reinterpret_cast<ConfigStringEnum *>(unshadowed.child("mode"))->set("off") == 0);
+    auto limits = reinterpret_cast<ConfigObject *>(unshadowed.child("limits"));
+    REQUIRE(reinterpret_cast<ConfigFloat *>(limits->child("radius"))->set(250.0) == 0);
+    REQUIRE(reinterpret_cast<ConfigString *>(unshadowed.child("name"))->set("a name far too long") == -EDOM);
+    REQUIRE(unshadowed.exit(true, -EDOM) == -EDOM);
+
+    REQUIRE(snapshots[1].restore() == 0);
+    REQUIRE(snapshots[0].restore() == 0);
+
+    REQUIRE(location.interval == 60);
+    REQUIRE(location.enable);
+    REQUIRE(!strcmp(direct.name, "tracker"));
+    REQUIRE(direct.mode == 1);
+    REQUIRE(direct.radius == 100.0);
+    config_hash(&shadowed, hash);
+    REQUIRE(hash == shadowed_hash);
+    config_hash(&unshadowed, hash);
+    REQUIRE(hash == unshadowed_hash);
+}
+
+// Power is cut at random points while appending records and while compacting.
+// A cut append leaves a prefix of the record or batch of records, possibly
+// followed by garbage, and a cut compaction leaves the log untouched next to a
+// partial temp file.
+// After every cut the store must open with the last completed write of each
+// module and carry on appending. Recovering from a torn append compacts the
+// log so appends are only cut now and then to let superseded records build up.
+TEST_CASE("Config store power cut fuzz") {
+    TempStore temp;
+    ConfigStore store(temp.path.c_str());
+    std::map<std::string, std::string> expected;
+    std::mt19937 rng(0x5EED);
+    auto random = [&](size_t min, size_t max) {
+        return std::uniform_int_distribution<size_t>(min, max)(rng);
+    };
+    auto bytes = [&](size_t len) {
+        std::string data(len, '\0');
+        for (auto &c : data) {
+            c = (char) random(0, 255);
+        }
+        return data;
+    };
+    unsigned cuts = 0, compactions = 0;
+
+    REQUIRE(store.open() == 0);
+
+    for (int i = 0; i < 2000; i++) {
+        auto before = TempStore::read(temp.path);
+
+        if (store.compact_pending()) {
+            bool cut = random(0, 1);
+            REQUIRE(store.compact() == 0);
+            compactions++;
+            if (cut) {
+                auto after = TempStore::read(temp.path);
+                store.close();
+                TempStore::write(temp.path, before);
+                TempStore::write(temp.temp_path, after.substr(0, random(0, after.size() - 1)));
+                REQUIRE(store.open() == 0);
+                REQUIRE_FALSE(TempStore::exists(temp.temp_path));
+                cuts++;
+            }
+        }
+        else {
+            // single writes and batches of several, a cut batch is lost whole
+            std::map<std::string, std::string> writes;
+            size_t count = random(0, 1) ? 1 : random(2, 4);
+            bool cut = !random(0, 15);
+            if (count > 1) {
+                store.begin();
+            }
+            for (size_t n = 0; n < count; n++) {
+                auto name = STORE_NAMES[random(0, 5)];
+                auto data = bytes(random(0, 600));
+                REQUIRE(store.write(name, data.data(), data.size()) == 0);
+                writes[name] = data;
+            }
+            if (count > 1) {
+                REQUIRE(store.commit() == 0);
+            }
+            auto after = TempStore::read(temp.path);
+            REQUIRE(after.compare(0, before.size(), before) == 0);
+            if (cut) {
+                store.close();
+                TempStore::write(temp.path, after.substr(0, random(before.size(), after.size() - 1)) + bytes(random(0, 32)));
+                REQUIRE(store.open() == 0);
+                cuts++;
+            }
+            else {
+                for (auto &it : writes) {
+                    expected[it.first] = it.second;
+                }
+            }
+        }
+        requireContents(store, expected);
+    }
+
+    REQUIRE(cuts > 50);
+    REQUIRE(compactions > 10);
+}
+
+// Digests of the murmur3 implementation that computed the hashes already
+// stored on devices, any change to these invalidates stored hash and
+// sync_hash values. The length mixed in on finalize is the tail length, so
+// inputs of 16 bytes or more differ from the reference murmur3.
+struct HashVector {
+    const char *data;
+    unsigned len;
+    uint32_t seed;
+    uint32_t h[4];
+};
+
+static const char *FOX = "The quick brown fox jumps over the lazy dog";
+static const char *PATTERN = nullptr;
+
+static const HashVector HASH_VECTORS[] = {
+    {"", 0, 0, {0x00000000, 0x00000000, 0x00000000, 0x00000000}},
+    {"", 0, 1, {0x88C4ADEC, 0x54D201B9, 0x54D201B9, 0x54D201B9}},
+    {"a", 1, 0, {0xA794933C, 0x5556B01B, 0x5556B01B, 0x5556B01B}},
+    {"abc", 3, 0, {0x75CDC6D1, 0xA2B006A5, 0xA2B006A5, 0xA2B006A5}},
+    {"abcd", 4, 0x9747b28c, {0x4795C529, 0xCEC1885E, 0xCEC1885E, 0xCEC1885E}},
+    {"0123456789abcde", 15, 0, {0x3C76C46D, 0x4D0818C0, 0xADD433DA, 0xA78673FA}},
+    {"0123456789abcdef", 16, 0, {0x935F4427, 0xBB5CDA6A, 0xB35F6BE9, 0x6A796B8C}},
+    {"0123456789abcdefg", 17, 0, {0x12A23D61, 0x04D6A57E, 0x29068A73, 0x33EED038}},
+    {FOX, 43, 0, {0x5B420A89, 0xB3599419, 0x140C7730, 0x199F4FCE}},
+    {FOX, 43, 0x9747b28c, {0x8DBBC32E, 0x5F19BFFA, 0x28AA4294, 0x30730111}},
+    {PATTERN, 31, 0, {0x73985B5D, 0x7126542E, 0x2C6BD7DC, 0x84527471}},
+    {PATTERN, 32, 0, {0xAB9967D3, 0x6E280EF4, 0x06A625CD, 0x445FB26C}},
+    {PATTERN, 33, 0, {0x659036AC, 0x08D0E8E3, 0x4CA0AD8A, 0xDB911939}},
+    {PATTERN, 64, 0, {0xFF63DF08, 0x6AD4F10A, 0xDFC882D4, 0x4AD9CAA6}},
+    {PATTERN, 100, 0, {0x3E7F231C, 0x9A7636FA, 0x12AB091E, 0x35CA1689}},
+    {PATTERN, 255, 0, {0x338CD458, 0xCB21E7BF, 0xB5809761, 0x8E1ACBC2}},
+    {PATTERN, 256, 0, {0xFE0CF74E, 0xF312CF49, 0x1F4A4A1D, 0xFF245EF7}},
+};
+
+static murmur3_hash_t hashChunks(const uint8_t *data, unsigned len, uint32_t seed, unsigned chunk) {
+    murmur3_hash_t hash;
+    murmur3_hash_start(hash, seed);
+    for (unsigned i = 0; i < len; i += chunk) {
+        murmur3_hash_update(hash, data + i, std::min(chunk, len - i));
+    }
+    murmur3_hash_finalize(hash);
+    return hash;
+}
+
+TEST_CASE("Murmur3 known answers") {
+    // byte i of the pattern is i * 7 + 1, with spare room to shift it off
+    // alignment
+    uint8_t pattern[256 + 16];
+    for (unsigned i = 0; i < 256; i++) {
+        pattern[i] = (uint8_t) (i * 7 + 1);
+    }
+
+    for (auto &vector : HASH_VECTORS) {
+        auto data = vector.data ? (const uint8_t *) vector.data : pattern;
+        CAPTURE(vector.len, vector.seed);
+
+        murmur3_hash_t hash;
+        murmur3_hash_start(hash, vector.seed);
+        murmur3_hash_update(hash, data, vector.len);
+        murmur3_hash_finalize(hash);
+        REQUIRE(hash.h[0] == vector.h[0]);
+        REQUIRE(hash.h[1] == vector.h[1]);
+        REQUIRE(hash.h[2] == vector.h[2]);
+        REQUIRE(hash.h[3] == vector.h[3]);
+        REQUIRE(hash.accum_len == 0);
+
+        // the digest doesn't depend on how the input is split into updates
+        // or where it sits in memory
+        uint8_t shifted[sizeof(pattern) + 8];
+        for (unsigned offset = 0; offset < 8; offset++) {
+            memcpy(shifted + offset, data, vector.len);
+            for (unsigned chunk = 1; chunk <= 33; chunk++) {
+                CAPTURE(offset, chunk);
+                REQUIRE(hashChunks(shifted + offset, vector.len, vector.seed, chunk) == hash);
+            }
+        }
+    }
+
+    SECTION("Empty updates leave the state untouched") {
+        murmur3_hash_t hash, expected;
+        murmur3_hash_start(hash, 0);
+        murmur3_hash_update(hash, pattern, 5);
+        murmur3_hash_update(hash, pattern + 5, 0);
+        murmur3_hash_update(hash, pattern + 5, 11);
+        murmur3_hash_update(hash, pattern + 16, 0);
+        murmur3_hash_finalize(hash);
+        murmur3_hash_start(expected, 0);
+        murmur3_hash_update(expected, pattern, 16);
+        murmur3_hash_finalize(expected);
+        REQUIRE(hash == expected);
+    }
+}
+
+// polls until the background publish thread has caught up, false on timeout
+static bool waitFor(std::function<bool()> done) {
+    for (int i = 0; i < 2000; i++) {
+        if (done()) {
+            return true;
+        }
+        delay(1);
+    }
+    return done();
+}
+
+// Records the completion callbacks of background publishes
+struct PublishLog {
+    std::mutex mutex;
+    std::vector<std::pair<std::string, publish_status_t>> completed;
+
+    publish_completed_cb_t cb() {
+        return [this](publish_status_t status, const char *name, const char *data, const void *context) {
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back({std::string(name) + ":" + data, status});
+        };
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed.size();
+    }
+};
+
+static std::vector<std::string> publishedNames() {
+    std::vector<std::string> names;
+    for (auto &it : Particle.publishes()) {
+        names.push_back(it.name);
+    }
+    return names;
+}
+
+TEST_CASE("Background publish queue") {
+    Particle.reset();
+    BackgroundPublish publisher;
+    PublishLog log;
+
+    REQUIRE_FALSE(publisher.publish("early"));
+    publisher.start();
+    REQUIRE(publisher.idle());
+
+    SECTION("A burst is queued and published in order") {
+        for (int i = 0; i < BACKGROUND_PUBLISH_QUEUE_SIZE; i++) {
+            auto name = "event" + std::to_string(i);
+            REQUIRE(publisher.publish(name.c_str(), "data", PRIVATE, log.cb()));
+        }
+        REQUIRE_FALSE(publisher.publish("overflow"));
+        REQUIRE_FALSE(publisher.idle());
+
+        for (int i = 0; i < BACKGROUND_PUBLISH_QUEUE_SIZE; i++) {
+            REQUIRE(waitFor([&]() { return Particle.publishes().size() == (size_t) i + 1; }));
+            // one publish is in progress at a time
+            delay(5);
+            REQUIRE(Particle.publishes().size() == (size_t) i + 1);
+            REQUIRE(Particle.complete(i, i != 1));
+            REQUIRE(waitFor([&]() { return log.size() == (size_t) i + 1; }));
+        }
+
+        REQUIRE(waitFor([&]() { return publisher.idle(); }));
+        REQUIRE(publishedNames() == std::vector<std::string>({"event0", "event1", "event2", "event3"}));
+        REQUIRE(log.completed[0] == std::make_pair(std::string("event0:data"), BACKGROUND_PUBLISH_STATUS_SUCCESS));
+        REQUIRE(log.completed[1] == std::make_pair(std::string("event1:data"), BACKGROUND_PUBLISH_STATUS_FAILURE));
+        REQUIRE(log.completed[3] == std::make_pair(std::string("event3:data"), BACKGROUND_PUBLISH_STATUS_SUCCESS));
+    }
+
+    SECTION("Higher priority publishes go first") {
+        REQUIRE(publisher.publish("first", nullptr, PRIVATE, log.cb()));
+        REQUIRE(waitFor([&]() { return Particle.publishes().size() == 1; }));
+
+        REQUIRE(publisher.publish("low", nullptr, PRIVATE, log.cb(), nullptr, BACKGROUND_PUBLISH_PRIORITY_LOW));
+        REQUIRE(publisher.publish("normal1", nullptr, PRIVATE, log.cb()));
+        REQUIRE(publisher.publish("high", nullptr, PRIVATE, log.cb(), nullptr, BACKGROUND_PUBLISH_PRIORITY_HIGH));
+        REQUIRE_FALSE(publisher.publish("full", nullptr, PRIVATE, log.cb(), nullptr, BACKGROUND_PUBLISH_PRIORITY_HIGH));
+
+        // a slot freed by a completed publish is taken again
+        REQUIRE(Particle.complete(0, true));
+        REQUIRE(waitFor([&]() { return Particle.publishes().size() == 2; }));
+        REQUIRE(publisher.publish("normal2", nullptr, PRIVATE, log.cb()));
+
+        for (size_t i = 1; i < 5; i++) {
+            REQUIRE(waitFor([&]() { return Particle.publishes().size() == i + 1; }));
+            REQUIRE(Particle.complete(i, true));
+        }
+        REQUIRE(waitFor([&]() { return publisher.idle(); }));
+        REQUIRE(log.size() == 5);
+        REQUIRE(publishedNames() == std::vector<std::string>({"first", "high", "normal1", "normal2", "low"}));
+    }
+
+    SECTION("The thread sleeps until there is work") {
+        delay(100);
+        REQUIRE(publisher.wakeups() == 0);
+
+        // woken once for the request and once more on completion
+        REQUIRE(publisher.publish("event", nullptr, PRIVATE, log.cb()));
+        REQUIRE(waitFor([&]() { return Particle.publishes().size() == 1; }));
+        delay(50);
+        REQUIRE(Particle.complete(0, true));
+        REQUIRE(waitFor([&]() { return publisher.idle() && log.size() == 1; }));
+        delay(50);
+        REQUIRE(publisher.wakeups() <= 3);
+        REQUIRE(publisher.idle_ms() >= 90);
+    }
+
+    SECTION("Stopping abandons a publish in progress") {
+        REQUIRE(publisher.publish("pending", "data", PRIVATE, log.cb()));
+        REQUIRE(waitFor([&]() { return Particle.publishes().size() == 1; }));
+        publisher.stop();
+        REQUIRE(log.size() == 1);
+        REQUIRE(log.completed[0].second == BACKGROUND_PUBLISH_STATUS_FAILURE);
+        REQUIRE_FALSE(publisher.publish("stopped"));
+    }
+}
+
+static std::string queuePayload(uint32_t i) {
+    return "{\"loc\":{\"time\":" + std::to_string(1600000000 + i) + "}}";
+}
+
+// pops the next payload and marks it sent, returns the payload or "" when
+// there is nothing more to send this session
+static std::string queueDrain(PublishQueue &queue, uint32_t *seq=nullptr) {
+    char data[PUBLISH_QUEUE_DATA_MAX];
+    uint32_t next;
+    int size = queue.next(data, sizeof(data), next);
+    if (size < 0) {
+        return "";
+    }
+    REQUIRE(queue.ack(next) == 0);
+    if (seq) {
+        *seq = next;
+    }
+    return std::string(data, size);
+}
+
+TEST_CASE("Publish queue") {
+    TempStore temp;
+    PublishQueue queue(temp.path.c_str(), 8);
+    char data[PUBLISH_QUEUE_DATA_MAX];
+    uint32_t seq = 0;
+
+    REQUIRE(queue.push("{}", 2) == -EBADF);
+    REQUIRE(queue.open() == 0);
+    REQUIRE(queue.pending() == 0);
+    REQUIRE(queue.next(data, sizeof(data), seq) == -ENOENT);
+
+    SECTION("Payloads outlive an outage and a reset") {
+        for (uint32_t i = 0; i < 5; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), queuePayload(i).size(), &seq) == 0);
+            REQUIRE(seq == i + 1);
+        }
+
+        // sent but not acked before the reset
+        REQUIRE(queue.next(data, sizeof(data), seq) == (int) queuePayload(0).size());
+        REQUIRE(seq == 1);
+        REQUIRE(queueDrain(queue) == queuePayload(0));
+
+        queue.close();
+        REQUIRE(queue.open() == 0);
+        REQUIRE(queue.pending() == 4);
+        for (uint32_t i = 1; i < 5; i++) {
+            REQUIRE(queueDrain(queue, &seq) == queuePayload(i));
+            REQUIRE(seq == i + 1);
+        }
+        REQUIRE(queue.pending() == 0);
+
+        // numbering carries on after a reset with nothing pending
+        queue.close();
+        REQUIRE(queue.open() == 0);
+        REQUIRE(queue.push("{}", 2, &seq) == 0);
+        REQUIRE(seq == 6);
+        REQUIRE(queue.ack(5) == -ENOENT);
+        REQUIRE(queue.ack(6) == 0);
+        REQUIRE(queue.ack(6) == -ENOENT);
+    }
+
+    SECTION("Ids are kept with their payloads") {
+        uint32_t id = 0;
+        REQUIRE(queue.push("{}", 2, nullptr, 42) == 0);
+        REQUIRE(queue.push("{}", 2) == 0);
+
+        queue.close();
+        REQUIRE(queue.open() == 0);
+        REQUIRE(queue.next(data, sizeof(data), seq, &id) == 2);
+        REQUIRE(id == 42);
+        REQUIRE(queue.ack(seq) == 0);
+        REQUIRE(queue.next(data, sizeof(data), seq, &id) == 2);
+        REQUIRE(id == 0);
+    }
+
+    SECTION("A full queue overwrites the oldest payloads") {
+        for (uint32_t i = 0; i < 11; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), queuePayload(i).size()) == 0);
+        }
+        REQUIRE(queue.pending() == 8);
+        REQUIRE(queue.dropped() == 3);
+
+        queue.close();
+        REQUIRE(queue.open() == 0);
+        for (uint32_t i = 3; i < 11; i++) {
+            REQUIRE(queueDrain(queue) == queuePayload(i));
+        }
+        REQUIRE(queueDrain(queue) == "");
+    }
+
+    SECTION("Newest payloads can go first") {
+        for (uint32_t i = 0; i < 4; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), queuePayload(i).size()) == 0);
+        }
+        queue.set_order(PUBLISH_QUEUE_NEWEST_FIRST);
+        for (int i = 3; i >= 0; i--) {
+            REQUIRE(queueDrain(queue) == queuePayload(i));
+        }
+    }
+
+    SECTION("A session budget spreads the backlog over sessions") {
+        auto size = queuePayload(0).size();
+        for (uint32_t i = 0; i < 6; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), size) == 0);
+        }
+
+        queue.set_budget(2 * size + 1);
+        REQUIRE(queueDrain(queue) == queuePayload(0));
+        REQUIRE(queueDrain(queue) == queuePayload(1));
+        REQUIRE(queue.next(data, sizeof(data), seq) == -EDQUOT);
+        REQUIRE(queue.session_bytes() == 2 * size);
+
+        queue.new_session();
+        REQUIRE(queueDrain(queue) == queuePayload(2));
+        REQUIRE(queueDrain(queue) == queuePayload(3));
+        REQUIRE(queueDrain(queue) == "");
+
+        // the first payload of a session goes out whatever its size
+        queue.set_budget(1);
+        queue.new_session();
+        REQUIRE(queueDrain(queue) == queuePayload(4));
+        REQUIRE(queueDrain(queue) == "");
+    }
+
+    SECTION("A payload handed out again is charged once") {
+        auto size = queuePayload(0).size();
+        for (uint32_t i = 0; i < 3; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), size) == 0);
+        }
+
+        // a busy send and a failed send hand out the same payload again
+        queue.set_budget(2 * size);
+        for (int i = 0; i < 3; i++) {
+            REQUIRE(queue.next(data, sizeof(data), seq) == (int) size);
+            REQUIRE(seq == 1);
+        }
+        REQUIRE(queue.session_bytes() == 0);
+        REQUIRE(queue.ack(seq) == 0);
+        REQUIRE(queue.session_bytes() == size);
+        REQUIRE(queueDrain(queue) == queuePayload(1));
+        REQUIRE(queue.next(data, sizeof(data), seq) == -EDQUOT);
+    }
+
+    SECTION("A torn or corrupt slot is found empty") {
+        for (uint32_t i = 0; i < 3; i++) {
+            REQUIRE(queue.push(queuePayload(i).c_str(), queuePayload(i).size()) == 0);
+        }
+        queue.close();
+
+        // payload 2 in slot 2 cut short and payload 3 in slot 3 with a flipped bit
+        auto file = TempStore::read(temp.path);
+        size_t slot_size = sizeof(publish_queue_record_t) + PUBLISH_QUEUE_DATA_MAX;
+        auto offset = [&](size_t slot) { return sizeof(publish_queue_file_header_t) + slot * slot_size; };
+        auto torn = offset(2) + sizeof(publish_queue_record_t) + 3;
+        std::fill(file.begin() + torn, file.begin() + offset(3), '\0');
+        file[offset(3) + sizeof(publish_queue_record_t) + 4] ^= 0x10;
+        TempStore::write(temp.path, file);
+
+        REQUIRE(queue.open() == 0);
+        REQUIRE(queue.pending() == 1);
+        REQUIRE(queueDrain(queue) == queuePayload(0));
+        REQUIRE(queueDrain(queue) == "");
+
+        // a queue written with another layout starts over
+        queue.close();
+        PublishQueue other(temp.path.c_str(), 4);
+        REQUIRE(other.open() == 0);
+        REQUIRE(other.pending() == 0);
+    }
+
+    SECTION("Oversized payloads are refused") {
+        std::string big(PUBLISH_QUEUE_DATA_MAX + 1, 'x');
+        REQUIRE(queue.push(big.c_str(), big.size()) == -EINVAL);
+        REQUIRE(queue.push(big.c_str(), PUBLISH_QUEUE_DATA_MAX) == 0);
+        REQUIRE(queue.next(data, 8, seq) == -ENOSPC);
+        REQUIRE(queue.next(data, sizeof(data), seq) == PUBLISH_QUEUE_DATA_MAX);
+    }
+}
+
+// Stand-in for CloudService as TrackerLocation sends location publishes
+// through PublishSender, a send completes when the test says so
+struct SenderCloud {
+    struct Send {
+        std::string data;
+        uint32_t id;
+        uint32_t context;
+    };
+    std::vector<Send> sends;
+    std::vector<std::pair<int, std::string>> done;
+    int result = 0;
+
+    PublishSender::send_t send() {
+        return [this](const char *data, uint32_t id, uint32_t context) {
+            if (!result) {
+                sends.push_back({data, id, context});
+            }
+            return result;
+        };
+    }
+
+    PublishSender::done_t finished() {
+        return [this](int status, void *response, const char *data) {
+            done.emplace_back(status, data);
+        };
+    }
+
+    // completes the latest send the way location_publish_cb() does
+    void complete(PublishSender &sender, int status, bool retry) {
+        auto &last = sends.back();
+        sender.complete(last.context, status, retry, last.data.c_str());
+    }
+};
+
+TEST_CASE("Publish sender") {
+    TempStore temp;
+    PublishQueue queue(temp.path.c_str(), 8);
+    REQUIRE(queue.open() == 0);
+    SenderCloud cloud;
+    PublishSender sender(queue, cloud.send(), cloud.finished());
+    const int SENT = 0, FAILED = 1;
+
+    SECTION("Publishes go straight out while connected") {
+        sender.loop(true);
+        for (uint32_t i = 0; i < 3; i++) {
+            auto payload = queuePayload(i);
+            REQUIRE(sender.publish(payload.c_str(), payload.size(), 100 + i, true) == 0);
+            REQUIRE(sender.sending());
+            REQUIRE(queue.pending() == 0);
+            cloud.complete(sender, SENT, false);
+            sender.loop(true);
+        }
+        REQUIRE(cloud.sends.size() == 3);
+        REQUIRE(cloud.sends[2].data == queuePayload(2));
+        REQUIRE(cloud.sends[2].id == 102);
+        REQUIRE(cloud.done.size() == 3);
+        REQUIRE(cloud.done[2] == std::make_pair(SENT, queuePayload(2)));
+    }
+
+    SECTION("Publishes made during a gap go out on reconnect") {
+        sender.loop(true);
+        auto payload = queuePayload(0);
+        REQUIRE(sender.publish(payload.c_str(), payload.size(), 100, true) == 0);
+        cloud.complete(sender, SENT, false);
+
+        // out of coverage
+        sender.loop(false);
+        for (uint32_t i = 1; i < 4; i++) {
+            payload = queuePayload(i);
+            REQUIRE(sender.publish(payload.c_str(), payload.size(), 100 + i, false) == 0);
+            sender.loop(false);
+        }
+        REQUIRE(cloud.sends.size() == 1);
+        REQUIRE(queue.pending() == 3);
+
+        // a publish while the backlog is sent is queued behind it
+        for (uint32_t i = 1; i < 4; i++) {
+            sender.loop(true);
+            REQUIRE(cloud.sends.back().data == queuePayload(i));
+            REQUIRE(cloud.sends.back().id == 100 + i);
+            if (i == 1) {
+                payload = queuePayload(4);
+                REQUIRE(sender.publish(payload.c_str(), payload.size(), 104, true) == 0);
+            }
+            cloud.complete(sender, SENT, false);
+        }
+        sender.loop(true);
+        REQUIRE(cloud.sends.back().data == queuePayload(4));
+        REQUIRE(cloud.done.size() == 1);
+        cloud.complete(sender, SENT, false);
+        REQUIRE(queue.pending() == 0);
+        REQUIRE(cloud.done.size() == 2);
+        REQUIRE(cloud.done[1] == std::make_pair(SENT, queuePayload(4)));
+    }
+
+    SECTION("A failed send is kept and retried") {
+        sender.loop(true);
+        auto payload = queuePayload(0);
+        REQUIRE(sender.publish(payload.c_str(), payload.size(), 100, true) == 0);
+        REQUIRE(cloud.sends.back().context == 0);
+
+        // the connection drops as the publish fails, its callbacks wait for
+        // the retry
+        cloud.complete(sender, FAILED, true);
+        REQUIRE(cloud.done.empty());
+        REQUIRE(queue.pending() == 1);
+        sender.loop(false);
+        REQUIRE(cloud.sends.size() == 1);
+
+        sender.loop(true);
+        REQUIRE(cloud.sends.size() == 2);
+        REQUIRE(cloud.sends.back().data == payload);
+        REQUIRE(cloud.sends.back().id == 100);
+        REQUIRE(cloud.sends.back().context != 0);
+        cloud.complete(sender, FAILED, true);
+        REQUIRE(queue.pending() == 1);
+        REQUIRE(queue.session_bytes() == 0);
+
+        sender.loop(true);
+        REQUIRE(cloud.sends.size() == 3);
+        cloud.complete(sender, SENT, false);
+        REQUIRE(queue.pending() == 0);
+        REQUIRE(queue.session_bytes() == payload.size());
+        REQUIRE(cloud.done.size() == 1);
+        REQUIRE(cloud.done[0] == std::make_pair(SENT, payload));
+    }
+
+    SECTION("A busy send is queued and retried, others are given up") {
+        sender.loop(true);
+        cloud.result = -EBUSY;
+        auto payload = queuePayload(0);
+        REQUIRE(sender.publish(payload.c_str(), payload.size(), 100, true) == 0);
+        REQUIRE(queue.pending() == 1);
+        sender.loop(true);
+        REQUIRE(queue.pending() == 1);
+        REQUIRE(cloud.done.empty());
+
+        cloud.result = -EINVAL;
+        sender.loop(true);
+        REQUIRE(queue.pending() == 0);
+        REQUIRE(cloud.done.size() == 1);
+        REQUIRE(cloud.done[0] == std::make_pair(-EINVAL, payload));
+    }
+
+    SECTION("Queued publishes survive a reset") {
+        auto payload = queuePayload(0);
+        REQUIRE(sender.publish(payload.c_str(), payload.size(), 100, false) == 0);
+        queue.close();
+
+        PublishQueue reopened(temp.path.c_str(), 8);
+        REQUIRE(reopened.open() == 0);
+        PublishSender after(reopened, cloud.send(), cloud.finished());
+        after.loop(true);
+        REQUIRE(cloud.sends.size() == 1);
+        REQUIRE(cloud.sends[0].data == payload);
+        REQUIRE(cloud.sends[0].id == 100);
+        cloud.complete(after, SENT, false);
+        REQUIRE(reopened.pending() == 0);
+        // callbacks didn't outlive the reset
+        REQUIRE(cloud.done.empty());
+    }
+}
+
+extern size_t test_json_parse_count;
+extern size_t test_json_parse_allocations;
+
+// location event as TrackerLocation ends it with a full ack
+static std::string locEvent(uint32_t i) {
+    return "{\"cmd\":\"loc\",\"time\":1600000000,\"loc\":{\"lck\":1,\"time\":" + std::to_string(1600000000 + i) +
+        ",\"lat\":37.7749295,\"lon\":-122.4194155},\"req_id\":" + std::to_string(100 + i) + "}";
+}
+
+static int ignoreSend(CloudServiceStatus status, JSONValue *rsp_root, const char *req_data, const void *context) {
+    return 0;
+}
+
+TEST_CASE("Cloud service sends") {
+    Particle.reset();
+    CloudService &cloud = CloudService::instance();
+    cloud.init();
+
+    // the background publish thread takes one publish at a time, each is
+    // completed as it comes through
+    size_t published = 0;
+    auto deliver = [&]() {
+        REQUIRE(waitFor([&]() { return Particle.publishes().size() == published + 1; }));
+        REQUIRE(Particle.complete(published++, true));
+        return Particle.publishes().back();
+    };
+
+    test_json_parse_count = 0;
+    test_json_parse_allocations = 0;
+
+    SECTION("A command sent from the writer isn't parsed") {
+        REQUIRE(cloud.beginCommand("loc") == 0);
+        cloud.writer().name("loc").beginObject().name("lck").value(1).endObject();
+        REQUIRE(cloud.send(WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend) == 0);
+        auto sent = deliver();
+        REQUIRE(sent.name == "loc");
+        REQUIRE(sent.data.find("\"req_id\":") != std::string::npos);
+
+        // ended and sent later from the writer without its metadata
+        REQUIRE(cloud.beginCommand("loc") == 0);
+        REQUIRE(cloud.endCommand(CloudServicePublishFlags::FULL_ACK) == 0);
+        REQUIRE(cloud.commandReqId() != 0);
+        REQUIRE(cloud.send(cloud.writer().buffer(), WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend) == 0);
+        cloud.unlock();
+        REQUIRE(deliver().name == "loc");
+
+        REQUIRE(test_json_parse_count == 0);
+        REQUIRE(test_json_parse_allocations == 0);
+    }
+
+    SECTION("An event kept elsewhere is parsed unless its metadata is passed") {
+        auto event = locEvent(0);
+        REQUIRE(cloud.send(event.c_str(), WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend) == 0);
+        REQUIRE(deliver().name == "loc");
+        REQUIRE(test_json_parse_count == 1);
+        REQUIRE(test_json_parse_allocations == 3);
+
+        REQUIRE(cloud.send(event.c_str(), WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend,
+            CLOUD_DEFAULT_TIMEOUT_MS, nullptr, "loc", 100) == 0);
+        REQUIRE(deliver().name == "loc");
+        REQUIRE(test_json_parse_count == 1);
+        REQUIRE(test_json_parse_allocations == 3);
+    }
+
+    SECTION("Queued location publishes are sent without parsing") {
+        TempStore temp;
+        PublishQueue queue(temp.path.c_str(), 8);
+        REQUIRE(queue.open() == 0);
+        const uint32_t COUNT = 5;
+
+        // as TrackerLocation::location_send() sends them, and as it did
+        // before the id was queued with each publish
+        uint32_t context = 0;
+        auto withId = [&](const char *data, uint32_t id, uint32_t seq) {
+            context = seq;
+            return cloud.send(data, WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend,
+                CLOUD_DEFAULT_TIMEOUT_MS, nullptr, "loc", id);
+        };
+        auto withoutId = [&](const char *data, uint32_t id, uint32_t seq) {
+            context = seq;
+            return cloud.send(data, WITH_ACK, CloudServicePublishFlags::FULL_ACK, ignoreSend,
+                CLOUD_DEFAULT_TIMEOUT_MS, nullptr);
+        };
+        auto sendAll = [&](PublishSender::send_t send) {
+            PublishSender sender(queue, send, [](int status, void *response, const char *data) {});
+            for (uint32_t i = 0; i < COUNT; i++) {
+                auto event = locEvent(i);
+                REQUIRE(sender.publish(event.c_str(), event.size(), 100 + i, false) == 0);
+            }
+            for (uint32_t i = 0; i < COUNT; i++) {
+                sender.loop(true);
+                REQUIRE(sender.sending());
+                auto sent = deliver();
+                REQUIRE(sent.data == locEvent(i));
+                sender.complete(context, 0, false, sent.data.c_str());
+            }
+            REQUIRE(queue.pending() == 0);
+        };
+
+        sendAll(withoutId);
+        WARN("parsed without the id: " << test_json_parse_count << " calls, " << test_json_parse_allocations << " allocations for " << COUNT << " sends");
+        REQUIRE(test_json_parse_count == COUNT);
+
+        test_json_parse_count = 0;
+        test_json_parse_allocations = 0;
+        sendAll(withId);
+        REQUIRE(test_json_parse_count == 0);
+        REQUIRE(test_json_parse_allocations == 0);
+    }
+}
+
+// writes a batch into the array begun last, the way the cloud service writer
+// does
+class BatchWriter : public JSONBufferWriter {
+public:
+    BatchWriter(char *buf, size_t size) : JSONBufferWriter(buf, size) {}
+
+    BatchWriter &raw(const char *data, size_t size) {
+        write(data, size);
+        return *this;
+    }
+};
+
+static std::string batchPoint(uint32_t i, size_t pad) {
+    return "{\"lck\":1,\"time\":" + std::to_string(1600000000 + i) + ",\"pad\":\"" + std::string(pad, 'x') + "\"}";
+}
+
+TEST_CASE("Publish batch") {
+    static const char HEADER[] = "{\"cmd\":\"loc\",\"time\":1600000000,\"locs\":[";
+    static const char TRAILER[] = "],\"req_id\":4294967295}";
+    // room an event has for the points
+    const size_t capacity = particle::protocol::MAX_EVENT_DATA_LENGTH - (sizeof(HEADER) - 1) - (sizeof(TRAILER) - 1);
+    PublishBatch batch(capacity);
+    std::vector<std::string> added, sent;
+    std::vector<size_t> fills;
+
+    auto flush = [&]() {
+        char buf[particle::protocol::MAX_EVENT_DATA_LENGTH + 1];
+        BatchWriter writer(buf, sizeof(buf));
+        size_t count;
+        size_t bytes = batch.front(capacity, count);
+
+        writer.beginObject();
+        writer.name("cmd").value("loc");
+        writer.name("time").value(1600000000u);
+        writer.name("locs").beginArray();
+        writer.raw(batch.data(), bytes);
+        writer.endArray();
+        writer.name("req_id").value(4294967295u);
+        writer.endObject();
+        REQUIRE(writer.dataSize() <= particle::protocol::MAX_EVENT_DATA_LENGTH);
+
+        // the values are written whole, oldest first
+        std::string event(buf, writer.dataSize());
+        std::string locs = event.substr(sizeof(HEADER) - 1, bytes);
+        for (size_t i = 0; i < count; i++) {
+            auto &point = added[sent.size()];
+            REQUIRE(locs.compare(0, point.size(), point) == 0);
+            locs.erase(0, point.size() + 1);
+            sent.push_back(point);
+        }
+        REQUIRE(locs.empty());
+
+        batch.pop(count);
+        fills.push_back(bytes);
+    };
+
+    SECTION("Events are packed full without splitting a point") {
+        std::mt19937 rng(0x5EED);
+        for (uint32_t i = 0; i < 400; i++) {
+            auto point = batchPoint(i, std::uniform_int_distribution<size_t>(0, 120)(rng));
+            REQUIRE(batch.add(point.c_str(), point.size(), 1600000000 + i) == 0);
+            added.push_back(point);
+            REQUIRE(batch.oldest() == 1600000000 + sent.size());
+            if (batch.full()) {
+                flush();
+            }
+        }
+        while (batch.count()) {
+            flush();
+        }
+        REQUIRE(sent == added);
+
+        // every full event has room for less than the largest point left
+        size_t largest = batchPoint(0, 120).size();
+        size_t total = 0;
+        for (size_t i = 0; i < fills.size() - 1; i++) {
+            REQUIRE(fills[i] + largest + 1 > capacity);
+            total += fills[i];
+        }
+        REQUIRE(total >= (fills.size() - 1) * capacity * 85 / 100);
+        WARN("points per event " << (double) added.size() / fills.size() << ", fill " << 100.0 * total / ((fills.size() - 1) * capacity) << "%");
+    }
+
+    SECTION("An oversized point is refused rather than split") {
+        auto small = batchPoint(0, 0);
+        auto oversized = batchPoint(1, capacity);
+        auto exact = batchPoint(2, 0);
+        exact = batchPoint(2, capacity - exact.size());
+        REQUIRE(exact.size() == capacity);
+
+        REQUIRE(batch.add(small.c_str(), small.size(), 1) == 0);
+        added.push_back(small);
+        REQUIRE(batch.add(oversized.c_str(), oversized.size(), 2) == -EINVAL);
+        REQUIRE(batch.add(exact.c_str(), exact.size(), 3) == 0);
+        added.push_back(exact);
+        REQUIRE(batch.full());
+        REQUIRE(batch.front_size(1) == small.size());
+        REQUIRE(batch.front_size(2) == small.size() + 1 + exact.size());
+        REQUIRE(batch.front_size(3) == batch.size());
+
+        // the point that fits an event alone goes alone
+        flush();
+        REQUIRE(sent.size() == 1);
+        flush();
+        REQUIRE(sent == added);
+        REQUIRE(batch.count() == 0);
+        REQUIRE(batch.size() == 0);
+    }
+
+    SECTION("A batch holds at most its buffer") {
+        auto point = batchPoint(0, 100);
+        size_t count = 0;
+        REQUIRE(batch.fits(PUBLISH_BATCH_BUFFER_SIZE));
+        REQUIRE_FALSE(batch.fits(PUBLISH_BATCH_BUFFER_SIZE + 1));
+        while (batch.fits(point.size())) {
+            REQUIRE(batch.add(point.c_str(), point.size(), 0) == 0);
+            count++;
+        }
+        REQUIRE(batch.add(point.c_str(), point.size(), 0) == -ENOSPC);
+        REQUIRE(count == (PUBLISH_BATCH_BUFFER_SIZE + 1) / (point.size() + 1));
+        batch.pop(1);
+        REQUIRE(batch.fits(point.size()));
+        REQUIRE(batch.add(point.c_str(), point.size(), 0) == 0);
+        batch.clear();
+        REQUIRE(batch.count() == 0);
+    }
+}
+
+// drifting track of a buoy with a fix every minute and some unlocked points
+static std::vector<location_fix_t> codecTrack(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> drift(0.0, 2e-5);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<location_fix_t> track;
+    double lat = 37.7749295, lon = -122.4194155;
+    float alt = 3.5f;
+
+    for (size_t i = 0; i < count; i++) {
+        location_fix_t fix = {};
+        fix.time = 1600000000 + 60 * i;
+        fix.locked = uniform(rng) > 0.1f;
+        fix.full = uniform(rng) > 0.3f;
+        lat += drift(rng);
+        lon += drift(rng);
+        alt += uniform(rng) - 0.5f;
+        fix.latitude = lat;
+        fix.longitude = lon;
+        fix.altitude = alt;
+        fix.heading = 360.0f * uniform(rng);
+        fix.speed = 2.0f * uniform(rng);
+        fix.horizontalAccuracy = 2.0f + 10.0f * uniform(rng);
+        fix.horizontalDop = 0.5f + 2.0f * uniform(rng);
+        fix.verticalAccuracy = 3.0f + 10.0f * uniform(rng);
+        fix.verticalDop = 0.5f + 3.0f * uniform(rng);
+        track.push_back(fix);
+    }
+    return track;
+}
+
+static void requireDecoded(const location_fix_t &decoded, const location_fix_t &fix) {
+    REQUIRE(decoded.time == fix.time);
+    REQUIRE(decoded.locked == fix.locked);
+    REQUIRE(decoded.full == (fix.locked && fix.full));
+    if (!decoded.locked) {
+        return;
+    }
+    REQUIRE(decoded.latitude == Approx(fix.latitude).margin(0.51e-7));
+    REQUIRE(decoded.longitude == Approx(fix.longitude).margin(0.51e-7));
+    if (!decoded.full) {
+        return;
+    }
+    REQUIRE(decoded.altitude == Approx(fix.altitude).margin(0.051));
+    REQUIRE(decoded.heading == Approx(fix.heading).margin(0.051));
+    REQUIRE(decoded.speed == Approx(fix.speed).margin(0.051));
+    REQUIRE(decoded.horizontalAccuracy == Approx(fix.horizontalAccuracy).margin(0.051));
+    REQUIRE(decoded.horizontalDop == Approx(fix.horizontalDop).margin(0.051));
+    REQUIRE(decoded.verticalAccuracy == Approx(fix.verticalAccuracy).margin(0.051));
+    REQUIRE(decoded.verticalDop == Approx(fix.verticalDop).margin(0.051));
+}
+
+TEST_CASE("Location codec") {
+    uint8_t buf[4096];
+    LocationEncoder encoder(buf, sizeof(buf));
+    auto track = codecTrack(200, 0x5EED);
+
+    SECTION("Points round trip through the text form") {
+        for (auto reference : {false, true}) {
+            REQUIRE(encoder.begin(reference ? &track[0] : nullptr) == 0);
+            for (size_t i = 1; i < track.size(); i++) {
+                REQUIRE(encoder.add(track[i]) == 0);
+            }
+            REQUIRE(encoder.count() == track.size() - 1);
+
+            std::string text(encoder.text_size() + 1, '\0');
+            REQUIRE(encoder.text(&text[0], text.size()) == (int) encoder.text_size());
+            text.resize(encoder.text_size());
+            REQUIRE(text.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=") == std::string::npos);
+
+            uint8_t payload[sizeof(buf)];
+            REQUIRE(base64_decode(text.c_str(), text.size(), payload, sizeof(payload)) == (int) encoder.size());
+            REQUIRE(memcmp(payload, buf, encoder.size()) == 0);
+
+            LocationDecoder decoder(payload, encoder.size());
+            REQUIRE(decoder.begin(reference ? &track[0] : nullptr) == 0);
+            std::vector<location_fix_t> decoded;
+            location_fix_t fix;
+            for (size_t i = 1; i < track.size(); i++) {
+                REQUIRE(decoder.next(fix) == 0);
+                requireDecoded(fix, track[i]);
+                decoded.push_back(fix);
+            }
+            REQUIRE(decoder.next(fix) == -ENOENT);
+
+            // decoded points encode to the same payload
+            uint8_t again[sizeof(buf)];
+            LocationEncoder reencoder(again, sizeof(again));
+            REQUIRE(reencoder.begin(reference ? &track[0] : nullptr) == 0);
+            for (auto &it : decoded) {
+                REQUIRE(reencoder.add(it) == 0);
+            }
+            REQUIRE(reencoder.size() == encoder.size());
+            REQUIRE(memcmp(again, buf, encoder.size()) == 0);
+        }
+    }
+
+    SECTION("A payload is only read with its version and reference") {
+        REQUIRE(encoder.begin(&track[0]) == 0);
+        REQUIRE(encoder.add(track[1]) == 0);
+
+        LocationDecoder decoder(buf, encoder.size());
+        REQUIRE(decoder.begin() == -EINVAL);
+        REQUIRE(decoder.begin(&track[1]) == -EINVAL);
+        REQUIRE(decoder.begin(&track[0]) == 0);
+
+        buf[0] = LOCATION_CODEC_VERSION + 1;
+        REQUIRE(decoder.begin(&track[0]) == -EINVAL);
+
+        // a payload cut short
+        REQUIRE(encoder.begin() == 0);
+        location_fix_t full = track[0];
+        full.locked = full.full = true;
+        REQUIRE(encoder.add(full) == 0);
+        LocationDecoder cut(buf, encoder.size() - 1);
+        location_fix_t fix;
+        REQUIRE(cut.begin() == 0);
+        REQUIRE(cut.next(fix) == -EINVAL);
+    }
+
+    SECTION("A point that doesn't fit leaves the payload as it was") {
+        uint8_t small[32];
+        LocationEncoder limited(small, sizeof(small));
+        location_fix_t full = track[0];
+        full.locked = full.full = true;
+
+        REQUIRE(limited.begin() == 0);
+        REQUIRE(limited.add(full) == 0);
+        size_t size = limited.size();
+        REQUIRE(limited.add(full) == -ENOSPC);
+        REQUIRE(limited.size() == size);
+        REQUIRE(limited.count() == 1);
+        REQUIRE(size <= 2 + LOCATION_CODEC_POINT_MAX);
+
+        char text[8];
+        REQUIRE(limited.text(text, sizeof(text)) == -ENOSPC);
+    }
+
+    SECTION("Points are a fraction of their JSON size") {
+        char json[particle::protocol::MAX_EVENT_DATA_LENGTH + 1];
+        size_t json_size = 0;
+        REQUIRE(encoder.begin() == 0);
+        for (auto &fix : track) {
+            JSONBufferWriter writer(json, sizeof(json));
+            writer.beginObject();
+            writer.name("lck").value(fix.locked ? 1 : 0);
+            if (fix.locked) {
+                writer.name("time").value((unsigned) fix.time);
+                writer.name("lat").value(fix.latitude, 8);
+                writer.name("lon").value(fix.longitude, 8);
+                if (fix.full) {
+                    writer.name("alt").value(fix.altitude, 3);
+                    writer.name("hd").value(fix.heading, 2);
+                    writer.name("spd").value(fix.speed, 2);
+                    writer.name("h_acc").value(fix.horizontalAccuracy, 3);
+                    writer.name("hdop").value(fix.horizontalDop, 1);
+                    writer.name("v_acc").value(fix.verticalAccuracy, 3);
+                    writer.name("vdop").value(fix.verticalDop, 1);
+                }
+            }
+            writer.endObject();
+            json_size += writer.dataSize() + 1;
+            REQUIRE(encoder.add(fix) == 0);
+        }
+        REQUIRE(encoder.text_size() * 5 < json_size);
+        WARN("json " << (double) json_size / track.size() << " bytes per point, compact " << (double) encoder.text_size() / track.size());
+    }
+}
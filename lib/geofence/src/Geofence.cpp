@@ -110,6 +110,50 @@ bool Geofence::AnyGeofenceEnabled() {
     return false;
 }
 
+int Geofence::GetReceiverCircles(Vector<GeofenceCircle>& circles) {
+    circles.clear();
+    for(auto zone : GeofenceZones) {
+        if(!zone.enable) {
+            continue;
+        }
+        if((zone.shape_type != GeofenceShapeType::CIRCULAR) ||
+                (circles.size() == NUM_OF_RECEIVER_ZONES)) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        for(auto other : circles) {
+            double distance;
+            GpsDistance(zone.center_lat, zone.center_lon, other.lat,
+                        other.lon, distance);
+            if(distance < zone.radius + other.radius) {
+                return SYSTEM_ERROR_NOT_SUPPORTED;
+            }
+        }
+        circles.append(GeofenceCircle{zone.center_lat, zone.center_lon, zone.radius});
+    }
+    return circles.isEmpty() ? SYSTEM_ERROR_NOT_FOUND : SYSTEM_ERROR_NONE;
+}
+
+GeofenceWakePolicy Geofence::GetWakePolicy(bool receiver, uint32_t interval_sec) {
+    Vector<GeofenceCircle> circles;
+    int ret = GetReceiverCircles(circles);
+    if(ret == SYSTEM_ERROR_NOT_FOUND) {
+        return GeofenceWakePolicy::NONE;
+    }
+    if(!receiver || (ret != SYSTEM_ERROR_NONE)) {
+        return interval_sec ?
+            GeofenceWakePolicy::INTERVAL : GeofenceWakePolicy::NONE;
+    }
+
+    bool repeated = false;
+    for(auto zone : GeofenceZones) {
+        if(zone.enable && (zone.inside_event || zone.outside_event)) {
+            repeated = true;
+        }
+    }
+    return (interval_sec && repeated) ?
+        GeofenceWakePolicy::RECEIVER_AND_INTERVAL : GeofenceWakePolicy::RECEIVER;
+}
+
 int Geofence::RegisterGeofenceCallback(GeofenceEventCallback callback) {
     EventCallback.append(callback);
     return SYSTEM_ERROR_NONE;
@@ -42,6 +42,30 @@ using GeofenceEventCallback =
  */
 constexpr int NUM_OF_POLYGON_POINTS = 10;
 
+/**
+ * @brief Max number of circular zones the GNSS receiver can evaluate in
+ * hardware
+ *
+ */
+constexpr int NUM_OF_RECEIVER_ZONES = 4;
+
+/**
+ * @brief How the MCU should wake from sleep to keep evaluating geofences
+ *
+ */
+enum class GeofenceWakePolicy {
+    NONE,                   ///< Nothing to evaluate while asleep
+    INTERVAL,               ///< Wake periodically to evaluate the zones
+    RECEIVER,               ///< Wake when the receiver reports a boundary crossing
+    RECEIVER_AND_INTERVAL,  ///< Wake on crossings and periodically for inside/outside events
+};
+
+struct GeofenceCircle {
+    double lat; /**< Center point latitude in degrees */
+    double lon; /**< Center point longitude in degrees */
+    double radius; /**< Radius in meters */
+};
+
 enum class GeofenceEventType {
     UNKNOWN,                ///< Unknown event type
     POOR_LOCATION,          ///< The current location doesn't pass evaluation quality
@@ -161,6 +185,37 @@ public:
      */
     bool AnyGeofenceEnabled();
 
+    /**
+     * @brief Get the enabled zones as circles for the GNSS receiver to
+     * evaluate while the MCU sleeps
+     *
+     * @details The receiver only reports whether the point is inside any of
+     * its circles, so a crossing between two zones that overlap would go
+     * unnoticed. The zones can't be offloaded if any are polygonal, if there
+     * are more than NUM_OF_RECEIVER_ZONES or if any two overlap
+     *
+     * @param[out] circles circles of the enabled zones
+     *
+     * @return SYSTEM_ERROR_NONE if the zones can be offloaded,
+     * SYSTEM_ERROR_NOT_FOUND if none are enabled, otherwise
+     * SYSTEM_ERROR_NOT_SUPPORTED
+     */
+    int GetReceiverCircles(Vector<GeofenceCircle>& circles);
+
+    /**
+     * @brief Decide how to wake from sleep for the enabled zones
+     *
+     * @details Boundary crossings cover the enter and exit events and also
+     * change the inside/outside state, the interval is only still needed to
+     * repeat inside and outside events while the state doesn't change
+     *
+     * @param[in] receiver the receiver can evaluate the zones and wake the MCU
+     * @param[in] interval_sec configured evaluation interval, 0 for none
+     *
+     * @return wake policy for the next sleep
+     */
+    GeofenceWakePolicy GetWakePolicy(bool receiver, uint32_t interval_sec);
+
     /**
      * @brief Pass the point data to be used to calculate boundary. Only writes
      * if there is a change to the stored _geofence_point
@@ -751,3 +751,81 @@ TEST_CASE("Confidence Level Test") {
     REQUIRE(badCount.exchange(0) == 0); // Not considered a poor location
     REQUIRE(enterCount.exchange(0) == 1); REQUIRE(exitCount.exchange(0) == 0); REQUIRE(insideCount.exchange(0) == 1); REQUIRE(outsideCount.exchange(0) == 0);
 }
+
+TEST_CASE("Receiver Offload Test") {
+    Geofence test(4);
+    test.init();
+
+    Vector<GeofenceCircle> circles;
+    REQUIRE(test.GetReceiverCircles(circles) == SYSTEM_ERROR_NOT_FOUND);
+    REQUIRE(test.GetWakePolicy(true, 300) == GeofenceWakePolicy::NONE);
+    REQUIRE(test.GetWakePolicy(false, 300) == GeofenceWakePolicy::NONE);
+
+    // Golden Gate Park and a zone around Twin Peaks, about 3.3km apart
+    test.GetZoneInfo(0).enable = true;
+    test.GetZoneInfo(0).radius = 1000.0;
+    test.GetZoneInfo(0).center_lat = 37.76887;
+    test.GetZoneInfo(0).center_lon = -122.48248;
+    test.GetZoneInfo(0).enter_event = true;
+    test.GetZoneInfo(0).shape_type = GeofenceShapeType::CIRCULAR;
+    test.GetZoneInfo(2).enable = true;
+    test.GetZoneInfo(2).radius = 500.0;
+    test.GetZoneInfo(2).center_lat = 37.75402;
+    test.GetZoneInfo(2).center_lon = -122.44960;
+    test.GetZoneInfo(2).exit_event = true;
+    test.GetZoneInfo(2).shape_type = GeofenceShapeType::CIRCULAR;
+
+    REQUIRE(test.GetReceiverCircles(circles) == SYSTEM_ERROR_NONE);
+    REQUIRE(circles.size() == 2);
+    REQUIRE(circles[0].lat == 37.76887);
+    REQUIRE(circles[0].lon == -122.48248);
+    REQUIRE(circles[0].radius == 1000.0);
+    REQUIRE(circles[1].lat == 37.75402);
+    REQUIRE(circles[1].radius == 500.0);
+
+    // enter and exit events only need crossings
+    REQUIRE(test.GetWakePolicy(true, 300) == GeofenceWakePolicy::RECEIVER);
+    REQUIRE(test.GetWakePolicy(true, 0) == GeofenceWakePolicy::RECEIVER);
+    REQUIRE(test.GetWakePolicy(false, 300) == GeofenceWakePolicy::INTERVAL);
+    REQUIRE(test.GetWakePolicy(false, 0) == GeofenceWakePolicy::NONE);
+
+    // repeated inside/outside events still need the interval
+    test.GetZoneInfo(2).outside_event = true;
+    REQUIRE(test.GetWakePolicy(true, 300) == GeofenceWakePolicy::RECEIVER_AND_INTERVAL);
+    REQUIRE(test.GetWakePolicy(true, 0) == GeofenceWakePolicy::RECEIVER);
+
+    // overlapping zones would hide a crossing from one to the other
+    test.GetZoneInfo(2).radius = 2500.0;
+    REQUIRE(test.GetReceiverCircles(circles) == SYSTEM_ERROR_NOT_SUPPORTED);
+    REQUIRE(test.GetWakePolicy(true, 300) == GeofenceWakePolicy::INTERVAL);
+    test.GetZoneInfo(2).radius = 500.0;
+
+    // polygons can't be offloaded
+    test.GetZoneInfo(1).enable = true;
+    test.GetZoneInfo(1).center_lat = -3.072765;
+    test.GetZoneInfo(1).center_lon = -59.99389;
+    test.GetZoneInfo(1).shape_type = GeofenceShapeType::POLYGONAL;
+    REQUIRE(test.GetReceiverCircles(circles) == SYSTEM_ERROR_NOT_SUPPORTED);
+    REQUIRE(test.GetWakePolicy(true, 300) == GeofenceWakePolicy::INTERVAL);
+
+    test.GetZoneInfo(1).shape_type = GeofenceShapeType::CIRCULAR;
+    test.GetZoneInfo(1).radius = 100.0;
+    test.GetZoneInfo(3).enable = true;
+    test.GetZoneInfo(3).center_lat = 6.721186;
+    test.GetZoneInfo(3).center_lon = -179.28955;
+    test.GetZoneInfo(3).radius = 100.0;
+    REQUIRE(test.GetReceiverCircles(circles) == SYSTEM_ERROR_NONE);
+    REQUIRE(circles.size() == NUM_OF_RECEIVER_ZONES);
+
+    // more zones than the receiver has fences
+    Geofence many(NUM_OF_RECEIVER_ZONES + 1);
+    for (int i = 0; i <= NUM_OF_RECEIVER_ZONES; i++) {
+        many.GetZoneInfo(i).enable = true;
+        many.GetZoneInfo(i).center_lat = 10.0 * i;
+        many.GetZoneInfo(i).radius = 100.0;
+    }
+    REQUIRE(many.GetReceiverCircles(circles) == SYSTEM_ERROR_NOT_SUPPORTED);
+    REQUIRE(many.GetWakePolicy(true, 60) == GeofenceWakePolicy::INTERVAL);
+    many.GetZoneInfo(NUM_OF_RECEIVER_ZONES).enable = false;
+    REQUIRE(many.GetWakePolicy(true, 60) == GeofenceWakePolicy::RECEIVER);
+}
@@ -79,6 +79,82 @@ parse_number(gps_t* gh, const char* t) {
     return minus ? -res : res;
 }
 
+#if GPS_CFG_FAST_NUMBER
+
+#if GPS_CFG_DOUBLE
+#define FAST_NUMBER_MAX_MANTISSA    (1ULL << 53)/*!< Integers up to 2^53 are exact in double */
+#define FAST_NUMBER_MAX_EXP         22          /*!< 10^22 is the largest power of 10 exact in double */
+#else /* GPS_CFG_DOUBLE */
+#define FAST_NUMBER_MAX_MANTISSA    (1ULL << 24)/*!< Integers up to 2^24 are exact in float */
+#define FAST_NUMBER_MAX_EXP         10          /*!< 10^10 is the largest power of 10 exact in float */
+#endif /* !GPS_CFG_DOUBLE */
+
+static const gps_float_t fast_number_pow10[] = {
+    FLT(1e0), FLT(1e1), FLT(1e2), FLT(1e3), FLT(1e4), FLT(1e5), FLT(1e6), FLT(1e7),
+    FLT(1e8), FLT(1e9), FLT(1e10),
+#if GPS_CFG_DOUBLE
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+#endif /* GPS_CFG_DOUBLE */
+};
+
+/**
+ * \brief           Scan a plain `[+-]digits[.digits]` decimal term in fixed-point
+ *
+ *                  The digits are accumulated into an integer mantissa and scaled by
+ *                  the number of fractional digits. When both the mantissa and the
+ *                  power of 10 are exact in \ref gps_float_t the single IEEE division
+ *                  is correctly rounded, which is the same result libc produces.
+ * \param[in]       t: Text to parse, leading spaces already stripped
+ * \param[out]      res: Parsed value
+ * \return          `1` on success, `0` when the term must be parsed by libc
+ */
+static uint8_t
+parse_fast_number(const char* t, gps_float_t* res) {
+    uint64_t mant = 0;
+    uint8_t minus, digits = 0, frac = 0, any = 0;
+
+    minus = (*t == '-');
+    if (*t == '-' || *t == '+') {
+        t++;
+    }
+    for (; CIN(*t); t++, any = 1) {
+        if (mant || *t != '0') {
+            if (++digits > 19) {                /* Stop before the mantissa can overflow */
+                return 0;
+            }
+            mant = 10 * mant + CTN(*t);
+        }
+    }
+    if (*t == '.') {
+        for (t++; CIN(*t); t++, any = 1) {
+            if (mant || *t != '0') {
+                if (++digits > 19) {
+                    return 0;
+                }
+                mant = 10 * mant + CTN(*t);
+            }
+            frac++;
+        }
+    }
+    if (!any) {
+        if (*t == '\0') {                       /* No conversion, libc returns positive zero */
+            *res = FLT(0);
+            return 1;
+        }
+        return 0;                               /* inf, nan, hex prefix etc */
+    }
+    if (*t != '\0' || mant > FAST_NUMBER_MAX_MANTISSA || frac > FAST_NUMBER_MAX_EXP) {
+        return 0;                               /* Exponents, trailing text or inexact scaling */
+    }
+    *res = FLT(mant) / fast_number_pow10[frac];
+    if (minus) {
+        *res = -*res;
+    }
+    return 1;
+}
+
+#endif /* GPS_CFG_FAST_NUMBER */
+
 /**
  * \brief           Parse number as double and convert it to \ref gps_float_t
  * \param[in]       gh: GPS handle
@@ -94,6 +170,12 @@ parse_float_number(gps_t* gh, const char* t) {
     }
     for (; t != NULL && *t == ' '; t++) {}      /* Strip leading spaces */
 
+#if GPS_CFG_FAST_NUMBER
+    if (parse_fast_number(t, &res)) {
+        return res;
+    }
+#endif /* GPS_CFG_FAST_NUMBER */
+
 #if GPS_CFG_DOUBLE
     res = strtod(t, NULL);                      /* Parse string to double */
 #else /* GPS_CFG_DOUBLE */
@@ -59,6 +59,19 @@ extern "C" {
 #define GPS_CFG_DOUBLE                      1
 #endif
 
+/**
+ * \brief           Enables `1` or disables `0` the fixed-point number scanner
+ *                  for decimal terms instead of `strtod`/`strtof`
+ *
+ *                  Plain decimal terms that are exactly representable in the scaled
+ *                  integer form are converted with a single exact division. The
+ *                  result is bit-identical to the libc conversion, any other input
+ *                  falls back to it.
+ */
+#ifndef GPS_CFG_FAST_NUMBER
+#define GPS_CFG_FAST_NUMBER                 1
+#endif
+
 /**
  * \brief           Enables `1` or disables `0` status reporting callback
  *                  by gps_process()
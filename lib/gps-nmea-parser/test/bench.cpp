@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gps/gps.cpp"
+
+// Compares the fixed-point scanner against strtod on typical NMEA numeric
+// terms and reports the end to end sentence parse rate
+
+static const unsigned REPEAT = 200;
+
+template<typename F>
+static double run(const char* name, size_t count, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < REPEAT; i++) {
+        f();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double rate = (double)count * REPEAT / elapsed.count();
+    printf("%-28s %12.0f /sec\n", name, rate);
+    return rate;
+}
+
+int main() {
+    const char* terms[] = {
+        "3746.49400", "12225.16400", "15.3", "-29.8", "0.71", "1.24", "1.02", "0.512", "45.10",
+        "15.300", "2.1", "3.4", "0.949", "0.010", "-123.456", "475312.00", "123456.00", "0.86",
+    };
+    const size_t count = sizeof(terms) / sizeof(terms[0]);
+    volatile gps_float_t sink = 0;
+
+    double libc = run("strtod", count, [&]() {
+        for (auto t : terms) {
+            sink = sink + strtod(t, NULL);
+        }
+    });
+    double fast = run("parse_float_number", count, [&]() {
+        for (auto t : terms) {
+            sink = sink + parse_float_number(NULL, t);
+        }
+    });
+    printf("speedup %.2fx\n", fast / libc);
+
+    std::string sentences;
+    for (int i = 0; i < 100; i++) {
+        sentences += "$GNGGA,123456.00,3746.49400,N,12225.16400,W,1,12,0.71,15.3,M,-29.8,M,,*41\r\n";
+        sentences += "$GNRMC,123456.00,A,3746.49400,N,12225.16400,W,0.512,45.10,170921,,,A*55\r\n";
+        sentences += "$GNGSA,A,3,02,05,12,13,15,18,20,25,29,,,,1.24,0.71,1.02*1B\r\n";
+    }
+    gps_t gps;
+    gps_init(&gps, NULL);
+    run("sentences", 300, [&]() {
+        gps_process(&gps, sentences.data(), sentences.size(), NULL);
+    });
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include <random>
+#include <string>
+
+#include "gps/gps.cpp"
+
+// Reference conversion used by parse_float_number before the fixed-point scanner
+static gps_float_t referenceParse(const char* t) {
+    for (; *t == ' '; t++) {}
+#if GPS_CFG_DOUBLE
+    return strtod(t, NULL);
+#else
+    return strtof(t, NULL);
+#endif
+}
+
+static bool sameBits(gps_float_t a, gps_float_t b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void checkTerm(const std::string& term) {
+    gps_float_t expected = referenceParse(term.c_str());
+    gps_float_t actual = parse_float_number(NULL, term.c_str());
+    INFO("term \"" << term << "\" expected " << expected << " got " << actual);
+    REQUIRE(sameBits(expected, actual));
+}
+
+TEST_CASE("Fixed-point number scanner") {
+    SECTION("Edge cases") {
+        const char* terms[] = {
+            "", " ", "-", "+", ".", "-.", "+.", "0", "-0", "-0.0", "+0.000", "00000", "1.", ".5", "-.5",
+            "4717.11437", "01131.00000", "-29.8", "0.512", "45.10", "15.300", "0.010", "-2660.664",
+            "12225.16400", "9007199254740992", "9007199254740993", "0.1", "0.2", "0.3",
+            "123456789.123456789", "0.0000000000000000000001", "0.00000000000000000000001",
+            "1e5", "1E-3", "0x1A", "inf", "-nan", "12.3abc", "\t7", " 42.5", "1.5 ", "--1", "1..2",
+            "99999999999999999999", "0.99999999999999999999", "16777216", "16777217", "3.4028235e38",
+        };
+        for (auto term : terms) {
+            checkTerm(term);
+        }
+    }
+
+    SECTION("Typical terms take the fixed-point path") {
+        gps_float_t value;
+#if GPS_CFG_DOUBLE
+        REQUIRE(parse_fast_number("4717.11437", &value));
+#else
+        // too many significant digits to be exact in a float
+        REQUIRE_FALSE(parse_fast_number("4717.11437", &value));
+#endif
+        REQUIRE(parse_fast_number("15.300", &value));
+        REQUIRE(parse_fast_number("-29.8", &value));
+        REQUIRE(parse_fast_number("", &value));
+        REQUIRE_FALSE(parse_fast_number("1e5", &value));
+        REQUIRE_FALSE(parse_fast_number("0x1A", &value));
+        REQUIRE_FALSE(parse_fast_number("12.3abc", &value));
+    }
+
+    SECTION("Differential against libc on NMEA-like terms") {
+        std::mt19937 rng(12345);
+        std::uniform_int_distribution<int> digit('0', '9');
+        for (int i = 0; i < 500000; i++) {
+            std::string term;
+            switch (rng() % 4) {
+                case 0: term += '-'; break;
+                case 1: if (rng() % 8 == 0) term += '+'; break;
+            }
+            for (int n = rng() % 13; n > 0; n--) {
+                term += (char)digit(rng);
+            }
+            if (rng() % 4) {
+                term += '.';
+                for (int n = rng() % 13; n > 0; n--) {
+                    term += (char)digit(rng);
+                }
+            }
+            checkTerm(term);
+        }
+    }
+
+    SECTION("Differential against libc on arbitrary terms") {
+        static const char alphabet[] = "0123456789.-+eExXinfa ";
+        std::mt19937 rng(54321);
+        for (int i = 0; i < 500000; i++) {
+            std::string term;
+            for (int n = rng() % 24; n > 0; n--) {
+                term += alphabet[rng() % (sizeof(alphabet) - 1)];
+            }
+            checkTerm(term);
+        }
+    }
+}
+
+TEST_CASE("Sentence parsing") {
+    gps_t gps;
+    gps_init(&gps, NULL);
+
+    const char sentences[] =
+        "$GNGGA,123456.00,3746.49400,N,12225.16400,W,1,12,0.71,15.3,M,-29.8,M,,*41\r\n"
+        "$GNRMC,123456.00,A,3746.49400,N,12225.16400,W,0.512,45.10,170921,,,A*55\r\n";
+    gps_process(&gps, sentences, strlen(sentences), NULL);
+
+    REQUIRE(sameBits(gps.latitude, FLT(37) + (referenceParse("3746.49400") - FLT(3700)) / FLT(60.0)));
+    REQUIRE(sameBits(gps.longitude, -(FLT(122) + (referenceParse("12225.16400") - FLT(12200)) / FLT(60.0))));
+    REQUIRE(sameBits(gps.altitude, referenceParse("15.3")));
+    REQUIRE(sameBits(gps.geo_sep, referenceParse("-29.8")));
+    REQUIRE(sameBits(gps.speed, referenceParse("0.512")));
+    REQUIRE(sameBits(gps.course, referenceParse("45.10")));
+}
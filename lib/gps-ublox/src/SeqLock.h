@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief Single writer, multiple reader snapshot of a trivially copyable value
+ *
+ * The value is double buffered. Each store() fills the buffer that readers are
+ * not directed to and then publishes it by bumping the sequence, so a reader
+ * that preempts the writer mid-store still copies the previous complete value
+ * without waiting. A reader only retries if the writer completes a store and
+ * begins overwriting the same buffer while that reader is copying it.
+ *
+ * The buffers are held as 32-bit atomic words so concurrent copies are well
+ * defined on every target.
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock() : _started(0), _published(0) {
+        copyIn(_buffer[0], T());
+        copyIn(_buffer[1], T());
+    }
+
+    /**
+     * @brief Publish a new value, only one thread may call this
+     *
+     * @param value Value to publish
+     */
+    void store(const T& value) {
+        uint32_t seq = _published.load(std::memory_order_relaxed) + 1;
+
+        // announce which buffer is about to be overwritten before touching it,
+        // the fence pairs with the one in load() for readers that observe any
+        // of the new words
+        _started.store(seq, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        copyIn(_buffer[seq & 1], value);
+        _published.store(seq, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copy out the most recently published value
+     *
+     * @return T Copy of the value
+     */
+    T load() const {
+        Words words;
+        uint32_t seq;
+
+        do {
+            seq = _published.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                words[i] = _buffer[seq & 1][i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // the copy is only torn if a later store reached this buffer
+        } while (_started.load(std::memory_order_relaxed) - seq > 1);
+
+        T value;
+        memcpy(&value, words, sizeof(value));
+        return value;
+    }
+
+    /**
+     * @brief Get the number of values published since construction
+     *
+     * @return uint32_t Sequence number
+     */
+    uint32_t sequence() const {
+        return _published.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    typedef uint32_t Words[WORD_COUNT];
+
+    static void copyIn(std::atomic<uint32_t> (&buffer)[WORD_COUNT], const T& value) {
+        Words words = {};
+        memcpy(words, &value, sizeof(value));
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            buffer[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> _started;
+    std::atomic<uint32_t> _published;
+    std::atomic<uint32_t> _buffer[2][WORD_COUNT];
+};
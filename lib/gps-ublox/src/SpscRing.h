@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2020 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Single producer, single consumer ring over caller supplied storage
+ *
+ * One thread may push while another pops without a lock. Positions run over
+ * twice the capacity so a full ring is told apart from an empty one without
+ * giving up a slot, and the capacity does not need to be a power of two.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * @brief Construct an empty ring
+     *
+     * @param storage Array of at least capacity elements, must outlive the ring
+     * @param capacity Number of elements in storage
+     */
+    SpscRing(T *storage, size_t capacity) : _storage(storage), _capacity(capacity), _head(0), _tail(0) {}
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    /**
+     * @brief Get the number of elements waiting to be popped
+     *
+     * @return size_t Element count
+     */
+    size_t size() const {
+        return distance(_tail.load(std::memory_order_acquire), _head.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Get the number of elements that can be pushed without failing
+     *
+     * @return size_t Free element count
+     */
+    size_t space() const {
+        return _capacity - size();
+    }
+
+    /**
+     * @brief Append an element, only the producer thread may call this
+     *
+     * @param value Element to copy into the ring
+     * @retval true Element was added
+     * @retval false Ring is full
+     */
+    bool push(const T& value) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (distance(_tail.load(std::memory_order_acquire), head) >= _capacity) {
+            return false;
+        }
+        _storage[slot(head)] = value;
+        _head.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest element, only the consumer thread may call this
+     *
+     * @param value Receives the element
+     * @retval true Element was removed
+     * @retval false Ring is empty
+     */
+    bool pop(T& value) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = _storage[slot(tail)];
+        _tail.store(advance(tail), std::memory_order_release);
+        return true;
+    }
+
+private:
+    size_t slot(size_t position) const {
+        return (position >= _capacity) ? position - _capacity : position;
+    }
+
+    size_t advance(size_t position) const {
+        return (position + 1 == 2 * _capacity) ? 0 : position + 1;
+    }
+
+    size_t distance(size_t from, size_t to) const {
+        return (to >= from) ? to - from : to + 2 * _capacity - from;
+    }
+
+    T *_storage;
+    const size_t _capacity;
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+};
@@ -18,10 +18,15 @@
 #include <mutex>
 #include <cmath>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static Logger Loglib("app.gps.ubx");
 static Logger nmea_log("app.gps.nmea");
 RecursiveMutex gps_mutex;
+// guards the asynchronous request slots, never held while talking to the module
+static RecursiveMutex request_mutex;
 
 /* Parse NMEA item define */
 #define PARSE_NMEA_GPGGA
@@ -44,6 +49,7 @@ RecursiveMutex gps_mutex;
 #define GPS_HEX_LOGGING (0)
 
 #define LOCK()      std::lock_guard<RecursiveMutex> __gps_guard(gps_mutex);
+#define REQUEST_LOCK()  std::lock_guard<RecursiveMutex> __request_guard(request_mutex);
 
 static const int MAX_GPS_AGE_MS = 10000; // GPS location must be newer than this to be considered valid
 
@@ -57,6 +63,22 @@ static uint32_t   byteCounter = 0;
 static uint32_t lastUbxMsgSent = 0;
 static const uint32_t UBX_MSG_TIMEOUT = 3000;
 static const uint32_t UBX_MAX_POLL_INTERVAL_MS = 1000;
+// configuration commands outstanding at once in a transaction, bounded so the
+// module's input buffer isn't overrun
+static const size_t UBX_CFG_TRANSACTION_WINDOW = 8;
+static const unsigned UBX_LOG_RETRIEVE_ATTEMPTS = 3;
+static const uint32_t UBX_SPI_DMA_TIMEOUT_MS = 100;
+static const uint8_t UBX_SPI_FILLER = 0xFF;
+
+// SPI DMA completion is signalled from interrupt context and the callback has
+// no context argument so the queue is shared by the driver instance
+static os_queue_t spi_dma_queue = nullptr;
+
+static void spiDmaComplete()
+{
+    uint8_t dummy = 0x00;
+    os_queue_put(spi_dma_queue, &dummy, 0, nullptr);
+}
 
 static int nmea_uptime_wrapper()
 {
@@ -81,6 +103,15 @@ ubloxGPS::ubloxGPS(USARTSerial &serial,
     tx_ready_gps_pin(PIN_INVALID),
 
     serial(&serial),
+    rx_chunk_index(0),
+    rx_chunk_len(0),
+    rx_chunk_offset(0),
+    spi_got_data(false),
+    spi_dma_pending(false),
+    spi_chunk_ready(false),
+    spi_tx_ready_enabled(false),
+    geofence_wake(false),
+    nav_epoch_ms(UBX_NAV_EPOCH_DEFAULT),
 
     pwr_enable(pwr_enable),
     tx_ready_queue(nullptr),
@@ -91,6 +122,13 @@ ubloxGPS::ubloxGPS(USARTSerial &serial,
     ubx_rx_msg({}),
     write_mga_active(false),
     write_mga_sequence(0),
+    mga_injecting(false),
+    mga_mode(UBX_MGA_INJECT_DIRECT),
+    mga_first(0),
+    mga_outstanding(0),
+    mga_next_offset(0),
+    mga_aborted(false),
+    mga_result(),
 
     initializing(false),
     gpsStatus(GPS_STATUS_OFF),
@@ -98,6 +136,7 @@ ubloxGPS::ubloxGPS(USARTSerial &serial,
 
     lockMethod(ubloxGpsLockMethod::HorizontalAccuracy),
     hdopStability(STABILITY_HDOP_THRESHOLD),
+    pvtMode(false),
 
     gpsUnit(0),
     last_receive_time(0),
@@ -106,10 +145,35 @@ ubloxGPS::ubloxGPS(USARTSerial &serial,
     mon_ver({}),
     cfg_dyn_model(UBX_DEFAULT_MODEL),
 
+    ackExpected(false),
+    rspExpected(false),
+    ackReceived(false),
+    nakReceived(false),
+    rspReceived(false),
+    rxTimeout(false),
+
+    cfg_queuing(false),
+    cfg_committing(false),
+    cfg_buffer_len(0),
+    cfg_next(0),
+    cfg_result(),
+    request_sequence(0),
+    log_retrieval(nullptr),
+    log_ring(nullptr),
+    log_range_end(0),
+    log_range_done(false),
+    log_range_seen(false),
+    cfg_saved_hash(0),
+    cfg_commit_ms(0),
+
     stabilityWindowLength(0),
     stabilityWindowNext(0),
+    stabilityWindowLastTimestamp(0),
     isStable(false),
-    startLockUptime(0)
+    startLockUptime(0),
+    fixSnapshotDate(0),
+    fixSnapshotTime(0),
+    fixSnapshotEpoch(0)
 {
     enablePower(false);
     gps_init(&nmea_gps, nmea_uptime_wrapper);
@@ -128,6 +192,15 @@ ubloxGPS::ubloxGPS(SPIClass &spi,
     tx_ready_gps_pin(tx_ready_gps_pin),
 
     serial(nullptr),
+    rx_chunk_index(0),
+    rx_chunk_len(0),
+    rx_chunk_offset(0),
+    spi_got_data(false),
+    spi_dma_pending(false),
+    spi_chunk_ready(false),
+    spi_tx_ready_enabled(false),
+    geofence_wake(false),
+    nav_epoch_ms(UBX_NAV_EPOCH_DEFAULT),
 
     pwr_enable(pwr_enable),
     tx_ready_queue(nullptr),
@@ -138,12 +211,20 @@ ubloxGPS::ubloxGPS(SPIClass &spi,
     ubx_rx_msg({}),
     write_mga_active(false),
     write_mga_sequence(0),
+    mga_injecting(false),
+    mga_mode(UBX_MGA_INJECT_DIRECT),
+    mga_first(0),
+    mga_outstanding(0),
+    mga_next_offset(0),
+    mga_aborted(false),
+    mga_result(),
 
     initializing(false),
     gpsStatus(GPS_STATUS_OFF),
     powerOn(false),
     lockMethod(ubloxGpsLockMethod::HorizontalAccuracy),
     hdopStability(STABILITY_HDOP_THRESHOLD),
+    pvtMode(false),
 
     gpsUnit(0),
     last_receive_time(0),
@@ -152,10 +233,35 @@ ubloxGPS::ubloxGPS(SPIClass &spi,
     mon_ver({}),
     cfg_dyn_model(UBX_DEFAULT_MODEL),
 
+    ackExpected(false),
+    rspExpected(false),
+    ackReceived(false),
+    nakReceived(false),
+    rspReceived(false),
+    rxTimeout(false),
+
+    cfg_queuing(false),
+    cfg_committing(false),
+    cfg_buffer_len(0),
+    cfg_next(0),
+    cfg_result(),
+    request_sequence(0),
+    log_retrieval(nullptr),
+    log_ring(nullptr),
+    log_range_end(0),
+    log_range_done(false),
+    log_range_seen(false),
+    cfg_saved_hash(0),
+    cfg_commit_ms(0),
+
     stabilityWindowLength(0),
     stabilityWindowNext(0),
+    stabilityWindowLastTimestamp(0),
     isStable(false),
-    startLockUptime(0)
+    startLockUptime(0),
+    fixSnapshotDate(0),
+    fixSnapshotTime(0),
+    fixSnapshotEpoch(0)
 {
     enablePower(false);
     spi_select(false);
@@ -193,9 +299,10 @@ void ubloxGPS::txReadyHandler()
 
 bool ubloxGPS::isLockStable()
 {
-    LOCK();
+    ubx_fix_snapshot_t fix;
+    getFix(fix);
 
-    return getLock() && isStable;
+    return fix.stable;
 }
 
 int ubloxGPS::setLockHdopThreshold(double threshold)
@@ -210,14 +317,10 @@ int ubloxGPS::setLockHdopThreshold(double threshold)
 
 unsigned int ubloxGPS::getLockDuration()
 {
-    LOCK();
-
-    if(!getLock())
-    {
-        return 0;
-    }
+    ubx_fix_snapshot_t fix;
+    getFix(fix);
 
-    return System.uptime() - startLockUptime;
+    return fix.lockedDuration;
 }
 
 // MUST BE CALLED WITH GPS LOCK ALREADY HELD
@@ -274,86 +377,212 @@ void ubloxGPS::processLockStability()
     stabilityWindowLastTimestamp = last_timestamp;
 }
 
-void ubloxGPS::processGPSByte(uint8_t c)
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::processSentence()
 {
+    if (!initializing) {
+        if (getLock())
+        {
+            lastLockTime = Time.now() - (System.uptime() - nmea_gps.time_timestamp);
+            gpsStatus = GPS_STATUS_LOCK;
+        }
+        else
+        {
+            gpsStatus = GPS_STATUS_FIXING;
+        }
+    }
+
+    processLockStability();
+    publishFix();
+}
+
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::publishFix()
+{
+    ubx_fix_snapshot_t fix = {};
+    uint32_t date = UINT32_MAX;
+    uint32_t time = UINT32_MAX;
+
+    // mktime() is relatively expensive so only convert once per new time
+    if (nmea_gps.time_valid && nmea_gps.date_valid) {
+        date = getDate();
+        time = getTime();
+    }
+    if (date != fixSnapshotDate || time != fixSnapshotTime) {
+        fixSnapshotEpoch = getUTCTime();
+        fixSnapshotDate = date;
+        fixSnapshotTime = time;
+    }
+
+    fix.latitude = getLatitude();
+    fix.longitude = getLongitude();
+    fix.horizontalAccuracy = getHorizontalAccuracy();
+    fix.verticalAccuracy = getVerticalAccuracy();
+    fix.horizontalDop = getHDOP();
+    fix.verticalDop = getVDOP();
+    fix.altitude = getAltitude();
+    fix.speed = getSpeed(GPS_SPEED_UNIT_MPS);
+    fix.heading = getHeading();
+    fix.epochTime = fixSnapshotEpoch;
+    fix.posTimestamp = nmea_gps.pos_timestamp;
+    fix.startLockUptime = startLockUptime;
+    fix.fix = nmea_gps.fix;
+    fix.posValid = nmea_gps.pos_valid;
+    fix.stable = isStable;
+    fixSnapshot.store(fix);
+}
+
+void ubloxGPS::getFix(ubx_fix_snapshot_t &fix)
+{
+    fix = fixSnapshot.load();
+
+    // same conditions as getLock() applied to the published state
+    auto now = System.uptime();
+    fix.locked = fix.fix
+        && fix.posValid
+        && fix.posTimestamp
+        && (now - fix.posTimestamp < (MAX_GPS_AGE_MS / 1000));
+    fix.lockedDuration = (fix.locked) ? now - fix.startLockUptime : 0;
+    fix.stable = fix.locked && fix.stable;
+}
+
+size_t ubloxGPS::processGPSBytes(const uint8_t *buf, size_t len, bool waiting)
+{
+    size_t count = 0;
+
+    // decode UBX frames first as this pass may stop short of the end of the
+    // span when an expected frame arrives to prevent it being overwritten
+    while (count < len)
+    {
+        if (decodeStateHandler == &ubloxGPS::stateSync1)
+        {
+            // decoder is idle so skip straight to the next possible frame
+            // start, the bytes in between are NMEA text or SPI filler
+            auto sync = (const uint8_t *)memchr(buf + count, SYNC_1, len - count);
+            if (!sync)
+            {
+                count = len;
+                break;
+            }
+            count = sync - buf;
+        }
+
+        decodeUbx(buf[count++]);
+
+        if (waiting && !checkWaitingForAckOrRspFlags())
+        {
+            break;
+        }
+    }
+
     // in SPI mode there are too many null 0xFF reads to reasonably log raw
     // traffic on the SPI port as we don't know at this layer if the byte is
     // part of an actual message or not
     if (debugNMEA && log_enabled && isInterfaceUart()) {
     #if (GPS_HEX_LOGGING == 1)
-        const char d = ',';
-        Loglib.dump(LOG_LEVEL_TRACE, &c, 1);
-        Loglib.write(LOG_LEVEL_TRACE, &d, 1);
+        Loglib.dump(LOG_LEVEL_TRACE, buf, count);
     #else
-        Loglib.write(LOG_LEVEL_TRACE, (char *) &c, 1);
+        Loglib.write(LOG_LEVEL_TRACE, (const char *) buf, count);
     #endif
     }
-    // decode UBX command
-    if (decodeUbx((uint8_t)c) == DECODE_RESULT_IS_ACK_NAK_RSP) {
-        // Loglib.info("UBX DECODE_RESULT_COMPLETE");
-    }
 
-    int pos_timestamp_prev = nmea_gps.pos_timestamp;
-    int date_timestamp_prev = nmea_gps.date_timestamp;
-
-    // parse NMEA message
-    gps_process(&nmea_gps, &c, 1, log_enabled ? nmea_event_log_cb :  nullptr);
-
-    if (pos_timestamp_prev != nmea_gps.pos_timestamp)
-    {
-        perf_counts.pos_report_count++;
-    }
-    if (date_timestamp_prev != nmea_gps.date_timestamp)
+    // parse NMEA text split at the end of each sentence so that lock and
+    // stability are evaluated once per completed sentence
+    const uint8_t *next = buf;
+    const uint8_t *end = buf + count;
+    while (next < end)
     {
-        perf_counts.time_report_count++;
-    }
+        if (isInterfaceSpi())
+        {
+            // SPI filler is never part of NMEA text so skip runs of it
+            // rather than feeding them through the parser
+            while (next < end && *next == UBX_SPI_FILLER)
+            {
+                next++;
+            }
+            if (next == end)
+            {
+                break;
+            }
+        }
 
-    if (!initializing) {
-        if (getLock())
+        auto cr = (const uint8_t *)memchr(next, '\r', end - next);
+        auto span_end = (cr) ? (cr + 1) : end;
+        if (isInterfaceSpi())
         {
-            lastLockTime = Time.now() - (System.uptime() - nmea_gps.time_timestamp);
-            gpsStatus = GPS_STATUS_LOCK;
+            auto filler = (const uint8_t *)memchr(next, UBX_SPI_FILLER, span_end - next);
+            if (filler)
+            {
+                span_end = filler;
+                cr = nullptr;
+            }
         }
-        else
+
+        int pos_timestamp_prev = nmea_gps.pos_timestamp;
+        int date_timestamp_prev = nmea_gps.date_timestamp;
+
+        gps_process(&nmea_gps, next, span_end - next, log_enabled ? nmea_event_log_cb :  nullptr);
+
+        if (cr)
         {
-            gpsStatus = GPS_STATUS_FIXING;
+            if (pos_timestamp_prev != nmea_gps.pos_timestamp)
+            {
+                perf_counts.pos_report_count++;
+            }
+            if (date_timestamp_prev != nmea_gps.date_timestamp)
+            {
+                perf_counts.time_report_count++;
+            }
+            processSentence();
         }
+        next = span_end;
     }
 
-    processLockStability();
+    if (count)
+    {
+        last_receive_time = millis();
+    }
 
-    last_receive_time = millis();
+    return count;
 }
 
 // gps reading Serial1 thread
 void ubloxGPS::updateGPS(void)
 {
     while (true) {
-        bool available =yieldThread(UBX_MAX_POLL_INTERVAL_MS);
+        bool available = yieldThread(requestYieldTimeout());
+        serviceGPS(available);
+    }
+}
 
-        if ((gpsStatus != GPS_STATUS_OFF) && (gpsStatus != GPS_STATUS_ERROR))
+void ubloxGPS::serviceGPS(bool available)
+{
+    if ((gpsStatus != GPS_STATUS_OFF) && (gpsStatus != GPS_STATUS_ERROR))
+    {
+        // try and acquire the lock in a non-blocking fashion as another
+        // thread may have already acquired the lock and also be pending
+        // on the tx ready event that was just consumed, want to be able
+        // to put it back in such a case
+        if(!gps_mutex.try_lock())
         {
-            // try and acquire the lock in a non-blocking fashion as another
-            // thread may have already acquired the lock and also be pending
-            // on the tx ready event that was just consumed, want to be able
-            // to put it back in such a case
-            if(!gps_mutex.try_lock())
-            {
-                if(tx_ready_queue && available)
-                {
-                    // put the tx ready event back
-                    txReadyHandler();
-                    // lock to force wait on whatever task may have been
-                    // holding the lock before coming back to try again
-                    gps_mutex.lock();
-                    gps_mutex.unlock();
-                }
-            }
-            else
+            if(tx_ready_queue && available)
             {
-                processBytes();
-                gps_mutex.unlock();
+                // put the tx ready event back
+                txReadyHandler();
             }
+            // lock to force wait on whatever task may have been holding the
+            // lock before coming back to try again, queued or expired
+            // requests would otherwise have the thread spin on a zero yield
+            // timeout until it is released
+            gps_mutex.lock();
+            gps_mutex.unlock();
+        }
+        else
+        {
+            sendRequests();
+            processBytes();
+            expireRequests();
+            gps_mutex.unlock();
         }
     }
 }
@@ -369,10 +598,15 @@ int ubloxGPS::setOn(lib_config_t &config)
 
     enablePower(true);
     initializing = true;
+    spi_tx_ready_enabled = false;
+    geofence_wake = false;
     gps_init(&nmea_gps, nmea_uptime_wrapper);
+    publishFix();
 
     NAMED_SCOPE_GUARD(exitScope, {
+        cfg_queuing = false;
         gpsStatus = GPS_STATUS_ERROR;
+        cancelRequests();
         enablePower(false);
         if (log_enabled) {
             Loglib.error("Initialization failed");
@@ -400,22 +634,40 @@ int ubloxGPS::setOn(lib_config_t &config)
             }
         }
 
+        // receive with DMA in the background if possible, otherwise fall
+        // back to blocking transfers
+        if(!spi_dma_queue && os_queue_create(&spi_dma_queue, sizeof(uint8_t), 1, nullptr))
+        {
+            spi_dma_queue = nullptr;
+        }
+
         // first process all bytes off of the port, reconfiguring seems to drop
         // some startup frames that are useful debug indications
         processBytes();
 
         CHECK_TRUE(setSpiMode(tx_ready_gps_pin, 0, UBX_CFG_PRT_MODE_SPI_MODE_0), SYSTEM_ERROR_IO);
+        spi_tx_ready_enabled = true;
     } else {
         // Interface not defined
         return SYSTEM_ERROR_INVALID_STATE;
     }
 
-    if (config.output_pubx) {
+    // the remaining commands are independent of each other so send them back
+    // to back rather than waiting for each ACK in turn
+    beginConfig();
+
+    if (config.output_pvt) {
+        CHECK_TRUE(enablePVT(config.fastIntervalSec), SYSTEM_ERROR_IO);
+        CHECK_TRUE(disableNMEA(), SYSTEM_ERROR_IO);
+        CHECK_TRUE(disablePUBX(), SYSTEM_ERROR_IO);
+    } else if (config.output_pubx) {
         CHECK_TRUE(enablePUBX(config.fastIntervalSec, config.slowIntervalSec), SYSTEM_ERROR_IO);
         CHECK_TRUE(disableNMEA(), SYSTEM_ERROR_IO);
+        CHECK_TRUE(disablePVT(), SYSTEM_ERROR_IO);
     } else {
         CHECK_TRUE(enableNMEA(config.fastIntervalSec, config.slowIntervalSec), SYSTEM_ERROR_IO);
         CHECK_TRUE(disablePUBX(), SYSTEM_ERROR_IO);
+        CHECK_TRUE(disablePVT(), SYSTEM_ERROR_IO);
     }
 
     CHECK_TRUE(configMsg(UBX_CLASS_ESF, UBX_ESF_STATUS, 10), SYSTEM_ERROR_IO); // TODO: Once ESF is good maybe we can slow this down.
@@ -424,6 +676,41 @@ int ubloxGPS::setOn(lib_config_t &config)
     CHECK_TRUE(setGNSS(config.support_gnss), SYSTEM_ERROR_IO);
     CHECK_TRUE(setPower((ubx_power_mode_t)config.power_mode), SYSTEM_ERROR_IO);
     CHECK_TRUE(setMode((ubx_dynamic_model_t)config.dynamic_model), SYSTEM_ERROR_IO);
+
+    // a module that kept its backup supply reloads the configuration saved
+    // on the previous power on, confirm it is still in place rather than
+    // sending all of it again
+    uint32_t hash = configHash();
+    uint32_t t0 = millis();
+    if(hash == cfg_saved_hash && verifySavedConfig())
+    {
+        cfg_queuing = false;
+        cfg_result.skipped = true;
+        cfg_result.elapsed = millis() - t0;
+        for(size_t i = 0; i < cfg_result.count; i++)
+        {
+            cfg_result.commands[i].result = UBX_CFG_RESULT_SKIPPED;
+        }
+        perf_counts.config_skipped_count += cfg_result.count;
+        perf_counts.config_saved_ms += (cfg_commit_ms > cfg_result.elapsed) ? (cfg_commit_ms - cfg_result.elapsed) : 0;
+        if(log_enabled)
+            Loglib.info("kept saved configuration, confirmed in %lu ms", cfg_result.elapsed);
+    }
+    else
+    {
+        cfg_saved_hash = 0;
+        CHECK_TRUE(commitConfig() == SYSTEM_ERROR_NONE, SYSTEM_ERROR_IO);
+        perf_counts.config_sent_count += cfg_result.count;
+        cfg_commit_ms = cfg_result.elapsed;
+        if(log_enabled)
+            Loglib.info("configured %u commands in %lu ms", (unsigned)cfg_result.count, cfg_result.elapsed);
+
+        // not being able to save only costs a full configuration next time
+        if(saveConfig())
+        {
+            cfg_saved_hash = hash;
+        }
+    }
     last_receive_time = 0;
 
     // TODO: Move this segment earlier and check for success
@@ -441,6 +728,7 @@ int ubloxGPS::on(ubx_dynamic_model_t model)
 {
     lib_config.resetDefault();
     lib_config.dynamic_model = model;
+    lib_config.output_pvt = pvtMode;
     return setOn(lib_config);
 }
 
@@ -448,6 +736,7 @@ int ubloxGPS::off(void)
 {
     initializing = false;
     gpsStatus = GPS_STATUS_OFF;
+    cancelRequests();
     return enablePower(false);
 }
 
@@ -475,6 +764,13 @@ void ubloxGPS::setOutputPUBX(void)
     disableNMEA();
 }
 
+void ubloxGPS::setOutputPVT(void)
+{
+    enablePVT(lib_config.fastIntervalSec);
+    disableNMEA();
+    disablePUBX();
+}
+
 
 uint8_t ubloxGPS::getGpsStatus()
 {
@@ -671,7 +967,12 @@ void ubloxGPS::initRxMsg()
 bool ubloxGPS::parseRxMsg()
 {
     if (ubx_rx_msg.msg_class == UBX_CLASS_ACK) {
-        if (ackExpected || rspExpected) {
+        matchRequests();
+        if (cfg_committing && ubx_rx_msg.length == 2) {
+            ubx_ack_t *ack = (ubx_ack_t *) &ubx_rx_msg;
+            matchConfigReply(ack->req_class, ack->req_id,
+                (ubx_rx_msg.msg_id == UBX_ACK_ACK) ? UBX_CFG_RESULT_ACK : UBX_CFG_RESULT_NAK);
+        } else if (ackExpected || rspExpected) {
             if (ubx_rx_msg.msg_id == UBX_ACK_ACK) {
                 ubx_ack_t *ack = (ubx_ack_t *) &ubx_rx_msg;
                 // allow wildcarding for ACK matches
@@ -692,6 +993,7 @@ bool ubloxGPS::parseRxMsg()
         }
     } else {
         processUBX();
+        matchRequests();
 
         // allow wildcarding for response matches (match any response, match any
         // response from a specified class)
@@ -777,6 +1079,26 @@ void ubloxGPS::processUBX()
             mon_ver.extension[str_ext.length()-1] = '\0';
         }
         mon_ver.valid = true;
+    } else if (ubx_rx_msg.msg_class == UBX_CLASS_NAV && ubx_rx_msg.msg_id == UBX_NAV_PVT ) {
+        if (ubx_rx_msg.length >= sizeof(ubx_nav_pvt_t)) {
+            ubx_nav_pvt_t pvt;
+            memcpy(&pvt, ubx_rx_msg.ubx_msg, sizeof(pvt));
+            processNavPvt(pvt);
+        }
+    } else if (ubx_rx_msg.msg_class == UBX_CLASS_NAV && ubx_rx_msg.msg_id == UBX_NAV_DOP ) {
+        if (ubx_rx_msg.length >= sizeof(ubx_nav_dop_t)) {
+            ubx_nav_dop_t dop;
+            memcpy(&dop, ubx_rx_msg.ubx_msg, sizeof(dop));
+            processNavDop(dop);
+        }
+    } else if (ubx_rx_msg.msg_class == UBX_CLASS_LOG &&
+        (ubx_rx_msg.msg_id == UBX_LOG_RETRIEVEPOS ||
+        ubx_rx_msg.msg_id == UBX_LOG_RETRIEVEPOSEXTRA ||
+        ubx_rx_msg.msg_id == UBX_LOG_RETRIEVESTRING)) {
+        processLogEntry();
+    } else if (ubx_rx_msg.msg_class == UBX_CLASS_MGA &&
+        (ubx_rx_msg.msg_id == UBX_MGA_ACK_DATA0 || ubx_rx_msg.msg_id == UBX_MGA_FLASH_DATA)) {
+        processMgaAck();
     }  else if (ubx_rx_msg.msg_class == UBX_CLASS_CFG && ubx_rx_msg.msg_id == UBX_CFG_NAV5 ) {
         cfg_dyn_model = static_cast<ubx_dynamic_model_t>(ubx_rx_msg.ubx_msg[2] + ubx_rx_msg.ubx_msg[3] * 256);
 
@@ -785,10 +1107,165 @@ void ubloxGPS::processUBX()
     }
 }
 
+// The PVT solution is stored in the same fields as the NMEA/PUBX parser so
+// that the getters, lock and stability handling are independent of the
+// output selected on the module
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::processNavPvt(const ubx_nav_pvt_t &pvt)
+{
+    constexpr double MM_PER_SEC_TO_KNOTS = 1.0 / 514.44444444444;
+    int now = (nmea_gps.timestamp_fn) ? nmea_gps.timestamp_fn() : 0;
+
+    // map onto the NMEA GGA fix quality reported by getFixQuality()
+    uint8_t fix = 0;
+    if (pvt.flags & UBX_NAV_PVT_FLAGS_GNSS_FIX_OK) {
+        switch (pvt.fixType) {
+            case UBX_NAV_PVT_FIX_2D:
+            case UBX_NAV_PVT_FIX_3D:
+            case UBX_NAV_PVT_FIX_GNSS_DR:
+                fix = (pvt.flags & UBX_NAV_PVT_FLAGS_DIFF_SOLN) ? 2 : 1;
+                break;
+            case UBX_NAV_PVT_FIX_DR:
+                fix = 6;
+                break;
+        }
+    }
+
+    if ((pvt.valid & UBX_NAV_PVT_VALID_TIME) && (pvt.valid & UBX_NAV_PVT_VALID_DATE)) {
+        nmea_gps.hours = pvt.hour;
+        nmea_gps.minutes = pvt.min;
+        nmea_gps.seconds = pvt.sec;
+        nmea_gps.date = pvt.day;
+        nmea_gps.month = pvt.month;
+        nmea_gps.year = pvt.year - 2000;
+        nmea_gps.time_valid = true;
+        nmea_gps.date_valid = true;
+        nmea_gps.time_timestamp = nmea_gps.date_timestamp = now;
+        perf_counts.time_report_count++;
+    }
+
+    nmea_gps.pos_valid = true;
+    nmea_gps.pos_timestamp = now;
+    nmea_gps.fix = fix;
+    nmea_gps.is_valid = (fix != 0);
+    nmea_gps.sats_in_use = pvt.numSV;
+    nmea_gps.dop_p = pvt.pDOP * 0.01;
+    perf_counts.pos_report_count++;
+
+    // without gnssFixOK the solution is outside the configured limits and
+    // the last position that was within them is kept
+    if (pvt.flags & UBX_NAV_PVT_FLAGS_GNSS_FIX_OK) {
+        nmea_gps.latitude = pvt.lat * 1e-7;
+        nmea_gps.longitude = pvt.lon * 1e-7;
+        nmea_gps.altitude = pvt.hMSL / 1000.0;
+        nmea_gps.geo_sep = (pvt.height - pvt.hMSL) / 1000.0;
+        nmea_gps.h_accuracy = pvt.hAcc / 1000.0;
+        nmea_gps.v_accuracy = pvt.vAcc / 1000.0;
+        nmea_gps.speed = pvt.gSpeed * MM_PER_SEC_TO_KNOTS;
+        nmea_gps.course = pvt.headMot * 1e-5;
+    }
+
+    processSentence();
+}
+
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::processNavDop(const ubx_nav_dop_t &dop)
+{
+    nmea_gps.dop_h = dop.hDOP * 0.01;
+    nmea_gps.dop_v = dop.vDOP * 0.01;
+    nmea_gps.dop_p = dop.pDOP * 0.01;
+}
+
+// Entries outside of a bulk retrieval are left to getLogEntry(). Within the
+// requested range only the next expected entry is taken so the ring stays in
+// index order, a skipped entry is requested again once the range ends.
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::processLogEntry()
+{
+    if(!log_retrieval || ubx_rx_msg.length < 4)
+    {
+        return;
+    }
+
+    const uint8_t *p = ubx_rx_msg.ubx_msg;
+    uint32_t index = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    if(index < log_retrieval->next_index || index >= log_range_end)
+    {
+        return;
+    }
+    log_range_seen = true;
+    if(index + 1 == log_range_end)
+    {
+        log_range_done = true;
+    }
+    if(index != log_retrieval->next_index)
+    {
+        return;
+    }
+
+    ubx_log_entry_t entry = {};
+    entry.index = index;
+    entry.type = ubx_rx_msg.msg_id;
+    if(ubx_rx_msg.msg_id == UBX_LOG_RETRIEVEPOS &&
+        ubx_rx_msg.length >= sizeof(ubx_log_pos_t) - offsetof(ubx_msg_t, payload))
+    {
+        ubx_log_pos_t pos;
+        memcpy(&pos, &ubx_rx_msg, sizeof(pos));
+        entry.fix = pos.fix;
+        entry.num_satellites = pos.num_satellites;
+        entry.year = pos.year;
+        entry.month = pos.month;
+        entry.day = pos.day;
+        entry.hour = pos.hour;
+        entry.minute = pos.minute;
+        entry.second = pos.second;
+        entry.lon = pos.lon;
+        entry.lat = pos.lat;
+        entry.alt = pos.alt;
+        entry.horizontal_accuracy = pos.horizontal_accuracy;
+        entry.ground_speed = pos.ground_speed;
+        entry.heading = pos.heading;
+    }
+    else if(ubx_rx_msg.msg_id == UBX_LOG_RETRIEVESTRING &&
+        ubx_rx_msg.length >= sizeof(ubx_log_rx_string_t) - offsetof(ubx_msg_t, payload))
+    {
+        ubx_log_rx_string_t str;
+        memcpy(&str, &ubx_rx_msg, sizeof(str));
+        entry.year = str.year;
+        entry.month = str.month;
+        entry.day = str.day;
+        entry.hour = str.hour;
+        entry.minute = str.minute;
+        entry.second = str.second;
+        entry.byte_count = str.byte_count;
+        size_t avail = ubx_rx_msg.length - (sizeof(ubx_log_rx_string_t) - offsetof(ubx_msg_t, payload));
+        memcpy(entry.bytes, &p[sizeof(ubx_log_rx_string_t) - offsetof(ubx_msg_t, payload)],
+            std::min({avail, (size_t)str.byte_count, sizeof(entry.bytes)}));
+    }
+    else if(ubx_rx_msg.msg_id == UBX_LOG_RETRIEVEPOSEXTRA && ubx_rx_msg.length >= 20)
+    {
+        // entryIndex, version, reserved, year, month, day, hour, minute,
+        // second, reserved[3], distance
+        entry.year = p[6] | (p[7] << 8);
+        entry.month = p[8];
+        entry.day = p[9];
+        entry.hour = p[10];
+        entry.minute = p[11];
+        entry.second = p[12];
+        entry.distance = p[16] | (p[17] << 8) | (p[18] << 16) | ((uint32_t)p[19] << 24);
+    }
+
+    // ranges are only requested as large as the free space in the ring
+    if(log_ring->push(entry))
+    {
+        log_retrieval->next_index++;
+        log_retrieval->retrieved++;
+    }
+}
 
 decode_result_t ubloxGPS::decodeUbx(uint8_t byte)
 {
-    return (decodeStateHandler)(this, byte);
+    return (this->*decodeStateHandler)(byte);
 }
 
 decode_result_t ubloxGPS::stateSync1(uint8_t byte)
@@ -954,13 +1431,13 @@ bool ubloxGPS::setBaudrate(ubx_baudrate_t baudrate)
  * Set configuration for ubloxGPS SPI port
  *
  */
-bool ubloxGPS::setSpiMode(int txReady, int threshold, int spiMode) {
+bool ubloxGPS::setSpiMode(int txReady, int threshold, int spiMode, bool txReadyEnable) {
     ubx_cfg_port_t msg = {
         .header = {.msg_class = UBX_CLASS_CFG, .msg_id = UBX_CFG_PRT},
     };
 
     msg.port = UBX_CFG_PRT_SPI;
-    msg.tx_ready.enable = 1;
+    msg.tx_ready.enable = txReadyEnable ? 1 : 0;
     msg.tx_ready.polarity = UBX_CFG_PRT_TX_READY_ACTIVE_LOW;
     msg.tx_ready.pin = txReady;
     msg.tx_ready.threshold = threshold;
@@ -989,7 +1466,12 @@ bool ubloxGPS::setRate(uint16_t measRateHz)
     uint16_t measTime = 1000 / measRateHz;
     sentences[4] = (uint8_t)(measTime & 0xFF);
     sentences[5] = (uint8_t)(measTime >> 8);
-    return requestSendUBX(sentences, 10);
+    if(!requestSendUBX(sentences, 10))
+    {
+        return false;
+    }
+    nav_epoch_ms = measTime;
+    return true;
 }
 
 bool ubloxGPS::updateEsfStatus(void)
@@ -1001,6 +1483,12 @@ bool ubloxGPS::updateEsfStatus(void)
     return requestSendUBX(sentences, 4);
 }
 
+int ubloxGPS::updateEsfStatusAsync(ubx_request_callback_t callback)
+{
+    uint8_t sentences[4] = { (uint8_t)UBX_CLASS_ESF, (uint8_t)UBX_ESF_STATUS, 0x00, 0x00 };
+    return requestAsync(sentences, sizeof(sentences), 0x00, UBX_CLASS_ESF, UBX_ESF_STATUS, callback);
+}
+
 bool ubloxGPS::getEsfStatus(ubx_esf_status_t &esf)
 {
     LOCK();
@@ -1034,6 +1522,12 @@ bool ubloxGPS::updateOdometer(void)
     return requestSendUBX(sentences, 4);
 }
 
+int ubloxGPS::updateOdometerAsync(ubx_request_callback_t callback)
+{
+    uint8_t sentences[4] = { (uint8_t)UBX_CLASS_NAV, (uint8_t)UBX_NAV_ODO, 0x00, 0x00 };
+    return requestAsync(sentences, sizeof(sentences), 0x00, UBX_CLASS_NAV, UBX_NAV_ODO, callback);
+}
+
 bool ubloxGPS::getOdometer(ubx_nav_odo_t &odo)
 {
     LOCK();
@@ -1262,9 +1756,9 @@ bool ubloxGPS::setPower(ubx_power_mode_t power_mode, uint16_t period, uint16_t o
 bool ubloxGPS::setGeofence(ubx_geofence_t geofence)
 {
     LOCK();
-    uint8_t sentences[60] = {0};
-    if (geofence.numFences > 4)
-        geofence.numFences = 4;
+    uint8_t sentences[4 + 8 + 12 * UBX_GEOFENCE_MAX] = {0};
+    if (geofence.numFences > UBX_GEOFENCE_MAX)
+        geofence.numFences = UBX_GEOFENCE_MAX;
 
     sentences[0]  = (uint8_t)UBX_CLASS_CFG;
     sentences[1]  = (uint8_t)UBX_CFG_GEOFENCE;
@@ -1279,22 +1773,104 @@ bool ubloxGPS::setGeofence(ubx_geofence_t geofence)
     sentences[10] = geofence.pinNumber;
     sentences[11] = 0x00;
     for (int i = 0; i < geofence.numFences; i++) {
-        sentences[12 + i] = geofence.lat[i] & 0xFF;
-        sentences[13 + i] = (geofence.lat[i] >> 8) & 0xFF;
-        sentences[14 + i] = (geofence.lat[i] >> 16) & 0xFF;
-        sentences[15 + i] = (geofence.lat[i] >> 24) & 0xFF;
-        sentences[16 + i] = geofence.lon[i] & 0xFF;
-        sentences[17 + i] = (geofence.lon[i] >> 8) & 0xFF;
-        sentences[18 + i] = (geofence.lon[i] >> 16) & 0xFF;
-        sentences[19 + i] = (geofence.lon[i] >> 24) & 0xFF;
-        sentences[20 + i] = geofence.rad[i] & 0xFF;
-        sentences[21 + i] = (geofence.rad[i] >> 8) & 0xFF;
-        sentences[22 + i] = (geofence.rad[i] >> 16) & 0xFF;
-        sentences[23 + i] = (geofence.rad[i] >> 24) & 0xFF;
+        uint8_t *fence = &sentences[12 + 12 * i];
+        for (int j = 0; j < 4; j++) {
+            fence[j]     = ((uint32_t)geofence.lat[i] >> (8 * j)) & 0xFF;
+            fence[4 + j] = ((uint32_t)geofence.lon[i] >> (8 * j)) & 0xFF;
+            fence[8 + j] = (geofence.rad[i] >> (8 * j)) & 0xFF;
+        }
         if(log_enabled) Loglib.info("geofence[%d] : (Lat,Lon,Radius) - (%.8f,%.8f,%.2f)", i + 1, geofence.lat[i] * 1e-7, geofence.lon[i] * 1e-7, geofence.rad[i] * 1e-2);
     }
 
-    return requestSendUBX(sentences, sentences[2] + 4);
+    uint16_t len = sentences[2] + 4;
+    if(cfg_queuing)
+    {
+        return requestSendUBX(sentences, len);
+    }
+
+    const ubx_msg_t *rsp = NULL;
+    if(requestSendUBX((const ubx_msg_t *) sentences, len, UBX_REQ_FLAGS_EXPECT_ACK))
+    {
+        rsp = getResponse();
+    }
+    return isACK(rsp);
+}
+
+bool ubloxGPS::getGeofenceState(ubx_nav_geofence_t& state)
+{
+    uint8_t sentences[4] = { (uint8_t)UBX_CLASS_NAV, (uint8_t)UBX_NAV_GEOFENCE, 0x00, 0x00 };
+    const ubx_msg_t *rsp = NULL;
+    LOCK();
+
+    if(requestSendUBX((const ubx_msg_t *) sentences, sizeof(sentences), 0x00, UBX_CLASS_NAV, UBX_NAV_GEOFENCE))
+    {
+        rsp = getResponse();
+    }
+
+    if(!rsp || rsp->msg_class != UBX_CLASS_NAV || rsp->msg_id != UBX_NAV_GEOFENCE || rsp->length < 8)
+    {
+        return false;
+    }
+    state = {};
+    memcpy(&state, rsp->payload, std::min<size_t>(rsp->length, sizeof(state)));
+    return true;
+}
+
+int ubloxGPS::setGeofenceWake(ubx_geofence_t geofence)
+{
+    CHECK_TRUE(isInterfaceSpi() && (tx_ready_gps_pin != PIN_INVALID), SYSTEM_ERROR_NOT_SUPPORTED);
+    CHECK_TRUE((geofence.numFences > 0) && (geofence.numFences <= UBX_GEOFENCE_MAX), SYSTEM_ERROR_INVALID_ARGUMENT);
+
+    NAMED_SCOPE_GUARD(restore, {
+        clearGeofenceWake();
+    });
+
+    uint32_t epoch;
+    {
+        LOCK();
+        CHECK_FALSE((gpsStatus == GPS_STATUS_OFF) || (gpsStatus == GPS_STATUS_ERROR), SYSTEM_ERROR_INVALID_STATE);
+
+        // from here on the pin no longer says whether bytes are pending
+        geofence_wake = true;
+        spi_tx_ready_enabled = false;
+
+        CHECK_TRUE(setSpiMode(tx_ready_gps_pin, 0, UBX_CFG_PRT_MODE_SPI_MODE_0, false), SYSTEM_ERROR_IO);
+        geofence.enablePIO(tx_ready_gps_pin, UBX_GEOFENCE_PIO_LOW_INSIDE);
+        CHECK_TRUE(setGeofence(geofence), SYSTEM_ERROR_IO);
+        epoch = nav_epoch_ms;
+    }
+
+    // the PIO reads as outside until the first epoch with the new fences,
+    // sleeping on it before then would wake straight away when inside. The
+    // lock is released between polls so the GPS thread keeps running.
+    uint32_t t0 = millis();
+    ubx_nav_geofence_t state = {};
+    while(!getGeofenceState(state) || !state.known())
+    {
+        CHECK_TRUE(millis() - t0 < epoch, SYSTEM_ERROR_TIMEOUT);
+        delay(std::min<uint32_t>(UBX_GEOFENCE_POLL_INTERVAL, epoch));
+    }
+    if(log_enabled) Loglib.info("geofence wake armed, %s", (state.comb_state == UBX_GEOFENCE_STATE_INSIDE) ? "inside" : "outside");
+
+    restore.dismiss();
+    return SYSTEM_ERROR_NONE;
+}
+
+int ubloxGPS::clearGeofenceWake()
+{
+    LOCK();
+
+    if(!geofence_wake)
+    {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    ubx_geofence_t none;
+    CHECK_TRUE(setGeofence(none), SYSTEM_ERROR_IO);
+    CHECK_TRUE(setSpiMode(tx_ready_gps_pin, 0, UBX_CFG_PRT_MODE_SPI_MODE_0), SYSTEM_ERROR_IO);
+    geofence_wake = false;
+    spi_tx_ready_enabled = true;
+    return SYSTEM_ERROR_NONE;
 }
 
 bool ubloxGPS::configMsg(ubx_msg_class_t msgClass, uint8_t msgId, uint8_t rate)
@@ -1412,6 +1988,34 @@ bool ubloxGPS::disablePUBX(void)
     return err == 0 ? true : false;
 }
 
+bool ubloxGPS::enablePVT(uint8_t intervalSec)
+{
+    LOCK();
+    uint8_t err = 0;
+    if(log_enabled) Loglib.info("enable NAV-PVT");
+    err |= configMsg(UBX_CLASS_NAV, UBX_NAV_PVT, intervalSec) ? 0 : 0x01;
+    // NAV-PVT only carries PDOP so HDOP/VDOP come from NAV-DOP
+    err |= configMsg(UBX_CLASS_NAV, UBX_NAV_DOP, intervalSec) ? 0 : 0x02;
+    if (err != 0) {
+        perf_counts.enable_pvt_error_count++;
+        if(log_enabled) Loglib.info("enablePVT error: 0x%02X", err);
+    }
+    return err == 0 ? true : false;
+}
+
+bool ubloxGPS::disablePVT(void)
+{
+    LOCK();
+    uint8_t err = 0;
+    err |= configMsg(UBX_CLASS_NAV, UBX_NAV_PVT, 0) ? 0 : 0x01;
+    err |= configMsg(UBX_CLASS_NAV, UBX_NAV_DOP, 0) ? 0 : 0x02;
+    if (err != 0) {
+        perf_counts.disable_pvt_error_count++;
+        if(log_enabled) Loglib.info("disablePVT error: 0x%02X", err);
+    }
+    return err == 0 ? true : false;
+}
+
 bool ubloxGPS::enablePUBX(uint8_t intervalSec, uint8_t slowIntervalSec)
 {
     LOCK();
@@ -1477,36 +2081,246 @@ bool ubloxGPS::requestSendUBX(const uint8_t *sentences, uint16_t len)
 
     if(sentences[0] == (uint8_t) UBX_CLASS_CFG)
     {
+        // polls have no payload and are answered rather than acknowledged
+        if(cfg_queuing && len > 4)
+        {
+            return queueConfig(sentences, len);
+        }
         flags = UBX_REQ_FLAGS_EXPECT_ACK;
     }
     return requestSendUBX((const ubx_msg_t *) sentences, len, flags);
 }
 
-bool ubloxGPS::requestSendUBX(const ubx_msg_t *request,
-    uint16_t len,
-    uint8_t flags,
-    uint8_t rsp_class,
-    uint8_t rsp_id)
+void ubloxGPS::beginConfig()
 {
-    bool ok = false;
+    LOCK();
+    cfg_queuing = true;
+    cfg_buffer_len = 0;
+    cfg_result = {};
+}
 
-    if(!request || len < 2)
+bool ubloxGPS::queueConfig(const uint8_t *sentences, uint16_t len)
+{
+    if(cfg_result.count >= UBX_CFG_TRANSACTION_MAX_COMMANDS || cfg_buffer_len + len > UBX_CFG_TRANSACTION_MAX_LEN)
     {
-        // minimum len is 2-bytes for the request class/id
+        cfg_result.overflow = true;
         return false;
     }
 
-    ackExpected = false;
-    rspExpected = false;
-    ackReceived = false;
-    nakReceived = false;
-    rspReceived = false;
-    rxTimeout   = false;
-
-    waitForReqClass = request->msg_class;
-    waitForReqId = request->msg_id;
+    ubx_cfg_command_result_t &cmd = cfg_result.commands[cfg_result.count];
+    cmd.msg_class = sentences[0];
+    cmd.msg_id = sentences[1];
+    cmd.result = UBX_CFG_RESULT_PENDING;
+    cmd.latency = 0;
+    cfg_offset[cfg_result.count++] = cfg_buffer_len;
+    memcpy(cfg_buffer + cfg_buffer_len, sentences, len);
+    cfg_buffer_len += len;
+    return true;
+}
 
-    if(flags & UBX_REQ_FLAGS_EXPECT_ACK)
+void ubloxGPS::matchConfigReply(uint8_t req_class, uint8_t req_id, uint8_t result)
+{
+    // the module handles commands in order so the reply belongs to the oldest
+    // outstanding command of the same class/id
+    for(size_t i = 0; i < cfg_next; i++)
+    {
+        ubx_cfg_command_result_t &cmd = cfg_result.commands[i];
+        if(cmd.result == UBX_CFG_RESULT_PENDING && cmd.msg_class == req_class && cmd.msg_id == req_id)
+        {
+            cmd.result = result;
+            cmd.latency = millis() - cfg_sent[i];
+            if(result == UBX_CFG_RESULT_ACK)
+            {
+                cfg_result.acked++;
+            }
+            else
+            {
+                cfg_result.naked++;
+                perf_counts.config_nak_count++;
+            }
+            return;
+        }
+    }
+}
+
+uint32_t ubloxGPS::configHash() const
+{
+    // FNV-1a over the queued commands
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < cfg_buffer_len; i++)
+    {
+        hash = (hash ^ cfg_buffer[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool ubloxGPS::verifySavedConfig()
+{
+    // a module that lost its backup supply starts from its defaults, which
+    // differ from the queued navigation model and message rates
+    const uint8_t *nav5 = nullptr;
+    const uint8_t *msg = nullptr;
+    for(size_t i = 0; i < cfg_result.count; i++)
+    {
+        const uint8_t *cmd = cfg_buffer + cfg_offset[i];
+        if(cmd[1] == UBX_CFG_NAV5)
+        {
+            nav5 = cmd;
+        }
+        else if(cmd[1] == UBX_CFG_MSG && cmd[6])
+        {
+            msg = cmd;
+        }
+    }
+    CHECK_TRUE(nav5 && msg, false);
+
+    const ubx_msg_t *rsp = NULL;
+    uint8_t poll_nav5[4] = { (uint8_t)UBX_CLASS_CFG, (uint8_t)UBX_CFG_NAV5, 0x00, 0x00 };
+    if(requestSendUBX((const ubx_msg_t *) poll_nav5, sizeof(poll_nav5), 0x00, UBX_CLASS_CFG, UBX_CFG_NAV5))
+    {
+        rsp = getResponse();
+    }
+    // dynamic model and fix mode
+    CHECK_TRUE(rsp && rsp->msg_id == UBX_CFG_NAV5 && rsp->length >= 4, false);
+    CHECK_TRUE(!memcmp(rsp->payload + 2, nav5 + 6, 2), false);
+
+    rsp = NULL;
+    uint8_t poll_msg[6] = { (uint8_t)UBX_CLASS_CFG, (uint8_t)UBX_CFG_MSG, 0x02, 0x00, msg[4], msg[5] };
+    if(requestSendUBX((const ubx_msg_t *) poll_msg, sizeof(poll_msg), 0x00, UBX_CLASS_CFG, UBX_CFG_MSG))
+    {
+        rsp = getResponse();
+    }
+    // message class/id and the rate on each port
+    CHECK_TRUE(rsp && rsp->msg_id == UBX_CFG_MSG && rsp->length == 8, false);
+    return !memcmp(rsp->payload, msg + 4, 8);
+}
+
+bool ubloxGPS::saveConfig(void)
+{
+    LOCK();
+    uint8_t sentences[17] = {0};
+    sentences[0]  = (uint8_t)UBX_CLASS_CFG;
+    sentences[1]  = (uint8_t)UBX_CFG_CFG;
+    sentences[2]  = 13;
+    sentences[3]  = 0x00;
+    // clearMask 4-7 left empty
+    sentences[8]  = 0x1A;   // saveMask, msgConf, navConf, rxmConf
+    // loadMask 12-15 left empty
+    sentences[16] = 0x01;   // deviceMask, devBBR
+
+    const ubx_msg_t *rsp = NULL;
+    if(requestSendUBX((const ubx_msg_t *) sentences, sentences[2] + 4, UBX_REQ_FLAGS_EXPECT_ACK))
+    {
+        rsp = getResponse();
+    }
+    return isACK(rsp);
+}
+
+int ubloxGPS::commitConfig()
+{
+    LOCK();
+    CHECK_TRUE(cfg_queuing, SYSTEM_ERROR_INVALID_STATE);
+    cfg_queuing = false;
+
+    cfg_next = 0;
+    cfg_committing = true;
+    NAMED_SCOPE_GUARD(commitScope, {
+        cfg_committing = false;
+    });
+
+    uint32_t t0 = millis();
+    size_t oldest = 0;  // oldest command without a result
+
+    while(oldest < cfg_result.count)
+    {
+        // keep the window full
+        while(cfg_next < cfg_result.count && cfg_next - oldest < UBX_CFG_TRANSACTION_WINDOW)
+        {
+            size_t i = cfg_next++;
+            size_t end = (cfg_next < cfg_result.count) ? cfg_offset[cfg_next] : cfg_buffer_len;
+            cfg_sent[i] = millis();
+            if(!sendUBX(cfg_buffer + cfg_offset[i], end - cfg_offset[i]))
+            {
+                cfg_result.commands[i].result = UBX_CFG_RESULT_SEND_ERROR;
+                cfg_result.send_errors++;
+            }
+        }
+
+        processBytes();
+
+        while(oldest < cfg_next && cfg_result.commands[oldest].result != UBX_CFG_RESULT_PENDING)
+        {
+            oldest++;
+        }
+        if(oldest == cfg_next)
+        {
+            continue;
+        }
+
+        uint32_t waited = millis() - cfg_sent[oldest];
+        if(waited > UBX_MSG_TIMEOUT)
+        {
+            cfg_result.commands[oldest].result = UBX_CFG_RESULT_TIMEOUT;
+            cfg_result.timeouts++;
+            perf_counts.timeouts++;
+            decodeStateHandler = &ubloxGPS::stateSync1;
+            if(log_enabled)
+            {
+                Loglib.info("UBX response timeout");
+            }
+            continue;
+        }
+        yieldThread(UBX_MSG_TIMEOUT - waited);
+    }
+    cfg_result.elapsed = millis() - t0;
+
+    if(cfg_result.overflow)
+    {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    if(cfg_result.acked != cfg_result.count)
+    {
+        if(log_enabled)
+        {
+            for(size_t i = 0; i < cfg_result.count; i++)
+            {
+                const ubx_cfg_command_result_t &cmd = cfg_result.commands[i];
+                if(cmd.result != UBX_CFG_RESULT_ACK)
+                {
+                    Loglib.info("UBX config 0x%02X 0x%02X failed: %u", cmd.msg_class, cmd.msg_id, (unsigned)cmd.result);
+                }
+            }
+        }
+        return SYSTEM_ERROR_IO;
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+bool ubloxGPS::requestSendUBX(const ubx_msg_t *request,
+    uint16_t len,
+    uint8_t flags,
+    uint8_t rsp_class,
+    uint8_t rsp_id)
+{
+    bool ok = false;
+
+    if(!request || len < 2)
+    {
+        // minimum len is 2-bytes for the request class/id
+        return false;
+    }
+
+    ackExpected = false;
+    rspExpected = false;
+    ackReceived = false;
+    nakReceived = false;
+    rspReceived = false;
+    rxTimeout   = false;
+
+    waitForReqClass = request->msg_class;
+    waitForReqId = request->msg_id;
+
+    if(flags & UBX_REQ_FLAGS_EXPECT_ACK)
     {
         ackExpected = true;
     }
@@ -1532,6 +2346,231 @@ bool ubloxGPS::requestSendUBX(const ubx_msg_t *request,
     return ok;
 }
 
+int ubloxGPS::requestAsync(const uint8_t *request,
+    uint16_t len,
+    uint8_t flags,
+    uint8_t rsp_class,
+    uint8_t rsp_id,
+    ubx_request_callback_t callback,
+    uint32_t timeout)
+{
+    CHECK_TRUE(request && len >= 4 && len <= UBX_ASYNC_REQUEST_MAX_LEN, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_FALSE((gpsStatus == GPS_STATUS_OFF) || (gpsStatus == GPS_STATUS_ERROR), SYSTEM_ERROR_INVALID_STATE);
+
+    int handle = SYSTEM_ERROR_LIMIT_EXCEEDED;
+    {
+        REQUEST_LOCK();
+        for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+        {
+            async_request_t &req = requests[i];
+            if(req.status == UBX_REQUEST_QUEUED || req.status == UBX_REQUEST_PENDING)
+            {
+                continue;
+            }
+            memcpy(req.request, request, len);
+            req.len = len;
+            req.flags = flags;
+            req.rsp_class = rsp_class;
+            req.rsp_id = rsp_id;
+            req.timeout = timeout;
+            req.callback = callback;
+            req.generation = (req.generation + 1) & 0x7FFF;
+            if(!req.generation)
+            {
+                req.generation = 1;
+            }
+            req.status = UBX_REQUEST_QUEUED;
+            handle = (req.generation << 8) | i;
+            break;
+        }
+    }
+
+    if(handle > 0 && tx_ready_queue)
+    {
+        // wake the GPS thread to send it
+        txReadyHandler();
+    }
+    return handle;
+}
+
+int ubloxGPS::getRequestStatus(int handle)
+{
+    size_t index = handle & 0xFF;
+    CHECK_TRUE(handle > 0 && index < UBX_ASYNC_MAX_REQUESTS, SYSTEM_ERROR_NOT_FOUND);
+
+    REQUEST_LOCK();
+    CHECK_TRUE(requests[index].generation == (handle >> 8), SYSTEM_ERROR_NOT_FOUND);
+    return requests[index].status;
+}
+
+void ubloxGPS::sendRequests()
+{
+    for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+    {
+        async_request_t &req = requests[i];
+        {
+            REQUEST_LOCK();
+            if(req.status != UBX_REQUEST_QUEUED)
+            {
+                continue;
+            }
+            req.status = UBX_REQUEST_PENDING;
+            req.sequence = request_sequence++;
+            req.sent = millis();
+        }
+
+        // the slot can't be reused while pending so it is sent without
+        // holding the request lock
+        if(!sendUBX(req.request, req.len))
+        {
+            completeRequest(i, UBX_REQUEST_SEND_ERROR, NULL);
+        }
+        else if(!(req.flags & UBX_REQ_FLAGS_EXPECT_ACK) && req.rsp_class == UBX_CLASS_INVALID)
+        {
+            completeRequest(i, UBX_REQUEST_SENT, NULL);
+        }
+    }
+}
+
+void ubloxGPS::matchRequests()
+{
+    const ubx_msg_t *msg = (const ubx_msg_t *) &ubx_rx_msg;
+    bool is_ack = (msg->msg_class == UBX_CLASS_ACK);
+    size_t match = UBX_ASYNC_MAX_REQUESTS;
+    uint8_t status = UBX_REQUEST_PENDING;
+
+    {
+        REQUEST_LOCK();
+        for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+        {
+            const async_request_t &req = requests[i];
+            if(req.status != UBX_REQUEST_PENDING)
+            {
+                continue;
+            }
+            uint8_t result;
+            if(is_ack)
+            {
+                if(msg->length != 2 || msg->payload[0] != req.request[0] || msg->payload[1] != req.request[1])
+                {
+                    continue;
+                }
+                if(msg->msg_id == UBX_ACK_NAK)
+                {
+                    result = UBX_REQUEST_NAK;
+                }
+                else if((req.flags & UBX_REQ_FLAGS_EXPECT_ACK) && req.rsp_class == UBX_CLASS_INVALID)
+                {
+                    result = UBX_REQUEST_ACK;
+                }
+                else
+                {
+                    // the ACK that follows a CFG poll response
+                    continue;
+                }
+            }
+            else if(req.rsp_class == msg->msg_class && (req.rsp_id == UBX_ID_INVALID || req.rsp_id == msg->msg_id))
+            {
+                result = UBX_REQUEST_RESPONSE;
+            }
+            else
+            {
+                continue;
+            }
+
+            // the module replies in order so the oldest match is the one
+            if(match == UBX_ASYNC_MAX_REQUESTS || (int32_t)(req.sequence - requests[match].sequence) < 0)
+            {
+                match = i;
+                status = result;
+            }
+        }
+    }
+
+    if(match < UBX_ASYNC_MAX_REQUESTS)
+    {
+        completeRequest(match, status, msg);
+    }
+}
+
+void ubloxGPS::expireRequests()
+{
+    for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+    {
+        bool expired;
+        {
+            REQUEST_LOCK();
+            expired = (requests[i].status == UBX_REQUEST_PENDING) && (millis() - requests[i].sent >= requests[i].timeout);
+        }
+        if(expired)
+        {
+            perf_counts.timeouts++;
+            completeRequest(i, UBX_REQUEST_TIMEOUT, NULL);
+        }
+    }
+}
+
+void ubloxGPS::cancelRequests()
+{
+    for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+    {
+        completeRequest(i, UBX_REQUEST_CANCELLED, NULL);
+    }
+}
+
+void ubloxGPS::completeRequest(size_t index, uint8_t status, const ubx_msg_t *rsp)
+{
+    ubx_request_callback_t callback;
+    int handle;
+    {
+        REQUEST_LOCK();
+        async_request_t &req = requests[index];
+        if(req.status != UBX_REQUEST_QUEUED && req.status != UBX_REQUEST_PENDING)
+        {
+            return;
+        }
+        req.status = status;
+        callback = std::move(req.callback);
+        req.callback = nullptr;
+        handle = (req.generation << 8) | index;
+    }
+
+    if(callback)
+    {
+        callback(handle, (ubx_request_status_t)status, rsp);
+    }
+}
+
+// time until the GPS thread next needs to service requests
+uint32_t ubloxGPS::requestYieldTimeout()
+{
+    uint32_t timeout = UBX_MAX_POLL_INTERVAL_MS;
+    uint32_t now = millis();
+
+    // serviceGPS() does nothing while the module is off, requests left then
+    // are cancelled by off() or a failed on() rather than serviced
+    if((gpsStatus == GPS_STATUS_OFF) || (gpsStatus == GPS_STATUS_ERROR))
+    {
+        return timeout;
+    }
+
+    REQUEST_LOCK();
+    for(size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++)
+    {
+        const async_request_t &req = requests[i];
+        if(req.status == UBX_REQUEST_QUEUED)
+        {
+            return 0;
+        }
+        if(req.status == UBX_REQUEST_PENDING)
+        {
+            uint32_t elapsed = now - req.sent;
+            timeout = std::min(timeout, (elapsed < req.timeout) ? (req.timeout - elapsed) : 0);
+        }
+    }
+    return timeout;
+}
+
 void ubloxGPS::processBytes()
 {
     // track if waiting on expected frame on entry
@@ -1539,11 +2578,30 @@ void ubloxGPS::processBytes()
     bool _waiting = checkWaitingForAckOrRspFlags();
     bool bytes_available = false;
 
+    // bytes are received into a chunk buffer and parsed a span at a time, any
+    // unparsed remainder after breaking out on an expected frame is resumed
+    // on the next call
     if(isInterfaceUart())
     {
-        while (serial->available() > 0)
+        while (true)
         {
-            processGPSByte(serial->read());
+            if(rx_chunk_offset >= rx_chunk_len)
+            {
+                // fully parsed last chunk, drain the serial FIFO into a new one
+                rx_chunk_offset = 0;
+                rx_chunk_len = 0;
+                while (rx_chunk_len < UBX_RX_CHUNK_LEN && serial->available() > 0)
+                {
+                    rx_chunk[0][rx_chunk_len++] = serial->read();
+                }
+                if(!rx_chunk_len)
+                {
+                    break;
+                }
+            }
+
+            rx_chunk_offset += processGPSBytes(rx_chunk[0] + rx_chunk_offset, rx_chunk_len - rx_chunk_offset, _waiting);
+
             if(_waiting && !checkWaitingForAckOrRspFlags())
             {
                 // break out if got an an expected frame to prevent overwrite
@@ -1551,54 +2609,37 @@ void ubloxGPS::processBytes()
             }
         }
 
-        bytes_available = serial->available();
+        bytes_available = (rx_chunk_offset < rx_chunk_len) || serial->available();
     }
     else
     {
-        // when receiving SPI bytes process in small chunks via a small static
-        // buffer to speed up operation and allow resuming parse after breaking
-        // out on expected frame
-        static uint8_t rx_buf[32];
-        static unsigned int rx_buf_offset = sizeof(rx_buf);
-
-        // for each chunk track if received any non 0xFF null bytes to decide
-        // if should immediately continue parsing next chunk or break out
-        static bool got_data = false;
-
-        do
+        // the module clocks out 0xFF filler when it has nothing to send so
+        // keep reading while it signals more data on the tx ready line, or
+        // until a chunk of only filler before tx ready has been configured
+        spi_got_data = true;
+        while (true)
         {
-            if(rx_buf_offset >= sizeof(rx_buf))
+            if(rx_chunk_offset >= rx_chunk_len)
             {
-                // fully parsed last chunk, receive a new one
-                spi->beginTransaction(spi_settings);
-                spi_select(true);
-                spi->transfer(NULL, rx_buf, sizeof(rx_buf), NULL);
-                spi_select(false);
-                spi->endTransaction();
-                rx_buf_offset = 0;
-                got_data = false;
-            }
-
-            for(;rx_buf_offset < sizeof(rx_buf); rx_buf_offset++)
-            {
-                if(rx_buf[rx_buf_offset] != 0xFF)
+                if(!spiNextChunk())
                 {
-                    got_data = true;
+                    break;
                 }
+            }
 
-                processGPSByte(rx_buf[rx_buf_offset]);
+            rx_chunk_offset += processGPSBytes(rx_chunk[rx_chunk_index] + rx_chunk_offset, rx_chunk_len - rx_chunk_offset, _waiting);
 
-                if(_waiting && !checkWaitingForAckOrRspFlags())
-                {
-                    // break out if got an an expected frame to prevent overwrite
-                    goto break_spi;
-                }
+            if(_waiting && !checkWaitingForAckOrRspFlags())
+            {
+                // break out if got an an expected frame to prevent overwrite
+                break;
             }
-        } while(got_data);
-break_spi: // break out of nested SPI receive
-        // possible to break out with data still remaining so assume if we got
-        // any bytes off of the SPI port then there might be more
-        bytes_available = got_data;
+        }
+
+        // never hold the bus between calls, a chunk received in the
+        // background is kept and parsed on the next call
+        spiFinishChunk();
+        bytes_available = (rx_chunk_offset < rx_chunk_len) || spi_chunk_ready || spiDataPending();
     }
 
     if(tx_ready_queue && bytes_available)
@@ -1608,6 +2649,104 @@ break_spi: // break out of nested SPI receive
     }
 }
 
+bool ubloxGPS::spiDataPending()
+{
+    // a chunk of only filler means nothing is pending whatever the tx ready
+    // line says, it may not be driven by the module yet
+    if(!spi_got_data)
+    {
+        return false;
+    }
+    if(spi_tx_ready_enabled)
+    {
+        // configured active low
+        return digitalRead(tx_ready_mcu_pin) == LOW;
+    }
+    return true;
+}
+
+void ubloxGPS::spiStartChunk()
+{
+    // receive into the chunk that isn't being parsed, completion is waited
+    // on in spiFinishChunk()
+    spi->beginTransaction(spi_settings);
+    spi_select(true);
+    spi_dma_pending = true;
+    spi->transfer(NULL, rx_chunk[rx_chunk_index ^ 1], UBX_SPI_CHUNK_LEN, (spi_dma_queue) ? spiDmaComplete : NULL);
+}
+
+void ubloxGPS::spiFinishChunk()
+{
+    if(!spi_dma_pending)
+    {
+        return;
+    }
+
+    uint8_t dummy;
+    if(spi_dma_queue && os_queue_take(spi_dma_queue, &dummy, UBX_SPI_DMA_TIMEOUT_MS, nullptr))
+    {
+        // transfer never completed so drop whatever was received, also
+        // consume a completion that may have raced with the cancel
+        spi->transferCancel();
+        os_queue_take(spi_dma_queue, &dummy, 0, nullptr);
+        memset(rx_chunk[rx_chunk_index ^ 1], UBX_SPI_FILLER, UBX_SPI_CHUNK_LEN);
+        if(log_enabled) Loglib.warn("SPI transfer timeout");
+    }
+    spi_select(false);
+    spi->endTransaction();
+    spi_dma_pending = false;
+    spi_chunk_ready = true;
+}
+
+// switch parsing to the next received SPI chunk, receiving it first if not
+// already in the background
+// will return FALSE if there is nothing more to receive
+bool ubloxGPS::spiNextChunk()
+{
+    if(!spi_dma_pending && !spi_chunk_ready)
+    {
+        if(!spiDataPending())
+        {
+            return false;
+        }
+        spiStartChunk();
+    }
+    spiFinishChunk();
+
+    rx_chunk_index ^= 1;
+    spi_chunk_ready = false;
+    rx_chunk_offset = 0;
+    rx_chunk_len = UBX_SPI_CHUNK_LEN;
+
+    const uint8_t *chunk = rx_chunk[rx_chunk_index];
+    spi_got_data = false;
+    for(unsigned int i = 0; i < rx_chunk_len; i++)
+    {
+        if(chunk[i] != UBX_SPI_FILLER)
+        {
+            spi_got_data = true;
+            break;
+        }
+    }
+
+    // leading filler can't be part of a frame while the UBX decoder is idle
+    // so strip it without parsing
+    if(decodeStateHandler == &ubloxGPS::stateSync1)
+    {
+        while(rx_chunk_offset < rx_chunk_len && chunk[rx_chunk_offset] == UBX_SPI_FILLER)
+        {
+            rx_chunk_offset++;
+        }
+    }
+
+    // clock in the next chunk while this one is parsed
+    if(spiDataPending())
+    {
+        spiStartChunk();
+    }
+    return true;
+}
+
 // wait for additional data either by capturing a tx ready event or fixed delay
 // for polling
 // will return TRUE if returned based on tx ready event or FALSE otherwise
@@ -1765,10 +2904,7 @@ size_t ubloxGPS::writeBytes(const uint8_t *tx_buf, size_t len)
             spi->transfer((void *) (tx_buf + i), rx_buf, _len, NULL);
             spi_select(false);
             spi->endTransaction();
-            for(int j=0; j < _len; j++)
-            {
-                processGPSByte(rx_buf[j]);
-            }
+            processGPSBytes(rx_buf, _len);
         }
         return len;
     }
@@ -2020,6 +3156,12 @@ bool ubloxGPS::getLogInfo(ubx_log_info_rsp_t *info)
     }
 }
 
+int ubloxGPS::getLogInfoAsync(ubx_request_callback_t callback)
+{
+    uint8_t sentences[4] = { (uint8_t)UBX_CLASS_LOG, (uint8_t)UBX_LOG_INFO, 0x00, 0x00 };
+    return requestAsync(sentences, sizeof(sentences), 0x00, UBX_CLASS_LOG, UBX_LOG_INFO, callback);
+}
+
 bool ubloxGPS::addLogString(uint8_t *bytes, uint16_t length)
 {
     union {
@@ -2083,6 +3225,101 @@ const ubx_msg_t *ubloxGPS::getLogEntry(uint32_t start)
     }
 }
 
+int ubloxGPS::beginLogRetrieval(ubx_log_retrieval_t &retrieval, uint32_t start, uint32_t count)
+{
+    ubx_log_info_rsp_t info = {};
+    CHECK_TRUE(getLogInfo(&info), SYSTEM_ERROR_IO);
+
+    retrieval = {};
+    retrieval.next_index = std::min(start, info.entry_count);
+    retrieval.end_index = retrieval.next_index + std::min(count, info.entry_count - retrieval.next_index);
+    return SYSTEM_ERROR_NONE;
+}
+
+int ubloxGPS::retrieveLog(ubx_log_retrieval_t &retrieval, ubx_log_ring_t &ring)
+{
+    ubx_log_retrieve_t msg = {
+        UBX_CLASS_LOG,
+        UBX_LOG_RETRIEVE,
+        sizeof(ubx_log_retrieve_t) - offsetof(ubx_msg_t, payload),
+    };
+    LOCK();
+
+    CHECK_FALSE((gpsStatus == GPS_STATUS_OFF) || (gpsStatus == GPS_STATUS_ERROR), SYSTEM_ERROR_INVALID_STATE);
+
+    uint32_t t0 = millis();
+    uint32_t retrieved = retrieval.retrieved;
+    log_retrieval = &retrieval;
+    log_ring = &ring;
+    NAMED_SCOPE_GUARD(guard, {
+        log_retrieval = nullptr;
+        log_ring = nullptr;
+        retrieval.elapsed += millis() - t0;
+    });
+
+    bool stalled = false;
+    unsigned attempts = 0;
+    while(!retrieval.done() && !stalled)
+    {
+        uint32_t count = std::min({retrieval.end_index - retrieval.next_index,
+            (uint32_t)ring.space(), (uint32_t)UBX_LOG_RETRIEVE_ENTRY_COUNT_MAX});
+        if(!count)
+        {
+            break;
+        }
+
+        msg.start_number = retrieval.next_index;
+        msg.entry_count = count;
+        msg.version = 0;
+        log_range_end = retrieval.next_index + count;
+        log_range_done = false;
+        log_range_seen = false;
+        if(!sendUBX((const uint8_t *) &msg, sizeof(msg)))
+        {
+            break;
+        }
+        lastUbxMsgSent = millis();
+        retrieval.requests++;
+
+        // entries are streamed back to back, give up on the range once the
+        // module has been quiet for a full response timeout
+        uint32_t start_index = retrieval.next_index;
+        uint32_t progress_index = start_index;
+        uint32_t last_progress = millis();
+        while(retrieval.next_index < log_range_end && !log_range_done)
+        {
+            processBytes();
+            if(retrieval.next_index != progress_index)
+            {
+                progress_index = retrieval.next_index;
+                last_progress = millis();
+                continue;
+            }
+
+            uint32_t quiet = millis() - last_progress;
+            if(quiet > UBX_MSG_TIMEOUT)
+            {
+                perf_counts.timeouts++;
+                decodeStateHandler = &ubloxGPS::stateSync1;
+                break;
+            }
+            yieldThread(UBX_MSG_TIMEOUT - quiet);
+        }
+
+        // a module that returns nothing is not asked again, one that keeps
+        // losing the same entry is given a few attempts
+        attempts = (retrieval.next_index == start_index) ? attempts + 1 : 0;
+        stalled = !log_range_seen || attempts >= UBX_LOG_RETRIEVE_ATTEMPTS;
+        if(!retrieval.done() && !stalled && retrieval.next_index < log_range_end)
+        {
+            retrieval.retries++;
+        }
+    }
+
+    uint32_t pushed = retrieval.retrieved - retrieved;
+    return (stalled && !pushed) ? SYSTEM_ERROR_TIMEOUT : (int) pushed;
+}
+
 // prepares for a new write MGA sequence OR returns an appropriate error
 bool ubloxGPS::startWriteMGA()
 {
@@ -2188,3 +3425,251 @@ ubx_mga_flash_ack_type_t ubloxGPS::writeMGA(uint8_t *bytes, uint16_t length)
 
     return UBX_MGA_FLASH_DATA_ACK_TIMEOUT;
 }
+
+int ubloxGPS::injectMGA(const char *path,
+    ubx_mga_inject_mode_t mode,
+    size_t window,
+    ubx_mga_progress_callback_t progress)
+{
+    CHECK_TRUE(path && window >= 1 && window <= UBX_MGA_INJECT_WINDOW_MAX, SYSTEM_ERROR_INVALID_ARGUMENT);
+    if(mode == UBX_MGA_INJECT_FLASH)
+    {
+        // the MGA-FLASH sequence requires each block to be acknowledged
+        // before the next is sent
+        window = 1;
+    }
+    LOCK();
+    CHECK_FALSE((gpsStatus == GPS_STATUS_OFF) || (gpsStatus == GPS_STATUS_ERROR), SYSTEM_ERROR_INVALID_STATE);
+    CHECK_FALSE(write_mga_active, SYSTEM_ERROR_BUSY);
+
+    int fd = open(path, O_RDONLY);
+    CHECK_TRUE(fd >= 0, SYSTEM_ERROR_FILE);
+    struct stat st;
+    if(fstat(fd, &st))
+    {
+        close(fd);
+        return SYSTEM_ERROR_FILE;
+    }
+
+    uint32_t t0 = millis();
+    mga_result = {};
+    mga_result.total_bytes = st.st_size;
+    NAMED_SCOPE_GUARD(guard, {
+        close(fd);
+        mga_injecting = false;
+        write_mga_active = false;
+        write_mga_sequence = 0;
+        mga_result.elapsed = millis() - t0;
+    });
+
+    if(mode == UBX_MGA_INJECT_DIRECT)
+    {
+        // only ackAiding is applied, mask1 leaves the other settings alone
+        uint8_t navx5[4 + 40] = { UBX_CLASS_CFG, UBX_CFG_NAVX5, 40, 0x00 };
+        navx5[4 + 0] = 0x02; // version
+        navx5[4 + 2] = 0x00;
+        navx5[4 + 3] = 0x04; // mask1 ackAid
+        navx5[4 + 17] = 0x01; // ackAiding
+        const ubx_msg_t *rsp = NULL;
+        if(requestSendUBX((const ubx_msg_t *) navx5, sizeof(navx5), UBX_REQ_FLAGS_EXPECT_ACK))
+        {
+            rsp = getResponse();
+        }
+        CHECK_TRUE(isACK(rsp), SYSTEM_ERROR_IO);
+    }
+    else
+    {
+        write_mga_active = true;
+        write_mga_sequence = 0;
+    }
+
+    mga_injecting = true;
+    mga_mode = mode;
+    mga_first = 0;
+    mga_outstanding = 0;
+    mga_next_offset = 0;
+    mga_aborted = false;
+
+    size_t reported = 0;
+    while(true)
+    {
+        while(mga_outstanding < window && mga_next_offset < mga_result.total_bytes)
+        {
+            int ret = sendMgaUnit(fd);
+            if(ret != SYSTEM_ERROR_NONE)
+            {
+                return ret;
+            }
+        }
+        if(!mga_outstanding)
+        {
+            break;
+        }
+
+        processBytes();
+        if(mga_aborted)
+        {
+            return SYSTEM_ERROR_ABORTED;
+        }
+        if(mga_result.acked != reported)
+        {
+            reported = mga_result.acked;
+            if(progress)
+            {
+                mga_result.elapsed = millis() - t0;
+                progress(mga_result);
+            }
+            continue;
+        }
+        if(!mga_outstanding)
+        {
+            // a flash retry rewound the window
+            continue;
+        }
+
+        uint32_t quiet = millis() - mga_units[mga_first].sent;
+        if(quiet > UBX_MSG_TIMEOUT)
+        {
+            perf_counts.timeouts++;
+            decodeStateHandler = &ubloxGPS::stateSync1;
+            return SYSTEM_ERROR_TIMEOUT;
+        }
+        yieldThread(UBX_MSG_TIMEOUT - quiet);
+    }
+
+    mga_injecting = false;
+    if(mode == UBX_MGA_INJECT_FLASH)
+    {
+        CHECK_TRUE(stopWriteMGA(), SYSTEM_ERROR_IO);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+// Read the unit at mga_next_offset from the blob, send it and add it to the
+// outstanding window. Direct units are whole MGA messages, flash units are up
+// to UBX_MGA_FLASH_DATA_MAX_LEN bytes of the blob.
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+int ubloxGPS::sendMgaUnit(int fd)
+{
+    union {
+        ubx_mga_flash_write_t header;
+        uint8_t bytes[sizeof(ubx_mga_flash_write_t) + UBX_RX_MSG_MAX_LEN + 2];
+    } __attribute__((packed)) msg;
+    mga_unit_t &unit = mga_units[(mga_first + mga_outstanding) % UBX_MGA_INJECT_WINDOW_MAX];
+
+    CHECK_TRUE(lseek(fd, mga_next_offset, SEEK_SET) == (off_t) mga_next_offset, SYSTEM_ERROR_FILE);
+    unit = {};
+    unit.offset = mga_next_offset;
+
+    uint16_t len;
+    if(mga_mode == UBX_MGA_INJECT_DIRECT)
+    {
+        // sync, class, id, length, then payload and checksum
+        uint8_t sync[2];
+        CHECK_TRUE(read(fd, sync, sizeof(sync)) == sizeof(sync), SYSTEM_ERROR_BAD_DATA);
+        CHECK_TRUE(sync[0] == SYNC_1 && sync[1] == SYNC_2, SYSTEM_ERROR_BAD_DATA);
+        CHECK_TRUE(read(fd, msg.bytes, 4) == 4, SYSTEM_ERROR_BAD_DATA);
+        len = msg.bytes[2] | (msg.bytes[3] << 8);
+        CHECK_TRUE(msg.bytes[0] == UBX_CLASS_MGA && len <= UBX_RX_MSG_MAX_LEN, SYSTEM_ERROR_BAD_DATA);
+        CHECK_TRUE(read(fd, &msg.bytes[4], len + 2) == len + 2, SYSTEM_ERROR_BAD_DATA);
+
+        uint8_t crc_a = 0, crc_b = 0;
+        for(size_t i = 0; i < 4u + len; i++)
+        {
+            crc_a += msg.bytes[i];
+            crc_b += crc_a;
+        }
+        CHECK_TRUE(msg.bytes[4 + len] == crc_a && msg.bytes[5 + len] == crc_b, SYSTEM_ERROR_BAD_DATA);
+
+        unit.len = len + 8;
+        unit.msg_id = msg.bytes[1];
+        memcpy(unit.payload_start, &msg.bytes[4], std::min(len, (uint16_t) sizeof(unit.payload_start)));
+        len += 4;
+    }
+    else
+    {
+        uint16_t size = std::min(mga_result.total_bytes - mga_next_offset, UBX_MGA_FLASH_DATA_MAX_LEN);
+        CHECK_TRUE(read(fd, msg.header.data, size) == size, SYSTEM_ERROR_FILE);
+
+        msg.header.msg_class = UBX_CLASS_MGA;
+        msg.header.msg_id = UBX_MGA_FLASH_DATA;
+        msg.header.length = size + offsetof(ubx_mga_flash_write_t, data) - offsetof(ubx_msg_t, payload);
+        msg.header.msg_type = UBX_MGA_FLASH_DATA_WRITE;
+        msg.header.version = 0x00;
+        msg.header.sequence = write_mga_sequence++;
+        msg.header.size = size;
+
+        unit.len = size;
+        unit.sequence = msg.header.sequence;
+        len = sizeof(msg.header) + size;
+    }
+
+    CHECK_TRUE(sendUBX(msg.bytes, len), SYSTEM_ERROR_IO);
+    lastUbxMsgSent = unit.sent = millis();
+    mga_next_offset += unit.len;
+    mga_outstanding++;
+    return SYSTEM_ERROR_NONE;
+}
+
+// The module handles MGA input in order so each ACK is for the oldest unit
+// outstanding, any other ACK is left over from units already given up on.
+// MUST BE CALLED WITH GPS LOCK ALREADY HELD
+void ubloxGPS::processMgaAck()
+{
+    if(!mga_injecting || !mga_outstanding)
+    {
+        return;
+    }
+
+    mga_unit_t &unit = mga_units[mga_first];
+    if(mga_mode == UBX_MGA_INJECT_DIRECT &&
+        ubx_rx_msg.msg_id == UBX_MGA_ACK_DATA0 &&
+        ubx_rx_msg.length >= sizeof(ubx_mga_ack_t) - offsetof(ubx_msg_t, payload))
+    {
+        ubx_mga_ack_t ack;
+        memcpy(&ack, &ubx_rx_msg, sizeof(ack));
+        if(ack.ack_msg_id != unit.msg_id || memcmp(ack.payload_start, unit.payload_start, sizeof(unit.payload_start)))
+        {
+            return;
+        }
+        if(ack.type != UBX_MGA_ACK_ACCEPTED)
+        {
+            mga_result.rejected++;
+        }
+    }
+    else if(mga_mode == UBX_MGA_INJECT_FLASH &&
+        ubx_rx_msg.msg_id == UBX_MGA_FLASH_DATA &&
+        ubx_rx_msg.length >= sizeof(ubx_mga_flash_ack_t) - offsetof(ubx_msg_t, payload) &&
+        ubx_rx_msg.ubx_msg[0] == UBX_MGA_FLASH_DATA_ACK)
+    {
+        ubx_mga_flash_ack_t ack;
+        memcpy(&ack, &ubx_rx_msg, sizeof(ack));
+        if(ack.sequence != unit.sequence)
+        {
+            return;
+        }
+        if(ack.ack == UBX_MGA_FLASH_DATA_ACK_RETRY)
+        {
+            // send this block again, it is the only one outstanding
+            mga_next_offset = unit.offset;
+            write_mga_sequence = unit.sequence;
+            mga_outstanding = 0;
+            mga_result.retries++;
+            return;
+        }
+        if(ack.ack != UBX_MGA_FLASH_DATA_ACK_OK)
+        {
+            mga_aborted = true;
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    mga_result.acked++;
+    mga_result.acked_bytes += unit.len;
+    mga_first = (mga_first + 1) % UBX_MGA_INJECT_WINDOW_MAX;
+    mga_outstanding--;
+}
@@ -16,12 +16,24 @@
 #ifndef __UBLOXGPS_H
 #define __UBLOXGPS_H
 
+#include <cmath>
+
 #include "Particle.h"
 #include "gps/gps.h" // the nmea parser
+#include "SeqLock.h"
+#include "SpscRing.h"
 
 const uint16_t UBX_RX_MSG_MAX_LEN = 512;
 const uint16_t UBX_LOG_STRING_MAX_LEN = 256;
 const size_t UBX_MGA_FLASH_DATA_MAX_LEN = 512;
+const size_t UBX_CFG_TRANSACTION_MAX_COMMANDS = 32;
+const size_t UBX_CFG_TRANSACTION_MAX_LEN = 512;
+const size_t UBX_ASYNC_MAX_REQUESTS = 4;
+const size_t UBX_ASYNC_REQUEST_MAX_LEN = 64;
+const uint32_t UBX_ASYNC_REQUEST_TIMEOUT_MS = 3000;
+const uint16_t UBX_LOG_ENTRY_STRING_MAX_LEN = 64;
+const size_t UBX_MGA_INJECT_WINDOW_MAX = 16;
+const size_t UBX_MGA_INJECT_WINDOW_DEFAULT = 8;
 
 typedef enum {
     UBX_CLASS_NAV      = 0x01,  // Navigation Results Messages: Position, Speed, Time, Acceleration, Heading, DOP, SVs used
@@ -95,6 +107,7 @@ typedef enum {
     UBX_LOG_FINDTIME         = 0x0E, // Find index of a log entry based on a given time
     UBX_LOG_RETRIEVEPOSEXTRA = 0x0F, // Odometer log entry
     UBX_MGA_FLASH_DATA       = 0x21, // Transfer MGA-ANO data block to flash
+    UBX_MGA_ACK_DATA0        = 0x60, // Multiple GNSS Acknowledge message
     UBX_MON_VER              = 0x04, // Receiver/Software Version
     UBX_NAV_AOPSTATUS        = 0x60, // AssistNow Autonomous Status
     UBX_NAV_ATT              = 0x05, // Attitude Solution
@@ -158,6 +171,16 @@ typedef enum { // ack types for UBX_MGA_FLASH_DATA_ACK
     UBX_MGA_FLASH_DATA_ACK_INVALID = -2,
 } ubx_mga_flash_ack_type_t;
 
+typedef enum { // where injectMGA() loads assistance data
+    UBX_MGA_INJECT_DIRECT          = 0x00, // blob of MGA messages loaded to receiver RAM, AssistNow Online or Offline
+    UBX_MGA_INJECT_FLASH           = 0x01, // AssistNow Offline blob stored to receiver flash with MGA-FLASH-DATA
+} ubx_mga_inject_mode_t;
+
+typedef enum { // type of MGA-ACK-DATA0
+    UBX_MGA_ACK_NOT_USED           = 0x00,
+    UBX_MGA_ACK_ACCEPTED           = 0x01,
+} ubx_mga_ack_type_t;
+
 typedef enum { // antenna type
     UBX_INTERNAL_ANT = 0x00,
     UBX_EXTERNAL_ANT = 0x01
@@ -251,6 +274,18 @@ enum {
     HEADER_LENGTH_MSB_OFFSET // 3
 };
 
+#define UBX_GEOFENCE_MAX                (4)
+#define UBX_GEOFENCE_PIO_LOW_INSIDE     (0)
+#define UBX_GEOFENCE_PIO_LOW_OUTSIDE    (1)
+#define UBX_GEOFENCE_POLL_INTERVAL      (250)   // ms between NAV-GEOFENCE polls
+#define UBX_NAV_EPOCH_DEFAULT           (1000)  // ms between navigation epochs at the module's default rate
+
+typedef enum { // NAV-GEOFENCE fence and combined states
+    UBX_GEOFENCE_STATE_UNKNOWN = 0,
+    UBX_GEOFENCE_STATE_INSIDE  = 1,
+    UBX_GEOFENCE_STATE_OUTSIDE = 2,
+} ubx_geofence_state_t;
+
 struct ubx_geofence_t {
     uint8_t  numFences   = 0;   // limit to 4, must be <=4
     uint8_t  confLvl     = 0;   // 0=no confidence required, 1=68%, 2=95%, 3=99.7% etc.
@@ -268,17 +303,19 @@ struct ubx_geofence_t {
         pioEnabled  = 0;
         pinPolarity = 0;
         pinNumber   = 0;
-        lat[4]      = {0};
-        lon[4]      = {0};
-        rad[4]      = {0};
+        memset(lat, 0, sizeof(lat));
+        memset(lon, 0, sizeof(lon));
+        memset(rad, 0, sizeof(rad));
     }
 
-    bool addGeofence(float latitude, float longitude, float radius)
+    // degrees and meters are rounded to the nearest step of the scaling so
+    // that a center given in doubles doesn't move by up to 1e-7 degrees
+    bool addGeofence(double latitude, double longitude, double radius)
     {
-        if (numFences < 4) {
-            lat[numFences] = (int32_t)(latitude * 1e7);
-            lon[numFences] = (int32_t)(longitude * 1e7);
-            rad[numFences] = (uint32_t)(radius * 1e2);
+        if (numFences < UBX_GEOFENCE_MAX) {
+            lat[numFences] = (int32_t)lround(latitude * 1e7);
+            lon[numFences] = (int32_t)lround(longitude * 1e7);
+            rad[numFences] = (uint32_t)lround(radius * 1e2);
             numFences++;
             return true;
         } else {
@@ -302,6 +339,21 @@ struct ubx_geofence_t {
 
 } __attribute__((packed)) ;
 
+struct ubx_nav_geofence_t {
+    uint32_t iTOW;          // ms, GPS time of week of the navigation epoch
+    uint8_t  version;
+    uint8_t  status;        // 0 = not available or not reliable, 1 = active
+    uint8_t  num_fences;
+    uint8_t  comb_state;    // ubx_geofence_state_t, inside if inside any fence
+    struct {
+        uint8_t state;      // ubx_geofence_state_t
+        uint8_t id;
+    } __attribute__((packed)) fences[UBX_GEOFENCE_MAX];
+
+    bool active() const { return status == 1; }
+    bool known() const { return active() && comb_state != UBX_GEOFENCE_STATE_UNKNOWN; }
+} __attribute__((packed));
+
 struct ubx_msg_header_t {
     uint8_t msg_class;
     uint8_t msg_id;
@@ -360,6 +412,66 @@ struct  ubx_nav_odo_t {
     bool     valid;
 };
 
+// UBX-NAV-PVT payload
+struct ubx_nav_pvt_t {
+    uint32_t iTOW;          // ms, GPS time of week of the navigation epoch
+    uint16_t year;          // UTC year
+    uint8_t  month;         // UTC month, 1..12
+    uint8_t  day;           // UTC day of month, 1..31
+    uint8_t  hour;          // UTC hour, 0..23
+    uint8_t  min;           // UTC minute, 0..59
+    uint8_t  sec;           // UTC second, 0..60
+    uint8_t  valid;         // validity flags, see UBX_NAV_PVT_VALID_*
+    uint32_t tAcc;          // ns, time accuracy estimate
+    int32_t  nano;          // ns, fraction of second
+    uint8_t  fixType;       // GNSS fix type, see UBX_NAV_PVT_FIX_*
+    uint8_t  flags;         // fix status flags, see UBX_NAV_PVT_FLAGS_*
+    uint8_t  flags2;        // additional flags
+    uint8_t  numSV;         // number of satellites used in the nav solution
+    int32_t  lon;           // 1e-7 deg, longitude
+    int32_t  lat;           // 1e-7 deg, latitude
+    int32_t  height;        // mm, height above ellipsoid
+    int32_t  hMSL;          // mm, height above mean sea level
+    uint32_t hAcc;          // mm, horizontal accuracy estimate
+    uint32_t vAcc;          // mm, vertical accuracy estimate
+    int32_t  velN;          // mm/s, NED north velocity
+    int32_t  velE;          // mm/s, NED east velocity
+    int32_t  velD;          // mm/s, NED down velocity
+    int32_t  gSpeed;        // mm/s, ground speed (2-D)
+    int32_t  headMot;       // 1e-5 deg, heading of motion (2-D)
+    uint32_t sAcc;          // mm/s, speed accuracy estimate
+    uint32_t headAcc;       // 1e-5 deg, heading accuracy estimate
+    uint16_t pDOP;          // 0.01, position DOP
+    uint8_t  flags3;        // additional flags
+    uint8_t  reserved1[5];
+    int32_t  headVeh;       // 1e-5 deg, heading of vehicle (2-D)
+    int16_t  magDec;        // 1e-2 deg, magnetic declination
+    uint16_t magAcc;        // 1e-2 deg, magnetic declination accuracy
+} __attribute__((packed));
+
+#define UBX_NAV_PVT_VALID_DATE          (0x01)
+#define UBX_NAV_PVT_VALID_TIME          (0x02)
+#define UBX_NAV_PVT_FLAGS_GNSS_FIX_OK   (0x01)
+#define UBX_NAV_PVT_FLAGS_DIFF_SOLN     (0x02)
+#define UBX_NAV_PVT_FIX_NONE            (0)
+#define UBX_NAV_PVT_FIX_DR              (1)
+#define UBX_NAV_PVT_FIX_2D              (2)
+#define UBX_NAV_PVT_FIX_3D              (3)
+#define UBX_NAV_PVT_FIX_GNSS_DR         (4)
+#define UBX_NAV_PVT_FIX_TIME            (5)
+
+// UBX-NAV-DOP payload, all DOP values scaled by 0.01
+struct ubx_nav_dop_t {
+    uint32_t iTOW;          // ms, GPS time of week of the navigation epoch
+    uint16_t gDOP;
+    uint16_t pDOP;
+    uint16_t tDOP;
+    uint16_t vDOP;
+    uint16_t hDOP;
+    uint16_t nDOP;
+    uint16_t eDOP;
+} __attribute__((packed));
+
 struct ubx_ack_t {
     uint8_t msg_class;
     uint8_t msg_id;
@@ -561,6 +673,45 @@ struct ubx_log_string_t {
     uint8_t bytes[];
 } __attribute((packed));
 
+// Log entry decoded from LOG-RETRIEVEPOS, LOG-RETRIEVEPOSEXTRA or
+// LOG-RETRIEVESTRING, fields not carried by the entry type are zero
+struct ubx_log_entry_t {
+    uint32_t index;
+    uint8_t type; // UBX_LOG_RETRIEVEPOS, UBX_LOG_RETRIEVEPOSEXTRA or UBX_LOG_RETRIEVESTRING
+    uint8_t fix; // UBX_LOG_POS_FIX_*
+    uint8_t num_satellites;
+    uint16_t year;
+    uint8_t month; // 1-12
+    uint8_t day; // 1-31
+    uint8_t hour; // 0-23
+    uint8_t minute; // 0-59
+    uint8_t second; // 0-60
+    int32_t lon; // mult 1e-7 to decimal
+    int32_t lat; // mult 1e-7 to decimal
+    int32_t alt; // mm above mean sea level
+    uint32_t horizontal_accuracy; // mm
+    uint32_t ground_speed; // mm/s
+    uint32_t heading; // deg, mult 1e-5
+    uint32_t distance; // m, odometer entries
+    uint16_t byte_count; // length of the logged string, only the first UBX_LOG_ENTRY_STRING_MAX_LEN bytes are kept
+    uint8_t bytes[UBX_LOG_ENTRY_STRING_MAX_LEN];
+};
+
+typedef SpscRing<ubx_log_entry_t> ubx_log_ring_t;
+
+// Progress of a bulk log retrieval, kept by the caller so that an interrupted
+// retrieval resumes where it stopped
+struct ubx_log_retrieval_t {
+    uint32_t next_index; // first entry not yet retrieved
+    uint32_t end_index; // one past the last entry to retrieve
+    uint32_t retrieved; // entries pushed to the ring
+    uint32_t requests; // LOG-RETRIEVE commands sent
+    uint32_t retries; // ranges requested again after an entry was lost
+    uint32_t elapsed; // ms spent retrieving
+
+    bool done() const { return next_index >= end_index; }
+};
+
 struct ubx_mga_flash_write_t {
     uint8_t msg_class;
     uint8_t msg_id;
@@ -591,6 +742,31 @@ struct ubx_mga_flash_ack_t {
     uint16_t sequence; // of the message for this ACK or 0xFFFF for UBX-MGA-FLASH-STOP
 } __attribute((packed));
 
+struct ubx_mga_ack_t {
+    uint8_t msg_class;
+    uint8_t msg_id;
+    uint16_t length;
+    uint8_t type; // ubx_mga_ack_type_t
+    uint8_t version;
+    uint8_t info_code; // reason the message was not used
+    uint8_t ack_msg_id; // ID of the acknowledged MGA message
+    uint8_t payload_start[4]; // first bytes of the acknowledged message payload
+} __attribute((packed));
+
+// Progress of an MGA injection, units are MGA messages or flash blocks
+struct ubx_mga_inject_result_t {
+    size_t total_bytes; // size of the blob
+    size_t acked_bytes; // blob bytes acknowledged by the receiver
+    size_t acked; // units acknowledged
+    size_t rejected; // MGA messages the receiver did not use
+    size_t retries; // flash blocks sent again on request
+    uint32_t elapsed; // ms since the injection started
+
+    uint32_t throughput() const { return elapsed ? (uint32_t)((uint64_t)acked_bytes * 1000 / elapsed) : 0; } // bytes per second
+};
+
+typedef std::function<void(const ubx_mga_inject_result_t &progress)> ubx_mga_progress_callback_t;
+
 struct ubx_mon_ver_t {
     bool    valid;
     uint8_t *sw_version;
@@ -598,6 +774,78 @@ struct ubx_mon_ver_t {
     uint8_t *extension;
 };
 
+typedef enum {
+    UBX_CFG_RESULT_PENDING = 0,     // sent or queued, no reply yet
+    UBX_CFG_RESULT_ACK,             // acknowledged
+    UBX_CFG_RESULT_NAK,             // rejected by the module
+    UBX_CFG_RESULT_TIMEOUT,         // no reply within the message timeout
+    UBX_CFG_RESULT_SEND_ERROR,      // could not be written to the module
+    UBX_CFG_RESULT_SKIPPED,         // not sent as the module kept its saved configuration
+} ubx_cfg_result_t;
+
+struct ubx_cfg_command_result_t {
+    uint8_t  msg_class;
+    uint8_t  msg_id;
+    uint8_t  result;                // ubx_cfg_result_t
+    uint32_t latency;               // ms from sending the command until its ACK/NAK
+};
+
+// Outcome of the last configuration transaction, commands are listed in the
+// order they were queued
+struct ubx_cfg_transaction_result_t {
+    size_t   count;                 // number of commands queued
+    size_t   acked;
+    size_t   naked;
+    size_t   timeouts;
+    size_t   send_errors;
+    bool     overflow;              // commands were dropped as the queue was full
+    uint32_t elapsed;               // ms from sending the first command until the last reply
+    bool     skipped;               // module kept its saved configuration, elapsed is the time to confirm it
+    ubx_cfg_command_result_t commands[UBX_CFG_TRANSACTION_MAX_COMMANDS];
+};
+
+typedef enum {
+    UBX_REQUEST_QUEUED = 0,         // waiting to be sent by the GPS thread
+    UBX_REQUEST_PENDING,            // sent, waiting for the ACK/NAK or response
+    UBX_REQUEST_SENT,               // sent, no reply expected
+    UBX_REQUEST_ACK,                // acknowledged
+    UBX_REQUEST_NAK,                // rejected by the module
+    UBX_REQUEST_RESPONSE,           // response received
+    UBX_REQUEST_TIMEOUT,            // no reply within the request timeout
+    UBX_REQUEST_SEND_ERROR,         // could not be written to the module
+    UBX_REQUEST_CANCELLED,          // module powered off before completion
+} ubx_request_status_t;
+
+// Completion of an asynchronous request, called from the GPS thread. rsp is
+// the ACK/NAK or response frame and is only valid during the call, it is
+// NULL when no frame completed the request. The GPS lock is held during the
+// call so the callback must not call back into ubloxGPS other than to make
+// another request with requestAsync() or getRequestStatus(), the blocking
+// methods would stall the GPS thread.
+typedef std::function<void(int handle, ubx_request_status_t status, const ubx_msg_t *rsp)> ubx_request_callback_t;
+
+// Consistent copy of the fix published by the GPS thread after each parsed
+// sentence or NAV-PVT solution
+struct ubx_fix_snapshot_t {
+    double   latitude;              // degrees
+    double   longitude;             // degrees
+    double   horizontalAccuracy;    // meters
+    double   verticalAccuracy;      // meters
+    double   horizontalDop;
+    double   verticalDop;
+    float    altitude;              // meters above mean sea level
+    float    speed;                 // m/s
+    float    heading;               // degrees
+    uint32_t epochTime;             // UTC seconds since epoch
+    uint32_t posTimestamp;          // uptime seconds of the position report
+    uint32_t startLockUptime;       // uptime seconds when the lock started
+    uint32_t lockedDuration;        // seconds, filled in when read
+    uint8_t  fix;                   // fix quality, see getFixQuality()
+    bool     posValid;
+    bool     locked;                // filled in when read
+    bool     stable;                // lock stability
+};
+
 constexpr ubx_dynamic_model_t UBX_DEFAULT_MODEL = UBX_DYNAMIC_MODEL_PORTABLE;
 
 enum class ubloxGpsInterface {
@@ -713,6 +961,30 @@ public:
 
     void setOutputNMEA(void);
     void setOutputPUBX(void);
+    void setOutputPVT(void);
+
+    /**
+     * @brief Select binary UBX-NAV-PVT/NAV-DOP output instead of NMEA/PUBX text
+     *
+     * Takes effect the next time the module is powered on with on(). Position,
+     * time, speed, heading, accuracy and DOP are then decoded from fixed layout
+     * UBX frames and reported through the same getters as the text outputs.
+     *
+     * @param enable Enable PVT output
+     */
+    void setPvtMode(bool enable) {
+        pvtMode = enable;
+    }
+
+    /**
+     * @brief Indicate if binary UBX-NAV-PVT output is selected
+     *
+     * @return true PVT output is selected
+     * @return false NMEA/PUBX text output is selected
+     */
+    bool getPvtMode() const {
+        return pvtMode;
+    }
     uint8_t  getGpsStatus();
 
     void setCal(void);
@@ -729,6 +1001,18 @@ public:
     float    getAltitude(void);
 
     uint8_t  getFixQuality(void);
+
+    /**
+     * @brief Get a consistent copy of the latest fix without taking the GPS lock
+     *
+     * All fields come from the same parser state so they cannot mix values
+     * from different epochs the way consecutive getter calls can. The lock
+     * state and duration are evaluated against the current uptime.
+     *
+     * @param fix Latest fix
+     */
+    void     getFix(ubx_fix_snapshot_t &fix);
+
     bool     getLock(void);
     uint32_t getLockTime(void);
     unsigned int getLockDuration(void);
@@ -844,19 +1128,39 @@ public:
      * @param txReady PIO to use for indicating that TX is ready.
      * @param threshold Threshold of multiples of 8 bytes to signal TX ready pin assertion.
      * @param spiMode SPI mode.  One of UBX_CFG_PRT_MODE_SPI_MODE_0, UBX_CFG_PRT_MODE_SPI_MODE_1, UBX_CFG_PRT_MODE_SPI_MODE_2, or UBX_CFG_PRT_MODE_SPI_MODE_3
+     * @param txReadyEnable Drive the TX ready PIO, false leaves the PIO free for other outputs.
      *
      * @retval true Configuration command sent and acknowledged successfully.
      * @retval false Configuration command failed.
      */
-    bool  setSpiMode(int txReady, int threshold, int spiMode);
+    bool  setSpiMode(int txReady, int threshold, int spiMode, bool txReadyEnable = true);
 
     bool  setAntanna(ubx_antenna_t ant);
     bool  setRate(uint16_t measRateHz);
     bool  updateEsfStatus(void);
+
+    /**
+     * @brief Request ESF-STATUS without waiting, see requestAsync()
+     *
+     * @param callback Optional completion callback
+     * @return int Request handle if positive, otherwise a system error
+     */
+    int   updateEsfStatusAsync(ubx_request_callback_t callback = nullptr);
     bool  getEsfStatus(ubx_esf_status_t &esf);
     bool  setReset(void);
     bool  resetOdometer(void);
     bool  updateOdometer(void);
+
+    /**
+     * @brief Request NAV-ODO without waiting, see requestAsync()
+     *
+     * getOdometer() returns the new values once the request completed with
+     * UBX_REQUEST_RESPONSE.
+     *
+     * @param callback Optional completion callback
+     * @return int Request handle if positive, otherwise a system error
+     */
+    int   updateOdometerAsync(ubx_request_callback_t callback = nullptr);
     bool  getOdometer(ubx_nav_odo_t &odo);
     bool  updateVersion(void);
     bool  getVersion(String& swVersion, String& hwVersion, String& extVersion);
@@ -882,13 +1186,118 @@ public:
 
     bool  setPower(ubx_power_mode_t power_mode);
     bool  setPower(ubx_power_mode_t power_mode, uint16_t period, uint16_t onTime);
+
+    /**
+     * @brief Configure the receiver's hardware geofences
+     *
+     * @param geofence Up to UBX_GEOFENCE_MAX circles, no circles clears them
+     * @retval true Configuration acknowledged (or queued inside beginConfig())
+     * @retval false Configuration failed or was rejected
+     */
     bool  setGeofence(ubx_geofence_t geofence);
+
+    /**
+     * @brief Poll the receiver's evaluation of its hardware geofences
+     *
+     * @param state Receives the NAV-GEOFENCE status
+     * @retval true State received
+     * @retval false Request failed
+     */
+    bool  getGeofenceState(ubx_nav_geofence_t& state);
+
+    /**
+     * @brief Output the combined geofence state on the TX ready PIO
+     *
+     * The receiver evaluates the fences on every navigation epoch and drives
+     * the PIO low while inside any of them, so the MCU can sleep on a pin
+     * change rather than waking to evaluate the fences itself. The PIO can
+     * only carry one signal, TX ready is disabled meanwhile and SPI reads
+     * fall back to polling until clearGeofenceWake().
+     *
+     * Returns once the receiver reports a known combined state so the PIO
+     * has settled, otherwise TX ready is restored. The receiver evaluates
+     * new fences on its next navigation epoch so the wait is at most one
+     * epoch at the rate set by setRate(), the GPS lock is only taken to poll.
+     *
+     * @param geofence Circles to evaluate, PIO settings are overridden
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_NOT_SUPPORTED No TX ready PIO on this interface
+     * @retval SYSTEM_ERROR_INVALID_ARGUMENT No circles or too many
+     * @retval SYSTEM_ERROR_INVALID_STATE Module is off
+     * @retval SYSTEM_ERROR_IO Configuration failed
+     * @retval SYSTEM_ERROR_TIMEOUT Combined state still unknown after an epoch, no fix
+     */
+    int   setGeofenceWake(ubx_geofence_t geofence);
+
+    /**
+     * @brief Clear the hardware geofences and give the PIO back to TX ready
+     *
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_IO Configuration failed
+     */
+    int   clearGeofenceWake();
+
+    bool  isGeofenceWakeEnabled() const {
+        return geofence_wake;
+    }
+
     bool  configMsg(ubx_msg_class_t msgClass, uint8_t msgId, uint8_t rate);
     bool  disableNMEA(void);
     bool  enableNMEA(uint8_t intervalSec, uint8_t slowIntervalSec);
     bool  disableUBX(void);
     bool  enablePUBX(uint8_t intervalSec, uint8_t slowIntervalSec);
     bool  disablePUBX(void);
+    bool  enablePVT(uint8_t intervalSec);
+    bool  disablePVT(void);
+
+    /**
+     * @brief Start queuing UBX configuration commands into a transaction
+     *
+     * Until commitConfig() is called, CFG commands issued through the setters
+     * (configMsg(), setGNSS(), setMode(), setPower(), enableNMEA(), ...) are
+     * queued instead of each waiting for its own ACK, and the setters return
+     * true once the command has been queued. Hold the GPS lock with lock()
+     * from beginConfig() until commitConfig() returns so that commands from
+     * other threads are not mixed into the transaction.
+     */
+    void  beginConfig();
+
+    /**
+     * @brief Send the queued configuration commands back to back
+     *
+     * Up to a window of commands are outstanding at any time and ACK/NAK
+     * replies are matched to them by class and ID in the order they were
+     * sent, so the transaction takes about one round trip rather than one per
+     * command. Per command results are available from getConfigResult().
+     *
+     * @retval SYSTEM_ERROR_NONE All commands were acknowledged
+     * @retval SYSTEM_ERROR_INVALID_STATE No transaction was started with beginConfig()
+     * @retval SYSTEM_ERROR_TOO_LARGE Commands were dropped as the queue was full
+     * @retval SYSTEM_ERROR_IO One or more commands were rejected, timed out or could not be sent
+     */
+    int   commitConfig();
+
+    /**
+     * @brief Get the results of the last configuration transaction
+     *
+     * @return const ubx_cfg_transaction_result_t& Per command results and total elapsed time
+     */
+    const ubx_cfg_transaction_result_t &getConfigResult() const {
+        return cfg_result;
+    }
+
+    /**
+     * @brief Save the current message, navigation and receiver manager configuration to battery backed RAM
+     *
+     * The module reloads it when powered on again as long as its backup
+     * supply was kept, so on() only confirms it instead of sending it again.
+     * Port settings are not saved so the module always starts at its
+     * default baudrate.
+     *
+     * @retval true Configuration saved
+     * @retval false Save command failed
+     */
+    bool  saveConfig(void);
 
     bool  createLog(void);
     bool  eraseLog(void);
@@ -896,14 +1305,135 @@ public:
     bool  startLog(void);
     bool  pauseLog(void);
     bool  getLogInfo(ubx_log_info_rsp_t *info);
+
+    /**
+     * @brief Request LOG-INFO without waiting, see requestAsync()
+     *
+     * @param callback Completion callback, the response frame is a ubx_log_info_rsp_t
+     * @return int Request handle if positive, otherwise a system error
+     */
+    int   getLogInfoAsync(ubx_request_callback_t callback);
     bool  addLogString(uint8_t *bytes, uint16_t length);
     const ubx_msg_t  *getLogEntry(uint32_t start);
 
+    /**
+     * @brief Prepare a bulk retrieval of the on-board log
+     *
+     * The range is clamped to the entries currently in the log. Logging
+     * should be paused with pauseLog() until the retrieval is done as the
+     * receiver renumbers a circular log when it wraps.
+     *
+     * @param retrieval Progress to initialize, pass it to retrieveLog()
+     * @param start Index of the first entry
+     * @param count Number of entries, all remaining entries by default
+     * @retval SYSTEM_ERROR_NONE Range set
+     * @retval SYSTEM_ERROR_IO LOG-INFO could not be read
+     */
+    int   beginLogRetrieval(ubx_log_retrieval_t &retrieval, uint32_t start = 0, uint32_t count = UINT32_MAX);
+
+    /**
+     * @brief Stream log entries into a ring until the retrieval is done or the ring is full
+     *
+     * Entries are requested with LOG-RETRIEVE in ranges of up to
+     * UBX_LOG_RETRIEVE_ENTRY_COUNT_MAX that fit the free space in the ring and
+     * are decoded as they are received, so several hundred entries cost one
+     * round trip. Another thread may pop entries from the ring meanwhile. A
+     * range that loses an entry is requested again from the missing entry.
+     * Call again with the same progress after draining the ring, or after
+     * an error, to resume.
+     *
+     * @param retrieval Progress from beginLogRetrieval(), updated
+     * @param ring Ring receiving the entries in index order
+     * @return int Number of entries pushed to the ring, otherwise one of
+     * @retval SYSTEM_ERROR_INVALID_STATE Module is not powered on
+     * @retval SYSTEM_ERROR_TIMEOUT Module stopped returning entries
+     */
+    int   retrieveLog(ubx_log_retrieval_t &retrieval, ubx_log_ring_t &ring);
+
+    /**
+     * @brief Send a UBX request without waiting for its reply
+     *
+     * The request is copied and sent by the GPS thread so the caller never
+     * blocks on the module, the GPS lock or the bus. Several requests may be
+     * in flight at once and replies are matched to them by class and ID in
+     * the order they were sent. Completion is reported through the callback
+     * and can also be polled with getRequestStatus().
+     *
+     * @param request UBX frame without sync and checksum, starting with class and ID
+     * @param len Length of the request
+     * @param flags UBX_REQ_FLAGS_EXPECT_ACK to complete on ACK/NAK
+     * @param rsp_class Class of the response that completes the request, UBX_CLASS_INVALID if none
+     * @param rsp_id ID of the response that completes the request
+     * @param callback Optional completion callback, must not block
+     * @param timeout Milliseconds to wait for the reply once sent
+     * @return int Request handle if positive, otherwise one of
+     * @retval SYSTEM_ERROR_INVALID_ARGUMENT Request is too short or too long
+     * @retval SYSTEM_ERROR_INVALID_STATE Module is not powered on
+     * @retval SYSTEM_ERROR_LIMIT_EXCEEDED Too many requests in flight
+     */
+    int   requestAsync(const uint8_t *request,
+        uint16_t len,
+        uint8_t flags,
+        uint8_t rsp_class = UBX_CLASS_INVALID,
+        uint8_t rsp_id = UBX_ID_INVALID,
+        ubx_request_callback_t callback = nullptr,
+        uint32_t timeout = UBX_ASYNC_REQUEST_TIMEOUT_MS);
+
+    /**
+     * @brief Get the status of an asynchronous request
+     *
+     * @param handle Handle returned when the request was made
+     * @return int One of ubx_request_status_t, or SYSTEM_ERROR_NOT_FOUND if the handle is no longer valid
+     */
+    int   getRequestStatus(int handle);
+
     bool startWriteMGA();
     bool stopWriteMGA();
     void abortWriteMGA();
     ubx_mga_flash_ack_type_t writeMGA(uint8_t *bytes, uint16_t length);
 
+    /**
+     * @brief Stream an AssistNow blob from the filesystem to the module
+     *
+     * Up to a window of MGA messages are outstanding at any time and the
+     * next is sent as each is acknowledged, which keeps the module's input
+     * buffer from overflowing without paying a round trip per message.
+     * Direct injection enables MGA-ACK-DATA0 replies on the module; messages
+     * it does not use are counted and skipped. Flash blocks are always sent
+     * one at a time as the MGA-FLASH sequence requires each to be
+     * acknowledged before the next, a block the module asks to retry is sent
+     * again.
+     *
+     * @param path File holding the blob, a series of UBX MGA messages for
+     * direct injection or the AssistNow Offline data for flash
+     * @param mode Load the data to receiver RAM or store it in receiver flash
+     * @param window Messages outstanding at once for direct injection, 1 to
+     * UBX_MGA_INJECT_WINDOW_MAX, flash injection uses a window of 1
+     * @param progress Optional callback after each acknowledged unit
+     * @retval SYSTEM_ERROR_NONE Whole blob was acknowledged, see getMGAResult()
+     * @retval SYSTEM_ERROR_INVALID_ARGUMENT Invalid path or window
+     * @retval SYSTEM_ERROR_INVALID_STATE Module is not powered on
+     * @retval SYSTEM_ERROR_BUSY A flash write sequence is already active
+     * @retval SYSTEM_ERROR_FILE Blob could not be read
+     * @retval SYSTEM_ERROR_BAD_DATA Blob is not a series of valid MGA messages
+     * @retval SYSTEM_ERROR_TIMEOUT Module stopped acknowledging
+     * @retval SYSTEM_ERROR_ABORTED Module aborted the flash write
+     * @retval SYSTEM_ERROR_IO Module rejected the configuration or final flash write
+     */
+    int   injectMGA(const char *path,
+        ubx_mga_inject_mode_t mode,
+        size_t window = UBX_MGA_INJECT_WINDOW_DEFAULT,
+        ubx_mga_progress_callback_t progress = nullptr);
+
+    /**
+     * @brief Get the progress of the last MGA injection
+     *
+     * @return const ubx_mga_inject_result_t& Acknowledged units, rejections and timing
+     */
+    const ubx_mga_inject_result_t &getMGAResult() const {
+        return mga_result;
+    }
+
     String deg2DMS(float degree);
     float  DMS2deg(String DMS);
 
@@ -912,8 +1442,8 @@ public:
     void hex_dump(LogLevel level, uint8_t *data, int len, Logger *logger=NULL);
 
     typedef struct {
-        size_t pos_report_count {0};           //Count of PUBX POS, GPGGA, GNGGA reports
-        size_t time_report_count {0};          //Count of PUBX TIME reports
+        size_t pos_report_count {0};           //Count of PUBX POS, GPGGA, GNGGA, NAV-PVT reports
+        size_t time_report_count {0};          //Count of PUBX TIME, NAV-PVT reports
 
         //The following are counts of error conditions
         size_t timeouts {0};                   //Timeout waiting for reports
@@ -922,14 +1452,25 @@ public:
         size_t enable_pubx_error_count {0};    //enablePUBX failure count
         size_t disable_pubx_error_count {0};   //disablePUBX failure count
         size_t disable_ubx_error_count {0};    //disableUBX failure count
+        size_t enable_pvt_error_count {0};     //enablePVT failure count
+        size_t disable_pvt_error_count {0};    //disablePVT failure count
+        size_t config_nak_count {0};           //NAK replies to configuration transaction commands
+
+        //The following count power on configuration work
+        size_t config_sent_count {0};          //Configuration commands sent
+        size_t config_skipped_count {0};       //Configuration commands skipped as the module kept its saved configuration
+        uint32_t config_saved_ms {0};          //Estimated time saved by skipping configuration
 
         size_t getTotalErrors() const {
             return timeouts +
+                config_nak_count +
                 enable_nmea_error_count +
                 disable_nmea_error_count +
                 enable_pubx_error_count +
                 disable_pubx_error_count +
-                disable_ubx_error_count;
+                disable_ubx_error_count +
+                enable_pvt_error_count +
+                disable_pvt_error_count;
         }
         size_t getTotalCounts() const {
             return getTotalErrors() +
@@ -958,6 +1499,35 @@ public:
 protected:
     bool checkWaitingForAckOrRspFlags() const;
 
+    /**
+     * @brief Receive and parse all bytes currently available from the module
+     *
+     * MUST BE CALLED WITH GPS LOCK ALREADY HELD
+     */
+    void processBytes();
+
+    /**
+     * @brief Parse a span of bytes received from the module
+     *
+     * UBX frames and NMEA sentences are decoded from the same span, lock
+     * status and stability are evaluated once per completed NMEA sentence.
+     * MUST BE CALLED WITH GPS LOCK ALREADY HELD
+     *
+     * @param buf Received bytes
+     * @param len Number of received bytes
+     * @param waiting Stop parsing immediately after an expected ACK/NAK/RSP frame
+     * @return size_t Number of bytes parsed, less than len only if stopped on an expected frame
+     */
+    size_t processGPSBytes(const uint8_t *buf, size_t len, bool waiting = false);
+
+    /**
+     * @brief One pass of the GPS thread, send queued requests, parse received
+     * bytes and expire overdue requests
+     *
+     * @param available A tx ready event was received
+     */
+    void serviceGPS(bool available);
+
 private:
     ubloxGpsInterface interface;
 
@@ -971,6 +1541,23 @@ private:
     // Serial related
     USARTSerial *serial;
 
+    // Receive chunks, UART drains the serial FIFO into the first chunk while
+    // SPI double buffers DMA transfers so that the next chunk is clocked in
+    // while the current one is parsed. SPI transfers are kept shorter as the
+    // tail of the last transfer of a burst is filler.
+    static constexpr size_t UBX_RX_CHUNK_LEN = 128;
+    static constexpr size_t UBX_SPI_CHUNK_LEN = 64;
+    uint8_t rx_chunk[2][UBX_RX_CHUNK_LEN];
+    uint8_t rx_chunk_index;
+    size_t rx_chunk_len;
+    size_t rx_chunk_offset;
+    bool spi_got_data;          // last SPI chunk had bytes other than 0xFF filler
+    bool spi_dma_pending;       // transfer into the other chunk is in flight
+    bool spi_chunk_ready;       // other chunk was received but not parsed yet
+    bool spi_tx_ready_enabled;  // module has been configured to drive tx ready
+    bool geofence_wake;         // tx ready PIO carries the geofence state instead
+    uint16_t nav_epoch_ms;      // navigation epoch period set by setRate()
+
     // Common
     std::function<bool(bool)> pwr_enable;
     os_queue_t tx_ready_queue; // to signal tx ready updates from interrupt
@@ -983,12 +1570,32 @@ private:
     bool write_mga_active;
     uint16_t write_mga_sequence;
 
+    // MGA injection in progress, units sent but not yet acknowledged oldest
+    // first, ACKs are matched to the oldest
+    struct mga_unit_t {
+        uint32_t offset;            // position in the blob
+        uint16_t len;               // bytes of the blob
+        uint16_t sequence;          // flash block sequence
+        uint8_t  msg_id;            // MGA message ID
+        uint8_t  payload_start[4];  // first bytes of the MGA message payload
+        uint32_t sent;              // millis() when sent
+    };
+    bool mga_injecting;
+    uint8_t mga_mode;               // ubx_mga_inject_mode_t
+    mga_unit_t mga_units[UBX_MGA_INJECT_WINDOW_MAX];
+    size_t mga_first;
+    size_t mga_outstanding;
+    uint32_t mga_next_offset;       // next blob position to send
+    bool mga_aborted;
+    ubx_mga_inject_result_t mga_result;
+
     // Status related
     bool initializing;
     uint8_t gpsStatus;
     bool powerOn;
     ubloxGpsLockMethod lockMethod;
     double hdopStability;
+    bool pvtMode;
 
     uint8_t gpsUnit;
     uint32_t last_receive_time;
@@ -1013,8 +1620,51 @@ private:
     uint8_t waitForRspClass;
     uint8_t waitForRspId;
 
+    // configuration transaction, commands are queued back to back in the
+    // buffer and replies are matched against cfg_result while committing
+    bool cfg_queuing;
+    bool cfg_committing;
+    uint8_t cfg_buffer[UBX_CFG_TRANSACTION_MAX_LEN];
+    uint16_t cfg_buffer_len;
+    uint16_t cfg_offset[UBX_CFG_TRANSACTION_MAX_COMMANDS];
+    uint32_t cfg_sent[UBX_CFG_TRANSACTION_MAX_COMMANDS];
+    size_t cfg_next;            // commands sent so far
+    ubx_cfg_transaction_result_t cfg_result;
+
+    // asynchronous requests, the slots are guarded by their own mutex as they
+    // are filled by application threads without taking the GPS lock
+    struct async_request_t {
+        uint8_t  request[UBX_ASYNC_REQUEST_MAX_LEN];
+        uint16_t len;
+        uint8_t  flags;
+        uint8_t  rsp_class;
+        uint8_t  rsp_id;
+        uint8_t  status = UBX_REQUEST_CANCELLED;    // ubx_request_status_t
+        uint16_t generation = 0;    // distinguishes handles for the same slot
+        uint32_t timeout;
+        uint32_t sent;              // millis() when sent
+        uint32_t sequence;          // send order, replies go to the oldest match
+        ubx_request_callback_t callback;
+    };
+    async_request_t requests[UBX_ASYNC_MAX_REQUESTS];
+    uint32_t request_sequence;
+
+    // bulk log retrieval in progress, entries within the requested range are
+    // decoded into the ring in index order
+    ubx_log_retrieval_t *log_retrieval;
+    ubx_log_ring_t *log_ring;
+    uint32_t log_range_end;     // one past the last entry requested
+    bool log_range_done;        // last entry of the range was received
+    bool log_range_seen;        // any entry of the range was received
+
+    // hash of the power on configuration last saved to the module's battery
+    // backed RAM, and how long sending it took
+    uint32_t cfg_saved_hash;
+    uint32_t cfg_commit_ms;
+
     typedef struct {
         bool     output_pubx = true;        // true - output PUBX,  false - output NMEA
+        bool     output_pvt = false;        // true - output NAV-PVT, overrides output_pubx
         uint8_t  power_enable = HIGH;       // pin state when GPS power on
         uint8_t  power_mode = UBX_POWER_MODE_FULL_POWER;
         uint8_t  dynamic_model = UBX_DEFAULT_MODEL;
@@ -1025,6 +1675,7 @@ private:
 
         void resetDefault(void){
             output_pubx = true;
+            output_pvt = false;
             power_enable = HIGH;
             power_mode = UBX_POWER_MODE_FULL_POWER;
             dynamic_model = UBX_DEFAULT_MODEL;
@@ -1048,9 +1699,24 @@ private:
     int setOn(lib_config_t &config);
     void updateGPS(void);
     void processLockStability();
-    void processGPSByte(uint8_t c);
+    void processSentence();
+    bool spiDataPending();
+    void spiStartChunk();
+    void spiFinishChunk();
+    bool spiNextChunk();
+    void publishFix();
 #define UBX_REQ_FLAGS_EXPECT_ACK 0x01
     bool requestSendUBX(const uint8_t *sentences, uint16_t len);
+    bool queueConfig(const uint8_t *sentences, uint16_t len);
+    void matchConfigReply(uint8_t req_class, uint8_t req_id, uint8_t result);
+    uint32_t configHash() const;
+    void sendRequests();
+    void expireRequests();
+    void cancelRequests();
+    uint32_t requestYieldTimeout();
+    void matchRequests();
+    void completeRequest(size_t index, uint8_t status, const ubx_msg_t *rsp);
+    bool verifySavedConfig();
     bool requestSendUBX(const ubx_msg_t *request,
         uint16_t len,
         uint8_t flags,
@@ -1059,7 +1725,11 @@ private:
     size_t writeBytes(const uint8_t *buf, size_t len);
     bool sendUBX(const uint8_t *sentences, uint16_t len);
     void processUBX();
-    void processBytes();
+    void processNavPvt(const ubx_nav_pvt_t &pvt);
+    void processNavDop(const ubx_nav_dop_t &dop);
+    void processLogEntry();
+    void processMgaAck();
+    int sendMgaUnit(int fd);
     bool yieldThread(uint32_t timeout);
     void waitForAckOrRsp();
     const ubx_msg_t *waitForAck(uint8_t req_class=UBX_CLASS_INVALID,
@@ -1073,7 +1743,7 @@ private:
     bool isNAK(const ubx_msg_t *rsp);
     void initRxMsg();
     bool parseRxMsg();
-    std::function<decode_result_t(ubloxGPS *,uint8_t chr)> decodeStateHandler = &ubloxGPS::stateSync1;
+    decode_result_t (ubloxGPS::*decodeStateHandler)(uint8_t chr) = &ubloxGPS::stateSync1;
     decode_result_t decodeUbx(uint8_t chr);
     decode_result_t stateSync1(uint8_t chr);
     decode_result_t stateSync2(uint8_t chr);
@@ -1097,6 +1767,13 @@ private:
     time_t stabilityWindowLastTimestamp;
     bool isStable;
     uint32_t startLockUptime;
+
+    // fix snapshot for lock free readers, the epoch time is only recalculated
+    // when the reported date or time changes
+    SeqLock<ubx_fix_snapshot_t> fixSnapshot;
+    uint32_t fixSnapshotDate;
+    uint32_t fixSnapshotTime;
+    uint32_t fixSnapshotEpoch;
 };
 
 #endif /* __UBLOXGPS_H */
@@ -0,0 +1,43 @@
+#include "Particle.h"
+
+SystemClass System;
+TimeClass Time;
+Logger Log;
+std::function<int(uint16_t)> digitalReadHook;
+
+struct os_queue_stub {
+    size_t item_size;
+    size_t item_count;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void* reserved) {
+    *queue = new os_queue_stub{item_size, item_count, {}};
+    return 0;
+}
+
+int os_queue_destroy(os_queue_t queue, void* reserved) {
+    delete queue;
+    return 0;
+}
+
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void* reserved) {
+    if (queue->items.size() >= queue->item_count) {
+        System.inc(delay);
+        return 1;
+    }
+    auto d = (const uint8_t*)item;
+    queue->items.emplace_back(d, d + queue->item_size);
+    return 0;
+}
+
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void* reserved) {
+    if (queue->items.empty()) {
+        // nothing will arrive while blocked on the host so just let time pass
+        System.inc(delay);
+        return 1;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    return 0;
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <string>
+#include <vector>
+
+// List of all defined system errors
+#define SYSTEM_ERROR_NONE                   (0)
+#define SYSTEM_ERROR_UNKNOWN                (-100)
+#define SYSTEM_ERROR_BUSY                   (-110)
+#define SYSTEM_ERROR_NOT_SUPPORTED          (-120)
+#define SYSTEM_ERROR_NOT_ALLOWED            (-130)
+#define SYSTEM_ERROR_CANCELLED              (-140)
+#define SYSTEM_ERROR_ABORTED                (-150)
+#define SYSTEM_ERROR_TIMEOUT                (-160)
+#define SYSTEM_ERROR_NOT_FOUND              (-170)
+#define SYSTEM_ERROR_ALREADY_EXISTS         (-180)
+#define SYSTEM_ERROR_TOO_LARGE              (-190)
+#define SYSTEM_ERROR_NOT_ENOUGH_DATA        (-191)
+#define SYSTEM_ERROR_LIMIT_EXCEEDED         (-200)
+#define SYSTEM_ERROR_END_OF_STREAM          (-201)
+#define SYSTEM_ERROR_INVALID_STATE          (-210)
+#define SYSTEM_ERROR_IO                     (-220)
+#define SYSTEM_ERROR_WOULD_BLOCK            (-221)
+#define SYSTEM_ERROR_FILE                   (-225)
+#define SYSTEM_ERROR_NETWORK                (-230)
+#define SYSTEM_ERROR_PROTOCOL               (-240)
+#define SYSTEM_ERROR_INTERNAL               (-250)
+#define SYSTEM_ERROR_NO_MEMORY              (-260)
+#define SYSTEM_ERROR_INVALID_ARGUMENT       (-270)
+#define SYSTEM_ERROR_BAD_DATA               (-280)
+#define SYSTEM_ERROR_OUT_OF_RANGE           (-290)
+#define SYSTEM_ERROR_DEPRECATED             (-300)
+
+#define CHECK_TRUE(_expr, _ret) \
+    do { \
+        if (!(_expr)) { \
+            return _ret; \
+        } \
+    } while (false)
+
+// Catch defines its own CHECK_FALSE assertion for test sources
+#ifndef CHECK_FALSE
+#define CHECK_FALSE(_expr, _ret) CHECK_TRUE(!(_expr), _ret)
+#endif
+
+#define WITH_LOCK(lock) for (std::unique_lock<typename std::remove_reference<decltype(lock)>::type> __with_lock((lock)); __with_lock; __with_lock.unlock())
+
+template<typename F>
+class ScopeGuard {
+public:
+    explicit ScopeGuard(F&& f) : _f(std::move(f)), _active(true) {}
+    ScopeGuard(ScopeGuard&& other) : _f(std::move(other._f)), _active(other._active) {
+        other._active = false;
+    }
+    ~ScopeGuard() {
+        if (_active) {
+            _f();
+        }
+    }
+    void dismiss() {
+        _active = false;
+    }
+
+private:
+    F _f;
+    bool _active;
+};
+
+template<typename F>
+ScopeGuard<F> makeScopeGuard(F&& f) {
+    return ScopeGuard<F>(std::move(f));
+}
+
+#define NAMED_SCOPE_GUARD(_name, _func) \
+    auto _name = makeScopeGuard([&]() _func)
+
+typedef uint32_t system_tick_t;
+typedef uint16_t pin_t;
+
+#define PIN_INVALID         (0xff)
+#define HIGH                (0x1)
+#define LOW                 (0x0)
+#define MHZ                 (1000000)
+#define MSBFIRST            (1)
+#define SPI_MODE0           (0x00)
+
+typedef enum {
+    INPUT,
+    OUTPUT,
+} PinMode;
+
+typedef enum {
+    CHANGE,
+    RISING,
+    FALLING,
+} InterruptMode;
+
+using std::min;
+using std::max;
+
+// Simulated clock, advanced explicitly by tests and by delay()
+class SystemClass {
+public:
+    SystemClass() : _tick(0) {}
+
+    unsigned uptime() const {
+        return _tick / 1000;
+    }
+
+    uint64_t millis() const {
+        return _tick;
+    }
+
+    void inc(int i = 1) {
+        _tick += i;
+    }
+
+private:
+    uint64_t _tick;
+};
+
+extern SystemClass System;
+
+class TimeClass {
+public:
+    time_t now() const {
+        return (time_t)(1600000000 + System.uptime());
+    }
+};
+
+extern TimeClass Time;
+
+inline system_tick_t millis() {
+    return (system_tick_t)System.millis();
+}
+
+inline void delay(unsigned ms) {
+    System.inc(ms);
+}
+
+inline void pinMode(uint16_t pin, PinMode mode) {}
+
+// Tests drive input pin levels through this hook, pins read HIGH otherwise
+extern std::function<int(uint16_t)> digitalReadHook;
+
+inline int32_t digitalRead(uint16_t pin) {
+    return digitalReadHook ? digitalReadHook(pin) : HIGH;
+}
+
+template<typename T>
+bool attachInterrupt(uint16_t pin, void (T::*handler)(), T* instance, InterruptMode mode) {
+    return true;
+}
+
+typedef enum {
+    LOG_LEVEL_ALL = 1,
+    LOG_LEVEL_TRACE = 1,
+    LOG_LEVEL_INFO = 30,
+    LOG_LEVEL_WARN = 40,
+    LOG_LEVEL_ERROR = 50,
+    LOG_LEVEL_NONE = 70
+} LogLevel;
+
+class Logger {
+public:
+    explicit Logger(const char* name = "app") {}
+    void trace(const char* fmt, ...) const {}
+    void info(const char* fmt, ...) const {}
+    void warn(const char* fmt, ...) const {}
+    void error(const char* fmt, ...) const {}
+    void print(LogLevel level, const char* str) const {}
+    void write(const char* str) const {}
+    void write(LogLevel level, const char* data, size_t size) const {}
+    void dump(LogLevel level, const void* data, size_t size) const {}
+};
+
+extern Logger Log;
+
+class String {
+public:
+    String() {}
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+
+    static String format(const char* fmt, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return String(buf);
+    }
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned length() const { return _s.length(); }
+    int indexOf(char c) const { auto i = _s.find(c); return (i == std::string::npos) ? -1 : (int)i; }
+    int indexOf(const char* str) const { auto i = _s.find(str); return (i == std::string::npos) ? -1 : (int)i; }
+    String substring(unsigned from, unsigned to) const { return String(_s.substr(from, to - from)); }
+    String& remove(unsigned index, unsigned count) { _s.erase(index, count); return *this; }
+    String& trim() {
+        _s.erase(0, _s.find_first_not_of(" \t\r\n"));
+        _s.erase(_s.find_last_not_of(" \t\r\n") + 1);
+        return *this;
+    }
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return atof(_s.c_str()); }
+    String& operator+=(const String& other) { _s += other._s; return *this; }
+    bool operator==(const char* other) const { return _s == other; }
+
+private:
+    std::string _s;
+};
+
+// Simple queue standing in for the RTOS queue used to signal tx ready events
+typedef struct os_queue_stub* os_queue_t;
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void* reserved);
+int os_queue_destroy(os_queue_t queue, void* reserved);
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void* reserved);
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void* reserved);
+
+#define OS_THREAD_PRIORITY_DEFAULT (2)
+
+// Threads are never started on the host, tests drive the driver directly
+class Thread {
+public:
+    Thread(const char* name, std::function<void()> function, int priority = OS_THREAD_PRIORITY_DEFAULT) :
+        _function(function) {}
+
+private:
+    std::function<void()> _function;
+};
+
+class RecursiveMutex {
+public:
+    void lock() { _mutex.lock(); }
+    bool try_lock() { return _mutex.try_lock(); }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::recursive_mutex _mutex;
+};
+
+// Serial port replaying bytes queued by the test and capturing writes
+class USARTSerial {
+public:
+    void begin(uint32_t baud) {}
+    void end() {}
+    void flush() {}
+
+    int available() {
+        if (on_read) {
+            on_read();
+        }
+        return std::min(rx.size(), fifo_size);
+    }
+
+    int read() {
+        if (on_read) {
+            on_read();
+        }
+        if (rx.empty()) {
+            return -1;
+        }
+        auto c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+
+    size_t write(const uint8_t* buf, size_t len) {
+        tx.insert(tx.end(), buf, buf + len);
+        if (on_write) {
+            on_write(buf, len);
+        }
+        return len;
+    }
+
+    void push(const void* data, size_t len) {
+        auto d = (const uint8_t*)data;
+        rx.insert(rx.end(), d, d + len);
+    }
+
+    std::deque<uint8_t> rx;
+    std::vector<uint8_t> tx;
+    size_t fifo_size = SIZE_MAX;
+    std::function<void(const uint8_t*, size_t)> on_write;
+    std::function<void()> on_read;          // called before rx is inspected
+};
+
+class __SPISettings {
+public:
+    __SPISettings(unsigned clock, uint8_t bitOrder, uint8_t dataMode) {}
+};
+
+// SPI port clocking out queued bytes, padded with 0xFF filler when idle.
+// Transfers with a callback complete immediately and invoke it the way the
+// DMA completion interrupt would.
+class SPIClass {
+public:
+    void beginTransaction(const __SPISettings& settings) {}
+    void endTransaction() {}
+    void transferCancel() {}
+
+    void transfer(const void* tx_buf, void* rx_buf, size_t len, void (*cb)()) {
+        if (on_read) {
+            on_read();
+        }
+        auto rx_d = (uint8_t*)rx_buf;
+        for (size_t i = 0; i < len; i++) {
+            uint8_t c = 0xFF;
+            if (!rx.empty()) {
+                c = rx.front();
+                rx.pop_front();
+            }
+            if (rx_d) {
+                rx_d[i] = c;
+            }
+        }
+        if (tx_buf) {
+            auto tx_d = (const uint8_t*)tx_buf;
+            tx.insert(tx.end(), tx_d, tx_d + len);
+            if (on_write) {
+                on_write(tx_d, len);
+            }
+        }
+        transfers++;
+        bytes_clocked += len;
+        if (rx.empty() && !drained) {
+            // bus position at which the last queued byte was received
+            drained = true;
+            drained_bytes = bytes_clocked;
+            drained_transfers = transfers;
+        }
+        if (cb) {
+            cb();
+        }
+    }
+
+    void push(const void* data, size_t len) {
+        auto d = (const uint8_t*)data;
+        rx.insert(rx.end(), d, d + len);
+        drained = false;
+    }
+
+    std::deque<uint8_t> rx;
+    std::vector<uint8_t> tx;
+    size_t transfers = 0;
+    size_t bytes_clocked = 0;
+    bool drained = true;
+    size_t drained_bytes = 0;
+    size_t drained_transfers = 0;
+    std::function<void(const uint8_t*, size_t)> on_write;
+    std::function<void()> on_read;          // called before rx is inspected
+};
@@ -0,0 +1,266 @@
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+#include "harness.h"
+#include "capture.h"
+#include "receiver.h"
+
+// Replays a receiver capture through the driver receive path and reports
+// throughput.  Pass a path to a raw UART/SPI capture to replay a recording,
+// otherwise a synthesized 10 Hz NMEA+GSV+PUBX+UBX stream is used.
+
+static const unsigned REPEAT = 20;
+
+// SPI bus model used to turn transfer counts into time, 5 MHz clock and an
+// assumed fixed cost per transaction for chip select and DMA setup
+static const double SPI_US_PER_BYTE = 8.0 / 5.0;
+static const double SPI_US_PER_TRANSFER = 10.0;
+
+struct SpiStats {
+    size_t useful = 0;
+    size_t clocked = 0;
+    size_t transfers = 0;
+    double latency_us = 0.0;
+    unsigned bursts = 0;
+};
+
+// Feed one receiver output burst per navigation epoch and account for the
+// bus time spent until the last byte of the burst had been received
+template<typename F>
+static void spiEpochs(SPIClass& spi, const std::vector<uint8_t>& burst, unsigned epochs, SpiStats& stats, F&& ingest) {
+    for (unsigned i = 0; i < epochs; i++) {
+        size_t bytes0 = spi.bytes_clocked;
+        size_t transfers0 = spi.transfers;
+        spi.push(burst.data(), burst.size());
+        ingest();
+        stats.useful += burst.size();
+        stats.clocked += spi.bytes_clocked - bytes0;
+        stats.transfers += spi.transfers - transfers0;
+        stats.latency_us += (spi.drained_bytes - bytes0) * SPI_US_PER_BYTE + (spi.drained_transfers - transfers0) * SPI_US_PER_TRANSFER;
+        stats.bursts++;
+    }
+}
+
+static void printSpiStats(const char* name, const SpiStats& stats) {
+    double busy_us = stats.clocked * SPI_US_PER_BYTE + stats.transfers * SPI_US_PER_TRANSFER;
+    printf("%-28s util %5.1f%%  %5.1f transfers/epoch  %7.1f us bus/epoch  %7.1f us ready-to-parsed\n",
+        name, 100.0 * stats.useful / stats.clocked, (double)stats.transfers / stats.bursts,
+        busy_us / stats.bursts, stats.latency_us / stats.bursts);
+}
+
+template<typename F>
+static void run(const char* name, size_t bytes, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < REPEAT; i++) {
+        f();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double total = (double)bytes * REPEAT;
+    printf("%-28s %10.0f bytes/sec (%.1f MB in %.3f s)\n", name, total / elapsed.count(), total / 1e6, elapsed.count());
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<uint8_t> capture;
+
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "unable to open %s\n", argv[1]);
+            return 1;
+        }
+        capture.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        capture = makeCapture();
+    }
+    printf("capture: %zu bytes\n", capture.size());
+
+    System.inc(10000);
+
+    {
+        USARTSerial serial;
+        TestGPS gps(serial);
+        run("bytewise (1 byte spans)", capture.size(), [&]() {
+            for (auto c : capture) {
+                gps.processGPSBytes(&c, 1);
+            }
+        });
+    }
+
+    {
+        USARTSerial serial;
+        TestGPS gps(serial);
+        run("block UART processBytes", capture.size(), [&]() {
+            serial.push(capture.data(), capture.size());
+            gps.processBytes();
+        });
+    }
+
+    {
+        SPIClass spi;
+        TestGPS gps(spi);
+        run("block SPI processBytes", capture.size(), [&]() {
+            spi.push(capture.data(), capture.size());
+            gps.processBytes();
+        });
+    }
+
+    {
+        // previous SPI ingest, blocking 32 byte transfers repeated until one
+        // returns only filler
+        CaptureOptions options;
+        options.epochs = 1;
+        auto burst = makeCapture(options);
+        SpiStats stats;
+        SPIClass spi;
+        TestGPS gps(spi);
+        spiEpochs(spi, burst, 1000, stats, [&]() {
+            uint8_t chunk[32];
+            bool got_data;
+            do {
+                spi.transfer(NULL, chunk, sizeof(chunk), NULL);
+                got_data = std::count(chunk, chunk + sizeof(chunk), 0xFF) != sizeof(chunk);
+                gps.processGPSBytes(chunk, sizeof(chunk));
+            } while (got_data);
+        });
+        printSpiStats("SPI 32 byte polled chunks", stats);
+    }
+
+    {
+        // tx ready driven double buffered DMA chunks
+        static const uint16_t MCU_PIN = 10;
+        CaptureOptions options;
+        options.epochs = 1;
+        auto burst = makeCapture(options);
+        SpiStats stats;
+        SPIClass spi;
+        TestGPS gps(spi, MCU_PIN, 11);
+        digitalReadHook = [&](uint16_t pin) {
+            return (pin == MCU_PIN && !spi.rx.empty()) ? LOW : HIGH;
+        };
+        {
+            FakeReceiver<SPIClass> receiver(spi);
+            gps.on();
+        }
+        spiEpochs(spi, burst, 1000, stats, [&]() {
+            gps.processBytes();
+        });
+        printSpiStats("SPI tx ready DMA chunks", stats);
+        digitalReadHook = nullptr;
+    }
+
+    {
+        // power on configuration against a module with assumed ACK latency,
+        // each command waiting for its ACK in turn versus one transaction
+        USARTSerial serial;
+        TestGPS gps(serial);
+        FakeReceiver<USARTSerial> receiver(serial);
+        receiver.process_ms = 2;
+        receiver.output_ms = 20;
+
+        auto t0 = System.millis();
+        gps.enablePUBX(1, 30);
+        gps.disableNMEA();
+        gps.disablePVT();
+        gps.configMsg(UBX_CLASS_ESF, UBX_ESF_STATUS, 10);
+        gps.configMsg(UBX_CLASS_NAV, UBX_NAV_ODO, 5);
+        gps.setGNSS(UBX_GNSS_TYPE_GPS | UBX_GNSS_TYPE_GLONASS);
+        gps.setPower(UBX_POWER_MODE_FULL_POWER);
+        gps.setMode(UBX_DEFAULT_MODEL);
+        printf("%-28s %6llu ms simulated\n", "config one ACK at a time", (unsigned long long)(System.millis() - t0));
+
+        gps.on();
+        printf("%-28s %6lu ms simulated for %zu commands\n", "config transaction",
+            (unsigned long)gps.getConfigResult().elapsed, gps.getConfigResult().count);
+
+        // module kept its saved configuration through power off
+        gps.off();
+        receiver.powerCycle(true);
+        gps.on();
+        printf("%-28s %6lu ms simulated, %zu commands skipped\n", "config warm wake",
+            (unsigned long)gps.getConfigResult().elapsed, gps.getPerfCounts().config_skipped_count);
+    }
+
+    {
+        // backfilling the on-board log over a 115200 baud UART, one entry per
+        // round trip versus streamed LOG-RETRIEVE ranges into a ring
+        static const uint32_t ENTRIES = 5000;
+        USARTSerial serial;
+        TestGPS gps(serial);
+        FakeReceiver<USARTSerial> receiver(serial);
+        gps.on();
+        receiver.process_ms = 2;
+        receiver.output_ms = 20;
+        receiver.baudrate = 115200;
+        for (uint32_t i = 0; i < ENTRIES; i++) {
+            receiver.logPosition(377749000 + i, -1224194000 - i, i % 60);
+        }
+
+        static const uint32_t SINGLE = 200;
+        auto t0 = System.millis();
+        for (uint32_t i = 0; i < SINGLE; i++) {
+            gps.getLogEntry(i);
+        }
+        printf("%-28s %6.0f entries/sec simulated\n", "log one entry per request", 1000.0 * SINGLE / (System.millis() - t0));
+
+        std::vector<ubx_log_entry_t> storage(256);
+        ubx_log_ring_t ring(storage.data(), storage.size());
+        ubx_log_retrieval_t retrieval;
+        gps.beginLogRetrieval(retrieval);
+        auto start = std::chrono::steady_clock::now();
+        while (!retrieval.done() && gps.retrieveLog(retrieval, ring) > 0) {
+            ubx_log_entry_t entry;
+            while (ring.pop(entry)) {
+            }
+        }
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+        printf("%-28s %6.0f entries/sec simulated, %.0f entries/sec host, %lu requests\n", "log streamed retrieval",
+            1000.0 * retrieval.retrieved / retrieval.elapsed, retrieval.retrieved / wall.count(), (unsigned long)retrieval.requests);
+    }
+
+    {
+        // AssistNow blob injected over a 115200 baud UART with increasing
+        // numbers of MGA messages outstanding
+        const char* path = "mga_blob_bench.ubx";
+        auto blob = makeMgaBlob();
+        FILE* file = fopen(path, "wb");
+        fwrite(blob.data(), 1, blob.size(), file);
+        fclose(file);
+
+        USARTSerial serial;
+        TestGPS gps(serial);
+        FakeReceiver<USARTSerial> receiver(serial);
+        gps.on();
+        receiver.process_ms = 2;
+        receiver.output_ms = 20;
+        receiver.baudrate = 115200;
+        for (size_t window : {1, 4, 8, 16}) {
+            char name[32];
+            snprintf(name, sizeof(name), "MGA inject window %zu", window);
+            gps.injectMGA(path, UBX_MGA_INJECT_DIRECT, window);
+            auto& result = gps.getMGAResult();
+            printf("%-28s %6lu bytes/sec simulated, %zu bytes in %lu ms\n", name,
+                (unsigned long)result.throughput(), result.acked_bytes, (unsigned long)result.elapsed);
+        }
+        remove(path);
+    }
+
+    {
+        // same epochs delivered as NAV-PVT/NAV-DOP only, as selected by setPvtMode()
+        CaptureOptions options;
+        options.nmea = false;
+        options.pubx = false;
+        options.pvt = true;
+        auto pvt_capture = makeCapture(options);
+        printf("NAV-PVT capture: %zu bytes\n", pvt_capture.size());
+
+        USARTSerial serial;
+        TestGPS gps(serial);
+        run("block UART NAV-PVT", pvt_capture.size(), [&]() {
+            serial.push(pvt_capture.data(), pvt_capture.size());
+            gps.processBytes();
+        });
+    }
+
+    return 0;
+}
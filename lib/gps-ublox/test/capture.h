@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Helpers to build receiver traffic for host tests and benchmarks
+
+inline void appendNmea(std::vector<uint8_t>& out, const char* body) {
+    uint8_t crc = 0;
+    for (auto p = body; *p; p++) {
+        crc ^= (uint8_t)*p;
+    }
+    char tail[8];
+    snprintf(tail, sizeof(tail), "*%02X\r\n", crc);
+    out.push_back('$');
+    for (auto p = body; *p; p++) {
+        out.push_back((uint8_t)*p);
+    }
+    for (auto p = tail; *p; p++) {
+        out.push_back((uint8_t)*p);
+    }
+}
+
+inline void appendUbx(std::vector<uint8_t>& out, uint8_t msg_class, uint8_t msg_id, const uint8_t* payload, uint16_t len) {
+    uint8_t a = 0, b = 0;
+    uint8_t header[] = {msg_class, msg_id, (uint8_t)(len & 0xff), (uint8_t)(len >> 8)};
+
+    out.push_back(0xB5);
+    out.push_back(0x62);
+    for (auto c : header) {
+        out.push_back(c);
+        a += c;
+        b += a;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        out.push_back(payload[i]);
+        a += payload[i];
+        b += a;
+    }
+    out.push_back(a);
+    out.push_back(b);
+}
+
+inline void appendAck(std::vector<uint8_t>& out, uint8_t req_class, uint8_t req_id, bool ack = true) {
+    uint8_t payload[] = {req_class, req_id};
+    appendUbx(out, 0x05, ack ? 0x01 : 0x00, payload, sizeof(payload));
+}
+
+inline void putLe(uint8_t* buf, size_t offset, uint32_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[offset + i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// NAV-PVT and NAV-DOP frames carrying the same solution as the NMEA and PUBX
+// sentences below
+inline void appendNavPvt(std::vector<uint8_t>& out, unsigned secs, unsigned centis, double lat, double lon) {
+    uint8_t pvt[92] = {};
+    putLe(pvt, 0, (432000 + secs) * 1000 + centis * 10, 4); // iTOW
+    putLe(pvt, 4, 2021, 2);
+    pvt[6] = 9;
+    pvt[7] = 17;
+    pvt[8] = secs / 3600;
+    pvt[9] = (secs / 60) % 60;
+    pvt[10] = secs % 60;
+    pvt[11] = 0x07;                                         // valid date, time, fully resolved
+    putLe(pvt, 16, centis * 10000000, 4);                   // nano
+    pvt[20] = 3;                                            // 3D fix
+    pvt[21] = 0x01;                                         // gnssFixOK
+    pvt[23] = 12;                                           // numSV
+    putLe(pvt, 24, (uint32_t)(int32_t)lround(lon * 1e7), 4);
+    putLe(pvt, 28, (uint32_t)(int32_t)lround(lat * 1e7), 4);
+    putLe(pvt, 32, (uint32_t)-14500, 4);                    // height, mm
+    putLe(pvt, 36, 15300, 4);                               // hMSL, mm
+    putLe(pvt, 40, 2100, 4);                                // hAcc, mm
+    putLe(pvt, 44, 3400, 4);                                // vAcc, mm
+    putLe(pvt, 60, 264, 4);                                 // gSpeed, mm/s
+    putLe(pvt, 64, 4510000, 4);                             // headMot, 1e-5 deg
+    putLe(pvt, 76, 124, 2);                                 // pDOP
+    appendUbx(out, 0x01, 0x07, pvt, sizeof(pvt));
+
+    uint8_t dop[18] = {};
+    putLe(dop, 0, (432000 + secs) * 1000 + centis * 10, 4);
+    putLe(dop, 6, 124, 2);                                  // pDOP
+    putLe(dop, 10, 102, 2);                                 // vDOP
+    putLe(dop, 12, 71, 2);                                  // hDOP
+    appendUbx(out, 0x01, 0x04, dop, sizeof(dop));
+}
+
+// Latitude/longitude in NMEA ddmm.mmmmm notation
+inline void formatNmeaCoord(char* buf, size_t size, double deg, bool is_lon) {
+    double abs_deg = (deg < 0.0) ? -deg : deg;
+    int whole = (int)abs_deg;
+    double minutes = (abs_deg - whole) * 60.0;
+    snprintf(buf, size, is_lon ? "%03d%08.5f" : "%02d%08.5f", whole, minutes);
+}
+
+struct CaptureOptions {
+    unsigned epochs = 600;          // number of navigation epochs
+    unsigned rate_hz = 10;          // navigation rate
+    bool nmea = true;               // standard NMEA sentences including GSV
+    bool pubx = true;               // PUBX POSITION and TIME sentences
+    bool ubx = true;                // periodic UBX ESF-STATUS and NAV-ODO frames
+    bool pvt = false;               // UBX NAV-PVT and NAV-DOP frames
+    size_t filler = 0;              // SPI 0xFF filler run after each group of messages
+};
+
+// Synthesize a recording of a receiver moving north-east at walking pace
+// with a stable fix
+inline std::vector<uint8_t> makeCapture(const CaptureOptions& options = CaptureOptions()) {
+    std::vector<uint8_t> out;
+    char body[256];
+    char lat_str[20];
+    char lon_str[20];
+
+    for (unsigned epoch = 0; epoch < options.epochs; epoch++) {
+        unsigned centis = epoch * (100 / options.rate_hz);
+        unsigned secs = 12 * 3600 + 34 * 60 + centis / 100;
+        unsigned hh = secs / 3600, mm = (secs / 60) % 60, ss = secs % 60;
+        double lat = 37.7749 + epoch * 1e-6;
+        double lon = -122.4194 + epoch * 1e-6;
+        formatNmeaCoord(lat_str, sizeof(lat_str), lat, false);
+        formatNmeaCoord(lon_str, sizeof(lon_str), lon, true);
+
+        if (options.nmea) {
+            snprintf(body, sizeof(body), "GNRMC,%02u%02u%02u.%02u,A,%s,N,%s,W,0.512,45.10,170921,,,A",
+                hh, mm, ss, centis % 100, lat_str, lon_str);
+            appendNmea(out, body);
+            snprintf(body, sizeof(body), "GNGGA,%02u%02u%02u.%02u,%s,N,%s,W,1,12,0.71,15.3,M,-29.8,M,,",
+                hh, mm, ss, centis % 100, lat_str, lon_str);
+            appendNmea(out, body);
+            appendNmea(out, "GNGSA,A,3,02,05,12,13,15,18,20,25,29,,,,1.24,0.71,1.02");
+            appendNmea(out, "GPGSV,4,1,13,02,30,176,41,05,65,103,45,12,13,322,36,13,27,052,40");
+            appendNmea(out, "GPGSV,4,2,13,15,48,058,46,18,70,221,44,20,21,110,38,25,36,299,43");
+            appendNmea(out, "GPGSV,4,3,13,29,52,256,47,31,08,212,30,33,45,234,40,46,45,210,39");
+            appendNmea(out, "GPGSV,4,4,13,48,44,209,41");
+            appendNmea(out, "GLGSV,2,1,06,65,38,284,40,66,17,330,33,72,27,223,37,81,55,061,44");
+            appendNmea(out, "GLGSV,2,2,06,82,66,168,45,88,22,027,35");
+            out.insert(out.end(), options.filler, 0xFF);
+        }
+        if (options.pubx) {
+            snprintf(body, sizeof(body), "PUBX,00,%02u%02u%02u.%02u,%s,N,%s,W,15.300,G3,2.1,3.4,0.949,45.10,0.010,,0.71,1.02,0.86,12,0,0",
+                hh, mm, ss, centis % 100, lat_str, lon_str);
+            appendNmea(out, body);
+            snprintf(body, sizeof(body), "PUBX,04,%02u%02u%02u.%02u,170921,%u.%02u,2176,18,-1234567,-123.456,21",
+                hh, mm, ss, centis % 100, 432000 + secs, centis % 100);
+            appendNmea(out, body);
+            out.insert(out.end(), options.filler, 0xFF);
+        }
+        if (options.pvt) {
+            appendNavPvt(out, secs, centis % 100, lat, lon);
+        }
+        if (options.ubx && (epoch % options.rate_hz) == 0) {
+            uint8_t esf_status[16] = {0x00, 0x10, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
+            appendUbx(out, 0x10, 0x10, esf_status, sizeof(esf_status));
+            uint8_t nav_odo[20] = {0x00, 0x00, 0x00, 0x00, (uint8_t)epoch, 0x00, 0x00, 0x00};
+            appendUbx(out, 0x01, 0x09, nav_odo, sizeof(nav_odo));
+            out.insert(out.end(), options.filler, 0xFF);
+        }
+    }
+
+    return out;
+}
+
+// AssistNow style blob of UBX MGA messages, UTC time followed by GPS
+// ephemerides and almanacs and GLONASS ephemerides
+inline std::vector<uint8_t> makeMgaBlob() {
+    std::vector<uint8_t> out;
+    uint8_t payload[68];
+
+    auto fill = [&](size_t len, uint8_t type, uint8_t sv) {
+        for (size_t i = 0; i < len; i++) {
+            payload[i] = (uint8_t)(i * 7 + sv);
+        }
+        payload[0] = type;
+        payload[1] = 0x00;                                  // version
+        payload[2] = sv;
+    };
+
+    fill(24, 0x10, 0);                                      // MGA-INI-TIME_UTC
+    appendUbx(out, 0x13, 0x40, payload, 24);
+    for (uint8_t sv = 1; sv <= 32; sv++) {
+        fill(68, 0x01, sv);                                 // MGA-GPS-EPH
+        appendUbx(out, 0x13, 0x00, payload, 68);
+    }
+    for (uint8_t sv = 1; sv <= 32; sv++) {
+        fill(36, 0x02, sv);                                 // MGA-GPS-ALM
+        appendUbx(out, 0x13, 0x00, payload, 36);
+    }
+    for (uint8_t sv = 1; sv <= 24; sv++) {
+        fill(48, 0x01, sv);                                 // MGA-GLO-EPH
+        appendUbx(out, 0x13, 0x06, payload, 48);
+    }
+    return out;
+}
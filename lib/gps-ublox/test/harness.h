@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Particle.h"
+#include "ubloxGPS.h"
+
+// Exposes the receive path of the driver so that tests can feed recorded
+// traffic without a running GPS thread
+class TestGPS : public ubloxGPS {
+public:
+    explicit TestGPS(USARTSerial& serial) :
+        ubloxGPS(serial, [](bool) { return true; }) {
+    }
+
+    TestGPS(SPIClass& spi, int tx_ready_mcu_pin = PIN_INVALID, int tx_ready_gps_pin = PIN_INVALID) :
+        ubloxGPS(spi, [](bool) { return true; }, [](bool) { return true; }, tx_ready_mcu_pin, tx_ready_gps_pin) {
+    }
+
+    using ubloxGPS::processBytes;
+    using ubloxGPS::processGPSBytes;
+    using ubloxGPS::serviceGPS;
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "Particle.h"
+#include "capture.h"
+
+// Simulated receiver answering the UBX traffic written by the driver.
+// Configuration writes are acknowledged and polls are answered from canned
+// responses. Frames are reassembled across writes as the driver sends sync,
+// body and checksum separately.
+//
+// CFG writes update the current configuration which answers CFG polls,
+// CFG-CFG saves it to battery backed RAM and powerCycle() reloads it from
+// there if the backup supply was kept.
+//
+// The on-board log is answered to LOG-INFO and streamed back one frame per
+// entry for LOG-RETRIEVE.
+//
+// MGA messages are answered with MGA-ACK-DATA0 once ackAiding is set with
+// CFG-NAVX5, and MGA-FLASH-DATA blocks are written to mga_flash in sequence.
+// A flash block sent before the previous block's ACK was output breaks the
+// MGA-FLASH sequence, it is counted in mga_flash_early and dropped.
+//
+// Replies are immediate unless latencies are set. Commands are then handled
+// one at a time taking process_ms each, and every reply is held back for a
+// further output_ms before it can be read from the port. A baudrate paces
+// bytes in both directions at that UART line rate.
+template<typename Port>
+class FakeReceiver {
+public:
+    struct Frame {
+        uint8_t msg_class;
+        uint8_t msg_id;
+        std::vector<uint8_t> payload;
+    };
+
+    explicit FakeReceiver(Port& port) : port_(port) {
+        // portable navigation model with automatic 2D/3D fix
+        std::vector<uint8_t> nav5(36, 0);
+        nav5[0] = nav5[1] = 0xFF;
+        nav5[3] = 3;
+        defaults_.settings[0x24] = nav5;
+        config_ = saved_ = defaults_;
+
+        port_.on_write = [this](const uint8_t* buf, size_t len) {
+            for (size_t i = 0; i < len; i++) {
+                feed(buf[i]);
+            }
+        };
+        port_.on_read = [this]() {
+            deliver();
+        };
+    }
+
+    ~FakeReceiver() {
+        port_.on_write = nullptr;
+        port_.on_read = nullptr;
+    }
+
+    // Canned response for a poll (zero length request) of class/id
+    void respond(uint8_t msg_class, uint8_t msg_id, const std::vector<uint8_t>& payload) {
+        responses_[std::make_pair(msg_class, msg_id)] = payload;
+    }
+
+    // Power the module off and on again, keeping the saved configuration
+    // only if the backup supply stayed up
+    void powerCycle(bool backup) {
+        if (!backup) {
+            saved_ = defaults_;
+        }
+        config_ = saved_;
+        pending_.clear();
+        rx_.clear();
+        line_us_ = 0;
+        in_line_us_ = 0;
+    }
+
+    // Append a LOG-RETRIEVEPOS entry
+    void logPosition(int32_t lat, int32_t lon, uint8_t second) {
+        std::vector<uint8_t> entry(40, 0);
+        putLe(entry.data(), 0, log.size(), 4);
+        putLe(entry.data(), 4, (uint32_t)lon, 4);
+        putLe(entry.data(), 8, (uint32_t)lat, 4);
+        putLe(entry.data(), 12, 15300, 4);                  // alt, mm
+        putLe(entry.data(), 16, 2100, 4);                   // hAcc, mm
+        entry[29] = 3;                                      // 3D fix
+        putLe(entry.data(), 30, 2021, 2);
+        entry[32] = 9;
+        entry[33] = 17;
+        entry[36] = second;
+        entry[38] = 12;                                     // numSV
+        log.emplace_back(0x0B, entry);
+    }
+
+    // Append a LOG-RETRIEVESTRING entry
+    void logString(const std::string& str) {
+        std::vector<uint8_t> entry(16, 0);
+        putLe(entry.data(), 0, log.size(), 4);
+        putLe(entry.data(), 6, 2021, 2);
+        putLe(entry.data(), 14, str.size(), 2);
+        entry.insert(entry.end(), str.begin(), str.end());
+        log.emplace_back(0x0D, entry);
+    }
+
+    size_t count(uint8_t msg_class, uint8_t msg_id) const {
+        size_t n = 0;
+        for (auto& frame : frames) {
+            if (frame.msg_class == msg_class && frame.msg_id == msg_id) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    std::vector<Frame> frames;              // every frame received, in order
+    bool ack = true;                        // reply ACK, otherwise NAK
+    std::set<std::pair<uint8_t, uint8_t>> nak;  // class/id always answered with NAK
+    bool silent = false;                    // drop all replies
+    uint32_t process_ms = 0;                // time to handle each command
+    uint32_t output_ms = 0;                 // delay before a reply is output
+    std::function<void(const Frame&)> on_frame;
+    uint32_t baudrate = 0;                  // UART line rate, unlimited if 0
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> log;  // LOG-RETRIEVE* ID and payload
+    std::set<uint32_t> corrupt;             // log entries output with a bad checksum, once
+    std::vector<uint8_t> mga_flash;         // AssistNow Offline data written to flash
+    bool mga_flash_stopped = false;         // MGA-FLASH-STOP was received
+    std::set<uint16_t> mga_retry;           // flash blocks answered with RETRY, once
+    size_t mga_flash_early = 0;             // flash blocks sent ahead of the last ACK
+
+private:
+    void feed(uint8_t c) {
+        rx_.push_back(c);
+        if (rx_.size() == 1 && c != 0xB5) {
+            rx_.clear();
+        } else if (rx_.size() == 2 && c != 0x62) {
+            rx_.clear();
+        } else if (rx_.size() >= 6 && rx_.size() == 8u + (rx_[4] | (rx_[5] << 8))) {
+            if (baudrate) {
+                // handled once its last byte has arrived on the line
+                in_line_us_ = std::max(in_line_us_, System.millis() * 1000) + rx_.size() * 10000000ull / baudrate;
+            }
+            Frame frame{rx_[2], rx_[3], std::vector<uint8_t>(rx_.begin() + 6, rx_.end() - 2)};
+            rx_.clear();
+            frames.push_back(frame);
+            reply(frame);
+        }
+    }
+
+    void reply(const Frame& frame) {
+        if (on_frame) {
+            on_frame(frame);
+        }
+        if (silent) {
+            return;
+        }
+
+        std::vector<uint8_t> out;
+        if (frame.msg_class == 0x21 && frame.msg_id == 0x09 && frame.payload.size() == 12) {
+            retrieve(frame);
+            return;
+        } else if (frame.msg_class == 0x21 && frame.msg_id == 0x08 && frame.payload.empty()) {
+            std::vector<uint8_t> info(48, 0);
+            putLe(info.data(), 24, log.size(), 4);
+            appendUbx(out, 0x21, 0x08, info.data(), info.size());
+        } else if (frame.msg_class == 0x13 && frame.msg_id == 0x21) {
+            flash(frame, out);
+        } else if (frame.msg_class == 0x13) {
+            auto navx5 = config_.settings.find(0x23);
+            if (navx5 != config_.settings.end() && navx5->second.size() > 17 && navx5->second[17]) {
+                bool used = !nak.count(std::make_pair(frame.msg_class, frame.msg_id));
+                uint8_t ack[8] = {(uint8_t)(used ? 1 : 0), 0x00, (uint8_t)(used ? 0 : 2), frame.msg_id};
+                std::copy_n(frame.payload.begin(), std::min<size_t>(4, frame.payload.size()), ack + 4);
+                appendUbx(out, 0x13, 0x60, ack, sizeof(ack));
+            }
+        } else if (frame.msg_class == 0x06) {
+            configure(frame, out);
+        } else if (frame.payload.empty()) {
+            auto it = responses_.find(std::make_pair(frame.msg_class, frame.msg_id));
+            if (it != responses_.end()) {
+                appendUbx(out, frame.msg_class, frame.msg_id, it->second.data(), it->second.size());
+            }
+        }
+        if (frame.msg_class == 0x06) {
+            bool accept = ack && !nak.count(std::make_pair(frame.msg_class, frame.msg_id));
+            appendAck(out, frame.msg_class, frame.msg_id, accept);
+        }
+        if (out.empty()) {
+            return;
+        }
+
+        uint64_t now = std::max(System.millis(), (in_line_us_ + 999) / 1000);
+        busy_until_ = std::max(busy_until_, now) + process_ms;
+        if (frame.msg_class == 0x13 && frame.msg_id == 0x21) {
+            mga_flash_ack_ms_ = busy_until_ + output_ms;
+        }
+        output(busy_until_ + output_ms, std::move(out));
+        deliver();
+    }
+
+    // Stream the requested entries, at most 256, starting at the first index
+    void retrieve(const Frame& frame) {
+        auto& p = frame.payload;
+        uint32_t start = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        uint32_t count = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+
+        uint64_t now = std::max(System.millis(), (in_line_us_ + 999) / 1000);
+        busy_until_ = std::max(busy_until_, now) + process_ms;
+        for (uint32_t i = start; i < log.size() && i - start < std::min(count, 256u); i++) {
+            std::vector<uint8_t> out;
+            appendUbx(out, 0x21, log[i].first, log[i].second.data(), log[i].second.size());
+            if (corrupt.erase(i)) {
+                out.back() ^= 0x5A;
+            }
+            output(busy_until_ + output_ms, std::move(out));
+        }
+        deliver();
+    }
+
+    void output(uint64_t ready, std::vector<uint8_t> out) {
+        if (baudrate) {
+            // 10 bits per byte on the line, kept in microseconds
+            line_us_ = std::max(line_us_, ready * 1000) + out.size() * 10000000ull / baudrate;
+            ready = (line_us_ + 999) / 1000;
+        }
+        pending_.emplace_back(ready, std::move(out));
+    }
+
+    void configure(const Frame& frame, std::vector<uint8_t>& out) {
+        const uint8_t CFG_MSG = 0x01, CFG_CFG = 0x09;
+        auto& p = frame.payload;
+
+        if (frame.msg_id == CFG_MSG && p.size() == 2) {
+            // message rate poll, unconfigured messages are off
+            auto key = std::make_pair(p[0], p[1]);
+            std::vector<uint8_t> rates = config_.rates.count(key) ? config_.rates[key] : std::vector<uint8_t>{p[0], p[1], 0, 0, 0, 0, 0, 0};
+            appendUbx(out, 0x06, CFG_MSG, rates.data(), rates.size());
+        } else if (frame.msg_id == CFG_MSG && p.size() == 8) {
+            config_.rates[std::make_pair(p[0], p[1])] = p;
+        } else if (frame.msg_id == CFG_CFG && p.size() >= 12) {
+            if (p[4] | p[5] | p[6] | p[7]) {
+                saved_ = config_;
+            }
+        } else if (p.empty()) {
+            auto it = config_.settings.find(frame.msg_id);
+            auto canned = responses_.find(std::make_pair(frame.msg_class, frame.msg_id));
+            if (it != config_.settings.end()) {
+                appendUbx(out, 0x06, frame.msg_id, it->second.data(), it->second.size());
+            } else if (canned != responses_.end()) {
+                appendUbx(out, 0x06, frame.msg_id, canned->second.data(), canned->second.size());
+            }
+        } else {
+            config_.settings[frame.msg_id] = p;
+        }
+    }
+
+    // Blocks out of sequence are dropped, as after a RETRY
+    void flash(const Frame& frame, std::vector<uint8_t>& out) {
+        auto& p = frame.payload;
+        if (p.size() >= 6 && p[0] == 0x01) {
+            uint16_t sequence = p[2] | (p[3] << 8);
+            uint16_t size = p[4] | (p[5] << 8);
+            if (System.millis() < mga_flash_ack_ms_) {
+                mga_flash_early++;
+                return;
+            }
+            if (sequence != mga_flash_sequence_) {
+                return;
+            }
+            uint8_t result = 0;
+            if (mga_retry.erase(sequence)) {
+                result = 1;
+            } else {
+                mga_flash.insert(mga_flash.end(), p.begin() + 6, p.begin() + 6 + size);
+                mga_flash_sequence_++;
+            }
+            uint8_t ack[6] = {0x03, 0x00, result, 0x00, (uint8_t)sequence, (uint8_t)(sequence >> 8)};
+            appendUbx(out, 0x13, 0x21, ack, sizeof(ack));
+        } else if (p.size() >= 2 && p[0] == 0x02) {
+            mga_flash_stopped = true;
+            mga_flash_sequence_ = 0;
+            uint8_t ack[6] = {0x03, 0x00, 0x00, 0x00, 0xFF, 0xFF};
+            appendUbx(out, 0x13, 0x21, ack, sizeof(ack));
+        }
+    }
+
+    void deliver() {
+        while (!pending_.empty() && pending_.front().first <= System.millis()) {
+            auto& out = pending_.front().second;
+            port_.push(out.data(), out.size());
+            pending_.pop_front();
+        }
+    }
+
+    struct Config {
+        std::map<std::pair<uint8_t, uint8_t>, std::vector<uint8_t>> rates;
+        std::map<uint8_t, std::vector<uint8_t>> settings;
+    };
+
+    Port& port_;
+    Config defaults_;
+    Config config_;
+    Config saved_;
+    uint64_t busy_until_ = 0;
+    uint64_t line_us_ = 0;
+    uint64_t in_line_us_ = 0;
+    uint16_t mga_flash_sequence_ = 0;
+    uint64_t mga_flash_ack_ms_ = 0;
+    std::deque<std::pair<uint64_t, std::vector<uint8_t>>> pending_;
+    std::vector<uint8_t> rx_;
+    std::map<std::pair<uint8_t, uint8_t>, std::vector<uint8_t>> responses_;
+};
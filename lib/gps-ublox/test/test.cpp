@@ -0,0 +1,1232 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include <thread>
+
+#include "harness.h"
+#include "capture.h"
+#include "receiver.h"
+
+static void feedBytewise(TestGPS& gps, const std::vector<uint8_t>& capture) {
+    for (auto c : capture) {
+        gps.processGPSBytes(&c, 1);
+    }
+}
+
+TEST_CASE("Block ingest") {
+    System.inc(10000);
+
+    SECTION("UART block ingest matches bytewise ingest") {
+        auto capture = makeCapture();
+        USARTSerial serial_block, serial_byte;
+        TestGPS block(serial_block), bytewise(serial_byte);
+
+        serial_block.push(capture.data(), capture.size());
+        block.processBytes();
+        feedBytewise(bytewise, capture);
+
+        REQUIRE(serial_block.rx.empty());
+        REQUIRE(block.getLatitude() == bytewise.getLatitude());
+        REQUIRE(block.getLongitude() == bytewise.getLongitude());
+        REQUIRE(block.getAltitude() == bytewise.getAltitude());
+        REQUIRE(block.getTime() == bytewise.getTime());
+        REQUIRE(block.getDate() == bytewise.getDate());
+        REQUIRE(block.getHorizontalAccuracy() == bytewise.getHorizontalAccuracy());
+        REQUIRE(block.getGpsStatus() == GPS_STATUS_LOCK);
+        REQUIRE(block.isLockStable() == bytewise.isLockStable());
+        REQUIRE(block.isLockStable());
+        REQUIRE(block.getPerfCounts().pos_report_count == bytewise.getPerfCounts().pos_report_count);
+        REQUIRE(block.getPerfCounts().time_report_count == bytewise.getPerfCounts().time_report_count);
+
+        ubx_nav_odo_t odo = {};
+        REQUIRE(block.getOdometer(odo));
+        REQUIRE(odo.iTOW == (590 & 0xff));
+    }
+
+    SECTION("SPI block ingest with filler") {
+        auto capture = makeCapture();
+        SPIClass spi;
+        TestGPS gps(spi);
+
+        spi.push(capture.data(), capture.size());
+        gps.processBytes();
+
+        REQUIRE(spi.rx.empty());
+        REQUIRE(gps.getGpsStatus() == GPS_STATUS_LOCK);
+        REQUIRE(gps.isLockStable());
+        REQUIRE(gps.getLatitude() == Approx(37.7749 + 599 * 1e-6));
+        REQUIRE(gps.getLongitude() == Approx(-122.4194 + 599 * 1e-6));
+    }
+
+    SECTION("Sentences split across chunks") {
+        CaptureOptions options;
+        options.epochs = 20;
+        auto capture = makeCapture(options);
+        USARTSerial serial;
+        TestGPS gps(serial);
+
+        // odd sized slices land sentence and frame boundaries mid-chunk
+        for (size_t i = 0; i < capture.size(); i += 7) {
+            gps.processGPSBytes(capture.data() + i, std::min<size_t>(7, capture.size() - i));
+        }
+        REQUIRE(gps.getLock());
+        REQUIRE(gps.getLatitude() == Approx(37.7749 + 19 * 1e-6));
+        REQUIRE(gps.getLongitude() == Approx(-122.4194 + 19 * 1e-6));
+        REQUIRE(gps.getPerfCounts().time_report_count > 0);
+    }
+
+    SECTION("Parsing resumes after expected frame") {
+        USARTSerial serial;
+        TestGPS gps(serial);
+
+        // the ACK is immediately followed by another UBX frame and NMEA text
+        // that must not be parsed until after the request completes
+        std::vector<uint8_t> response;
+        appendAck(response, UBX_CLASS_LOG, UBX_LOG_CREATE);
+        uint8_t nav_odo[20] = {0x00, 0x00, 0x00, 0x00, 0x2a};
+        appendUbx(response, UBX_CLASS_NAV, UBX_NAV_ODO, nav_odo, sizeof(nav_odo));
+        appendNmea(response, "GNGGA,123456.00,3746.49400,N,12225.16400,W,1,12,0.71,15.3,M,-29.8,M,,");
+        serial.on_write = [&](const uint8_t*, size_t) {
+            serial.push(response.data(), response.size());
+            response.clear();
+        };
+
+        ubx_nav_odo_t odo = {};
+        REQUIRE(gps.createLog());
+        REQUIRE_FALSE(gps.getOdometer(odo));
+        REQUIRE(gps.getLatitude() == 0.0);
+
+        gps.processBytes();
+        REQUIRE(gps.getOdometer(odo));
+        REQUIRE(odo.iTOW == 0x2a);
+        REQUIRE(gps.getLatitude() == Approx(37.7749));
+    }
+}
+
+TEST_CASE("NAV-PVT fix pipeline") {
+    System.inc(10000);
+
+    CaptureOptions nmea_options;
+    nmea_options.epochs = 50;
+    nmea_options.ubx = false;
+    CaptureOptions pvt_options = nmea_options;
+    pvt_options.nmea = false;
+    pvt_options.pubx = false;
+    pvt_options.pvt = true;
+
+    SECTION("PVT frames match the NMEA path") {
+        auto nmea_capture = makeCapture(nmea_options);
+        auto pvt_capture = makeCapture(pvt_options);
+        USARTSerial serial_nmea, serial_pvt;
+        TestGPS nmea(serial_nmea), pvt(serial_pvt);
+
+        serial_nmea.push(nmea_capture.data(), nmea_capture.size());
+        nmea.processBytes();
+        serial_pvt.push(pvt_capture.data(), pvt_capture.size());
+        pvt.processBytes();
+
+        REQUIRE(pvt_capture.size() * 4 < nmea_capture.size());
+        REQUIRE(pvt.getLock());
+        REQUIRE(pvt.getGpsStatus() == GPS_STATUS_LOCK);
+        REQUIRE(pvt.isLockStable());
+        REQUIRE(pvt.getFixQuality() == nmea.getFixQuality());
+        REQUIRE(pvt.getLatitude() == Approx(nmea.getLatitude()).margin(1e-6));
+        REQUIRE(pvt.getLongitude() == Approx(nmea.getLongitude()).margin(1e-6));
+        REQUIRE(pvt.getAltitude() == Approx(nmea.getAltitude()));
+        REQUIRE(pvt.getGeoIdHeight() == Approx(nmea.getGeoIdHeight()));
+        REQUIRE(pvt.getSpeed(GPS_SPEED_UNIT_MPS) == Approx(nmea.getSpeed(GPS_SPEED_UNIT_MPS)).margin(0.001));
+        REQUIRE(pvt.getHeading() == Approx(nmea.getHeading()));
+        REQUIRE(pvt.getHorizontalAccuracy() == Approx(nmea.getHorizontalAccuracy()));
+        REQUIRE(pvt.getVerticalAccuracy() == Approx(nmea.getVerticalAccuracy()));
+        REQUIRE(pvt.getHDOP() == Approx(nmea.getHDOP()));
+        REQUIRE(pvt.getVDOP() == Approx(nmea.getVDOP()));
+        REQUIRE(pvt.getSatellites() == nmea.getSatellites());
+        REQUIRE(pvt.getTime() == nmea.getTime());
+        REQUIRE(pvt.getDate() == nmea.getDate());
+        REQUIRE(pvt.getUTCTime() == nmea.getUTCTime());
+        REQUIRE(pvt.getPerfCounts().pos_report_count > 0);
+    }
+
+    SECTION("No fix reported without gnssFixOK") {
+        USARTSerial serial;
+        TestGPS gps(serial);
+        std::vector<uint8_t> good;
+        appendNavPvt(good, 45295, 0, 37.7749, -122.4194);
+        gps.processGPSBytes(good.data(), good.size());
+        REQUIRE(gps.getFixQuality() == 1);
+
+        std::vector<uint8_t> frame;
+        appendNavPvt(frame, 45296, 0, 38.0, -123.0);
+        frame[6 + 21] = 0x00;   // clear gnssFixOK, checksum recomputed below
+        uint8_t a = 0, b = 0;
+        for (size_t i = 2; i < 6 + 92; i++) {
+            a += frame[i];
+            b += a;
+        }
+        frame[6 + 92] = a;
+        frame[6 + 93] = b;
+
+        gps.processGPSBytes(frame.data(), frame.size());
+        REQUIRE(gps.getFixQuality() == 0);
+        REQUIRE_FALSE(gps.getLock());
+        // the position is only taken from solutions with gnssFixOK
+        REQUIRE(gps.getLatitude() == Approx(37.7749));
+        REQUIRE(gps.getLongitude() == Approx(-122.4194));
+    }
+
+    SECTION("PVT output is configured on the receiver") {
+        USARTSerial serial;
+        TestGPS gps(serial);
+        std::vector<std::pair<uint8_t, uint8_t>> enabled;
+
+        // acknowledge every CFG-MSG and record the messages given a non-zero
+        // rate, the frame body is written separately from sync and checksum
+        serial.on_write = [&](const uint8_t* buf, size_t len) {
+            if (len >= 7 && buf[0] == UBX_CLASS_CFG && buf[1] == UBX_CFG_MSG) {
+                if (buf[6] != 0) {
+                    enabled.emplace_back(buf[4], buf[5]);
+                }
+                std::vector<uint8_t> ack;
+                appendAck(ack, UBX_CLASS_CFG, UBX_CFG_MSG);
+                serial.push(ack.data(), ack.size());
+            }
+        };
+
+        REQUIRE(gps.enablePVT(1));
+        REQUIRE(enabled.size() == 2);
+        REQUIRE(enabled[0] == std::make_pair((uint8_t)UBX_CLASS_NAV, (uint8_t)UBX_NAV_PVT));
+        REQUIRE(enabled[1] == std::make_pair((uint8_t)UBX_CLASS_NAV, (uint8_t)UBX_NAV_DOP));
+        REQUIRE(gps.disablePVT());
+        REQUIRE(enabled.size() == 2);
+        REQUIRE(gps.getPerfCounts().enable_pvt_error_count == 0);
+    }
+}
+
+TEST_CASE("Fix snapshot") {
+    System.inc(10000);
+
+    SECTION("Snapshot matches the getters") {
+        auto capture = makeCapture();
+        USARTSerial serial;
+        TestGPS gps(serial);
+
+        serial.push(capture.data(), capture.size());
+        gps.processBytes();
+
+        ubx_fix_snapshot_t fix;
+        gps.getFix(fix);
+        REQUIRE(fix.locked == gps.getLock());
+        REQUIRE(fix.stable == gps.isLockStable());
+        REQUIRE(fix.latitude == gps.getLatitude());
+        REQUIRE(fix.longitude == gps.getLongitude());
+        REQUIRE(fix.altitude == gps.getAltitude());
+        REQUIRE(fix.speed == gps.getSpeed(GPS_SPEED_UNIT_MPS));
+        REQUIRE(fix.heading == gps.getHeading());
+        REQUIRE(fix.horizontalAccuracy == gps.getHorizontalAccuracy());
+        REQUIRE(fix.verticalAccuracy == gps.getVerticalAccuracy());
+        REQUIRE(fix.horizontalDop == gps.getHDOP());
+        REQUIRE(fix.verticalDop == gps.getVDOP());
+        REQUIRE(fix.epochTime == gps.getUTCTime());
+        REQUIRE(fix.fix == gps.getFixQuality());
+
+        // lock ages out without any further reports
+        System.inc(11000);
+        gps.getFix(fix);
+        REQUIRE_FALSE(fix.locked);
+        REQUIRE_FALSE(fix.stable);
+        REQUIRE(fix.lockedDuration == 0);
+        REQUIRE_FALSE(gps.isLockStable());
+    }
+
+    SECTION("Readers never observe a torn value") {
+        struct Pattern {
+            uint32_t words[24];
+        };
+        SeqLock<Pattern> seqlock;
+        std::atomic<bool> done(false);
+        std::atomic<int> torn(0);
+        std::atomic<long> reads(0);
+
+        auto reader = [&]() {
+            uint32_t last = 0;
+            while (!done) {
+                auto value = seqlock.load();
+                for (auto word : value.words) {
+                    if (word != value.words[0]) {
+                        torn++;
+                    }
+                }
+                if (value.words[0] < last) {
+                    torn++;
+                }
+                last = value.words[0];
+                reads++;
+            }
+        };
+        std::thread readers[] = {std::thread(reader), std::thread(reader), std::thread(reader)};
+
+        for (uint32_t i = 1; i <= 200000; i++) {
+            Pattern value;
+            for (auto& word : value.words) {
+                word = i;
+            }
+            seqlock.store(value);
+        }
+        done = true;
+        for (auto& t : readers) {
+            t.join();
+        }
+
+        REQUIRE(torn == 0);
+        REQUIRE(reads > 0);
+        REQUIRE(seqlock.sequence() == 200000);
+        REQUIRE(seqlock.load().words[0] == 200000);
+    }
+
+    SECTION("Readers see fields from a single epoch while parsing") {
+        auto capture = makeCapture();
+        USARTSerial serial;
+        TestGPS gps(serial);
+        std::atomic<bool> done(false);
+        std::atomic<int> mismatched(0);
+        std::atomic<long> locked_reads(0);
+
+        // every epoch moves latitude and longitude by the same amount so any
+        // mix of two epochs shows up as a different offset
+        auto reader = [&]() {
+            while (!done) {
+                ubx_fix_snapshot_t fix;
+                gps.getFix(fix);
+                if (fix.locked) {
+                    double lat_step = fix.latitude - 37.7749;
+                    double lon_step = fix.longitude + 122.4194;
+                    if (std::fabs(lat_step - lon_step) > 1e-9) {
+                        mismatched++;
+                    }
+                    locked_reads++;
+                }
+            }
+        };
+        std::thread readers[] = {std::thread(reader), std::thread(reader)};
+
+        for (unsigned repeat = 0; repeat < 10; repeat++) {
+            for (size_t i = 0; i < capture.size(); i += 64) {
+                gps.processGPSBytes(capture.data() + i, std::min<size_t>(64, capture.size() - i));
+            }
+        }
+        done = true;
+        for (auto& t : readers) {
+            t.join();
+        }
+
+        REQUIRE(mismatched == 0);
+        REQUIRE(locked_reads > 0);
+    }
+}
+
+TEST_CASE("SPI tx ready ingest") {
+    System.inc(10000);
+
+    static const uint16_t MCU_PIN = 10;
+    static const uint16_t GPS_PIN = 11;
+    SPIClass spi;
+    TestGPS gps(spi, MCU_PIN, GPS_PIN);
+
+    // tx ready is asserted (low) while the simulated module has bytes queued
+    digitalReadHook = [&](uint16_t pin) {
+        return (pin == MCU_PIN && !spi.rx.empty()) ? LOW : HIGH;
+    };
+    NAMED_SCOPE_GUARD(resetHook, {
+        digitalReadHook = nullptr;
+    });
+
+    SECTION("Power on configures tx ready and parses filler separated traffic") {
+        FakeReceiver<SPIClass> receiver(spi);
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_PRT) == 1);
+
+        CaptureOptions options;
+        options.epochs = 100;
+        options.filler = 40;
+        auto capture = makeCapture(options);
+        auto useful = capture.size() - std::count(capture.begin(), capture.end(), 0xFF);
+
+        USARTSerial serial;
+        TestGPS reference(serial);
+        serial.push(capture.data(), capture.size());
+        reference.processBytes();
+
+        spi.bytes_clocked = 0;
+        spi.push(capture.data(), capture.size());
+        gps.processBytes();
+
+        REQUIRE(spi.rx.empty());
+        REQUIRE(gps.getLatitude() == reference.getLatitude());
+        REQUIRE(gps.getLongitude() == reference.getLongitude());
+        REQUIRE(gps.getTime() == reference.getTime());
+        REQUIRE(gps.getPerfCounts().pos_report_count == reference.getPerfCounts().pos_report_count);
+        ubx_nav_odo_t odo = {};
+        REQUIRE(gps.getOdometer(odo));
+        REQUIRE(odo.iTOW == 90);
+
+        // reading stops when tx ready deasserts rather than after a chunk of
+        // only filler, at most the tail of the final chunk is wasted
+        REQUIRE(spi.bytes_clocked < capture.size() + 128);
+        REQUIRE(spi.bytes_clocked >= useful);
+
+        // a spurious tx ready event with nothing queued clocks nothing
+        spi.bytes_clocked = 0;
+        gps.processBytes();
+        REQUIRE(spi.bytes_clocked == 0);
+    }
+
+    SECTION("0xFF bytes inside UBX frames are not treated as filler") {
+        std::vector<uint8_t> data(100, 0xFF);
+        uint8_t nav_odo[20];
+        memset(nav_odo, 0xFF, sizeof(nav_odo));
+        nav_odo[4] = 0x2a;
+        nav_odo[5] = nav_odo[6] = nav_odo[7] = 0x00;
+        // frame straddles the first chunk boundary with 0xFF on both sides
+        std::vector<uint8_t> frame;
+        appendUbx(frame, UBX_CLASS_NAV, UBX_NAV_ODO, nav_odo, sizeof(nav_odo));
+        data.insert(data.begin() + 50, frame.begin(), frame.end());
+        appendNmea(data, "GNGGA,123456.00,3746.49400,N,12225.16400,W,1,12,0.71,15.3,M,-29.8,M,,");
+
+        spi.push(data.data(), data.size());
+        gps.processBytes();
+
+        ubx_nav_odo_t odo = {};
+        REQUIRE(gps.getOdometer(odo));
+        REQUIRE(odo.iTOW == 0x2a);
+        REQUIRE(odo.distance == 0xFFFFFFFF);
+        REQUIRE(gps.getLatitude() == Approx(37.7749));
+    }
+
+    SECTION("Without tx ready reading continues until a chunk of only filler") {
+        digitalReadHook = nullptr;
+        auto capture = makeCapture();
+        spi.push(capture.data(), capture.size());
+        gps.processBytes();
+
+        REQUIRE(spi.rx.empty());
+        REQUIRE(gps.getLatitude() == Approx(37.7749 + 599 * 1e-6));
+        REQUIRE(spi.bytes_clocked > capture.size());
+        REQUIRE(std::all_of(spi.rx.begin(), spi.rx.end(), [](uint8_t c) { return c == 0xFF; }));
+    }
+}
+
+TEST_CASE("Pipelined configuration") {
+    System.inc(10000);
+
+    USARTSerial serial;
+    TestGPS gps(serial);
+    FakeReceiver<USARTSerial> receiver(serial);
+    // assumed module timing, a few ms to apply each command and the reply
+    // then waiting for the next output slot
+    receiver.process_ms = 2;
+    receiver.output_ms = 20;
+
+    SECTION("Power on configures the module in one transaction") {
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+
+        auto& result = gps.getConfigResult();
+        REQUIRE(result.count == 18);
+        REQUIRE(result.acked == result.count);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_MSG) == 15);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_GNSS) == 1);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_PMS) == 1);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_NAV5) == 1);
+        for (size_t i = 0; i < result.count; i++) {
+            REQUIRE(result.commands[i].result == UBX_CFG_RESULT_ACK);
+            REQUIRE(result.commands[i].latency >= receiver.process_ms + receiver.output_ms);
+        }
+        // a few round trips in total rather than one per command
+        REQUIRE(result.elapsed < 4 * (receiver.process_ms + receiver.output_ms) + result.count * receiver.process_ms);
+        REQUIRE(gps.getPerfCounts().getTotalErrors() == 0);
+    }
+
+    SECTION("Transaction is faster than waiting for each ACK") {
+        auto t0 = System.millis();
+        REQUIRE(gps.enableNMEA(1, 30));
+        auto sequential = System.millis() - t0;
+
+        gps.lock();
+        gps.beginConfig();
+        REQUIRE(gps.enableNMEA(1, 30));
+        REQUIRE(receiver.frames.size() == 8);
+        REQUIRE(gps.commitConfig() == SYSTEM_ERROR_NONE);
+        gps.unlock();
+
+        REQUIRE(receiver.frames.size() == 16);
+        REQUIRE(gps.getConfigResult().count == 8);
+        REQUIRE(gps.getConfigResult().elapsed * 4 < sequential);
+    }
+
+    SECTION("Replies with the same class and ID are matched in order") {
+        // reject only the GSV rate so the NAK must land on the fourth command
+        receiver.on_frame = [&](const FakeReceiver<USARTSerial>::Frame& frame) {
+            receiver.ack = !(frame.msg_id == UBX_CFG_MSG && frame.payload[1] == UBX_NEMA_GSV);
+        };
+
+        gps.lock();
+        gps.beginConfig();
+        REQUIRE(gps.enableNMEA(1, 30));
+        REQUIRE(gps.commitConfig() == SYSTEM_ERROR_IO);
+        gps.unlock();
+
+        auto& result = gps.getConfigResult();
+        REQUIRE(result.acked == 7);
+        REQUIRE(result.naked == 1);
+        for (size_t i = 0; i < result.count; i++) {
+            REQUIRE(result.commands[i].result == ((i == 3) ? UBX_CFG_RESULT_NAK : UBX_CFG_RESULT_ACK));
+            if (i > 0) {
+                REQUIRE(result.commands[i].latency >= result.commands[i - 1].latency);
+            }
+        }
+        REQUIRE(gps.getPerfCounts().config_nak_count == 1);
+    }
+
+    SECTION("Rejected command fails power on") {
+        receiver.nak.insert(std::make_pair((uint8_t)UBX_CLASS_CFG, (uint8_t)UBX_CFG_NAV5));
+
+        REQUIRE(gps.on() == SYSTEM_ERROR_IO);
+        REQUIRE(gps.isError());
+
+        auto& result = gps.getConfigResult();
+        REQUIRE(result.naked == 1);
+        REQUIRE(result.acked == result.count - 1);
+        REQUIRE(result.commands[result.count - 1].msg_id == UBX_CFG_NAV5);
+        REQUIRE(result.commands[result.count - 1].result == UBX_CFG_RESULT_NAK);
+    }
+
+    SECTION("Missing reply times out without holding up the rest") {
+        receiver.on_frame = [&](const FakeReceiver<USARTSerial>::Frame& frame) {
+            receiver.silent = (frame.msg_id == UBX_CFG_GNSS);
+        };
+
+        gps.lock();
+        gps.beginConfig();
+        REQUIRE(gps.setGNSS(UBX_GNSS_TYPE_GPS));
+        REQUIRE(gps.setPower(UBX_POWER_MODE_FULL_POWER));
+        REQUIRE(gps.setMode(UBX_DYNAMIC_MODEL_PORTABLE));
+        REQUIRE(gps.commitConfig() == SYSTEM_ERROR_IO);
+        gps.unlock();
+
+        auto& result = gps.getConfigResult();
+        REQUIRE(result.commands[0].result == UBX_CFG_RESULT_TIMEOUT);
+        REQUIRE(result.commands[1].result == UBX_CFG_RESULT_ACK);
+        REQUIRE(result.commands[2].result == UBX_CFG_RESULT_ACK);
+        REQUIRE(result.commands[2].latency < 100);
+        REQUIRE(result.timeouts == 1);
+        REQUIRE(result.elapsed > 3000);
+        REQUIRE(result.elapsed < 3100);
+        REQUIRE(gps.getPerfCounts().timeouts == 1);
+    }
+
+    SECTION("Queue overflow and misuse are reported") {
+        REQUIRE(gps.commitConfig() == SYSTEM_ERROR_INVALID_STATE);
+
+        gps.lock();
+        gps.beginConfig();
+        for (size_t i = 0; i < UBX_CFG_TRANSACTION_MAX_COMMANDS; i++) {
+            REQUIRE(gps.configMsg(UBX_CLASS_NAV, UBX_NAV_ODO, 1));
+        }
+        REQUIRE_FALSE(gps.configMsg(UBX_CLASS_NAV, UBX_NAV_ODO, 1));
+        REQUIRE(gps.commitConfig() == SYSTEM_ERROR_TOO_LARGE);
+        gps.unlock();
+
+        REQUIRE(gps.getConfigResult().overflow);
+        REQUIRE(gps.getConfigResult().acked == UBX_CFG_TRANSACTION_MAX_COMMANDS);
+
+        // commands are sent one at a time again afterwards
+        receiver.frames.clear();
+        REQUIRE(gps.configMsg(UBX_CLASS_NAV, UBX_NAV_ODO, 1));
+        REQUIRE(receiver.frames.size() == 1);
+    }
+}
+
+TEST_CASE("Saved configuration") {
+    System.inc(10000);
+
+    USARTSerial serial;
+    TestGPS gps(serial);
+    FakeReceiver<USARTSerial> receiver(serial);
+    receiver.process_ms = 2;
+    receiver.output_ms = 20;
+
+    REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+    REQUIRE_FALSE(gps.getConfigResult().skipped);
+    REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_CFG) == 1);
+    auto sent = gps.getConfigResult().count;
+    REQUIRE(gps.getPerfCounts().config_sent_count == sent);
+    gps.off();
+
+    SECTION("Warm wake confirms the saved configuration instead of sending it") {
+        receiver.powerCycle(true);
+        receiver.frames.clear();
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+
+        auto& result = gps.getConfigResult();
+        REQUIRE(result.skipped);
+        REQUIRE(result.count == sent);
+        for (size_t i = 0; i < result.count; i++) {
+            REQUIRE(result.commands[i].result == UBX_CFG_RESULT_SKIPPED);
+        }
+        // baudrate, then one navigation model and one message rate poll
+        REQUIRE(receiver.frames.size() == 3);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_PRT) == 1);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_NAV5) == 1);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_MSG) == 1);
+
+        auto counts = gps.getPerfCounts();
+        REQUIRE(counts.config_sent_count == sent);
+        REQUIRE(counts.config_skipped_count == sent);
+        REQUIRE(counts.config_saved_ms > 0);
+        REQUIRE(counts.getTotalErrors() == 0);
+    }
+
+    SECTION("Module that lost its backup supply is configured again") {
+        receiver.powerCycle(false);
+        receiver.frames.clear();
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+
+        REQUIRE_FALSE(gps.getConfigResult().skipped);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_MSG) == sent - 3 + 1);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_CFG) == 1);
+        REQUIRE(gps.getPerfCounts().config_sent_count == 2 * sent);
+        REQUIRE(gps.getPerfCounts().config_skipped_count == 0);
+
+        // saved again so the next warm wake is skipped
+        gps.off();
+        receiver.powerCycle(true);
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.getConfigResult().skipped);
+    }
+
+    SECTION("Changed configuration is sent") {
+        receiver.powerCycle(true);
+        REQUIRE(gps.on(UBX_DYNAMIC_MODEL_AUTOMOTIVE) == SYSTEM_ERROR_NONE);
+        REQUIRE_FALSE(gps.getConfigResult().skipped);
+        REQUIRE(gps.getPerfCounts().config_sent_count == 2 * sent);
+
+        gps.off();
+        receiver.powerCycle(true);
+        REQUIRE(gps.on(UBX_DYNAMIC_MODEL_AUTOMOTIVE) == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.getConfigResult().skipped);
+    }
+
+    SECTION("Failed save is not trusted") {
+        receiver.nak.insert(std::make_pair((uint8_t)UBX_CLASS_CFG, (uint8_t)UBX_CFG_CFG));
+        receiver.powerCycle(false);
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+
+        gps.off();
+        receiver.powerCycle(true);
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+        REQUIRE_FALSE(gps.getConfigResult().skipped);
+    }
+}
+
+TEST_CASE("Asynchronous requests") {
+    System.inc(10000);
+
+    USARTSerial serial;
+    TestGPS gps(serial);
+    FakeReceiver<USARTSerial> receiver(serial);
+    REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+    receiver.frames.clear();
+    receiver.process_ms = 2;
+    receiver.output_ms = 20;
+
+    uint8_t nav_odo[20] = {0x00, 0x00, 0x00, 0x00, 0x2a};
+    receiver.respond(UBX_CLASS_NAV, UBX_NAV_ODO, std::vector<uint8_t>(nav_odo, nav_odo + sizeof(nav_odo)));
+    uint8_t esf_status[16] = {0x00, 0x10, 0x00, 0x00, 0x02};
+    receiver.respond(UBX_CLASS_ESF, UBX_ESF_STATUS, std::vector<uint8_t>(esf_status, esf_status + sizeof(esf_status)));
+
+    struct Completion {
+        int handle;
+        ubx_request_status_t status;
+        uint8_t msg_class;
+        uint8_t msg_id;
+    };
+    std::vector<Completion> completions;
+    auto record = [&](int handle, ubx_request_status_t status, const ubx_msg_t* rsp) {
+        completions.push_back({handle, status, rsp ? rsp->msg_class : (uint8_t)UBX_CLASS_INVALID, rsp ? rsp->msg_id : (uint8_t)UBX_ID_INVALID});
+    };
+
+    // run the GPS thread until nothing is outstanding, one ms at a time
+    auto runUntilIdle = [&](std::vector<int> handles) {
+        for (unsigned ms = 0; ms < 10000; ms++) {
+            gps.serviceGPS(false);
+            bool idle = true;
+            for (auto handle : handles) {
+                auto status = gps.getRequestStatus(handle);
+                idle = idle && status != UBX_REQUEST_QUEUED && status != UBX_REQUEST_PENDING;
+            }
+            if (idle) {
+                return;
+            }
+            System.inc(1);
+        }
+    };
+
+    SECTION("Requests return immediately and complete together") {
+        uint8_t rate[] = {UBX_CLASS_CFG, UBX_CFG_MSG, 0x08, 0x00, UBX_CLASS_NAV, UBX_NAV_ODO, 1, 1, 1, 1, 1, 1};
+
+        auto t0 = System.millis();
+        int odo = gps.updateOdometerAsync(record);
+        int esf = gps.updateEsfStatusAsync(record);
+        int cfg = gps.requestAsync(rate, sizeof(rate), UBX_REQ_FLAGS_EXPECT_ACK, UBX_CLASS_INVALID, UBX_ID_INVALID, record);
+        REQUIRE(odo > 0);
+        REQUIRE(esf > 0);
+        REQUIRE(cfg > 0);
+        // nothing touched the module or the clock in the calling thread
+        REQUIRE(System.millis() == t0);
+        REQUIRE(receiver.frames.empty());
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_QUEUED);
+
+        // all in flight at once after a single pass of the GPS thread
+        gps.serviceGPS(false);
+        REQUIRE(receiver.frames.size() == 3);
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_PENDING);
+
+        runUntilIdle({odo, esf, cfg});
+        REQUIRE(System.millis() - t0 < 2 * (receiver.process_ms + receiver.output_ms));
+        REQUIRE(completions.size() == 3);
+        REQUIRE(completions[0].handle == odo);
+        REQUIRE(completions[0].status == UBX_REQUEST_RESPONSE);
+        REQUIRE(completions[0].msg_id == UBX_NAV_ODO);
+        REQUIRE(completions[1].handle == esf);
+        REQUIRE(completions[1].status == UBX_REQUEST_RESPONSE);
+        REQUIRE(completions[2].handle == cfg);
+        REQUIRE(completions[2].status == UBX_REQUEST_ACK);
+        REQUIRE(completions[2].msg_class == UBX_CLASS_ACK);
+
+        // pollable without a callback, parsed data is already updated
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_RESPONSE);
+        ubx_nav_odo_t odometer = {};
+        REQUIRE(gps.getOdometer(odometer));
+        REQUIRE(odometer.iTOW == 0x2a);
+    }
+
+    SECTION("Missing reply times out without holding up other requests") {
+        receiver.on_frame = [&](const FakeReceiver<USARTSerial>::Frame& frame) {
+            receiver.silent = (frame.msg_class == UBX_CLASS_LOG);
+        };
+
+        auto t0 = System.millis();
+        int log = gps.getLogInfoAsync(record);
+        int odo = gps.updateOdometerAsync(record);
+        runUntilIdle({odo});
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_RESPONSE);
+        REQUIRE(gps.getRequestStatus(log) == UBX_REQUEST_PENDING);
+
+        runUntilIdle({log});
+        REQUIRE(gps.getRequestStatus(log) == UBX_REQUEST_TIMEOUT);
+        REQUIRE(System.millis() - t0 >= UBX_ASYNC_REQUEST_TIMEOUT_MS);
+        REQUIRE(System.millis() - t0 < UBX_ASYNC_REQUEST_TIMEOUT_MS + 10);
+        REQUIRE(completions.back().handle == log);
+        REQUIRE(completions.back().msg_class == UBX_CLASS_INVALID);
+        REQUIRE(gps.getPerfCounts().timeouts == 1);
+    }
+
+    SECTION("Per request timeout") {
+        receiver.silent = true;
+        uint8_t poll[] = {UBX_CLASS_NAV, UBX_NAV_ODO, 0x00, 0x00};
+        int odo = gps.requestAsync(poll, sizeof(poll), 0x00, UBX_CLASS_NAV, UBX_NAV_ODO, nullptr, 100);
+        auto t0 = System.millis();
+        runUntilIdle({odo});
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_TIMEOUT);
+        REQUIRE(System.millis() - t0 == 100);
+    }
+
+    SECTION("GPS thread waits out a held lock") {
+        int odo = gps.updateOdometerAsync(record);
+        std::atomic<bool> released(false);
+        bool waited = false;
+
+        // the pass can't take the lock, it must wait for it rather than
+        // come straight back to a zero yield timeout for the queued request
+        gps.lock();
+        std::thread service([&]() {
+            gps.serviceGPS(false);
+            waited = released;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        released = true;
+        gps.unlock();
+        service.join();
+        REQUIRE(waited);
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_QUEUED);
+
+        runUntilIdle({odo});
+        REQUIRE(gps.getRequestStatus(odo) == UBX_REQUEST_RESPONSE);
+    }
+
+    SECTION("Rejected command completes with NAK") {
+        receiver.ack = false;
+        uint8_t rate[] = {UBX_CLASS_CFG, UBX_CFG_MSG, 0x08, 0x00, UBX_CLASS_NAV, UBX_NAV_ODO, 1, 1, 1, 1, 1, 1};
+        int cfg = gps.requestAsync(rate, sizeof(rate), UBX_REQ_FLAGS_EXPECT_ACK, UBX_CLASS_INVALID, UBX_ID_INVALID, record);
+        runUntilIdle({cfg});
+        REQUIRE(gps.getRequestStatus(cfg) == UBX_REQUEST_NAK);
+        REQUIRE(completions.size() == 1);
+        REQUIRE(completions[0].msg_id == UBX_ACK_NAK);
+    }
+
+    SECTION("Slots, stale handles and power off") {
+        std::vector<int> handles;
+        for (size_t i = 0; i < UBX_ASYNC_MAX_REQUESTS; i++) {
+            handles.push_back(gps.updateOdometerAsync(record));
+            REQUIRE(handles.back() > 0);
+        }
+        REQUIRE(gps.updateOdometerAsync(record) == SYSTEM_ERROR_LIMIT_EXCEEDED);
+
+        gps.serviceGPS(false);
+        gps.off();
+        REQUIRE(completions.size() == UBX_ASYNC_MAX_REQUESTS);
+        for (auto& completion : completions) {
+            REQUIRE(completion.status == UBX_REQUEST_CANCELLED);
+        }
+        REQUIRE(gps.updateOdometerAsync(record) == SYSTEM_ERROR_INVALID_STATE);
+
+        // a reused slot invalidates the old handle
+        REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+        int handle = gps.updateOdometerAsync(record);
+        REQUIRE(handle > 0);
+        REQUIRE(handle != handles[0]);
+        REQUIRE(gps.getRequestStatus(handles[0]) == SYSTEM_ERROR_NOT_FOUND);
+        REQUIRE(gps.getRequestStatus(0) == SYSTEM_ERROR_NOT_FOUND);
+
+        std::vector<uint8_t> big(UBX_ASYNC_REQUEST_MAX_LEN + 1);
+        REQUIRE(gps.requestAsync(big.data(), big.size(), 0x00) == SYSTEM_ERROR_INVALID_ARGUMENT);
+    }
+}
+
+TEST_CASE("Log retrieval") {
+    System.inc(10000);
+
+    USARTSerial serial;
+    TestGPS gps(serial);
+    FakeReceiver<USARTSerial> receiver(serial);
+    REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+    receiver.frames.clear();
+    receiver.process_ms = 2;
+    receiver.output_ms = 20;
+    receiver.baudrate = 115200;
+
+    const uint32_t ENTRIES = 3000;
+    for (uint32_t i = 0; i < ENTRIES; i++) {
+        if (i % 100 == 99) {
+            receiver.logString("wake " + std::to_string(i));
+        } else {
+            receiver.logPosition(377749000 + i, -1224194000 - i, i % 60);
+        }
+    }
+
+    std::vector<ubx_log_entry_t> storage(300);
+    ubx_log_ring_t ring(storage.data(), storage.size());
+    std::vector<ubx_log_entry_t> track;
+    auto drain = [&]() {
+        ubx_log_entry_t entry;
+        while (ring.pop(entry)) {
+            track.push_back(entry);
+        }
+    };
+    auto checkTrack = [&](uint32_t first, uint32_t count) {
+        REQUIRE(track.size() == count);
+        for (uint32_t i = 0; i < count; i++) {
+            auto& entry = track[i];
+            uint32_t index = first + i;
+            REQUIRE(entry.index == index);
+            if (index % 100 == 99) {
+                std::string str = "wake " + std::to_string(index);
+                REQUIRE(entry.type == UBX_LOG_RETRIEVESTRING);
+                REQUIRE(entry.byte_count == str.size());
+                REQUIRE(std::string((const char*)entry.bytes, entry.byte_count) == str);
+            } else {
+                REQUIRE(entry.type == UBX_LOG_RETRIEVEPOS);
+                REQUIRE(entry.lat == (int32_t)(377749000 + index));
+                REQUIRE(entry.lon == (int32_t)(-1224194000 - index));
+                REQUIRE(entry.fix == UBX_LOG_POS_FIX_3D);
+                REQUIRE(entry.num_satellites == 12);
+                REQUIRE(entry.year == 2021);
+                REQUIRE(entry.second == index % 60);
+            }
+        }
+    };
+
+    SECTION("Whole log is streamed through a smaller ring") {
+        ubx_log_retrieval_t retrieval;
+        REQUIRE(gps.beginLogRetrieval(retrieval) == SYSTEM_ERROR_NONE);
+        REQUIRE(retrieval.next_index == 0);
+        REQUIRE(retrieval.end_index == ENTRIES);
+
+        auto t0 = System.millis();
+        while (!retrieval.done()) {
+            int ret = gps.retrieveLog(retrieval, ring);
+            REQUIRE(ret > 0);
+            REQUIRE(ret <= (int)storage.size());
+            drain();
+        }
+        checkTrack(0, ENTRIES);
+        REQUIRE(retrieval.retrieved == ENTRIES);
+        REQUIRE(retrieval.retries == 0);
+        REQUIRE(retrieval.requests == receiver.count(UBX_CLASS_LOG, UBX_LOG_RETRIEVE));
+        REQUIRE(retrieval.elapsed == System.millis() - t0);
+
+        // close to the line rate rather than one round trip per entry, a
+        // position entry is 48 bytes on the wire
+        double line_rate = 115200.0 / 10 / 48;
+        double rate = 1000.0 * ENTRIES / retrieval.elapsed;
+        REQUIRE(rate > 0.8 * line_rate);
+        REQUIRE(gps.getPerfCounts().timeouts == 0);
+    }
+
+    SECTION("Range is clamped to the log") {
+        ubx_log_retrieval_t retrieval;
+        REQUIRE(gps.beginLogRetrieval(retrieval, ENTRIES - 10, 100) == SYSTEM_ERROR_NONE);
+        REQUIRE(retrieval.next_index == ENTRIES - 10);
+        REQUIRE(retrieval.end_index == ENTRIES);
+        REQUIRE(gps.retrieveLog(retrieval, ring) == 10);
+        REQUIRE(retrieval.done());
+        drain();
+        checkTrack(ENTRIES - 10, 10);
+
+        REQUIRE(gps.beginLogRetrieval(retrieval, ENTRIES + 5) == SYSTEM_ERROR_NONE);
+        REQUIRE(retrieval.done());
+        REQUIRE(gps.retrieveLog(retrieval, ring) == 0);
+    }
+
+    SECTION("Lost entries are requested again") {
+        receiver.corrupt = {0, 17, 255, 700, 701};
+        ubx_log_retrieval_t retrieval;
+        REQUIRE(gps.beginLogRetrieval(retrieval, 0, 1000) == SYSTEM_ERROR_NONE);
+        while (!retrieval.done()) {
+            REQUIRE(gps.retrieveLog(retrieval, ring) > 0);
+            drain();
+        }
+        checkTrack(0, 1000);
+        // entries after a lost one are dropped until its range ends, the
+        // range with 255 lost as well is only ended by the timeout
+        REQUIRE(retrieval.retries == 2);
+        REQUIRE(gps.getPerfCounts().timeouts == 1);
+    }
+
+    SECTION("Interrupted retrieval resumes where it stopped") {
+        receiver.on_frame = [&](const FakeReceiver<USARTSerial>::Frame& frame) {
+            if (frame.msg_class == UBX_CLASS_LOG && frame.msg_id == UBX_LOG_RETRIEVE) {
+                receiver.silent = receiver.count(UBX_CLASS_LOG, UBX_LOG_RETRIEVE) >= 2;
+            }
+        };
+        ubx_log_retrieval_t retrieval;
+        REQUIRE(gps.beginLogRetrieval(retrieval) == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.retrieveLog(retrieval, ring) == UBX_LOG_RETRIEVE_ENTRY_COUNT_MAX);
+        drain();
+        REQUIRE(gps.retrieveLog(retrieval, ring) == SYSTEM_ERROR_TIMEOUT);
+        REQUIRE(retrieval.next_index == UBX_LOG_RETRIEVE_ENTRY_COUNT_MAX);
+
+        receiver.on_frame = nullptr;
+        receiver.silent = false;
+        while (!retrieval.done()) {
+            REQUIRE(gps.retrieveLog(retrieval, ring) > 0);
+            drain();
+        }
+        checkTrack(0, ENTRIES);
+
+        gps.off();
+        REQUIRE(gps.retrieveLog(retrieval, ring) == SYSTEM_ERROR_INVALID_STATE);
+    }
+
+    SECTION("Ring is drained concurrently") {
+        const size_t COUNT = 100000;
+        std::vector<uint32_t> values(7);
+        SpscRing<uint32_t> numbers(values.data(), values.size());
+        std::thread producer([&]() {
+            for (uint32_t i = 0; i < COUNT; ) {
+                if (numbers.push(i)) {
+                    i++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        uint32_t expected = 0;
+        while (expected < COUNT) {
+            uint32_t value;
+            if (numbers.pop(value)) {
+                REQUIRE(value == expected);
+                expected++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        REQUIRE(numbers.size() == 0);
+        REQUIRE(numbers.space() == values.size());
+    }
+}
+
+TEST_CASE("MGA injection") {
+    System.inc(10000);
+
+    USARTSerial serial;
+    TestGPS gps(serial);
+    FakeReceiver<USARTSerial> receiver(serial);
+    REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+    receiver.frames.clear();
+    receiver.process_ms = 2;
+    receiver.output_ms = 20;
+    receiver.baudrate = 115200;
+
+    const char* path = "mga_blob_test.ubx";
+    auto blob = makeMgaBlob();
+    auto writeBlob = [&](const std::vector<uint8_t>& data) {
+        FILE* file = fopen(path, "wb");
+        REQUIRE(file);
+        REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+        fclose(file);
+    };
+    writeBlob(blob);
+    const size_t MESSAGES = 1 + 32 + 32 + 24;
+
+    // MGA messages as received by the module, re-encoded
+    auto injected = [&]() {
+        std::vector<uint8_t> out;
+        for (auto& frame : receiver.frames) {
+            if (frame.msg_class == UBX_CLASS_MGA) {
+                appendUbx(out, frame.msg_class, frame.msg_id, frame.payload.data(), frame.payload.size());
+            }
+        }
+        return out;
+    };
+
+    SECTION("Blob is streamed with a window of outstanding messages") {
+        std::vector<ubx_mga_inject_result_t> progress;
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT, 8, [&](const ubx_mga_inject_result_t& p) {
+            progress.push_back(p);
+        }) == SYSTEM_ERROR_NONE);
+
+        auto result = gps.getMGAResult();
+        REQUIRE(result.total_bytes == blob.size());
+        REQUIRE(result.acked_bytes == blob.size());
+        REQUIRE(result.acked == MESSAGES);
+        REQUIRE(result.rejected == 0);
+        REQUIRE(result.throughput() > 0);
+        REQUIRE(injected() == blob);
+
+        // MGA-ACK-DATA0 was enabled first
+        REQUIRE(receiver.frames[0].msg_class == UBX_CLASS_CFG);
+        REQUIRE(receiver.frames[0].msg_id == UBX_CFG_NAVX5);
+        REQUIRE(receiver.frames[0].payload[17] == 1);
+
+        REQUIRE(progress.size() > 1);
+        for (size_t i = 1; i < progress.size(); i++) {
+            REQUIRE(progress[i].acked > progress[i - 1].acked);
+            REQUIRE(progress[i].elapsed >= progress[i - 1].elapsed);
+        }
+        REQUIRE(progress.back().acked_bytes == blob.size());
+
+        // waiting for each ACK in turn costs a round trip per message
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT, 1) == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.getMGAResult().acked == MESSAGES);
+        REQUIRE(result.elapsed * 3 < gps.getMGAResult().elapsed);
+    }
+
+    SECTION("Messages the module does not use are counted") {
+        receiver.nak = {std::make_pair(UBX_CLASS_MGA, 0x06)};
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.getMGAResult().acked == MESSAGES);
+        REQUIRE(gps.getMGAResult().rejected == 24);
+    }
+
+    SECTION("Offline blob is stored in receiver flash") {
+        receiver.mga_retry = {2};
+        // a window is only used for direct injection, each block waits on
+        // the ACK of the one before
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_FLASH, 4) == SYSTEM_ERROR_NONE);
+        REQUIRE(receiver.mga_flash_early == 0);
+        auto result = gps.getMGAResult();
+        REQUIRE(result.acked == (blob.size() + UBX_MGA_FLASH_DATA_MAX_LEN - 1) / UBX_MGA_FLASH_DATA_MAX_LEN);
+        REQUIRE(result.acked_bytes == blob.size());
+        REQUIRE(result.retries == 1);
+        REQUIRE(receiver.mga_flash == blob);
+        REQUIRE(receiver.mga_flash_stopped);
+        REQUIRE(receiver.count(UBX_CLASS_CFG, UBX_CFG_NAVX5) == 0);
+
+        // the flash write sequence is finished and may be started again
+        REQUIRE(gps.startWriteMGA());
+        gps.abortWriteMGA();
+    }
+
+    SECTION("Errors") {
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT, 0) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT, UBX_MGA_INJECT_WINDOW_MAX + 1) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        REQUIRE(gps.injectMGA("no_such_blob.ubx", UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_FILE);
+
+        REQUIRE(gps.startWriteMGA());
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_FLASH) == SYSTEM_ERROR_BUSY);
+        gps.abortWriteMGA();
+
+        auto corrupt = blob;
+        corrupt[100] ^= 0x01;
+        writeBlob(corrupt);
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_BAD_DATA);
+        writeBlob(blob);
+
+        receiver.on_frame = [&](const FakeReceiver<USARTSerial>::Frame& frame) {
+            receiver.silent = (frame.msg_class == UBX_CLASS_MGA);
+        };
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_TIMEOUT);
+        receiver.on_frame = nullptr;
+        receiver.silent = false;
+
+        receiver.ack = false;
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_IO);
+        receiver.ack = true;
+
+        gps.off();
+        REQUIRE(gps.injectMGA(path, UBX_MGA_INJECT_DIRECT) == SYSTEM_ERROR_INVALID_STATE);
+    }
+
+    remove(path);
+}
+
+TEST_CASE("Geofence wake") {
+    System.inc(10000);
+
+    static const uint16_t MCU_PIN = 10;
+    static const uint16_t GPS_PIN = 14;
+    SPIClass spi;
+    TestGPS gps(spi, MCU_PIN, GPS_PIN);
+    FakeReceiver<SPIClass> receiver(spi);
+
+    digitalReadHook = [&](uint16_t pin) {
+        return (pin == MCU_PIN && !spi.rx.empty()) ? LOW : HIGH;
+    };
+    NAMED_SCOPE_GUARD(resetHook, {
+        digitalReadHook = nullptr;
+    });
+    REQUIRE(gps.on() == SYSTEM_ERROR_NONE);
+    receiver.frames.clear();
+
+    auto navGeofence = [](uint8_t status, uint8_t comb_state) {
+        std::vector<uint8_t> payload = {0x10, 0x27, 0x00, 0x00, 0x00, status, 0x02, comb_state,
+                                        comb_state, 0x00, UBX_GEOFENCE_STATE_OUTSIDE, 0x01};
+        return payload;
+    };
+    auto last = [&](uint8_t msg_id) {
+        for (auto it = receiver.frames.rbegin(); it != receiver.frames.rend(); ++it) {
+            if (it->msg_class == UBX_CLASS_CFG && it->msg_id == msg_id) {
+                return it->payload;
+            }
+        }
+        return std::vector<uint8_t>();
+    };
+    auto txReadyEnabled = [&]() {
+        return (last(UBX_CFG_PRT).at(2) & 0x01) != 0;
+    };
+
+    ubx_geofence_t geofence;
+    REQUIRE(geofence.addGeofence(37.7749295, -122.4194155, 150.25));
+    REQUIRE(geofence.addGeofence(-33.8688197, 151.2092955, 2000.0));
+
+    SECTION("Circles are encoded twelve bytes apart") {
+        REQUIRE(gps.setGeofence(geofence));
+
+        auto p = last(UBX_CFG_GEOFENCE);
+        REQUIRE(p.size() == 8 + 2 * 12);
+        REQUIRE(p[1] == 2);
+        REQUIRE(p[4] == 0);
+        auto le = [&](size_t offset) {
+            return (int32_t)(p[offset] | (p[offset + 1] << 8) | (p[offset + 2] << 16) | ((uint32_t)p[offset + 3] << 24));
+        };
+        REQUIRE(le(8) == 377749295);
+        REQUIRE(le(12) == -1224194155);
+        REQUIRE(le(16) == 15025);
+        REQUIRE(le(20) == -338688197);
+        REQUIRE(le(24) == 1512092955);
+        REQUIRE(le(28) == 200000);
+
+        // a fifth circle doesn't fit and NAK is reported
+        REQUIRE(geofence.addGeofence(1.0, 1.0, 1.0));
+        REQUIRE(geofence.addGeofence(2.0, 2.0, 2.0));
+        REQUIRE_FALSE(geofence.addGeofence(3.0, 3.0, 3.0));
+        receiver.nak.insert(std::make_pair(UBX_CLASS_CFG, UBX_CFG_GEOFENCE));
+        REQUIRE_FALSE(gps.setGeofence(geofence));
+
+        geofence.init();
+        REQUIRE(geofence.numFences == 0);
+        REQUIRE(geofence.lat[3] == 0);
+    }
+
+    SECTION("PIO carries the combined state once the receiver has evaluated it") {
+        size_t polls = 0;
+        receiver.respond(UBX_CLASS_NAV, UBX_NAV_GEOFENCE, navGeofence(0, UBX_GEOFENCE_STATE_UNKNOWN));
+        receiver.on_frame = [&](const FakeReceiver<SPIClass>::Frame& frame) {
+            if (frame.msg_class == UBX_CLASS_NAV && frame.msg_id == UBX_NAV_GEOFENCE && ++polls == 3) {
+                receiver.respond(UBX_CLASS_NAV, UBX_NAV_GEOFENCE, navGeofence(1, UBX_GEOFENCE_STATE_INSIDE));
+            }
+        };
+
+        REQUIRE(gps.setGeofenceWake(geofence) == SYSTEM_ERROR_NONE);
+        REQUIRE(gps.isGeofenceWakeEnabled());
+        REQUIRE(polls == 3);
+        REQUIRE_FALSE(txReadyEnabled());
+        auto p = last(UBX_CFG_GEOFENCE);
+        REQUIRE(p[1] == 2);
+        REQUIRE(p[4] == 1);
+        REQUIRE(p[5] == UBX_GEOFENCE_PIO_LOW_INSIDE);
+        REQUIRE(p[6] == GPS_PIN);
+
+        ubx_nav_geofence_t state;
+        REQUIRE(gps.getGeofenceState(state));
+        REQUIRE(state.known());
+        REQUIRE(state.num_fences == 2);
+        REQUIRE(state.fences[1].state == UBX_GEOFENCE_STATE_OUTSIDE);
+
+        REQUIRE(gps.clearGeofenceWake() == SYSTEM_ERROR_NONE);
+        REQUIRE_FALSE(gps.isGeofenceWakeEnabled());
+        REQUIRE(txReadyEnabled());
+        REQUIRE(last(UBX_CFG_GEOFENCE).size() == 8);
+        REQUIRE(last(UBX_CFG_GEOFENCE)[1] == 0);
+    }
+
+    SECTION("Without a fix tx ready is restored after one epoch") {
+        receiver.respond(UBX_CLASS_NAV, UBX_NAV_GEOFENCE, navGeofence(1, UBX_GEOFENCE_STATE_UNKNOWN));
+        auto t0 = System.millis();
+        REQUIRE(gps.setGeofenceWake(geofence) == SYSTEM_ERROR_TIMEOUT);
+        REQUIRE(System.millis() - t0 >= UBX_NAV_EPOCH_DEFAULT);
+        REQUIRE(System.millis() - t0 < UBX_NAV_EPOCH_DEFAULT + UBX_GEOFENCE_POLL_INTERVAL);
+        REQUIRE_FALSE(gps.isGeofenceWakeEnabled());
+        REQUIRE(txReadyEnabled());
+        REQUIRE(last(UBX_CFG_GEOFENCE).size() == 8);
+
+        // a faster navigation rate shortens the wait
+        REQUIRE(gps.setRate(5));
+        t0 = System.millis();
+        REQUIRE(gps.setGeofenceWake(geofence) == SYSTEM_ERROR_TIMEOUT);
+        REQUIRE(System.millis() - t0 >= 200);
+        REQUIRE(System.millis() - t0 < 2 * 200);
+        REQUIRE_FALSE(gps.isGeofenceWakeEnabled());
+    }
+
+    SECTION("Invalid requests") {
+        REQUIRE(gps.setGeofenceWake(ubx_geofence_t()) == SYSTEM_ERROR_INVALID_ARGUMENT);
+
+        receiver.nak.insert(std::make_pair(UBX_CLASS_CFG, UBX_CFG_GEOFENCE));
+        REQUIRE(gps.setGeofenceWake(geofence) == SYSTEM_ERROR_IO);
+        // the fences couldn't be cleared either, reads keep polling until they are
+        REQUIRE(gps.isGeofenceWakeEnabled());
+        REQUIRE_FALSE(txReadyEnabled());
+        receiver.nak.clear();
+        REQUIRE(gps.clearGeofenceWake() == SYSTEM_ERROR_NONE);
+        REQUIRE(txReadyEnabled());
+
+        gps.off();
+        REQUIRE(gps.setGeofenceWake(geofence) == SYSTEM_ERROR_INVALID_STATE);
+
+        USARTSerial serial;
+        TestGPS uart(serial);
+        REQUIRE(uart.setGeofenceWake(geofence) == SYSTEM_ERROR_NOT_SUPPORTED);
+    }
+}
@@ -39,7 +39,7 @@ LocationService::LocationService()
 
 }
 
-int LocationService::begin(bool fastLock) {
+int LocationService::begin(bool fastLock, bool pvtMode) {
     CHECK_FALSE(gps_, SYSTEM_ERROR_INVALID_STATE);
 
     pinMode(UBLOX_CS_PIN, OUTPUT);
@@ -68,6 +68,7 @@ int LocationService::begin(bool fastLock) {
         }
 
         setFastLock(fastLock);
+        setPvtMode(pvtMode);
         return SYSTEM_ERROR_NONE;
     } while (false);
 
@@ -102,6 +103,20 @@ bool LocationService::getFastLock() {
     return false;
 }
 
+void LocationService::setPvtMode(bool enable) {
+    if (gps_) {
+        gps_->setPvtMode(enable);
+    }
+}
+
+bool LocationService::getPvtMode() {
+    if (gps_) {
+        return gps_->getPvtMode();
+    }
+
+    return false;
+}
+
 int LocationService::start(bool restart) {
     CHECK_TRUE(gps_, SYSTEM_ERROR_INVALID_STATE);
 
@@ -130,27 +145,42 @@ int LocationService::stop() {
     return ret;
 }
 
+int LocationService::enableGeofenceWake(const ubx_geofence_t& geofence) {
+    CHECK_TRUE(gps_, SYSTEM_ERROR_INVALID_STATE);
+    CHECK_TRUE(gps_->isOn(), SYSTEM_ERROR_INVALID_STATE);
+
+    return gps_->setGeofenceWake(geofence);
+}
+
+int LocationService::disableGeofenceWake() {
+    CHECK_TRUE(gps_, SYSTEM_ERROR_INVALID_STATE);
+
+    return gps_->clearGeofenceWake();
+}
+
 int LocationService::getLocation(LocationPoint& point) {
     point.type = LocationType::DEVICE;
     point.sources.append(LocationSource::GNSS);
 
-    WITH_LOCK(*gps_) {
-        point.locked = (gps_->getLock()) ? 1 : 0;
-        point.stable = gps_->isLockStable();
-        point.lockedDuration = gps_->getLockDuration();
-        point.epochTime = (time_t)gps_->getUTCTime();
-        point.timeScale = LocationTimescale::TIMESCALE_UTC;
-        if (point.locked) {
-            point.latitude = gps_->getLatitude();
-            point.longitude = gps_->getLongitude();
-            point.altitude = gps_->getAltitude();
-            point.speed = gps_->getSpeed(GPS_SPEED_UNIT_MPS);
-            point.heading = gps_->getHeading();
-            point.horizontalAccuracy = gps_->getHorizontalAccuracy();
-            point.horizontalDop = gps_->getHDOP();
-            point.verticalAccuracy = gps_->getVerticalAccuracy();
-            point.verticalDop = gps_->getVDOP();
-        }
+    // single consistent snapshot published by the GPS thread, no GPS lock
+    ubx_fix_snapshot_t fix;
+    gps_->getFix(fix);
+
+    point.locked = (fix.locked) ? 1 : 0;
+    point.stable = fix.stable;
+    point.lockedDuration = fix.lockedDuration;
+    point.epochTime = (time_t)fix.epochTime;
+    point.timeScale = LocationTimescale::TIMESCALE_UTC;
+    if (point.locked) {
+        point.latitude = fix.latitude;
+        point.longitude = fix.longitude;
+        point.altitude = fix.altitude;
+        point.speed = fix.speed;
+        point.heading = fix.heading;
+        point.horizontalAccuracy = fix.horizontalAccuracy;
+        point.horizontalDop = fix.horizontalDop;
+        point.verticalAccuracy = fix.verticalAccuracy;
+        point.verticalDop = fix.verticalDop;
     }
 
     return SYSTEM_ERROR_NONE;
@@ -129,7 +129,7 @@ public:
      * @retval SYSTEM_ERROR_INVALID_ARGUMENT
      * @retval SYSTEM_ERROR_IO
      */
-    int begin(bool fastLock = false);
+    int begin(bool fastLock = false, bool pvtMode = false);
 
     /**
      * @brief Set the GNSS fast lock
@@ -146,6 +146,21 @@ public:
      */
     bool getFastLock();
 
+    /**
+     * @brief Set binary UBX-NAV-PVT output from the GNSS, takes effect the next time it is started
+     *
+     * @param enable Enable UBX-NAV-PVT output instead of NMEA/PUBX text
+     */
+    void setPvtMode(bool enable);
+
+    /**
+     * @brief Get binary UBX-NAV-PVT output from the GNSS
+     *
+     * @return true UBX-NAV-PVT output is enabled
+     * @return false NMEA/PUBX text output is enabled
+     */
+    bool getPvtMode();
+
     /**
      * @brief Start the location service
      *
@@ -256,6 +271,27 @@ public:
         return gps_->is_active();
     };
 
+    /**
+     * @brief Have the GNSS module evaluate geofences and signal crossings on its tx ready pin
+     *
+     * @param geofence Circles to evaluate
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_STATE
+     * @retval SYSTEM_ERROR_INVALID_ARGUMENT
+     * @retval SYSTEM_ERROR_IO
+     * @retval SYSTEM_ERROR_TIMEOUT
+     */
+    int enableGeofenceWake(const ubx_geofence_t& geofence);
+
+    /**
+     * @brief Clear the GNSS module geofences and restore the tx ready pin
+     *
+     * @retval SYSTEM_ERROR_NONE
+     * @retval SYSTEM_ERROR_INVALID_STATE
+     * @retval SYSTEM_ERROR_IO
+     */
+    int disableGeofenceWake();
+
 private:
 
     LocationService();
@@ -574,7 +574,7 @@ int Tracker::init()
     // Register our own configuration settings
     registerConfig();
 
-    ret = locationService.begin(_deviceConfig.enableFastLock());
+    ret = locationService.begin(_deviceConfig.enableFastLock(), _deviceConfig.enablePvt());
     if (ret)
     {
         Log.error("Failed to begin location service");
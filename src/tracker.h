@@ -55,6 +55,11 @@
 #define TRACKER_CONFIG_ENABLE_FAST_LOCK       (false)
 #endif
 
+#ifndef TRACKER_CONFIG_ENABLE_PVT
+// Enable or disable binary UBX-NAV-PVT GNSS output instead of NMEA, see TrackerConfiguration below
+#define TRACKER_CONFIG_ENABLE_PVT             (false)
+#endif
+
 #ifndef TRACKER_CONFIG_GNSS_RETRY_COUNT
 // GNSS initialization retry count, see TrackerConfiguration below
 #define TRACKER_CONFIG_GNSS_RETRY_COUNT       (1)
@@ -90,6 +95,7 @@ public:
         _enableIo(TRACKER_CONFIG_ENABLE_IO),
         _enableIoSleep(TRACKER_CONFIG_ENABLE_IO_SLEEP),
         _enableFastLock(TRACKER_CONFIG_ENABLE_FAST_LOCK),
+        _enablePvt(TRACKER_CONFIG_ENABLE_PVT),
         _gnssRetryCount(TRACKER_CONFIG_GNSS_RETRY_COUNT) {
 
     }
@@ -163,6 +169,27 @@ public:
         return _enableFastLock;
     }
 
+    /**
+     * @brief Enable or disable binary UBX-NAV-PVT GNSS output instead of NMEA/PUBX text.
+     *
+     * @param enable Decode fixes from UBX-NAV-PVT frames
+     * @return TrackerConfiguration&
+     */
+    TrackerConfiguration& enablePvt(bool enable) {
+        _enablePvt = enable;
+        return *this;
+    }
+
+    /**
+     * @brief Indicate if binary UBX-NAV-PVT GNSS output is enabled.
+     *
+     * @return true UBX-NAV-PVT output is enabled
+     * @return false NMEA/PUBX text output is enabled
+     */
+    bool enablePvt() const {
+        return _enablePvt;
+    }
+
     /**
      * @brief Set GNSS initialization retry count.
      *
@@ -190,6 +217,7 @@ public:
         this->_enableIo = rhs._enableIo;
         this->_enableIoSleep = rhs._enableIoSleep;
         this->_enableFastLock = rhs._enableFastLock;
+        this->_enablePvt = rhs._enablePvt;
         this->_gnssRetryCount = rhs._gnssRetryCount;
 
         return *this;
@@ -198,6 +226,7 @@ private:
     bool _enableIo;
     bool _enableIoSleep;
     bool _enableFastLock;
+    bool _enablePvt;
     unsigned int _gnssRetryCount;
 };
 
@@ -301,6 +330,26 @@ class Tracker {
             return locationService.getFastLock();;
         }
 
+        /**
+         * @brief Set binary UBX-NAV-PVT GNSS output, takes effect the next time the GNSS is powered on
+         *
+         * @param enable Enable UBX-NAV-PVT output
+         */
+        void setPvtMode(bool enable) {
+            _deviceConfig.enablePvt(enable);
+            locationService.setPvtMode(enable);
+        }
+
+        /**
+         * @brief Get binary UBX-NAV-PVT GNSS output
+         *
+         * @return true UBX-NAV-PVT output is enabled
+         * @return false NMEA/PUBX text output is enabled
+         */
+        bool getPvtMode() const {
+            return locationService.getPvtMode();
+        }
+
         /**
          * @brief Enable battery charging
          *
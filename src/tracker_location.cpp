@@ -35,6 +35,7 @@ static constexpr uint32_t WifiPowerScanSec = 1; // seconds - time to wait for Wi
 
 static constexpr size_t EnhancedLocationQueueSize = 5; // up to this many elements
 static constexpr size_t ObjectEstimateWpsHeaderSize = sizeof(",{\"wps\":[]}") - 1 /* null */;
+static constexpr size_t ObjectEstimateBatchSize = sizeof("{\"cmd\":\"loc\",\"time\":4294967295,\"trig\":[\"time\",\"err\"],\"locs\":[],\"req_id\":4294967295}") - 1 /* null */;
 static constexpr size_t ObjectEstimateWpsDataSize = sizeof("{\"bssid\":\"00:11:22:33:44:55\",\"ch\":99,\"str\":-999},") - 1 /* null */;
 
 static int set_radius_cb(double value, const void *context)
@@ -138,8 +139,9 @@ void TrackerLocation::init(unsigned int gnssRetries)
 
     ConfigService::instance().registerModule(location_desc);
 
-    static ConfigObject geofence_desc("geofence", {
-        ConfigInt("interval", &_geofenceConfig.interval, 0, 86400l),
+    // the zones are kept in static storage and referenced by the module
+    // rather than copied onto the heap
+    static ConfigObject geofence_zones[] = {
         ConfigObject("zone1", {
             ConfigBool("enable", &_geofence.GetZoneInfo(0).enable),
             ConfigFloat("lat", &_geofence.GetZoneInfo(0).center_lat),
@@ -200,6 +202,15 @@ void TrackerLocation::init(unsigned int gnssRetries)
                 {"polygonal", (int32_t) GeofenceShapeType::POLYGONAL}
             }, &_geofence.GetZoneInfo(3).shape_type)
         }),
+    };
+
+    static ConfigObject geofence_desc("geofence", {
+        ConfigInt("interval", &_geofenceConfig.interval, 0, 86400l),
+        ConfigBool("receiver", &_geofenceConfig.receiver),
+        &geofence_zones[0],
+        &geofence_zones[1],
+        &geofence_zones[2],
+        &geofence_zones[3],
     });
     ConfigService::instance().registerModule(geofence_desc);
 
@@ -207,6 +218,22 @@ void TrackerLocation::init(unsigned int gnssRetries)
 
     _last_location_publish_sec = System.uptime() - _config_state.interval_min_seconds;
 
+#if TRACKER_LOCATION_BATCHING
+    // a full batch leaves room in the event for the rest of the publish
+    _batch.set_capacity(particle::protocol::MAX_EVENT_DATA_LENGTH - ObjectEstimateBatchSize);
+#endif
+
+    _publishQueue.set_budget(TRACKER_LOCATION_QUEUE_SESSION_BUDGET);
+    int rval = _publishQueue.open();
+    if(rval)
+    {
+        Log.error("location queue open failed %d", rval);
+    }
+    else
+    {
+        Log.info("location queue has %u publishes pending", _publishQueue.pending());
+    }
+
     _sleep.registerSleepPrepare([this](TrackerSleepContext context){ this->onSleepPrepare(context); });
     _sleep.registerSleep([this](TrackerSleepContext context){ this->onSleep(context); });
     _sleep.registerSleepCancel([this](TrackerSleepContext context){ this->onSleepCancel(context); });
@@ -367,13 +394,16 @@ void TrackerLocation::issue_location_publish_callbacks(CloudServiceStatus status
 
 int TrackerLocation::location_publish_cb(CloudServiceStatus status, JSONValue *rsp_root, const char *req_event, const void *context)
 {
-    bool issue_callbacks = true;
+    // sequence number of the queued publish, 0 if it was sent without
+    // being queued
+    uint32_t seq = (uint32_t) (uintptr_t) context;
+    bool retry = false;
 
     if(status == CloudServiceStatus::SUCCESS)
     {
         // this could either be on the Particle Cloud ack (default) OR the
         // end-to-end ACK
-        Log.info("location cb publish %lu success!", *(uint32_t *) context);
+        Log.info("location cb publish %lu success!", seq);
         _first_publish = false;
         _pending_first_publish = false;
     }
@@ -383,103 +413,82 @@ int TrackerLocation::location_publish_cb(CloudServiceStatus status, JSONValue *r
         // once Particle Cloud passes if waiting on end-to-end it will
         // only ever timeout
 
-        // save on failure for retry
-        if(req_event && !location_publish_retry_str)
-        {
-            size_t len = strlen(req_event) + 1;
-            location_publish_retry_str = (char *) malloc(len);
-            if(location_publish_retry_str)
-            {
-                memcpy(location_publish_retry_str, req_event, len);
-                // we've saved for retry, defer callbacks until retry completes
-                issue_callbacks = false;
-            }
-        }
-        Log.info("location cb publish %lu failure", *(uint32_t *) context);
+        // the publish is queued for retry, callbacks are deferred until
+        // the retry completes
+        retry = true;
+        Log.info("location cb publish %lu failure", seq);
     }
     else if(status == CloudServiceStatus::TIMEOUT)
     {
-        Log.info("location cb publish %lu timeout", *(uint32_t *) context);
+        Log.info("location cb publish %lu timeout", seq);
     }
     else
     {
-        Log.info("location cb publish %lu unexpected status: %d", *(uint32_t *) context, status);
+        Log.info("location cb publish %lu unexpected status: %d", seq, status);
     }
 
     _publishAttempted++;
 
-    if(issue_callbacks)
-    {
-        issue_location_publish_callbacks(status, rsp_root, req_event);
-    }
+    // reached the cloud or timed out waiting on the end-to-end ack, either
+    // way it isn't sent again
+    _publishSender.complete(seq, status, retry, req_event, rsp_root);
 
     return 0;
 }
 
-void TrackerLocation::location_publish()
+int TrackerLocation::location_send(const char *data, uint32_t req_id, uint32_t seq)
 {
-    int rval;
-    CloudService &cloud_service = CloudService::instance();
-
-    // maintain cloud service lock across the send to allow us to save off
-    // the finalized loc publish to retry on failure
-    cloud_service.lock();
-
     CloudServicePublishFlags cloud_flags =
         (_config_state.process_ack) ? CloudServicePublishFlags::FULL_ACK : CloudServicePublishFlags::NONE;
 
-    if(location_publish_retry_str)
-    {
-        // publish a retry loc
-        rval = cloud_service.send(location_publish_retry_str,
-            WITH_ACK,
-            cloud_flags,
-            &TrackerLocation::location_publish_cb, this,
-            CLOUD_DEFAULT_TIMEOUT_MS, &_last_location_publish_sec);
-    }
-    else
+    // the request id is kept with the publish so it isn't parsed back out
+    return CloudService::instance().send(data,
+        WITH_ACK,
+        cloud_flags,
+        &TrackerLocation::location_publish_cb, this,
+        CLOUD_DEFAULT_TIMEOUT_MS, (const void *) (uintptr_t) seq,
+        "loc", req_id);
+}
+
+void TrackerLocation::location_publish_done(int status, void *rsp_root, const char *req_event)
+{
+    // pending callbacks are for the latest publish only, older publishes
+    // sent from the queue released theirs already
+    if(status < 0)
     {
-        // publish a new loc (contained in cloud_service buffer)
-        rval = cloud_service.send(WITH_ACK,
-            cloud_flags,
-            &TrackerLocation::location_publish_cb, this,
-            CLOUD_DEFAULT_TIMEOUT_MS, &_last_location_publish_sec);
+        Log.error("location publish dropped %d", status);
+        issue_location_publish_callbacks(CloudServiceStatus::FAILURE, NULL, req_event);
+        return;
     }
+    issue_location_publish_callbacks((CloudServiceStatus) status, (JSONValue *) rsp_root, req_event);
+}
+
+void TrackerLocation::location_publish()
+{
+    CloudService &cloud_service = CloudService::instance();
+
+    CloudServicePublishFlags cloud_flags =
+        (_config_state.process_ack) ? CloudServicePublishFlags::FULL_ACK : CloudServicePublishFlags::NONE;
 
-    if(rval == -EBUSY)
+    // finish the publish built in the cloud service buffer and send it, it
+    // is only kept in the queue while offline or after a failed send, the
+    // cloud service lock taken to build it is kept until then
+    int rval = cloud_service.endCommand(cloud_flags);
+    if(!rval)
     {
-        // this implies a transient failure that should recover very
-        // quickly (normally another publish in progress blocking lower
-        // in the system)
-        // save off the generated publish to retry as it has already
-        // consumed pending events if applicable
-        if(!location_publish_retry_str)
+        rval = _publishSender.publish(cloud_service.writer().buffer(), cloud_service.writer().dataSize(),
+            cloud_service.commandReqId(), Particle.connected());
+        if(rval)
         {
-            size_t len = strlen(cloud_service.writer().buffer()) + 1;
-            location_publish_retry_str = (char *) malloc(len);
-            if(location_publish_retry_str)
-            {
-                memcpy(location_publish_retry_str, cloud_service.writer().buffer(), len);
-            }
-            else
-            {
-                // generated successfuly but unable to save off a copy to retry
-                issue_location_publish_callbacks(CloudServiceStatus::FAILURE, NULL, cloud_service.writer().buffer());
-            }
+            Log.error("location publish failed %d", rval);
         }
     }
-    else
+
+    // the callbacks are handed the cloud service buffer, hold the lock
+    // until they are done with it
+    if(rval)
     {
-        if(rval)
-        {
-            issue_location_publish_callbacks(CloudServiceStatus::FAILURE, NULL, location_publish_retry_str);
-        }
-        if(location_publish_retry_str)
-        {
-            // on success or fatal failure free it
-            free(location_publish_retry_str);
-            location_publish_retry_str = nullptr;
-        }
+        issue_location_publish_callbacks(CloudServiceStatus::FAILURE, NULL, cloud_service.writer().buffer());
     }
     cloud_service.unlock();
 }
@@ -626,12 +635,21 @@ void TrackerLocation::onSleepPrepare(TrackerSleepContext context) {
     if (wake > _nextEarlyWake)
         wake -= _nextEarlyWake;
 
-    if (_geofenceConfig.interval && _config_state_loop_safe.gnss && _geofence.AnyGeofenceEnabled()) {
-        unsigned int geoWake = System.uptime() + (unsigned int)_geofenceConfig.interval;
-        if (geoWake < wake) {
-            wake = geoWake;
+    if (_config_state_loop_safe.gnss && _geofence.AnyGeofenceEnabled()) {
+        auto policy = _geofence.GetWakePolicy(_geofenceConfig.receiver, (uint32_t)_geofenceConfig.interval);
+        bool receiverWake = (policy == GeofenceWakePolicy::RECEIVER) ||
+            (policy == GeofenceWakePolicy::RECEIVER_AND_INTERVAL);
+        if (receiverWake && !armGeofenceWake()) {
+            policy = (_geofenceConfig.interval) ? GeofenceWakePolicy::INTERVAL : GeofenceWakePolicy::NONE;
+        }
+
+        if ((policy == GeofenceWakePolicy::INTERVAL) || (policy == GeofenceWakePolicy::RECEIVER_AND_INTERVAL)) {
+            unsigned int geoWake = System.uptime() + (unsigned int)_geofenceConfig.interval;
+            if (geoWake < wake) {
+                wake = geoWake;
+            }
+            _pendingGeofence = true;
         }
-        _pendingGeofence = true;
     }
 
     TrackerSleepError wakeRet = _sleep.wakeAtSeconds(wake);
@@ -648,13 +666,16 @@ void TrackerLocation::onSleepPrepare(TrackerSleepContext context) {
 
 // The purpose of this callback is to alert us that sleep has been cancelled by another task or improper wake settings.
 void TrackerLocation::onSleepCancel(TrackerSleepContext context) {
-
+    disarmGeofenceWake();
 }
 
 // This callback will alert us that the system is just about to go to sleep.  This is past of the point
 // of no return to cancel the pending sleep cycle.
 void TrackerLocation::onSleep(TrackerSleepContext context) {
-    disableGnss();
+    // The GNSS module has to stay powered to evaluate the geofences
+    if (!_geofenceReceiverWake) {
+        disableGnss();
+    }
 }
 
 // This callback will be called immediately after wake from sleep and allows us to figure out if the network interface
@@ -663,6 +684,13 @@ void TrackerLocation::onWake(TrackerSleepContext context) {
     // Allow capturing of the first lock instance
     _firstLockSec = 0;
 
+    // Whether woken by a boundary crossing or not, GNSS is already running so
+    // evaluate the zones on this wake
+    if (_geofenceReceiverWake) {
+        disarmGeofenceWake();
+        _pendingGeofence = true;
+    }
+
     auto result = evaluatePublish(false);
 
     if (result.networkNeeded) {
@@ -670,7 +698,7 @@ void TrackerLocation::onWake(TrackerSleepContext context) {
         // GNSS power state handled elsewhere
         Log.trace("%s needs to start the network", __FUNCTION__);
     }
-    else if (_geofenceConfig.interval && _pendingGeofence) {
+    else if (_pendingGeofence) {
         Log.trace("%s needs to evaluate geofences", __FUNCTION__);
         _sleep.extendExecution(_sleep.getConfigConnectingTime());
     }
@@ -683,6 +711,45 @@ void TrackerLocation::onWake(TrackerSleepContext context) {
     _loopSampleTick = 0;
 }
 
+bool TrackerLocation::armGeofenceWake() {
+    // The module only reports a known state with a fix, without one it would
+    // hold off sleep for a navigation epoch only to fall back to the interval
+    if (!LocationService::instance().isLockStable()) {
+        return false;
+    }
+
+    Vector<GeofenceCircle> circles;
+    if (_geofence.GetReceiverCircles(circles) != SYSTEM_ERROR_NONE) {
+        return false;
+    }
+
+    ubx_geofence_t geofence;
+    for (auto& circle : circles) {
+        geofence.addGeofence(circle.lat, circle.lon, circle.radius);
+    }
+
+    auto ret = LocationService::instance().enableGeofenceWake(geofence);
+    if (ret) {
+        Log.warn("%s failed to offload geofences: %d", __FUNCTION__, ret);
+        return false;
+    }
+
+    // The pin is low while inside any zone, either edge is a crossing
+    _sleep.wakeFor(UBLOX_TX_READY_MCU_PIN, CHANGE);
+    _geofenceReceiverWake = true;
+    return true;
+}
+
+void TrackerLocation::disarmGeofenceWake() {
+    if (!_geofenceReceiverWake) {
+        return;
+    }
+
+    _sleep.ignore(UBLOX_TX_READY_MCU_PIN);
+    (void)LocationService::instance().disableGeofenceWake();
+    _geofenceReceiverWake = false;
+}
+
 void TrackerLocation::onSleepState(TrackerSleepContext context) {
     switch (context.reason) {
         case TrackerSleepReason::STATE_TO_CONNECTING: {
@@ -998,41 +1065,44 @@ GnssState TrackerLocation::loopLocation(LocationPoint& cur_loc) {
     return currentGnssState;
 }
 
-void TrackerLocation::buildPublish(LocationPoint& cur_loc, bool error) {
+void TrackerLocation::buildLocation(JSONWriter& writer, LocationPoint& cur_loc, bool fields) {
     bool locked = (_config_state.gnss) ? cur_loc.locked : false;
 
     if(locked) {
         LocationService::instance().setWayPoint(cur_loc.latitude, cur_loc.longitude);
     }
 
-    CloudService &cloud_service = CloudService::instance();
-    cloud_service.beginCommand("loc");
-    cloud_service.writer().name("loc").beginObject();
-    if (locked) {
-        cloud_service.writer().name("lck").value(1);
-        cloud_service.writer().name("time").value((unsigned int) cur_loc.epochTime);
-        cloud_service.writer().name("lat").value(cur_loc.latitude, 8);
-        cloud_service.writer().name("lon").value(cur_loc.longitude, 8);
+    // Without the location fields only the generated fields are written, the location goes elsewhere
+    writer.beginObject();
+    if (fields && locked) {
+        writer.name("lck").value(1);
+        writer.name("time").value((unsigned int) cur_loc.epochTime);
+        writer.name("lat").value(cur_loc.latitude, 8);
+        writer.name("lon").value(cur_loc.longitude, 8);
         if(!_config_state.min_publish)
         {
-            cloud_service.writer().name("alt").value(cur_loc.altitude, 3);
-            cloud_service.writer().name("hd").value(cur_loc.heading, 2);
-            cloud_service.writer().name("spd").value(cur_loc.speed, 2);
-            cloud_service.writer().name("h_acc").value(cur_loc.horizontalAccuracy, 3);
-            cloud_service.writer().name("hdop").value(cur_loc.horizontalDop, 1);
-            cloud_service.writer().name("v_acc").value(cur_loc.verticalAccuracy, 3);
-            cloud_service.writer().name("vdop").value(cur_loc.verticalDop, 1);
+            writer.name("alt").value(cur_loc.altitude, 3);
+            writer.name("hd").value(cur_loc.heading, 2);
+            writer.name("spd").value(cur_loc.speed, 2);
+            writer.name("h_acc").value(cur_loc.horizontalAccuracy, 3);
+            writer.name("hdop").value(cur_loc.horizontalDop, 1);
+            writer.name("v_acc").value(cur_loc.verticalAccuracy, 3);
+            writer.name("vdop").value(cur_loc.verticalDop, 1);
         }
     }
-    else {
-        cloud_service.writer().name("lck").value(0);
+    else if (fields) {
+        writer.name("lck").value(0);
     }
 
     for(auto cb : locGenCallbacks) {
-        cb(cloud_service.writer(), cur_loc);
+        cb(writer, cur_loc);
     }
 
-    cloud_service.writer().endObject();
+    writer.endObject();
+}
+
+void TrackerLocation::buildTriggers(bool error) {
+    CloudService &cloud_service = CloudService::instance();
 
     // Errors are handled separately from normal triggers so that the error doesn't cause the
     // minimum publish times to be invoked as other normal triggers would
@@ -1048,6 +1118,10 @@ void TrackerLocation::buildPublish(LocationPoint& cur_loc, bool error) {
         _pending_triggers.clear();
         cloud_service.writer().endArray();
     }
+}
+
+void TrackerLocation::buildEnhanced() {
+    CloudService &cloud_service = CloudService::instance();
 
     if (_config_state_loop_safe.enhance_loc) {
         // Request a callback of the enhanced location when made available
@@ -1062,9 +1136,210 @@ void TrackerLocation::buildPublish(LocationPoint& cur_loc, bool error) {
         remainingSize -= buildTowerInfo(cloud_service.writer(), remainingSize);
         remainingSize -= buildWpsInfo(cloud_service.writer(), remainingSize);
     }
+}
+
+void TrackerLocation::buildPublish(LocationPoint& cur_loc, bool error) {
+    CloudService &cloud_service = CloudService::instance();
+    cloud_service.beginCommand("loc");
+    cloud_service.writer().name("loc");
+    buildLocation(cloud_service.writer(), cur_loc);
+    buildTriggers(error);
+    buildEnhanced();
+
+    Log.info("%.*s", cloud_service.writer().dataSize(), cloud_service.writer().buffer());
+}
+
+#if TRACKER_LOCATION_BATCHING
+void TrackerLocation::buildBatchPublish(bool error) {
+    CloudService &cloud_service = CloudService::instance();
+    cloud_service.beginCommand("loc");
+    buildTriggers(error);
+
+    // As many of the oldest points as fit, whole, any left over go in the next publish
+    size_t used = cloud_service.writer().dataSize() + cloud_service.estimatedEndCommandSize() + 1 /* null */;
+    size_t remainingSize = (cloud_service.writer().bufferSize() > used) ?
+        cloud_service.writer().bufferSize() - used : 0;
+#if TRACKER_LOCATION_COMPACT
+    buildCompactLocations(remainingSize);
+#else
+    size_t overhead = sizeof(",\"locs\":[]") - 1 /* null */;
+    size_t count;
+    size_t size = _batch.front((remainingSize > overhead) ? remainingSize - overhead : 0, count);
+    cloud_service.writer().name("locs").beginArray();
+    cloud_service.writer().raw(_batch.data(), size);
+    cloud_service.writer().endArray();
+    _batch.pop(count);
+#endif
+
+    buildEnhanced();
 
     Log.info("%.*s", cloud_service.writer().dataSize(), cloud_service.writer().buffer());
 }
+#endif
+
+#if TRACKER_LOCATION_COMPACT
+// Encodes the oldest points of the batch, returns how many fit
+size_t TrackerLocation::encodeLocations(LocationEncoder& encoder, size_t count) {
+    size_t encoded = 0;
+    encoder.begin();
+    while ((encoded < count) && (encoded < _batchFixes.size()) && !encoder.add(_batchFixes[encoded])) {
+        encoded++;
+    }
+    return encoded;
+}
+
+// Writes the compact payload of as many of the oldest points as fit, along with their generated
+// fields when there are location generation callbacks
+void TrackerLocation::buildCompactLocations(size_t remainingSize) {
+    CloudService &cloud_service = CloudService::instance();
+    bool generated = !locGenCallbacks.isEmpty();
+    size_t overhead = (sizeof(",\"locz\":\"\"") - 1 /* null */) +
+        (generated ? (sizeof(",\"locs\":[]") - 1 /* null */) : 0);
+    LocationEncoder encoder(_compactPayload, sizeof(_compactPayload));
+    size_t count = 0;
+
+    encoder.begin();
+    while ((count < _batchFixes.size()) && !encoder.add(_batchFixes[count])) {
+        if ((encoder.text_size() + overhead > remainingSize) ||
+            (generated && (_batch.front_size(count + 1) + encoder.text_size() + overhead > remainingSize))) {
+            break;
+        }
+        count++;
+    }
+    encodeLocations(encoder, count);
+
+    encoder.text(_batchScratch, sizeof(_batchScratch));
+    cloud_service.writer().name("locz").value(_batchScratch);
+    if (generated) {
+        cloud_service.writer().name("locs").beginArray();
+        cloud_service.writer().raw(_batch.data(), _batch.front_size(count));
+        cloud_service.writer().endArray();
+    }
+    _batch.pop(count);
+    _batchFixes.removeAt(0, count);
+}
+#endif
+
+#if TRACKER_LOCATION_BATCHING
+bool TrackerLocation::batchFull() {
+#if TRACKER_LOCATION_COMPACT
+    // Room for another point of the largest size
+    LocationEncoder encoder(_compactPayload, sizeof(_compactPayload));
+    if (encodeLocations(encoder, _batchFixes.size()) < _batchFixes.size()) {
+        return true;
+    }
+    size_t generated = locGenCallbacks.isEmpty() ? 0 : _batch.size();
+    return (generated + encoder.text_size() + (LOCATION_CODEC_POINT_MAX * 4 / 3 + 4)) > _batch.capacity();
+#else
+    return _batch.full();
+#endif
+}
+
+// Publishes the points batched so far ahead of a new point, the triggers and callbacks waiting
+// are for the new point so are kept for the publish it goes in
+void TrackerLocation::publishBatchAhead() {
+    Vector<const char *> triggers;
+    {
+        std::lock_guard<RecursiveMutex> lg(mutex);
+        std::swap(triggers, _pending_triggers);
+    }
+    decltype(locPubCallbacks) callbacks;
+    std::swap(callbacks, locPubCallbacks);
+
+    publishLocation(nullptr);
+
+    callbacks.append(locPubCallbacks);
+    std::swap(callbacks, locPubCallbacks);
+    std::lock_guard<RecursiveMutex> lg(mutex);
+    for (auto trigger : triggers) {
+        bool matched = false;
+        for (auto pending : _pending_triggers) {
+            if (!strcmp(trigger, pending)) {
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            _pending_triggers.append(trigger);
+        }
+    }
+}
+
+// Returns 1 when the batch is due to be published, 0 when the point is held
+int TrackerLocation::batchLocation(LocationPoint& cur_loc) {
+    // Points are never larger than the capacity, a batch that can't take one that size is sent
+    // first rather than once the point is built, leaving the point where it is built untouched
+    if (!_batch.fits(_batch.capacity())) {
+        publishBatchAhead();
+    }
+
+    JSONBufferWriter writer(_batchScratch, sizeof(_batchScratch));
+    buildLocation(writer, cur_loc, !TRACKER_LOCATION_COMPACT);
+
+    // A point too large for an event would be cut short, drop it rather
+    // than publish it broken
+    int rval = (writer.dataSize() < sizeof(_batchScratch)) ?
+        _batch.add(_batchScratch, writer.dataSize(), System.uptime()) : -EINVAL;
+    if (rval) {
+        Log.error("location point of %u bytes not batched %d", writer.dataSize(), rval);
+        return rval;
+    }
+
+#if TRACKER_LOCATION_COMPACT
+    location_fix_t fix = {};
+    fix.time = (uint32_t) cur_loc.epochTime;
+    fix.locked = (_config_state.gnss) ? cur_loc.locked : false;
+    fix.full = !_config_state.min_publish;
+    fix.latitude = cur_loc.latitude;
+    fix.longitude = cur_loc.longitude;
+    fix.altitude = cur_loc.altitude;
+    fix.heading = cur_loc.heading;
+    fix.speed = cur_loc.speed;
+    fix.horizontalAccuracy = cur_loc.horizontalAccuracy;
+    fix.horizontalDop = cur_loc.horizontalDop;
+    fix.verticalAccuracy = cur_loc.verticalAccuracy;
+    fix.verticalDop = cur_loc.verticalDop;
+    _batchFixes.append(fix);
+#endif
+
+    return (batchFull() || (_batch.count() >= TRACKER_LOCATION_BATCH_POINTS)) ? 1 : 0;
+}
+#endif
+
+// Publishes the point, or the points batched with a null point
+void TrackerLocation::publishLocation(LocationPoint* cur_loc, bool error) {
+    if(!pendingLocPubCallbacks.isEmpty())
+    {
+        Log.info("previous publish still queued");
+        // previous publish not completed in time for new publish, it
+        // stays queued but its callbacks are issued
+        issue_location_publish_callbacks(CloudServiceStatus::TIMEOUT, NULL, nullptr);
+    }
+    Log.info("publishing now...");
+    if (cur_loc) {
+        buildPublish(*cur_loc, error);
+    }
+#if TRACKER_LOCATION_BATCHING
+    else {
+        buildBatchPublish(error);
+    }
+#endif
+    pendingLocPubCallbacks = locPubCallbacks;
+    locPubCallbacks.clear();
+
+    // Prevent flooding of first publishes when there are no acknowledges.
+    if (!_config_state.process_ack && _first_publish) {
+        _first_publish = false;
+    }
+
+    location_publish();
+
+    // There may be a delay between the first event being published and an acknowledgement
+    // from the cloud.  This leads to multiple event publishes meant to be the first publish.
+    if (_first_publish && !_pending_first_publish) {
+        _pending_first_publish = true;
+    }
+}
 
 void TrackerLocation::loop() {
     // The rest of this loop should only sample as fast as necessary
@@ -1083,7 +1358,7 @@ void TrackerLocation::loop() {
         setGnssCycle();
     }
 
-    if ((_geofenceConfig.interval && _pendingGeofence) ||
+    if (_pendingGeofence ||
         (_config_state_loop_safe.gnss && _sleep.isFullWakeCycle() && (0 != getGnssCycle()))) {
         _pendingGeofence = false;
         // This is safe to call repeatedly
@@ -1093,11 +1368,17 @@ void TrackerLocation::loop() {
         disableGnss();
     }
 
-    // First take care of any retry attempts of last loc
-    if (location_publish_retry_str && Particle.connected()) {
-        Log.info("retry failed publish");
-        location_publish();
+    // First send publishes queued while offline or waiting on a retry, each
+    // connection gets a new budget
+    _publishSender.loop(Particle.connected());
+
+#if TRACKER_LOCATION_BATCHING
+    // Batched points that waited long enough go out whether the batch is full or not
+    if (_batch.count() &&
+        (System.uptime() - _batch.oldest() >= TRACKER_LOCATION_BATCH_AGE_SEC)) {
+        publishLocation(nullptr);
     }
+#endif
 
     // Gather current location information and status
     LocationPoint cur_loc = {};
@@ -1219,22 +1500,22 @@ void TrackerLocation::loop() {
     // Perform publish of location data if requested
     //
 
-    // then of any new publish
-    if(publishNow && Particle.connected())
+    // then of any new publish, queued when offline
+    if(publishNow)
     {
-        if(location_publish_retry_str)
-        {
-            Log.info("freeing unsuccessful retry");
-            // retried attempt not completed in time for new publish
-            // drop and issue callbacks
-            issue_location_publish_callbacks(CloudServiceStatus::TIMEOUT, NULL, location_publish_retry_str);
-            free(location_publish_retry_str);
-            location_publish_retry_str = nullptr;
-        }
-        Log.info("publishing now...");
-        buildPublish(cur_loc, (0 == getGnssCycle()));
-        pendingLocPubCallbacks = locPubCallbacks;
-        locPubCallbacks.clear();
+        bool error = (0 == getGnssCycle());
+        bool batched = false;
+        bool publish = true;
+
+        // Points published for time alone are held in the batch, anything else sends the batch
+        // along with it, a point too large for the batch is dropped
+#if TRACKER_LOCATION_BATCHING
+        int rval = batchLocation(cur_loc);
+        batched = true;
+        publish = (rval > 0) ||
+            ((0 == rval) && (error || (PublishReason::TIME != publishReason.reason)));
+#endif
+
         _last_location_publish_sec = System.uptime();
         if ((_first_publish && !_pending_first_publish) || _newMonotonic)
         {
@@ -1246,17 +1527,20 @@ void TrackerLocation::loop() {
             _monotonic_publish_sec += (uint32_t)_config_state.interval_max_seconds;
         }
 
-        // Prevent flooding of first publishes when there are no acknowledges.
-        if (!_config_state.process_ack && _first_publish) {
-            _first_publish = false;
+        if (!publish) {
+#if TRACKER_LOCATION_BATCHING
+            Log.info("%u location points held", _batch.count());
+#endif
+            std::lock_guard<RecursiveMutex> lg(mutex);
+            _pending_triggers.clear();
+            // the interval starts over as if published
+            _publishAttempted++;
         }
-
-        location_publish();
-
-        // There may be a delay between the first event being published and an acknowledgement
-        // from the cloud.  This leads to multiple event publishes meant to be the first publish.
-        if (_first_publish && !_pending_first_publish) {
-            _pending_first_publish = true;
+        else if (batched) {
+            publishLocation(nullptr, error);
+        }
+        else {
+            publishLocation(&cur_loc, error);
         }
     }
 }
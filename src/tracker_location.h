@@ -20,6 +20,9 @@
 #include "cloud_service.h"
 #include "location_service.h"
 #include "motion_service.h"
+#include "location_codec.h"
+#include "publish_batch.h"
+#include "publish_queue.h"
 #include "tracker_sleep.h"
 #include "Geofence.h"
 
@@ -37,6 +40,49 @@
 // regardless
 #define TRACKER_LOCATION_INITIAL_LOCK_MAX (90)
 
+// location points sent together in one event, 0 or 1 sends each point in
+// its own event
+#ifndef TRACKER_LOCATION_BATCH_POINTS
+    #define TRACKER_LOCATION_BATCH_POINTS (0)
+#endif
+
+// send batched points once the oldest has waited this many seconds
+#ifndef TRACKER_LOCATION_BATCH_AGE_SEC
+    #define TRACKER_LOCATION_BATCH_AGE_SEC (3600)
+#endif
+
+// send points as a compact delta encoded payload in "locz" instead of json,
+// fields added by location generation callbacks go in "locs" alongside
+#ifndef TRACKER_LOCATION_COMPACT
+    #define TRACKER_LOCATION_COMPACT (false)
+#endif
+
+// points are held back to be published together, the batch and compact
+// payload buffers are only built in when they are used
+#define TRACKER_LOCATION_BATCHING ((TRACKER_LOCATION_BATCH_POINTS > 1) || TRACKER_LOCATION_COMPACT)
+
+// location publishes that can't be sent, offline or after a failed send, are
+// kept in this file until acknowledged so tracks recorded out of coverage are
+// sent once connected again
+#ifndef TRACKER_LOCATION_QUEUE_PATH
+    #define TRACKER_LOCATION_QUEUE_PATH "/usr/location.q"
+#endif
+
+// publishes kept while offline, the oldest is overwritten when full
+#ifndef TRACKER_LOCATION_QUEUE_SLOTS
+    #define TRACKER_LOCATION_QUEUE_SLOTS (PUBLISH_QUEUE_SLOTS)
+#endif
+
+// send the latest position first after an outage rather than the oldest
+#ifndef TRACKER_LOCATION_QUEUE_NEWEST_FIRST
+    #define TRACKER_LOCATION_QUEUE_NEWEST_FIRST (false)
+#endif
+
+// bytes of queued publishes sent per connection, 0 = no limit
+#ifndef TRACKER_LOCATION_QUEUE_SESSION_BUDGET
+    #define TRACKER_LOCATION_QUEUE_SESSION_BUDGET (0)
+#endif
+
 constexpr int TrackerLocationMaxWpsCollect = 20;
 constexpr int TrackerLocationMaxWpsSend = 5;
 constexpr int TrackerLocationMaxTowerSend = 3;
@@ -125,6 +171,7 @@ struct EvaluationResults {
 
 struct TrackerGeofenceConfig {
     int32_t interval; // seconds
+    bool receiver; // evaluate circular zones on the GNSS module while asleep
 };
 
 class TrackerLocation
@@ -215,7 +262,12 @@ class TrackerLocation
             _earlyWake(0),
             _nextEarlyWake(0),
             _pendingGeofence(false),
-            location_publish_retry_str(nullptr),
+            _geofenceReceiverWake(false),
+            _publishQueue(TRACKER_LOCATION_QUEUE_PATH, TRACKER_LOCATION_QUEUE_SLOTS,
+                (TRACKER_LOCATION_QUEUE_NEWEST_FIRST) ? PUBLISH_QUEUE_NEWEST_FIRST : PUBLISH_QUEUE_OLDEST_FIRST),
+            _publishSender(_publishQueue,
+                [this](const char *data, uint32_t id, uint32_t context){ return this->location_send(data, id, context); },
+                [this](int status, void *response, const char *data){ this->location_publish_done(status, response, data); }),
             _lastInterval(0),
             _publishAttempted(0),
             _monotonic_publish_sec(0),
@@ -257,8 +309,22 @@ class TrackerLocation
         unsigned int _nextEarlyWake;
         TrackerGeofenceConfig _geofenceConfig {};
         bool _pendingGeofence;
-
-        char *location_publish_retry_str;
+        bool _geofenceReceiverWake;
+
+        PublishQueue _publishQueue;
+        PublishSender _publishSender;
+
+#if TRACKER_LOCATION_BATCHING
+        // points held back to be published together
+        PublishBatch _batch;
+        // a point as it is batched, or the compact payload as text
+        char _batchScratch[particle::protocol::MAX_EVENT_DATA_LENGTH + 1];
+#endif
+#if TRACKER_LOCATION_COMPACT
+        // points of the batch for the compact payload
+        Vector<location_fix_t> _batchFixes;
+        uint8_t _compactPayload[particle::protocol::MAX_EVENT_DATA_LENGTH];
+#endif
 
         int enter_location_config_cb(bool write, const void *context);
         int exit_location_config_cb(bool write, int status, const void *context);
@@ -269,6 +335,8 @@ class TrackerLocation
 
         void issue_location_publish_callbacks(CloudServiceStatus status, JSONValue *, const char *req_event);
 
+        int location_send(const char *data, uint32_t req_id, uint32_t seq);
+        void location_publish_done(int status, void *rsp_root, const char *req_event);
         void location_publish();
 
         bool isSleepEnabled();
@@ -281,8 +349,24 @@ class TrackerLocation
         void onWake(TrackerSleepContext context);
         void onSleepState(TrackerSleepContext context);
         void onGeofenceCallback(CallbackContext& context);
+        bool armGeofenceWake();
+        void disarmGeofenceWake();
         EvaluationResults evaluatePublish(bool error);
         void buildPublish(LocationPoint& cur_loc, bool error = false);
+        void buildLocation(JSONWriter& writer, LocationPoint& cur_loc, bool fields = true);
+        void buildTriggers(bool error);
+        void buildEnhanced();
+#if TRACKER_LOCATION_BATCHING
+        void buildBatchPublish(bool error = false);
+        bool batchFull();
+        int batchLocation(LocationPoint& cur_loc);
+        void publishBatchAhead();
+#endif
+#if TRACKER_LOCATION_COMPACT
+        void buildCompactLocations(size_t remainingSize);
+        size_t encodeLocations(LocationEncoder& encoder, size_t count);
+#endif
+        void publishLocation(LocationPoint* cur_loc, bool error = false);
         GnssState loopLocation(LocationPoint& cur_loc);
         static int parseServeCell(const char* in, CellularServing& out);
         size_t buildTowerInfo(JSONBufferWriter& writer, size_t size);